@@ -128,10 +128,18 @@ Analysis::Raw::writeAsText(/*destination,*/ const char* filenm, bool sm_easyToGr
 void
 Analysis::Raw::writeAsText_callpath(const char* filenm, bool sm_easyToGrep)
 {
-  if (!filenm) { return; }
+  writeAsText_callpath(filenm, stdout, sm_easyToGrep, NULL);
+}
+
+
+bool
+Analysis::Raw::writeAsText_callpath(const char* filenm, FILE* outfs, bool sm_easyToGrep,
+                                    const Prof::CallPath::Profile::TextFilter* filter)
+{
+  if (!filenm) { return false; }
 
   try {
-    Prof::CallPath::Profile::make(filenm, stdout, sm_easyToGrep);
+    return Prof::CallPath::Profile::make(filenm, outfs, sm_easyToGrep, filter);
   }
   catch (...) {
     DIAG_EMsg("While reading '" << filenm << "'...");
@@ -257,7 +265,8 @@ Analysis::Raw::writeAsText_profiledb(const char* filenm, bool easygrep)
           case IDTUPLE_GPUDEVICE: std::cout << "GPUDEVICE"; break;
           case IDTUPLE_GPUCONTEXT: std::cout << "GPUCONTEXT"; break;
           case IDTUPLE_GPUSTREAM: std::cout << "GPUSTREAM"; break;
-          case IDTUPLE_CORE: std::cout << "CORE";
+          case IDTUPLE_CORE: std::cout << "CORE"; break;
+          case IDTUPLE_SNAPSHOT: std::cout << "SNAPSHOT";
           }
           std::cout << " " << std::dec << elem.logicalId << std::hex;
           if(elem.isPhysical)
@@ -553,13 +562,14 @@ Analysis::Raw::writeAsText_tracedb(const char* filenm)
     fmt_tracedb_fHdr_t fhdr;
     { // trace.db file header
       rewind(fs);
-      char buf[FMT_CCTDB_SZ_FHdr];
+      char buf[FMT_TRACEDB_SZ_FHdr];
       if(fread(buf, 1, sizeof buf, fs) < sizeof buf)
-        DIAG_Throw("eof reading cct.db file header");
+        DIAG_Throw("eof reading trace.db file header");
       fmt_tracedb_fHdr_read(&fhdr, buf);
       std::cout << std::hex <<
         "[file header:\n"
         "  (szCtxTraces: 0x" << fhdr.szCtxTraces << ") (pCtxTraces: 0x" << fhdr.pCtxTraces << ")\n"
+        "  (szCtxTraceSums: 0x" << fhdr.szCtxTraceSums << ") (pCtxTraceSums: 0x" << fhdr.pCtxTraceSums << ")\n"
         "]\n" << std::dec;
     }
 
@@ -591,7 +601,37 @@ Analysis::Raw::writeAsText_tracedb(const char* filenm)
       std::cout << "]\n" << std::dec;
     }
 
-    // Rest of the file is context traces. Output is in file order.
+    fmt_tracedb_ctxTraceSumSHdr_t sumshdr;
+    std::vector<fmt_tracedb_ctxTraceSum_t> ctxTraceSums;
+    if(fhdr.pCtxTraceSums != 0) { // Context Trace Summaries section
+      if(fseeko(fs, fhdr.pCtxTraceSums, SEEK_SET) < 0)
+        DIAG_Throw("error seeking to trace.db Context Trace Summaries section");
+      std::vector<char> buf(fhdr.szCtxTraceSums);
+      if(fread(buf.data(), 1, buf.size(), fs) < buf.size())
+        DIAG_Throw("eof reading trace.db Context Trace Summaries section");
+
+      fmt_tracedb_ctxTraceSumSHdr_read(&sumshdr, buf.data());
+      std::cout << std::hex <<
+        "[context trace summaries:\n"
+        "  (pSummaries: 0x" << sumshdr.pSummaries << ") (nSummaries: " << std::dec << sumshdr.nSummaries << std::hex << ")\n"
+        "  (szSummary: 0x" << (unsigned int)sumshdr.szSummary << " >= 0x" << FMT_TRACEDB_SZ_CtxTraceSum << ")\n"
+        "  (szBucket: 0x" << sumshdr.szBucket << ")\n" << std::dec <<
+        "  (nLevels: " << (unsigned int)sumshdr.nLevels << ") (nHist: " << (unsigned int)sumshdr.nHist
+        << ") (ctxDepth: " << (unsigned int)sumshdr.ctxDepth << ")\n";
+      for(uint32_t i = 0; i < sumshdr.nSummaries; i++) {
+        fmt_tracedb_ctxTraceSum_t cts;
+        fmt_tracedb_ctxTraceSum_read(&cts, &buf[sumshdr.pSummaries + i * sumshdr.szSummary - fhdr.pCtxTraceSums]);
+        ctxTraceSums.push_back(cts);
+        std::cout << "  [pSummaries[" << std::dec << i << "]:\n" <<
+          "    (profIndex: " << cts.profIndex << ")\n"
+          "    (startTimestamp: " << cts.startTimestamp << ") (bucketWidth: " << cts.bucketWidth << ")\n"
+          << std::hex << "    (pBuckets: 0x" << cts.pBuckets << ")\n"
+          "  ]\n";
+      }
+      std::cout << "]\n" << std::dec;
+    }
+
+    // Rest of the file is context traces and their summaries. Output is in file order.
     std::sort(ctxTraces.begin(), ctxTraces.end(), [](const auto& a, const auto& b){
       return a.pStart < b.pStart;
     });
@@ -612,6 +652,42 @@ Analysis::Raw::writeAsText_tracedb(const char* filenm)
       std::cout << "]\n";
     }
 
+    std::sort(ctxTraceSums.begin(), ctxTraceSums.end(), [](const auto& a, const auto& b){
+      return a.pBuckets < b.pBuckets;
+    });
+    for(const auto& cts: ctxTraceSums) {
+      if(cts.pBuckets == 0) continue;
+      std::cout << std::hex << "(0x" << cts.pBuckets << ") [context trace summary:\n" << std::dec;
+      for(uint8_t l = 0; l < sumshdr.nLevels; l++) {
+        const uint64_t nBuckets = UINT64_C(1) << l;
+        if(fseeko(fs, fmt_tracedb_ctxTraceSum_pLevel(&sumshdr, &cts, l), SEEK_SET) < 0)
+          DIAG_Throw("error seeking to trace.db context trace summary level");
+        std::vector<char> buf(nBuckets * sumshdr.szBucket);
+        if(fread(buf.data(), 1, buf.size(), fs) < buf.size())
+          DIAG_Throw("eof reading trace.db context trace summary level");
+
+        const uint64_t width = fmt_tracedb_ctxTraceSum_levelWidth(&sumshdr, &cts, l);
+        std::cout << "  [level " << (unsigned int)l << " (width: " << width << "):\n";
+        for(uint64_t i = 0; i < nBuckets; i++) {
+          const char* cur = &buf[i * sumshdr.szBucket];
+          fmt_tracedb_ctxSumBucket_t bkt;
+          fmt_tracedb_ctxSumBucket_read(&bkt, cur);
+          std::cout << "    (start: " << cts.startTimestamp + i * width
+                    << ", ctxId: " << bkt.ctxId << ") [";
+          for(uint8_t h = 0; h < sumshdr.nHist; h++) {
+            fmt_tracedb_ctxSumHist_t hist;
+            fmt_tracedb_ctxSumHist_read(&hist, cur + FMT_TRACEDB_SZ_CtxSumBucket
+                                               + h * FMT_TRACEDB_SZ_CtxSumHist);
+            if(hist.share == 0) continue;
+            std::cout << " " << hist.ctxId << ":" << (double)hist.share / UINT32_MAX;
+          }
+          std::cout << " ]\n";
+        }
+        std::cout << "  ]\n";
+      }
+      std::cout << "]\n";
+    }
+
     { // File footer
       char buf[sizeof fmt_tracedb_footer + 1];
       if(fseeko(fs, -sizeof fmt_tracedb_footer, SEEK_END) < 0)
@@ -1091,6 +1167,41 @@ Analysis::Raw::writeAsText_callpathTrace(const char* filenm)
 
     hpctrace_fmt_hdr_fprint(&hdr, stdout);
 
+    if (HPCTRACE_HDR_FLAGS_GET_BIT(hdr.flags, HPCTRACE_HDR_FLAGS_BLOCKED_BIT_POS)) {
+      hpctrace_fmt_trailer_t trailer;
+      bool hasTrailer;
+      uint64_t end = hpctrace_fmt_blocks_end(fs, &trailer, &hasTrailer);
+
+      // Walk the block headers; the index repeats them
+      uint64_t off = ftello(fs);
+      while (off + HPCTRACE_FMT_BlockHdrLen <= end) {
+        hpctrace_fmt_block_hdr_t bhdr;
+        if (hpctrace_fmt_block_hdr_fread(&bhdr, fs) != HPCFMT_OK) {
+          DIAG_Throw("error reading trace block in '" << filenm << "'");
+        }
+        hpctrace_fmt_block_hdr_fprint(&bhdr, off, stdout);
+        for (uint32_t i = 0; i < bhdr.count; ++i) {
+          hpctrace_fmt_datum_t datum;
+          if (hpctrace_fmt_datum_fread(&datum, hdr.flags, fs) != HPCFMT_OK) {
+            DIAG_Throw("error reading trace file '" << filenm << "'");
+          }
+          hpctrace_fmt_datum_fprint(&datum, hdr.flags, stdout);
+        }
+        off = ftello(fs);
+      }
+
+      if (hasTrailer) {
+        printf("[block index: (blocks: %" PRIu64 ") (offset: %" PRIu64 ")]\n",
+               trailer.num_blocks, trailer.index_offset);
+      }
+      else {
+        printf("[no block index: trace is incomplete]\n");
+      }
+
+      hpcio_fclose(fs);
+      return;
+    }
+
     // Read trace records and exit on EOF
     while ( !feof(fs) ) {
       hpctrace_fmt_datum_t datum;
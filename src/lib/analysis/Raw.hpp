@@ -63,9 +63,12 @@
 //************************* System Include Files ****************************
 
 #include <string>
+#include <cstdio>
 
 //*************************** User Include Files ****************************
 
+#include "../prof/CallPath-Profile.hpp"
+
 #include "../prof-lean/hpcrun-fmt.h"
 #include "../prof-lean/id-tuple.h"
 
@@ -84,6 +87,13 @@ writeAsText(/*destination,*/ const char* filenm, bool sm_easyToGrep);
 void
 writeAsText_callpath(/*destination,*/ const char* filenm, bool sm_easyToGrep);
 
+// Writes the textual form of the hpcrun profile 'filenm' to 'outfs',
+// restricted by 'filter' (if non-NULL).  Returns false if 'filter'
+// rejected the whole profile.
+bool
+writeAsText_callpath(const char* filenm, FILE* outfs, bool sm_easyToGrep,
+                     const Prof::CallPath::Profile::TextFilter* filter);
+
 void
 writeAsText_profiledb(const char* filenm, bool sm_easyToGrep);
 
@@ -78,9 +78,14 @@
 
 #include <string.h>
 
+#include <atomic>
+#include <chrono>
 #include <list>
+#include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -151,6 +156,116 @@ closeSymtab()
 
 //***************************************************************************
 
+// Memo caches for demangled proc names and callsite realpaths.  Large
+// C++ template code repeats the same few thousand names millions of
+// times, so these are shared across all work items (threads).  Every
+// work item uses the same search paths, so the realpath of a given
+// callsite file name is the same in every RealPathMgr.
+
+typedef unordered_map <string, string> NameCache;
+
+static NameCache demangleCache;
+static NameCache realpathCache;
+static shared_mutex demangleMutex;
+static shared_mutex realpathMutex;
+
+static atomic <long> num_sweeps(0);
+static atomic <long> num_sweep_addrs(0);
+static atomic <long> num_fallback_addrs(0);
+static atomic <long> num_seqns(0);
+static atomic <long> num_demangle(0);
+static atomic <long> num_demangle_hits(0);
+static atomic <long> num_realpath(0);
+static atomic <long> num_realpath_hits(0);
+static atomic <long> sweep_nsec(0);
+
+static string
+lookupCache(NameCache & cache, shared_mutex & mtx, const string & key, bool & found)
+{
+  shared_lock <shared_mutex> lock (mtx);
+  auto it = cache.find(key);
+
+  found = (it != cache.end());
+  return found ? it->second : string();
+}
+
+static void
+insertCache(NameCache & cache, shared_mutex & mtx, const string & key,
+            const string & val)
+{
+  unique_lock <shared_mutex> lock (mtx);
+  cache.emplace(key, val);
+}
+
+static string
+demangleName(const string & procnm)
+{
+  if (procnm == "") {
+    return UNKNOWN_PROC;
+  }
+
+  bool found;
+  string prettynm = lookupCache(demangleCache, demangleMutex, procnm, found);
+
+  num_demangle++;
+  if (found) {
+    num_demangle_hits++;
+    return prettynm;
+  }
+
+  prettynm = BinUtil::demangleProcName(procnm);
+  insertCache(demangleCache, demangleMutex, procnm, prettynm);
+
+  return prettynm;
+}
+
+static void
+realpathName(string & filenm, RealPathMgr * realPath)
+{
+  if (filenm == "" || realPath == NULL) {
+    return;
+  }
+
+  bool found;
+  string path = lookupCache(realpathCache, realpathMutex, filenm, found);
+
+  num_realpath++;
+  if (found) {
+    num_realpath_hits++;
+    filenm = path;
+    return;
+  }
+
+  string orig = filenm;
+  realPath->realpath(filenm);
+  insertCache(realpathCache, realpathMutex, orig, filenm);
+}
+
+// The inline node for the call site of inlined func 'func'.
+static InlineNode
+makeInlineNode(FunctionBase * func, RealPathMgr * realPath)
+{
+  InlinedFunction *ifunc = static_cast <InlinedFunction *> (func);
+  pair <string, Offset> callsite = ifunc->getCallsite();
+  string filenm = callsite.first;
+  realpathName(filenm, realPath);
+  long lineno = callsite.second;
+
+  // symtab does not provide mangled and pretty names for
+  // inlined functions, so we have to decide this ourselves
+  string prettynm = demangleName(func->getName());
+
+#if DEBUG_INLINE_SEQNS
+  cout << "\nl=" << lineno << "  file:  " << filenm << "\n"
+       << "symtab:  " << func->getName() << "\n"
+       << "demang:  " << prettynm << "\n";
+#endif
+
+  return InlineNode(filenm, prettynm, lineno);
+}
+
+//***************************************************************************
+
 // Returns nodelist as a list of InlineNodes for the inlined sequence
 // at VMA addr.  The front of the list is the outermost frame, back is
 // innermost.
@@ -175,26 +290,7 @@ analyzeAddr(InlineSeqn & nodelist, VMA addr, RealPathMgr * realPath)
       //
       // func is inlined iff it has a parent
       //
-      InlinedFunction *ifunc = static_cast <InlinedFunction *> (func);
-      pair <string, Offset> callsite = ifunc->getCallsite();
-      string filenm = callsite.first;
-      if (filenm != "") { realPath->realpath(filenm); }
-      long lineno = callsite.second;
-
-      // symtab does not provide mangled and pretty names for
-      // inlined functions, so we have to decide this ourselves
-      string procnm = func->getName();
-      string prettynm =
-          (procnm == "") ? UNKNOWN_PROC : BinUtil::demangleProcName(procnm);
-
-#if DEBUG_INLINE_SEQNS
-      cout << "\n0x" << hex << addr << dec
-           << "  l=" << lineno << "  file:  " << filenm << "\n"
-           << "0x" << hex << addr << "  symtab:  " << procnm << "\n"
-           << "0x" << addr << dec << "  demang:  " << prettynm << "\n";
-#endif
-
-      nodelist.push_front(InlineNode(filenm, prettynm, lineno));
+      nodelist.push_front(makeInlineNode(func, realPath));
 
       func = parent;
       parent = func->getInlinedParent();
@@ -206,6 +302,190 @@ analyzeAddr(InlineSeqn & nodelist, VMA addr, RealPathMgr * realPath)
 
 //***************************************************************************
 
+// Enumerate the inlined ranges of 'func' covering [st, en) and paint
+// them into the segment map.  If symtab has no containing function,
+// then every lookup falls back to analyzeAddr().
+//
+void
+InlineSweep::sweep(SymtabAPI::Function * func, VMA st, VMA en)
+{
+  auto time_start = chrono::steady_clock::now();
+
+  clear();
+
+  if (the_symtab == NULL || func == NULL || en <= st) {
+    return;
+  }
+
+  start = st;
+  end = en;
+  valid = true;
+
+  const auto & ranges = func->getRanges();
+
+  for (auto rit = ranges.begin(); rit != ranges.end(); ++rit) {
+    funcRanges.push_back(make_pair((VMA) rit->low(), (VMA) rit->high()));
+  }
+
+  const auto & inlines = func->getInlines();
+
+  for (auto iit = inlines.begin(); iit != inlines.end(); ++iit) {
+    addInlines(*iit, NULL);
+  }
+
+  num_sweeps++;
+  sweep_nsec += chrono::duration_cast <chrono::nanoseconds>
+      (chrono::steady_clock::now() - time_start).count();
+}
+
+void
+InlineSweep::clear()
+{
+  // the per-address counts are kept locally to avoid contention
+  num_sweep_addrs += num_swept;
+  num_fallback_addrs += num_fallback;
+  num_swept = 0;
+  num_fallback = 0;
+
+  segMap.clear();
+  seqnMap.clear();
+  funcRanges.clear();
+  start = 0;
+  end = 0;
+  valid = false;
+}
+
+// Parents are painted before their children, so the innermost
+// inlined func wins.  'parent' is NULL for the top-level inlines,
+// whose parent (the symtab func) is not in the map.
+//
+void
+InlineSweep::addInlines(FunctionBase * func, FunctionBase * parent)
+{
+  const auto & ranges = func->getRanges();
+
+  for (auto rit = ranges.begin(); rit != ranges.end(); ++rit) {
+    VMA lo = std::max((VMA) rit->low(), start);
+    VMA hi = std::min((VMA) rit->high(), end);
+
+    if (lo < hi) {
+      paint(lo, hi, func, parent);
+    }
+  }
+
+  const auto & inlines = func->getInlines();
+
+  for (auto iit = inlines.begin(); iit != inlines.end(); ++iit) {
+    addInlines(*iit, func);
+  }
+}
+
+// Assign [lo, hi) to 'func', but only over the parts that currently
+// belong to 'parent' (or are unclaimed, for top-level inlines).  If
+// two siblings overlap, then the first one wins.  This matches
+// symtab's own top-down search for the containing inline.
+//
+void
+InlineSweep::paint(VMA lo, VMA hi, FunctionBase * func, FunctionBase * parent)
+{
+  VMA pos = lo;
+
+  while (pos < hi) {
+    auto it = segMap.upper_bound(pos);
+
+    if (it != segMap.begin()) {
+      auto prev = it;  --prev;
+      VMA seg_start = prev->first;
+      Segment seg = prev->second;
+
+      if (pos < seg.end) {
+        // pos is inside an existing segment
+        VMA seg_end = std::min(seg.end, hi);
+
+        if (seg.func == parent) {
+          if (seg_start < pos) {
+            prev->second.end = pos;
+          } else {
+            segMap.erase(prev);
+          }
+          segMap[pos] = Segment(seg_end, func);
+          if (seg_end < seg.end) {
+            segMap[seg_end] = Segment(seg.end, parent);
+          }
+        }
+        pos = seg_end;
+        continue;
+      }
+    }
+
+    // pos is unclaimed up to the next segment.  only the top-level
+    // inlines claim new space, a child never extends past its parent.
+    VMA next = (it == segMap.end()) ? hi : std::min(hi, it->first);
+
+    if (parent == NULL) {
+      segMap[pos] = Segment(next, func);
+    }
+    pos = next;
+  }
+}
+
+// The seqn for an inlined func is its parent's seqn plus the call
+// site for this func.  Build each one only once.
+//
+const InlineSeqn &
+InlineSweep::getSeqn(FunctionBase * func)
+{
+  auto sit = seqnMap.find(func);
+
+  if (sit != seqnMap.end()) {
+    return sit->second;
+  }
+
+  InlineSeqn seqn;
+  FunctionBase * parent = func->getInlinedParent();
+
+  if (parent != NULL) {
+    seqn = getSeqn(parent);
+    seqn.push_back(makeInlineNode(func, realPath));
+  }
+  num_seqns++;
+
+  return seqnMap[func] = seqn;
+}
+
+bool
+InlineSweep::analyzeAddr(InlineSeqn & nodelist, VMA addr)
+{
+  if (valid && start <= addr && addr < end) {
+    auto it = segMap.upper_bound(addr);
+
+    if (it != segMap.begin()) {
+      --it;
+      if (addr < it->second.end) {
+        num_swept++;
+        nodelist = getSeqn(it->second.func);
+        return true;
+      }
+    }
+
+    // not inlined, but only if addr is inside the func itself
+    for (auto rit = funcRanges.begin(); rit != funcRanges.end(); ++rit) {
+      if (rit->first <= addr && addr < rit->second) {
+        num_swept++;
+        nodelist.clear();
+        return true;
+      }
+    }
+  }
+
+  num_fallback++;
+  return Inline::analyzeAddr(nodelist, addr, realPath);
+}
+
+//***************************************************************************
+
+//***************************************************************************
+
 // Insert one statement range into the map.
 //
 // Note: we pass the stmt info in 'sinfo', but we don't link sinfo
@@ -302,14 +582,14 @@ StmtMap::insert(StmtInfo * sinfo)
 // adjacent stmts if their file and line match.
 //
 void
-addStmtToTree(TreeNode * root, HPC::StringTable & strTab, RealPathMgr * realPath,
+addStmtToTree(TreeNode * root, HPC::StringTable & strTab, InlineSweep & inlineSweep,
               VMA vma, int len, string & filenm, SrcFile::ln line,
               string & device, bool is_call, bool is_sink, VMA target)
 {
   InlineSeqn path;
   TreeNode *node;
 
-  analyzeAddr(path, vma, realPath);
+  inlineSweep.analyzeAddr(path, vma);
 
   // follow 'path' down the tree and insert any edges that don't exist
   node = root;
@@ -440,4 +720,26 @@ mergeInlineLoop(TreeNode * dest, FLPSeqn & path, LoopInfo * info)
   dest->loopList.push_back(info);
 }
 
+//***************************************************************************
+
+// Print and reset the inline analysis stats for hpcstruct --time.
+// The sweep time is summed over all threads.
+//
+void
+printStats(std::ostream & os)
+{
+  long demangle = num_demangle.exchange(0);
+  long demangle_hits = num_demangle_hits.exchange(0);
+  long realpath = num_realpath.exchange(0);
+  long realpath_hits = num_realpath_hits.exchange(0);
+
+  os << "inline:  sweeps: " << num_sweeps.exchange(0)
+     << "  time: " << ((double) sweep_nsec.exchange(0) / 1.0e9) << " sec"
+     << "  seqns: " << num_seqns.exchange(0) << "\n"
+     << "inline:  addrs swept: " << num_sweep_addrs.exchange(0)
+     << "  fallback: " << num_fallback_addrs.exchange(0) << "\n"
+     << "inline:  demangle: " << demangle_hits << "/" << demangle << " cached"
+     << "  realpath: " << realpath_hits << "/" << realpath << " cached\n";
+}
+
 }  // namespace Inline
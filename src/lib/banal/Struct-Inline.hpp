@@ -69,6 +69,9 @@
 
 #include <list>
 #include <map>
+#include <ostream>
+#include <utility>
+#include <vector>
 
 #include "../isa/ISATypes.hpp"
 #include "../support/FileUtil.hpp"
@@ -353,6 +356,71 @@ public:
   }
 };
 
+// Inline sequences for one symtab function, computed in one sweep.
+//
+// Rather than ask symtab for the inline chain of every instruction
+// separately, enumerate the inlined ranges of the function once and
+// paint them into a map of disjoint intervals where the innermost
+// inlined function wins.  The InlineSeqn for each inlined function is
+// built once, from its parent's seqn, and then shared by every
+// address in its ranges.
+//
+// Addresses outside the swept function's ranges (eg, call sites in
+// another function of the group) fall back to analyzeAddr().
+//
+class InlineSweep {
+private:
+  class Segment {
+  public:
+    VMA  end;
+    FunctionBase * func;
+
+    Segment(VMA en = 0, FunctionBase * fn = NULL)
+    {
+      end = en;
+      func = fn;
+    }
+  };
+
+  typedef map <VMA, Segment> SegmentMap;
+  typedef map <FunctionBase *, InlineSeqn> SeqnMap;
+  typedef vector <pair <VMA, VMA>> RangeList;
+
+  SegmentMap  segMap;
+  SeqnMap  seqnMap;
+  RangeList  funcRanges;
+  RealPathMgr * realPath;
+  VMA  start;
+  VMA  end;
+  long num_swept;
+  long num_fallback;
+  bool valid;
+
+  void addInlines(FunctionBase * func, FunctionBase * parent);
+  void paint(VMA lo, VMA hi, FunctionBase * func, FunctionBase * parent);
+  const InlineSeqn & getSeqn(FunctionBase * func);
+
+public:
+  InlineSweep(RealPathMgr * rp = NULL)
+  {
+    realPath = rp;
+    start = 0;
+    end = 0;
+    num_swept = 0;
+    num_fallback = 0;
+    valid = false;
+  }
+
+  void setRealPath(RealPathMgr * rp) { realPath = rp; }
+
+  // enumerate the inlined ranges for 'func' covering [st, en)
+  void sweep(SymtabAPI::Function * func, VMA st, VMA en);
+
+  void clear();
+
+  bool analyzeAddr(InlineSeqn & nodelist, VMA addr);
+};
+
 //***************************************************************************
 
 Symtab * openSymtab(ElfFile *elfFile);
@@ -361,7 +429,7 @@ bool closeSymtab();
 bool analyzeAddr(InlineSeqn & nodelist, VMA addr, RealPathMgr *);
 
 void
-addStmtToTree(TreeNode * root, HPC::StringTable & strTab, RealPathMgr *,
+addStmtToTree(TreeNode * root, HPC::StringTable & strTab, InlineSweep &,
               VMA vma, int len, string & filenm, SrcFile::ln line,
               std::string & device, bool is_call = false, bool is_sink = false,
               VMA target = 0);
@@ -378,6 +446,10 @@ mergeInlineTree(TreeNode * dest, TreeNode * src);
 void
 mergeInlineLoop(TreeNode * dest, FLPSeqn & path, LoopInfo * info);
 
+// statistics for hpcstruct --time
+void
+printStats(std::ostream & os);
+
 }  // namespace Inline
 
 #endif
@@ -130,11 +130,11 @@ static bool enable_call_tags = false;
 
 #if USE_INDEX_NUMBERS
 // this generates pre-order
-#define INDEX  " i=\"" << next_index++ << "\""
+#define INDEX(index)  " i=\"" << (index)++ << "\""
 #define INDEX_MARKER  "<>i"
 
 #else
-#define INDEX         ""
+#define INDEX(index)  ""
 #define INDEX_MARKER  ""
 #endif
 
@@ -183,7 +183,8 @@ public:
 };
 
 static void
-doGaps(ostream *, ostream *, string, FileInfo *, GroupInfo *, ProcInfo *);
+doGaps(ostream *, ostream *, string, FileInfo *, GroupInfo *, ProcInfo *,
+       long &, long &);
 
 static void
 doTreeNode(ostream *, int, TreeNode *, ScopeInfo, HPC::StringTable &);
@@ -270,7 +271,7 @@ printLoadModuleBegin(ostream * os, string lmName, bool has_calls)
   next_index = INIT_LM_INDEX;
 
   *os << "<LM"
-      << INDEX
+      << INDEX(next_index)
       << STRING("n", lmName)
       << " has-calls=\"" << (has_calls ? "1" : "0") << "\" v=\"{}\">\n";
 }
@@ -288,9 +289,9 @@ printLoadModuleEnd(ostream * os)
 
 //----------------------------------------------------------------------
 
-// Begin <F> file tag.
+// Begin <F> file tag.  'index' is from reserveIndexes().
 void
-printFileBegin(ostream * os, FileInfo * finfo)
+printFileBegin(ostream * os, FileInfo * finfo, long & index)
 {
   if (os == NULL || finfo == NULL) {
     return;
@@ -298,7 +299,7 @@ printFileBegin(ostream * os, FileInfo * finfo)
 
   doIndent(os, 1);
   *os << "<F"
-      << INDEX
+      << INDEX(index)
       << STRING("n", finfo->fileName)
       << ">\n";
 }
@@ -367,16 +368,80 @@ earlyFormatProc(ostream * os, FileInfo * finfo, GroupInfo * ginfo, ProcInfo * pi
 
 //----------------------------------------------------------------------
 
+//
+// Count the index numbers and .gaps file lines that finalPrintProc()
+// will use for 'buf'.  This runs concurrently with other procs, so
+// that the serial part only needs to reserve a range of numbers.
+//
+void
+countProcIndexes(string & buf, bool do_gaps, GroupInfo * ginfo,
+                 long & num_index, long & num_gaps_lines)
+{
+  num_index = 0;
+  num_gaps_lines = 0;
+
+  for (size_t pos = buf.find(MARKER); pos != string::npos;
+       pos = buf.find(MARKER, pos + MARKER_LEN + 1))
+  {
+    switch (buf[pos + MARKER_LEN]) {
+    case 'g':
+      // see doGaps()
+      if (do_gaps && ! ginfo->gapSet.empty()) {
+#if USE_INDEX_NUMBERS
+        num_index += 2 + ginfo->gapSet.size();
+#endif
+        num_gaps_lines += 6 + ginfo->gapSet.size();
+      }
+      break;
+
+    case 'i':
+      num_index++;
+      break;
+
+    default:
+      break;
+    }
+  }
+}
+
+// Reserve 'num' consecutive index numbers or .gaps file lines and
+// return the first one.  This must be called in output order, locked
+// or single threaded, but it's cheap.
+//
+long
+reserveIndexes(long num)
+{
+  long first = next_index;
+
+  next_index += num;
+  return first;
+}
+
+long
+reserveGapsLines(long num)
+{
+  long first = gaps_line;
+
+  gaps_line += num;
+  return first;
+}
+
+//----------------------------------------------------------------------
+
 //
 // Do the final translation of the index and gaps markers (<>i, <>g)
 // from 'buf' and write the output to 'os' (hpcstruct file) and 'gaps'
-// (gaps file, if used).  This part is run serial, inside a lock.
+// (gaps file, if used).  The index and gaps line numbers start at
+// 'index' and 'gaps_line' from reserveIndexes() and
+// reserveGapsLines(), so this can run concurrently for different
+// groups, each writing to its own buffer.
 //
 // Note: this is called once per group, where pinfo is the group leader.
 //
 void
 finalPrintProc(ostream * os, ostream * gaps, string & buf, string & gaps_filenm,
-               FileInfo * finfo, GroupInfo * ginfo, ProcInfo * pinfo)
+               FileInfo * finfo, GroupInfo * ginfo, ProcInfo * pinfo,
+               long & index, long & gaps_line)
 {
   // if no index or gaps, then nothing to translate, just dump 'buf'
   // directly to 'os'
@@ -402,11 +467,11 @@ finalPrintProc(ostream * os, ostream * gaps, string & buf, string & gaps_filenm,
 
     switch (buf[pos + MARKER_LEN]) {
     case 'g':
-      doGaps(os, gaps, gaps_filenm, finfo, ginfo, pinfo);
+      doGaps(os, gaps, gaps_filenm, finfo, ginfo, pinfo, index, gaps_line);
       break;
 
     case 'i':
-      *os << INDEX;
+      *os << INDEX(index);
       break;
 
     default:
@@ -431,7 +496,8 @@ finalPrintProc(ostream * os, ostream * gaps, string & buf, string & gaps_filenm,
 //
 static void
 doGaps(ostream * os, ostream * gaps, string gaps_file,
-       FileInfo * finfo, GroupInfo * ginfo, ProcInfo * pinfo)
+       FileInfo * finfo, GroupInfo * ginfo, ProcInfo * pinfo,
+       long & index, long & gaps_line)
 {
   if (gaps == NULL || ginfo->gapSet.empty()) {
     return;
@@ -445,7 +511,7 @@ doGaps(ostream * os, ostream * gaps, string gaps_file,
 
   doIndent(os, 3);
   *os << "<A"
-      << INDEX
+      << INDEX(index)
       << NUMBER("l", pinfo->line_num)
       << STRING("f", finfo->fileName)
       << STRING("n", "")
@@ -454,7 +520,7 @@ doGaps(ostream * os, ostream * gaps, string gaps_file,
 
   doIndent(os, 4);
   *os << "<A"
-      << INDEX
+      << INDEX(index)
       << NUMBER("l", gaps_line - 4)
       << STRING("f", gaps_file)
       << STRING("n", "unclaimed region in: " + pinfo->prettyName)
@@ -472,7 +538,7 @@ doGaps(ostream * os, ostream * gaps, string gaps_file,
 
     doIndent(os, 5);
     *os << "<S"
-        << INDEX
+        << INDEX(index)
         << NUMBER("l", gaps_line)
         << VRANGE(start, len)
         << "/>\n";
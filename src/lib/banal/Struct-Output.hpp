@@ -72,14 +72,19 @@ void printStructFileEnd(ostream *, ostream *);
 void printLoadModuleBegin(ostream *, string, bool has_calls);
 void printLoadModuleEnd(ostream *);
 
-void printFileBegin(ostream *, FileInfo *);
+void printFileBegin(ostream *, FileInfo *, long &);
 void printFileEnd(ostream *, FileInfo *);
 
 void earlyFormatProc(ostream *, FileInfo *, GroupInfo *, ProcInfo *,
                      bool, HPC::StringTable & strTab);
 
+void countProcIndexes(string &, bool, GroupInfo *, long &, long &);
+
+long reserveIndexes(long);
+long reserveGapsLines(long);
+
 void finalPrintProc(ostream *, ostream *, string &, string &,
-                    FileInfo *, GroupInfo *, ProcInfo *);
+                    FileInfo *, GroupInfo *, ProcInfo *, long &, long &);
 
 void setPrettyPrint(bool _pretty_print_output);
 
@@ -218,13 +218,19 @@ static FileMap *
 makeSkeleton(CodeObject *, const string &);
 
 static void
-doWorkItem(WorkItem *, string &, bool, bool);
+doWorkItem(WorkItem *, RealPathMgr *, bool, bool);
+
+static void
+reserveWorkList(WorkList &);
+
+static void
+finalFormatWorkItem(WorkItem *, string &, bool);
 
 static void
 makeWorkList(FileMap *, WorkList &, WorkList &);
 
 static void
-printWorkList(WorkList &, unsigned int &, ostream *, ostream *, string &);
+printWorkList(WorkList &, unsigned int &, ostream *, ostream *);
 
 static void
 doFunctionList(WorkEnv &, FileInfo *, GroupInfo *, bool);
@@ -351,13 +357,17 @@ public:
 
 //----------------------------------------------------------------------
 
-// The environment for interpreting paths, strings, etc.  We allocate
-// one environ per thread to avoid lock contention.
+// The environment for interpreting paths, strings, etc.  The path
+// manager is shared by all threads (lock-free for paths already
+// seen).  The string table and inline sweep are per work item: the
+// inline trees are ordered by string index (FLPCompare), so the
+// indices must not depend on how the threads interleave.
 //
 class WorkEnv {
 public:
   HPC::StringTable * strTab;
   RealPathMgr * realPath;
+  Inline::InlineSweep inlineSweep;
 
   WorkEnv()
   {
@@ -374,6 +384,12 @@ public:
   WorkEnv env;
   double cost;
   stringstream obuf;
+  string  text;
+  string  gaps_text;
+  long  num_index;
+  long  num_gaps_lines;
+  long  first_index;
+  long  first_gaps_line;
   bool first_proc;
   bool last_proc;
   bool promote;
@@ -384,6 +400,10 @@ public:
     finfo = fi;
     ginfo = gi;
     cost = cst;
+    num_index = 0;
+    num_gaps_lines = 0;
+    first_index = 0;
+    first_gaps_line = 0;
     first_proc = first;
     last_proc = last;
     promote = false;
@@ -883,19 +903,42 @@ makeStructure(string absfilepath,
 
     makeWorkList(fileMap, wlPrint, wlLaunch);
 
+    // one path manager shared by all work items, so each file name
+    // is resolved only once.
+    RealPathMgr * realPath =
+      new RealPathMgr(new PathFindMgr, new PathReplacementMgr);
+    realPath->searchPaths(search_path);
+
     Output::printLoadModuleBegin(outFile, filename, has_calls);
 
+    // make and format the inline trees, except for index and gap
+    // fields
 #pragma omp parallel  default(none)                             \
-    shared(wlPrint, wlLaunch, num_done, output_mtx)             \
-    firstprivate(outFile, gapsFile, search_path, gaps_filenm, parsable)
+    shared(wlLaunch)                                            \
+    firstprivate(realPath, gapsFile, parsable)
     {
 #pragma omp for  schedule(dynamic, 1)
       for (unsigned int i = 0; i < wlLaunch.size(); i++) {
-        doWorkItem(wlLaunch[i], search_path, parsable, gapsFile != NULL);
+        doWorkItem(wlLaunch[i], realPath, parsable, gapsFile != NULL);
+      }
+    }  // end parallel
+
+    // assign index and gaps line numbers in output order (cheap)
+    reserveWorkList(wlPrint);
+
+    // translate the index and gaps markers in parallel, only the
+    // final concatenation is serial.
+#pragma omp parallel  default(none)                             \
+    shared(wlPrint, num_done, output_mtx)                       \
+    firstprivate(outFile, gapsFile, gaps_filenm)
+    {
+#pragma omp for  schedule(dynamic, 1)
+      for (unsigned int i = 0; i < wlPrint.size(); i++) {
+        finalFormatWorkItem(wlPrint[i], gaps_filenm, gapsFile != NULL);
 
         // the printing must be single threaded
         if (output_mtx.try_lock()) {
-          printWorkList(wlPrint, num_done, outFile, gapsFile, gaps_filenm);
+          printWorkList(wlPrint, num_done, outFile, gapsFile);
           output_mtx.unlock();
         }
       }
@@ -903,13 +946,14 @@ makeStructure(string absfilepath,
 
     // with try_lock(), there are interleavings where not all items
     // have been printed.
-    printWorkList(wlPrint, num_done, outFile, gapsFile, gaps_filenm);
+    printWorkList(wlPrint, num_done, outFile, gapsFile);
 
     Output::printLoadModuleEnd(outFile);
 
     if (opts.show_time) {
       printTime("struct:", &tv_parse, &ru_parse, &tv_fini, &ru_fini);
       printTime("total: ", &tv_init, &ru_init, &tv_fini, &ru_fini);
+      Inline::printStats(cout);
       cout << "\nnum funcs: " << wlPrint.size() << "\n" << endl;
     }
 
@@ -924,6 +968,7 @@ makeStructure(string absfilepath,
         delete wlPrint[i];
       }
 
+      delete realPath;
       delete code_obj;
       Inline::closeSymtab();
     }
@@ -939,23 +984,24 @@ makeStructure(string absfilepath,
 // run concurrently.
 //
 static void
-doWorkItem(WorkItem * witem, string & search_path, bool parsable, bool do_gaps)
+doWorkItem(WorkItem * witem, RealPathMgr * realPath, bool parsable, bool do_gaps)
 {
   FileInfo * finfo = witem->finfo;
   GroupInfo * ginfo = witem->ginfo;
+  ProcInfo * leader = ginfo->procMap.begin()->second;
 
-  // each work item gets its own string table and path manager to
-  // avoid lock contention.
+  // each work item gets its own string table, so that the index order
+  // (and thus the output order) is the same for any number of threads.
   HPC::StringTable * strTab = new HPC::StringTable;
   strTab->str2index("");
 
-  PathFindMgr * pathFind = new PathFindMgr;
-  PathReplacementMgr * pathReplace = new PathReplacementMgr;
-  RealPathMgr * realPath = new RealPathMgr(pathFind, pathReplace);
-  realPath->searchPaths(search_path);
-
   witem->env.strTab = strTab;
   witem->env.realPath = realPath;
+  witem->env.inlineSweep.setRealPath(realPath);
+
+  // enumerate the inline ranges for the group's symtab func once,
+  // instead of querying symtab for every instruction
+  witem->env.inlineSweep.sweep(ginfo->sym_func, ginfo->start, ginfo->end);
 
   // make the inline tree for every proc in this group
   if (parsable) {
@@ -963,6 +1009,7 @@ doWorkItem(WorkItem * witem, string & search_path, bool parsable, bool do_gaps)
   } else {
     doUnparsableFunctionList(witem->env, finfo, ginfo);
   }
+  witem->env.inlineSweep.clear();
 
   // partially format the output (except for index and gap fields)
   // into a string stream
@@ -976,6 +1023,78 @@ doWorkItem(WorkItem * witem, string & search_path, bool parsable, bool do_gaps)
     pinfo->root = NULL;
   }
 
+  // the formatted text no longer refers to string indices
+  delete strTab;
+  witem->env.strTab = NULL;
+
+  // count the index numbers and gaps lines this item will use, so
+  // that reserveWorkList() is just a prefix sum
+  witem->text = witem->obuf.str();
+  witem->obuf.str("");
+  witem->obuf.clear();
+
+  if (! leader->gap_only) {
+    Output::countProcIndexes(witem->text, do_gaps, ginfo,
+                             witem->num_index, witem->num_gaps_lines);
+  }
+  if (witem->first_proc) {
+    witem->num_index++;
+  }
+}
+
+//----------------------------------------------------------------------
+
+//
+// Assign the first index number and gaps line for each work item in
+// output order.  This must be single threaded.
+//
+static void
+reserveWorkList(WorkList & workList)
+{
+  for (auto wit = workList.begin(); wit != workList.end(); ++wit) {
+    WorkItem * witem = *wit;
+
+    witem->first_index = Output::reserveIndexes(witem->num_index);
+    witem->first_gaps_line = Output::reserveGapsLines(witem->num_gaps_lines);
+  }
+}
+
+//
+// Translate the index and gaps markers for one work item, including
+// the file begin and end tags.  This runs concurrently, each item
+// writes to its own buffers.
+//
+static void
+finalFormatWorkItem(WorkItem * witem, string & gaps_filenm, bool do_gaps)
+{
+  FileInfo * finfo = witem->finfo;
+  GroupInfo * ginfo = witem->ginfo;
+  ProcInfo * pinfo = ginfo->procMap.begin()->second;
+  long index = witem->first_index;
+  long gaps_line = witem->first_gaps_line;
+  stringstream os;
+  stringstream gaps;
+
+  if (witem->first_proc) {
+    Output::printFileBegin(&os, finfo, index);
+  }
+
+  if (! pinfo->gap_only) {
+    Output::finalPrintProc(&os, do_gaps ? &gaps : NULL, witem->text, gaps_filenm,
+                           finfo, ginfo, pinfo, index, gaps_line);
+  }
+
+  if (witem->last_proc) {
+    Output::printFileEnd(&os, finfo);
+  }
+
+  if (index != witem->first_index + witem->num_index) {
+    DIAG_WMsgIf(1, "hpcstruct: index numbers out of sync in: " << pinfo->prettyName);
+  }
+
+  witem->text = os.str();
+  witem->gaps_text = gaps.str();
+
   ANNOTATE_HAPPENS_BEFORE(&witem->is_done);
   witem->is_done.exchange(true);
 }
@@ -1062,45 +1181,31 @@ makeWorkList(FileMap * fileMap, WorkList & wlPrint, WorkList & wlLaunch)
 // be printed.  The output order is always work list order, regardless
 // of order finished.
 //
-// Note: the output functions have state (index number), so this must
-// be called locked or else single threaded.
+// Note: the items are already fully formatted, so this is just the
+// concatenation, but it must be called locked or else single threaded.
 //
 static void
 printWorkList(WorkList & workList, unsigned int & num_done, ostream * outFile,
-              ostream * gapsFile, string & gaps_filenm)
+              ostream * gapsFile)
 {
   while (num_done < workList.size() && workList[num_done]->is_done.load()) {
     ANNOTATE_HAPPENS_AFTER(&workList[num_done]->is_done);
     WorkItem * witem = workList[num_done];
-    FileInfo * finfo = witem->finfo;
-    GroupInfo * ginfo = witem->ginfo;
-    ProcInfo * pinfo = ginfo->procMap.begin()->second;
-    HPC::StringTable * strTab = witem->env.strTab;
 
-    if (witem->first_proc) {
-      Output::printFileBegin(outFile, finfo);
-    }
-
-    if (! pinfo->gap_only) {
-      string buf = witem->obuf.str();
+    *outFile << witem->text;
 
-      Output::finalPrintProc(outFile, gapsFile, buf, gaps_filenm,
-                             finfo, ginfo, pinfo);
+    if (gapsFile != NULL) {
+      *gapsFile << witem->gaps_text;
     }
 
-    if (witem->last_proc) {
-      Output::printFileEnd(outFile, finfo);
-    }
+    witem->text.clear();
+    witem->text.shrink_to_fit();
+    witem->gaps_text.clear();
+    witem->gaps_text.shrink_to_fit();
 
-    // delete the work environment
-    delete strTab;
     witem->env.strTab = NULL;
-
-    delete witem->env.realPath;
     witem->env.realPath = NULL;
-
-    witem->obuf.str("");
-    witem->obuf.clear();
+    witem->env.inlineSweep.setRealPath(NULL);
 
     num_done++;
   }
@@ -1697,7 +1802,7 @@ doFunctionList(WorkEnv & env, FileInfo * finfo, GroupInfo * ginfo, bool fullGaps
     auto call_it = callMap.find(entry_addr);
 
     if (call_it != callMap.end()) {
-      analyzeAddr(prefix, call_it->second, env.realPath);
+      env.inlineSweep.analyzeAddr(prefix, call_it->second);
     }
 
 #if DEBUG_CFG_SOURCE
@@ -2044,11 +2149,11 @@ doBlock(WorkEnv & env, GroupInfo * ginfo, ParseAPI::Function * func,
 
     // a call must be the last instruction in the block
     if (next_it == imap.end() && is_call) {
-      addStmtToTree(root, *(env.strTab), env.realPath, vma, len, filenm, line,
+      addStmtToTree(root, *(env.strTab), env.inlineSweep, vma, len, filenm, line,
                     device, is_call, is_sink, target);
     }
     else {
-      addStmtToTree(root, *(env.strTab), env.realPath, vma, len, filenm, line, device);
+      addStmtToTree(root, *(env.strTab), env.inlineSweep, vma, len, filenm, line, device);
     }
   }
 
@@ -2098,7 +2203,7 @@ doUnparsableFunction(WorkEnv & env, GroupInfo * ginfo, ParseAPI::Function * func
 
     lmcache.getLineInfo(vma, filenm, line);
     string device;
-    addStmtToTree(root, *(env.strTab), env.realPath, vma, len, filenm, line, device);
+    addStmtToTree(root, *(env.strTab), env.inlineSweep, vma, len, filenm, line, device);
   }
 }
 
@@ -2141,7 +2246,7 @@ addGaps(WorkEnv & env, FileInfo * finfo, GroupInfo * ginfo)
         VMA end = std::min(((VMA) svec[0]->endAddr()), end_gap);
 
         string device;
-        addStmtToTree(root, *(env.strTab), env.realPath, vma, end - vma,
+        addStmtToTree(root, *(env.strTab), env.inlineSweep, vma, end - vma,
                       filenm, line, device);
         vma = end;
       }
@@ -2150,7 +2255,7 @@ addGaps(WorkEnv & env, FileInfo * finfo, GroupInfo * ginfo)
         VMA end = std::min(vma + 4, end_gap);
 
         string device;
-        addStmtToTree(root, *(env.strTab), env.realPath, vma, end - vma,
+        addStmtToTree(root, *(env.strTab), env.inlineSweep, vma, end - vma,
                       finfo->fileName, pinfo->line_num, device);
         vma = end;
       }
@@ -2230,7 +2335,7 @@ findLoopHeader(WorkEnv & env, FileInfo * finfo, GroupInfo * ginfo,
       }
 
       InlineSeqn seqn;
-      analyzeAddr(seqn, src_vma, env.realPath);
+      env.inlineSweep.analyzeAddr(seqn, src_vma);
 
       clist[src_vma] = HeaderInfo(block);
       clist[src_vma].is_excl = loop->hasBlockExclusive(block);
@@ -124,6 +124,12 @@ void fmt_cctdb_pVal_write(char d[FMT_CCTDB_SZ_PVal], const fmt_cctdb_pVal_t* val
   fmt_u32_write(d+0x00, val->profIndex);
   fmt_f64_write(d+0x04, val->value);
 }
+void fmt_cctdb_pVal_write_n(char* d, const fmt_cctdb_pVal_t* val, size_t n) {
+  for(size_t i = 0; i < n; i++, d += FMT_CCTDB_SZ_PVal) {
+    fmt_u32_write(d+0x00, val[i].profIndex);
+    fmt_f64_write(d+0x04, val[i].value);
+  }
+}
 
 void fmt_cctdb_mIdx_read(fmt_cctdb_mIdx_t* idx, const char d[FMT_CCTDB_SZ_MIdx]) {
   idx->metricId = fmt_u16_read(d+0x00);
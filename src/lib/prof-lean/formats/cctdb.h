@@ -124,6 +124,8 @@ typedef struct fmt_cctdb_pVal_t {
 
 void fmt_cctdb_pVal_read(fmt_cctdb_pVal_t*, const char[FMT_CCTDB_SZ_PVal]);
 void fmt_cctdb_pVal_write(char[FMT_CCTDB_SZ_PVal], const fmt_cctdb_pVal_t*);
+// Runs of n consecutive pairs, see fmt_profiledb_mVal_read_n
+void fmt_cctdb_pVal_write_n(char*, const fmt_cctdb_pVal_t*, size_t n);
 
 // Metric-Index pair
 enum { FMT_CCTDB_SZ_MIdx = 0x0a };
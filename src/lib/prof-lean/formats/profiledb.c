@@ -134,6 +134,12 @@ void fmt_profiledb_mVal_write(char d[FMT_PROFILEDB_SZ_MVal], const fmt_profiledb
   fmt_u16_write(d+0x00, mv->metricId);
   fmt_f64_write(d+0x02, mv->value);
 }
+void fmt_profiledb_mVal_read_n(fmt_profiledb_mVal_t* mv, size_t n, const char* d) {
+  for(size_t i = 0; i < n; i++, d += FMT_PROFILEDB_SZ_MVal) {
+    mv[i].metricId = fmt_u16_read(d+0x00);
+    mv[i].value = fmt_f64_read(d+0x02);
+  }
+}
 
 void fmt_profiledb_cIdx_read(fmt_profiledb_cIdx_t* ci, const char d[FMT_PROFILEDB_SZ_CIdx]) {
   ci->ctxId = fmt_u32_read(d+0x00);
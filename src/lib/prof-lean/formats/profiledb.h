@@ -129,6 +129,9 @@ typedef struct fmt_profiledb_mVal_t {
 
 void fmt_profiledb_mVal_read(fmt_profiledb_mVal_t*, const char[FMT_PROFILEDB_SZ_MVal]);
 void fmt_profiledb_mVal_write(char[FMT_PROFILEDB_SZ_MVal], const fmt_profiledb_mVal_t*);
+// Runs of n consecutive pairs. The format is little-endian, so on
+// little-endian hosts this is a plain copy of each field.
+void fmt_profiledb_mVal_read_n(fmt_profiledb_mVal_t*, size_t n, const char*);
 
 // Context-Index pair {Idx}
 enum { FMT_PROFILEDB_SZ_CIdx = 0x0c };
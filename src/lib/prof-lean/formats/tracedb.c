@@ -81,6 +81,13 @@ enum fmt_version_t fmt_tracedb_check(const char hdr[16], uint8_t* minorVer) {
 void fmt_tracedb_fHdr_read(fmt_tracedb_fHdr_t* hdr, const char d[FMT_TRACEDB_SZ_FHdr]) {
   hdr->szCtxTraces = fmt_u64_read(d+0x10);
   hdr->pCtxTraces = fmt_u64_read(d+0x18);
+  if(d[0x0f] >= 1) {
+    hdr->szCtxTraceSums = fmt_u64_read(d+0x20);
+    hdr->pCtxTraceSums = fmt_u64_read(d+0x28);
+  } else {
+    hdr->szCtxTraceSums = 0;
+    hdr->pCtxTraceSums = 0;
+  }
 }
 void fmt_tracedb_fHdr_write(char d[FMT_TRACEDB_SZ_FHdr], const fmt_tracedb_fHdr_t* hdr) {
   memcpy(d, fmt_tracedb_magic, sizeof fmt_tracedb_magic);
@@ -88,6 +95,8 @@ void fmt_tracedb_fHdr_write(char d[FMT_TRACEDB_SZ_FHdr], const fmt_tracedb_fHdr_
   d[0x0f] = FMT_TRACEDB_MinorVersion;
   fmt_u64_write(d+0x10, hdr->szCtxTraces);
   fmt_u64_write(d+0x18, hdr->pCtxTraces);
+  fmt_u64_write(d+0x20, hdr->szCtxTraceSums);
+  fmt_u64_write(d+0x28, hdr->pCtxTraceSums);
 }
 
 void fmt_tracedb_ctxTraceSHdr_read(fmt_tracedb_ctxTraceSHdr_t* hdr, const char d[FMT_TRACEDB_SZ_CtxTraceSHdr]) {
@@ -127,3 +136,64 @@ void fmt_tracedb_ctxSample_write(char d[FMT_TRACEDB_SZ_CtxSample], const fmt_tra
   fmt_u64_write(d+0x00, elem->timestamp);
   fmt_u32_write(d+0x08, elem->ctxId);
 }
+
+void fmt_tracedb_ctxTraceSumSHdr_read(fmt_tracedb_ctxTraceSumSHdr_t* hdr, const char d[FMT_TRACEDB_SZ_CtxTraceSumSHdr]) {
+  hdr->pSummaries = fmt_u64_read(d+0x00);
+  hdr->nSummaries = fmt_u32_read(d+0x08);
+  hdr->szSummary = d[0x0c];
+  hdr->nLevels = d[0x0d];
+  hdr->nHist = d[0x0e];
+  hdr->ctxDepth = d[0x0f];
+  hdr->szBucket = fmt_u32_read(d+0x10);
+}
+void fmt_tracedb_ctxTraceSumSHdr_write(char d[FMT_TRACEDB_SZ_CtxTraceSumSHdr], const fmt_tracedb_ctxTraceSumSHdr_t* hdr) {
+  fmt_u64_write(d+0x00, hdr->pSummaries);
+  fmt_u32_write(d+0x08, hdr->nSummaries);
+  d[0x0c] = FMT_TRACEDB_SZ_CtxTraceSum;
+  d[0x0d] = hdr->nLevels;
+  d[0x0e] = hdr->nHist;
+  d[0x0f] = hdr->ctxDepth;
+  fmt_u32_write(d+0x10, FMT_TRACEDB_SZ_CtxSumBucket + hdr->nHist * FMT_TRACEDB_SZ_CtxSumHist);
+  memset(d+0x14, 0, 4);
+}
+
+void fmt_tracedb_ctxTraceSum_read(fmt_tracedb_ctxTraceSum_t* cts, const char d[FMT_TRACEDB_SZ_CtxTraceSum]) {
+  cts->profIndex = fmt_u32_read(d+0x00);
+  cts->startTimestamp = fmt_u64_read(d+0x08);
+  cts->bucketWidth = fmt_u64_read(d+0x10);
+  cts->pBuckets = fmt_u64_read(d+0x18);
+}
+void fmt_tracedb_ctxTraceSum_write(char d[FMT_TRACEDB_SZ_CtxTraceSum], const fmt_tracedb_ctxTraceSum_t* cts) {
+  fmt_u32_write(d+0x00, cts->profIndex);
+  memset(d+0x04, 0, 4);
+  fmt_u64_write(d+0x08, cts->startTimestamp);
+  fmt_u64_write(d+0x10, cts->bucketWidth);
+  fmt_u64_write(d+0x18, cts->pBuckets);
+}
+
+uint64_t fmt_tracedb_ctxTraceSum_pLevel(const fmt_tracedb_ctxTraceSumSHdr_t* shdr,
+                                        const fmt_tracedb_ctxTraceSum_t* cts, uint8_t level) {
+  // Levels are stored coarsest first, level l is preceded by 2^l - 1 buckets
+  return cts->pBuckets + ((UINT64_C(1) << level) - 1) * shdr->szBucket;
+}
+
+uint64_t fmt_tracedb_ctxTraceSum_levelWidth(const fmt_tracedb_ctxTraceSumSHdr_t* shdr,
+                                            const fmt_tracedb_ctxTraceSum_t* cts, uint8_t level) {
+  return cts->bucketWidth << (shdr->nLevels - 1 - level);
+}
+
+void fmt_tracedb_ctxSumBucket_read(fmt_tracedb_ctxSumBucket_t* bkt, const char d[FMT_TRACEDB_SZ_CtxSumBucket]) {
+  bkt->ctxId = fmt_u32_read(d+0x00);
+}
+void fmt_tracedb_ctxSumBucket_write(char d[FMT_TRACEDB_SZ_CtxSumBucket], const fmt_tracedb_ctxSumBucket_t* bkt) {
+  fmt_u32_write(d+0x00, bkt->ctxId);
+}
+
+void fmt_tracedb_ctxSumHist_read(fmt_tracedb_ctxSumHist_t* hist, const char d[FMT_TRACEDB_SZ_CtxSumHist]) {
+  hist->ctxId = fmt_u32_read(d+0x00);
+  hist->share = fmt_u32_read(d+0x04);
+}
+void fmt_tracedb_ctxSumHist_write(char d[FMT_TRACEDB_SZ_CtxSumHist], const fmt_tracedb_ctxSumHist_t* hist) {
+  fmt_u32_write(d+0x00, hist->ctxId);
+  fmt_u32_write(d+0x04, hist->share);
+}
@@ -56,7 +56,7 @@ extern "C" {
 #endif
 
 /// Minor version of the trace.db format implemented here
-enum { FMT_TRACEDB_MinorVersion = 0 };
+enum { FMT_TRACEDB_MinorVersion = 1 };
 
 /// Check the given file start bytes for the trace.db format.
 /// If minorVer != NULL, also returns the exact minor version.
@@ -70,16 +70,20 @@ extern const char fmt_tracedb_footer[8];
 //
 
 /// Size of the trace.db file header in serialized form
-enum { FMT_TRACEDB_SZ_FHdr = 0x20 };
+enum { FMT_TRACEDB_SZ_FHdr = 0x30 };
 
 /// trace.db file header, names match FORMATS.md
 typedef struct fmt_tracedb_fHdr_t {
   // NOTE: magic and versions are constant and cannot be adjusted
   uint64_t szCtxTraces;
   uint64_t pCtxTraces;
+  // NOTE: Zero if the file has no Context Trace Summaries section (or is v4.0)
+  uint64_t szCtxTraceSums;
+  uint64_t pCtxTraceSums;
 } fmt_tracedb_fHdr_t;
 
 /// Read a trace.db file header from a byte array
+/// Fields not present in the file's minor version are set to 0.
 void fmt_tracedb_fHdr_read(fmt_tracedb_fHdr_t*, const char[FMT_TRACEDB_SZ_FHdr]);
 
 /// Write a trace.db file header into a byte array
@@ -123,6 +127,65 @@ typedef struct fmt_tracedb_ctxSample_t {
 void fmt_tracedb_ctxSample_read(fmt_tracedb_ctxSample_t*, const char[FMT_TRACEDB_SZ_CtxSample]);
 void fmt_tracedb_ctxSample_write(char[FMT_TRACEDB_SZ_CtxSample], const fmt_tracedb_ctxSample_t*);
 
+//
+// Context Trace Summaries section
+//
+
+// Context Trace Summaries section header
+enum { FMT_TRACEDB_SZ_CtxTraceSumSHdr = 0x18 };
+typedef struct fmt_tracedb_ctxTraceSumSHdr_t {
+  uint64_t pSummaries;
+  uint32_t nSummaries;
+  uint8_t szSummary;
+  uint8_t nLevels;
+  uint8_t nHist;
+  uint8_t ctxDepth;
+  uint32_t szBucket;
+} fmt_tracedb_ctxTraceSumSHdr_t;
+
+void fmt_tracedb_ctxTraceSumSHdr_read(fmt_tracedb_ctxTraceSumSHdr_t*, const char[FMT_TRACEDB_SZ_CtxTraceSumSHdr]);
+void fmt_tracedb_ctxTraceSumSHdr_write(char[FMT_TRACEDB_SZ_CtxTraceSumSHdr], const fmt_tracedb_ctxTraceSumSHdr_t*);
+
+// Context Trace Summary structure {CTS}
+enum { FMT_TRACEDB_SZ_CtxTraceSum = 0x20 };
+typedef struct fmt_tracedb_ctxTraceSum_t {
+  uint32_t profIndex;
+  uint64_t startTimestamp;
+  uint64_t bucketWidth;
+  uint64_t pBuckets;
+} fmt_tracedb_ctxTraceSum_t;
+
+void fmt_tracedb_ctxTraceSum_read(fmt_tracedb_ctxTraceSum_t*, const char[FMT_TRACEDB_SZ_CtxTraceSum]);
+void fmt_tracedb_ctxTraceSum_write(char[FMT_TRACEDB_SZ_CtxTraceSum], const fmt_tracedb_ctxTraceSum_t*);
+
+/// Get the file offset of the first {Bkt} of the given level of a summary.
+/// Level 0 is the coarsest (a single bucket), level `l` has `2^l` buckets.
+uint64_t fmt_tracedb_ctxTraceSum_pLevel(const fmt_tracedb_ctxTraceSumSHdr_t*,
+                                        const fmt_tracedb_ctxTraceSum_t*, uint8_t level);
+
+/// Get the width (in nanoseconds) of the buckets in the given level of a summary.
+uint64_t fmt_tracedb_ctxTraceSum_levelWidth(const fmt_tracedb_ctxTraceSumSHdr_t*,
+                                            const fmt_tracedb_ctxTraceSum_t*, uint8_t level);
+
+// Context Trace Summary Bucket {Bkt}, followed by `nHist` {Hist} entries
+enum { FMT_TRACEDB_SZ_CtxSumBucket = 0x04 };
+typedef struct fmt_tracedb_ctxSumBucket_t {
+  uint32_t ctxId;
+} fmt_tracedb_ctxSumBucket_t;
+
+void fmt_tracedb_ctxSumBucket_read(fmt_tracedb_ctxSumBucket_t*, const char[FMT_TRACEDB_SZ_CtxSumBucket]);
+void fmt_tracedb_ctxSumBucket_write(char[FMT_TRACEDB_SZ_CtxSumBucket], const fmt_tracedb_ctxSumBucket_t*);
+
+// Context Trace Summary Histogram entry {Hist}
+enum { FMT_TRACEDB_SZ_CtxSumHist = 0x08 };
+typedef struct fmt_tracedb_ctxSumHist_t {
+  uint32_t ctxId;
+  uint32_t share;
+} fmt_tracedb_ctxSumHist_t;
+
+void fmt_tracedb_ctxSumHist_read(fmt_tracedb_ctxSumHist_t*, const char[FMT_TRACEDB_SZ_CtxSumHist]);
+void fmt_tracedb_ctxSumHist_write(char[FMT_TRACEDB_SZ_CtxSumHist], const fmt_tracedb_ctxSumHist_t*);
+
 #if defined(__cplusplus)
 }  // extern "C"
 #endif
@@ -105,6 +105,8 @@ typedef struct hpcio_outbuf_s {
   size_t buf_size;
   size_t in_use;
   int  fd;
+  hpcio_outbuf_sink_t sink;
+  void *sink_arg;
   int  flags;
   char use_lock;
   spinlock_t lock;
@@ -180,8 +182,14 @@ outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
   amt_done = 0;
   while (amt_done < outbuf->in_use) {
     errno = 0;
-    ret = write(outbuf->fd, outbuf->buf_start + amt_done,
-                outbuf->in_use - amt_done);
+    if (outbuf->sink != NULL) {
+      ret = outbuf->sink(outbuf->sink_arg, outbuf->buf_start + amt_done,
+                         outbuf->in_use - amt_done);
+    }
+    else {
+      ret = write(outbuf->fd, outbuf->buf_start + amt_done,
+                  outbuf->in_use - amt_done);
+    }
 
     // Check for short writes.  Note: EINTR is not failure.
     if (ret > 0 || (ret == 0 && errno == EINTR)) {
@@ -241,6 +249,50 @@ hpcio_outbuf_attach
   outbuf->buf_size = buf_size;
   outbuf->in_use = 0;
   outbuf->fd = fd;
+  outbuf->sink = NULL;
+  outbuf->sink_arg = NULL;
+  outbuf->flags = flags;
+  outbuf->use_lock = (flags & HPCIO_OUTBUF_LOCKED);
+  spinlock_unlock(&outbuf->lock);
+
+  *outbuf_ptr = outbuf;
+
+  return HPCFMT_OK;
+}
+
+
+// Attach a sink function in place of a file descriptor.  Flushes hand
+// the buffered data to sink(sink_arg, ...), and close does not close
+// any file descriptor.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_attach_sink
+(
+  hpcio_outbuf_t **outbuf_ptr /* out */,
+  hpcio_outbuf_sink_t sink,
+  void *sink_arg,
+  void *buf_start,
+  size_t buf_size,
+  int flags,
+  allocator_t alloc
+)
+{
+  if (outbuf_ptr == NULL || sink == NULL || buf_start == NULL || buf_size == 0) {
+    return HPCFMT_ERR;
+  }
+
+  hpcio_outbuf_t *outbuf = outbuf_alloc(alloc);
+
+  outbuf->next = NULL;
+  outbuf->magic = HPCIO_OUTBUF_MAGIC;
+  outbuf->buf_start = buf_start;
+  outbuf->buf_size = buf_size;
+  outbuf->in_use = 0;
+  outbuf->fd = -1;
+  outbuf->sink = sink;
+  outbuf->sink_arg = sink_arg;
   outbuf->flags = flags;
   outbuf->use_lock = (flags & HPCIO_OUTBUF_LOCKED);
   spinlock_unlock(&outbuf->lock);
@@ -336,7 +388,7 @@ hpcio_outbuf_close(hpcio_outbuf_t **outbuf_ptr)
   }
 
   if (outbuf_flush_buffer(outbuf) == HPCFMT_OK
-      && close(outbuf->fd) == 0) {
+      && (outbuf->sink != NULL || close(outbuf->fd) == 0)) {
     // flush and close both succeed
     outbuf->magic = 0;
     outbuf->fd = -1;
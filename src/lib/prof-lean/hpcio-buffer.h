@@ -57,6 +57,12 @@
 
 typedef struct hpcio_outbuf_s hpcio_outbuf_t;
 
+// Consumer of flushed data for outbufs that are not backed by a file
+// descriptor.  Must consume the whole buffer and be safe inside signal
+// handlers.  Returns: the number of bytes consumed, or -1 on error.
+
+typedef ssize_t (*hpcio_outbuf_sink_t)(void *arg, const void *data, size_t size);
+
 //***************************************************************************
 
 // Flags for hpcio_outbuf_attach().
@@ -80,6 +86,19 @@ hpcio_outbuf_attach
 );
 
 
+int
+hpcio_outbuf_attach_sink
+(
+  hpcio_outbuf_t **outbuf /* out */,
+  hpcio_outbuf_sink_t sink,
+  void *sink_arg,
+  void *buf_start,
+  size_t buf_size,
+  int flags,
+  allocator_t alloc
+);
+
+
 ssize_t
 hpcio_outbuf_write
 (
@@ -0,0 +1,614 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   hpcio-bulk.c
+//
+// Purpose:
+//   Bulk big-endian conversion kernels, see hpcio-bulk.h.
+//
+//   The SIMD kernels only exist for little-endian hosts, where every
+//   value needs its bytes reversed.  Contiguous values are loaded,
+//   shuffled and stored a vector at a time; strided values are moved
+//   to and from the vector one lane at a time, which still saves the
+//   per-byte shifting of the scalar loop.
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#ifndef _DEFAULT_SOURCE
+#  define _DEFAULT_SOURCE  // htobe64() and friends
+#endif
+
+#include <assert.h>
+#include <endian.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__) \
+    && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define HPCIO_BULK_X86 1
+#  include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON) \
+    && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define HPCIO_BULK_NEON 1
+#  include <arm_neon.h>
+#endif
+
+//*************************** User Include Files ****************************
+
+#include "hpcio-bulk.h"
+
+//***************************************************************************
+// types
+//***************************************************************************
+
+typedef struct hpcio_bulk_ops_t {
+  const char* name;
+  bool (*supported)(void);
+  void (*enc4)(char* buf, size_t stride, const void* val, size_t n);
+  void (*enc8)(char* buf, size_t stride, const void* val, size_t n);
+  void (*dec4)(void* val, const char* buf, size_t stride, size_t n);
+  void (*dec8)(void* val, const char* buf, size_t stride, size_t n);
+} hpcio_bulk_ops_t;
+
+static_assert(sizeof(double) == sizeof(uint64_t), "doubles aren't 8 bytes?");
+
+//***************************************************************************
+// scalar kernels
+//***************************************************************************
+
+// N.B.: values move through memcpy so that doubles can share the
+// uint64_t kernels without breaking strict aliasing.
+
+static inline uint32_t
+load4(const void* p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t
+load8(const void* p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void
+store4(void* p, uint32_t v)
+{
+  memcpy(p, &v, sizeof(v));
+}
+
+static inline void
+store8(void* p, uint64_t v)
+{
+  memcpy(p, &v, sizeof(v));
+}
+
+
+static void
+scalar_enc4(char* buf, size_t stride, const void* val, size_t n)
+{
+  const char* src = val;
+  for (size_t i = 0; i < n; i++) {
+    store4(buf + i * stride, htobe32(load4(src + 4 * i)));
+  }
+}
+
+static void
+scalar_enc8(char* buf, size_t stride, const void* val, size_t n)
+{
+  const char* src = val;
+  for (size_t i = 0; i < n; i++) {
+    store8(buf + i * stride, htobe64(load8(src + 8 * i)));
+  }
+}
+
+static void
+scalar_dec4(void* val, const char* buf, size_t stride, size_t n)
+{
+  char* dst = val;
+  for (size_t i = 0; i < n; i++) {
+    store4(dst + 4 * i, be32toh(load4(buf + i * stride)));
+  }
+}
+
+static void
+scalar_dec8(void* val, const char* buf, size_t stride, size_t n)
+{
+  char* dst = val;
+  for (size_t i = 0; i < n; i++) {
+    store8(dst + 8 * i, be64toh(load8(buf + i * stride)));
+  }
+}
+
+static bool
+scalar_supported(void)
+{
+  return true;
+}
+
+//***************************************************************************
+// x86 kernels
+//***************************************************************************
+
+#if HPCIO_BULK_X86
+
+#define SWAP4_MASK  3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+#define SWAP8_MASK  7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8
+
+__attribute__((target("ssse3")))
+static void
+ssse3_enc4(char* buf, size_t stride, const void* val, size_t n)
+{
+  const char* src = val;
+  const __m128i mask = _mm_setr_epi8(SWAP4_MASK);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 4 * i)), mask);
+    if (stride == 4) {
+      _mm_storeu_si128((__m128i*)(buf + 4 * i), v);
+    } else {
+      char* p = buf + i * stride;
+      store4(p, _mm_cvtsi128_si32(v));
+      store4(p + stride, _mm_cvtsi128_si32(_mm_srli_si128(v, 4)));
+      store4(p + 2 * stride, _mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+      store4(p + 3 * stride, _mm_cvtsi128_si32(_mm_srli_si128(v, 12)));
+    }
+  }
+  scalar_enc4(buf + i * stride, stride, src + 4 * i, n - i);
+}
+
+__attribute__((target("ssse3")))
+static void
+ssse3_enc8(char* buf, size_t stride, const void* val, size_t n)
+{
+  const char* src = val;
+  const __m128i mask = _mm_setr_epi8(SWAP8_MASK);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + 8 * i)), mask);
+    if (stride == 8) {
+      _mm_storeu_si128((__m128i*)(buf + 8 * i), v);
+    } else {
+      char* p = buf + i * stride;
+      _mm_storel_epi64((__m128i*) p, v);
+      _mm_storel_epi64((__m128i*)(p + stride), _mm_unpackhi_epi64(v, v));
+    }
+  }
+  scalar_enc8(buf + i * stride, stride, src + 8 * i, n - i);
+}
+
+__attribute__((target("ssse3")))
+static void
+ssse3_dec4(void* val, const char* buf, size_t stride, size_t n)
+{
+  char* dst = val;
+  const __m128i mask = _mm_setr_epi8(SWAP4_MASK);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const char* p = buf + i * stride;
+    __m128i v;
+    if (stride == 4) {
+      v = _mm_loadu_si128((const __m128i*) p);
+    } else {
+      v = _mm_setr_epi32(load4(p), load4(p + stride),
+                         load4(p + 2 * stride), load4(p + 3 * stride));
+    }
+    _mm_storeu_si128((__m128i*)(dst + 4 * i), _mm_shuffle_epi8(v, mask));
+  }
+  scalar_dec4(dst + 4 * i, buf + i * stride, stride, n - i);
+}
+
+__attribute__((target("ssse3")))
+static void
+ssse3_dec8(void* val, const char* buf, size_t stride, size_t n)
+{
+  char* dst = val;
+  const __m128i mask = _mm_setr_epi8(SWAP8_MASK);
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    const char* p = buf + i * stride;
+    __m128i v;
+    if (stride == 8) {
+      v = _mm_loadu_si128((const __m128i*) p);
+    } else {
+      v = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) p),
+                             _mm_loadl_epi64((const __m128i*)(p + stride)));
+    }
+    _mm_storeu_si128((__m128i*)(dst + 8 * i), _mm_shuffle_epi8(v, mask));
+  }
+  scalar_dec8(dst + 8 * i, buf + i * stride, stride, n - i);
+}
+
+static bool
+ssse3_supported(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("ssse3");
+}
+
+
+__attribute__((target("avx2")))
+static void
+avx2_enc4(char* buf, size_t stride, const void* val, size_t n)
+{
+  const char* src = val;
+  const __m256i mask = _mm256_setr_epi8(SWAP4_MASK, SWAP4_MASK);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + 4 * i)), mask);
+    if (stride == 4) {
+      _mm256_storeu_si256((__m256i*)(buf + 4 * i), v);
+    } else {
+      char* p = buf + i * stride;
+      for (int k = 0; k < 2; k++, p += 4 * stride) {
+        __m128i h = k ? _mm256_extracti128_si256(v, 1) : _mm256_castsi256_si128(v);
+        store4(p, _mm_cvtsi128_si32(h));
+        store4(p + stride, _mm_extract_epi32(h, 1));
+        store4(p + 2 * stride, _mm_extract_epi32(h, 2));
+        store4(p + 3 * stride, _mm_extract_epi32(h, 3));
+      }
+    }
+  }
+  scalar_enc4(buf + i * stride, stride, src + 4 * i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void
+avx2_enc8(char* buf, size_t stride, const void* val, size_t n)
+{
+  const char* src = val;
+  const __m256i mask = _mm256_setr_epi8(SWAP8_MASK, SWAP8_MASK);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + 8 * i)), mask);
+    if (stride == 8) {
+      _mm256_storeu_si256((__m256i*)(buf + 8 * i), v);
+    } else {
+      char* p = buf + i * stride;
+      __m128i lo = _mm256_castsi256_si128(v);
+      __m128i hi = _mm256_extracti128_si256(v, 1);
+      _mm_storel_epi64((__m128i*) p, lo);
+      _mm_storel_epi64((__m128i*)(p + stride), _mm_unpackhi_epi64(lo, lo));
+      _mm_storel_epi64((__m128i*)(p + 2 * stride), hi);
+      _mm_storel_epi64((__m128i*)(p + 3 * stride), _mm_unpackhi_epi64(hi, hi));
+    }
+  }
+  scalar_enc8(buf + i * stride, stride, src + 8 * i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void
+avx2_dec4(void* val, const char* buf, size_t stride, size_t n)
+{
+  char* dst = val;
+  const __m256i mask = _mm256_setr_epi8(SWAP4_MASK, SWAP4_MASK);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const char* p = buf + i * stride;
+    __m256i v;
+    if (stride == 4) {
+      v = _mm256_loadu_si256((const __m256i*) p);
+    } else {
+      v = _mm256_setr_epi32(load4(p), load4(p + stride),
+                            load4(p + 2 * stride), load4(p + 3 * stride),
+                            load4(p + 4 * stride), load4(p + 5 * stride),
+                            load4(p + 6 * stride), load4(p + 7 * stride));
+    }
+    _mm256_storeu_si256((__m256i*)(dst + 4 * i), _mm256_shuffle_epi8(v, mask));
+  }
+  scalar_dec4(dst + 4 * i, buf + i * stride, stride, n - i);
+}
+
+__attribute__((target("avx2")))
+static void
+avx2_dec8(void* val, const char* buf, size_t stride, size_t n)
+{
+  char* dst = val;
+  const __m256i mask = _mm256_setr_epi8(SWAP8_MASK, SWAP8_MASK);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const char* p = buf + i * stride;
+    __m256i v;
+    if (stride == 8) {
+      v = _mm256_loadu_si256((const __m256i*) p);
+    } else {
+      __m128i lo = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*) p),
+                                      _mm_loadl_epi64((const __m128i*)(p + stride)));
+      __m128i hi = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(p + 2 * stride)),
+                                      _mm_loadl_epi64((const __m128i*)(p + 3 * stride)));
+      v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    }
+    _mm256_storeu_si256((__m256i*)(dst + 8 * i), _mm256_shuffle_epi8(v, mask));
+  }
+  scalar_dec8(dst + 8 * i, buf + i * stride, stride, n - i);
+}
+
+static bool
+avx2_supported(void)
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+#endif // HPCIO_BULK_X86
+
+//***************************************************************************
+// aarch64 kernels
+//***************************************************************************
+
+#if HPCIO_BULK_NEON
+
+static void
+neon_enc4(char* buf, size_t stride, const void* val, size_t n)
+{
+  const char* src = val;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    uint32x4_t v = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8((const uint8_t*)(src + 4 * i))));
+    if (stride == 4) {
+      vst1q_u32((uint32_t*)(void*)(buf + 4 * i), v);
+    } else {
+      char* p = buf + i * stride;
+      store4(p, vgetq_lane_u32(v, 0));
+      store4(p + stride, vgetq_lane_u32(v, 1));
+      store4(p + 2 * stride, vgetq_lane_u32(v, 2));
+      store4(p + 3 * stride, vgetq_lane_u32(v, 3));
+    }
+  }
+  scalar_enc4(buf + i * stride, stride, src + 4 * i, n - i);
+}
+
+static void
+neon_enc8(char* buf, size_t stride, const void* val, size_t n)
+{
+  const char* src = val;
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    uint64x2_t v = vreinterpretq_u64_u8(vrev64q_u8(vld1q_u8((const uint8_t*)(src + 8 * i))));
+    if (stride == 8) {
+      vst1q_u64((uint64_t*)(void*)(buf + 8 * i), v);
+    } else {
+      char* p = buf + i * stride;
+      store8(p, vgetq_lane_u64(v, 0));
+      store8(p + stride, vgetq_lane_u64(v, 1));
+    }
+  }
+  scalar_enc8(buf + i * stride, stride, src + 8 * i, n - i);
+}
+
+static void
+neon_dec4(void* val, const char* buf, size_t stride, size_t n)
+{
+  char* dst = val;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const char* p = buf + i * stride;
+    uint8x16_t v;
+    if (stride == 4) {
+      v = vld1q_u8((const uint8_t*) p);
+    } else {
+      uint32x4_t w = vdupq_n_u32(load4(p));
+      w = vsetq_lane_u32(load4(p + stride), w, 1);
+      w = vsetq_lane_u32(load4(p + 2 * stride), w, 2);
+      w = vsetq_lane_u32(load4(p + 3 * stride), w, 3);
+      v = vreinterpretq_u8_u32(w);
+    }
+    vst1q_u8((uint8_t*)(dst + 4 * i), vrev32q_u8(v));
+  }
+  scalar_dec4(dst + 4 * i, buf + i * stride, stride, n - i);
+}
+
+static void
+neon_dec8(void* val, const char* buf, size_t stride, size_t n)
+{
+  char* dst = val;
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    const char* p = buf + i * stride;
+    uint8x16_t v;
+    if (stride == 8) {
+      v = vld1q_u8((const uint8_t*) p);
+    } else {
+      uint64x2_t w = vcombine_u64(vcreate_u64(load8(p)), vcreate_u64(load8(p + stride)));
+      v = vreinterpretq_u8_u64(w);
+    }
+    vst1q_u8((uint8_t*)(dst + 8 * i), vrev64q_u8(v));
+  }
+  scalar_dec8(dst + 8 * i, buf + i * stride, stride, n - i);
+}
+
+static bool
+neon_supported(void)
+{
+  return true;  // baseline on aarch64
+}
+
+#endif // HPCIO_BULK_NEON
+
+//***************************************************************************
+// dispatch
+//***************************************************************************
+
+// best first
+static const hpcio_bulk_ops_t hpcio_bulk_kernels[] = {
+#if HPCIO_BULK_X86
+  { "avx2",  avx2_supported,  avx2_enc4,  avx2_enc8,  avx2_dec4,  avx2_dec8 },
+  { "ssse3", ssse3_supported, ssse3_enc4, ssse3_enc8, ssse3_dec4, ssse3_dec8 },
+#endif
+#if HPCIO_BULK_NEON
+  { "neon",  neon_supported,  neon_enc4,  neon_enc8,  neon_dec4,  neon_dec8 },
+#endif
+  { "scalar", scalar_supported, scalar_enc4, scalar_enc8, scalar_dec4, scalar_dec8 },
+};
+
+#define HPCIO_BULK_NKERNELS \
+  (sizeof(hpcio_bulk_kernels) / sizeof(hpcio_bulk_kernels[0]))
+
+static _Atomic(const hpcio_bulk_ops_t*) hpcio_bulk_ops = NULL;
+
+
+// The choice is the same from every thread, so racing first uses
+// just store the same pointer.
+static const hpcio_bulk_ops_t*
+bulk_ops(void)
+{
+  const hpcio_bulk_ops_t* ops =
+    atomic_load_explicit(&hpcio_bulk_ops, memory_order_relaxed);
+  if (ops == NULL) {
+    for (size_t k = 0; k < HPCIO_BULK_NKERNELS; k++) {
+      if (hpcio_bulk_kernels[k].supported()) {
+        ops = &hpcio_bulk_kernels[k];
+        break;
+      }
+    }
+    atomic_store_explicit(&hpcio_bulk_ops, ops, memory_order_relaxed);
+  }
+  return ops;
+}
+
+//***************************************************************************
+// interface operations
+//***************************************************************************
+
+char*
+hpcio_be2_encode_n(char* buf, size_t stride, const uint16_t* val, size_t n)
+{
+  // too narrow to gain from a vector, the records around it dominate
+  for (size_t i = 0; i < n; i++) {
+    uint16_t v = htobe16(val[i]);
+    memcpy(buf + i * stride, &v, sizeof(v));
+  }
+  return buf + n * stride;
+}
+
+char*
+hpcio_be4_encode_n(char* buf, size_t stride, const uint32_t* val, size_t n)
+{
+  bulk_ops()->enc4(buf, stride, val, n);
+  return buf + n * stride;
+}
+
+char*
+hpcio_be8_encode_n(char* buf, size_t stride, const uint64_t* val, size_t n)
+{
+  bulk_ops()->enc8(buf, stride, val, n);
+  return buf + n * stride;
+}
+
+char*
+hpcio_bef8_encode_n(char* buf, size_t stride, const double* val, size_t n)
+{
+  bulk_ops()->enc8(buf, stride, val, n);
+  return buf + n * stride;
+}
+
+
+const char*
+hpcio_be2_decode_n(uint16_t* val, const char* buf, size_t stride, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    uint16_t v;
+    memcpy(&v, buf + i * stride, sizeof(v));
+    val[i] = be16toh(v);
+  }
+  return buf + n * stride;
+}
+
+const char*
+hpcio_be4_decode_n(uint32_t* val, const char* buf, size_t stride, size_t n)
+{
+  bulk_ops()->dec4(val, buf, stride, n);
+  return buf + n * stride;
+}
+
+const char*
+hpcio_be8_decode_n(uint64_t* val, const char* buf, size_t stride, size_t n)
+{
+  bulk_ops()->dec8(val, buf, stride, n);
+  return buf + n * stride;
+}
+
+const char*
+hpcio_bef8_decode_n(double* val, const char* buf, size_t stride, size_t n)
+{
+  bulk_ops()->dec8(val, buf, stride, n);
+  return buf + n * stride;
+}
+
+
+const char*
+hpcio_bulk_kernel(void)
+{
+  return bulk_ops()->name;
+}
+
+
+bool
+hpcio_bulk_select(const char* name)
+{
+  for (size_t k = 0; k < HPCIO_BULK_NKERNELS; k++) {
+    if (strcmp(hpcio_bulk_kernels[k].name, name) == 0) {
+      if (!hpcio_bulk_kernels[k].supported()) {
+        return false;
+      }
+      atomic_store_explicit(&hpcio_bulk_ops, &hpcio_bulk_kernels[k],
+                            memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
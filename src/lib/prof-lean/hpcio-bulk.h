@@ -0,0 +1,138 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   hpcio-bulk.h
+//
+// Purpose:
+//   Convert arrays of integers (and doubles) to and from the big-endian
+//   byte order of the HPC data files, many values at a time.
+//
+//   The values in a buffer need not be contiguous: consecutive values
+//   start 'stride' bytes apart, so a column of a packed record (eg, the
+//   8-byte value of a 10-byte value/metric-id pair) is converted in
+//   place.  Kernels using SSSE3, AVX2 or NEON are selected at first use
+//   according to the CPU, with a portable scalar fallback.
+//
+//   These routines do not allocate memory and are safe to call from
+//   multiple threads.
+//
+//***************************************************************************
+
+#ifndef prof_lean_hpcio_bulk_h
+#define prof_lean_hpcio_bulk_h
+
+//************************* System Include Files ****************************
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//*************************** Forward Declarations **************************
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//***************************************************************************
+
+// hpcio_beX_encode_n: Write the 'n' X-byte values of 'val' to 'buf' in
+// big-endian order, the values 'stride' (>= X) bytes apart.  Returns
+// the byte 'n * stride' past 'buf'.
+
+char*
+hpcio_be2_encode_n(char* buf, size_t stride, const uint16_t* val, size_t n);
+
+char*
+hpcio_be4_encode_n(char* buf, size_t stride, const uint32_t* val, size_t n);
+
+char*
+hpcio_be8_encode_n(char* buf, size_t stride, const uint64_t* val, size_t n);
+
+char*
+hpcio_bef8_encode_n(char* buf, size_t stride, const double* val, size_t n);
+
+
+// hpcio_beX_decode_n: Read 'n' big-endian X-byte values, 'stride' bytes
+// apart, from 'buf' into 'val'.  Returns the byte 'n * stride' past
+// 'buf'.
+
+const char*
+hpcio_be2_decode_n(uint16_t* val, const char* buf, size_t stride, size_t n);
+
+const char*
+hpcio_be4_decode_n(uint32_t* val, const char* buf, size_t stride, size_t n);
+
+const char*
+hpcio_be8_decode_n(uint64_t* val, const char* buf, size_t stride, size_t n);
+
+const char*
+hpcio_bef8_decode_n(double* val, const char* buf, size_t stride, size_t n);
+
+
+//***************************************************************************
+
+// hpcio_bulk_kernel: Name of the kernel in use ("scalar", "ssse3",
+// "avx2" or "neon").
+const char*
+hpcio_bulk_kernel(void);
+
+// hpcio_bulk_select: Use the kernel 'name' from now on, for comparing
+// the kernels.  Returns false (and keeps the current kernel) if 'name'
+// is unknown or the CPU does not support it.
+bool
+hpcio_bulk_select(const char* name);
+
+
+//***************************************************************************
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif // prof_lean_hpcio_bulk_h
@@ -80,6 +80,7 @@
 
 #include "hpcio.h"
 #include "hpcio-buffer.h"
+#include "hpcio-bulk.h"
 #include "hpcfmt.h"
 #include "hpcrun-fmt.h"
 #include "placeholders.h"
@@ -814,6 +815,9 @@ hpcrun_fmt_idtuple_dxnry_fwrite(FILE* outfs)
   hpcfmt_int2_fwrite(IDTUPLE_CORE, outfs);
   hpcfmt_str_fwrite(HPCRUN_IDTUPLE_CORE, outfs);
 
+  hpcfmt_int2_fwrite(IDTUPLE_SNAPSHOT, outfs);
+  hpcfmt_str_fwrite(HPCRUN_IDTUPLE_SNAPSHOT, outfs);
+
   return HPCFMT_OK;
 }
 
@@ -864,6 +868,13 @@ hpcrun_fmt_idtuple_dxnry_free(hpcrun_fmt_idtuple_dxnry_t* dxnry, hpcfmt_free_fn
 */
 //***************************************************************************
 
+// The value/metric-id pairs and the cct node id/index pairs are
+// converted a chunk of records at a time with the bulk kernels.
+#define SPARSE_CHUNK         512
+#define SPARSE_VAL_REC_SIZE  (SF_val_SIZE + SF_mid_SIZE)
+#define SPARSE_CCT_REC_SIZE  (SF_cct_node_id_SIZE + SF_cct_node_idx_SIZE)
+#define SPARSE_REC_MAX_SIZE  12  // the larger of the two, as a constant
+
 int
 hpcrun_fmt_sparse_metrics_fread(hpcrun_fmt_sparse_metrics_t* x, FILE* fs)
 {
@@ -875,16 +886,28 @@ hpcrun_fmt_sparse_metrics_fread(hpcrun_fmt_sparse_metrics_t* x, FILE* fs)
 
   x->values = (hpcrun_metricVal_t *) malloc((x->num_vals)*sizeof(hpcrun_metricVal_t));
   x->mids = (uint16_t *) malloc((x->num_vals)*sizeof(uint16_t));
-  for (unsigned int i = 0; i < x->num_vals; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->values[i].bits), fs));
-    HPCFMT_ThrowIfError(hpcfmt_int2_fread(&x->mids[i], fs));
-  }
-
   x->cct_node_ids = (uint32_t *) malloc((x->num_nz_cct_nodes + 1)*sizeof(uint32_t));
   x->cct_node_idxs = (uint64_t *) malloc((x->num_nz_cct_nodes + 1)*sizeof(uint64_t));
-  for (unsigned int i = 0; i < x->num_nz_cct_nodes + 1; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&x->cct_node_ids[i], fs));
-    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->cct_node_idxs[i], fs));
+
+  char buf[SPARSE_CHUNK * SPARSE_REC_MAX_SIZE];
+  for (uint64_t i = 0; i < x->num_vals; i += SPARSE_CHUNK) {
+    size_t n = (x->num_vals - i < SPARSE_CHUNK) ? x->num_vals - i : SPARSE_CHUNK;
+    if (fread(buf, SPARSE_VAL_REC_SIZE, n, fs) != n) {
+      return HPCFMT_ERR;
+    }
+    hpcio_be8_decode_n(&x->values[i].bits, buf, SPARSE_VAL_REC_SIZE, n);
+    hpcio_be2_decode_n(&x->mids[i], buf + SF_val_SIZE, SPARSE_VAL_REC_SIZE, n);
+  }
+
+  for (uint64_t i = 0; i < x->num_nz_cct_nodes + 1; i += SPARSE_CHUNK) {
+    size_t n = (x->num_nz_cct_nodes + 1 - i < SPARSE_CHUNK)
+               ? x->num_nz_cct_nodes + 1 - i : SPARSE_CHUNK;
+    if (fread(buf, SPARSE_CCT_REC_SIZE, n, fs) != n) {
+      return HPCFMT_ERR;
+    }
+    hpcio_be4_decode_n(&x->cct_node_ids[i], buf, SPARSE_CCT_REC_SIZE, n);
+    hpcio_be8_decode_n(&x->cct_node_idxs[i], buf + SF_cct_node_id_SIZE,
+                       SPARSE_CCT_REC_SIZE, n);
   }
 
   return HPCFMT_OK;
@@ -900,23 +923,73 @@ hpcrun_fmt_sparse_metrics_fwrite(hpcrun_fmt_sparse_metrics_t* x,FILE* fs)
   HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->num_nz_cct_nodes, fs));
 
 
-  for (unsigned int i = 0; i < x->num_vals; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->values[i].bits, fs));
-    HPCFMT_ThrowIfError(hpcfmt_int2_fwrite(x->mids[i], fs));
+  char buf[SPARSE_CHUNK * SPARSE_REC_MAX_SIZE];
+  for (uint64_t i = 0; i < x->num_vals; i += SPARSE_CHUNK) {
+    size_t n = (x->num_vals - i < SPARSE_CHUNK) ? x->num_vals - i : SPARSE_CHUNK;
+    hpcio_be8_encode_n(buf, SPARSE_VAL_REC_SIZE, &x->values[i].bits, n);
+    hpcio_be2_encode_n(buf + SF_val_SIZE, SPARSE_VAL_REC_SIZE, &x->mids[i], n);
+    if (fwrite(buf, SPARSE_VAL_REC_SIZE, n, fs) != n) {
+      return HPCFMT_ERR;
+    }
   }
 
-  for (unsigned int i = 0; i < x->num_nz_cct_nodes + 1; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->cct_node_ids[i], fs));
-    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->cct_node_idxs[i], fs));
+  for (uint64_t i = 0; i < x->num_nz_cct_nodes + 1; i += SPARSE_CHUNK) {
+    size_t n = (x->num_nz_cct_nodes + 1 - i < SPARSE_CHUNK)
+               ? x->num_nz_cct_nodes + 1 - i : SPARSE_CHUNK;
+    hpcio_be4_encode_n(buf, SPARSE_CCT_REC_SIZE, &x->cct_node_ids[i], n);
+    hpcio_be8_encode_n(buf + SF_cct_node_id_SIZE, SPARSE_CCT_REC_SIZE,
+                       &x->cct_node_idxs[i], n);
+    if (fwrite(buf, SPARSE_CCT_REC_SIZE, n, fs) != n) {
+      return HPCFMT_ERR;
+    }
   }
 
   return HPCFMT_OK;
 }
 
 
+static double
+sparse_metrics_val_as_real(const hpcrun_fmt_sparse_metrics_t* x, uint64_t i,
+          const metric_tbl_t* metricTbl)
+{
+  hpcrun_metricFlags_t mflags = hpcrun_metricFlags_NULL;
+  if (metricTbl) {
+    mflags = metricTbl->lst[x->mids[i]].flags;
+  }
+  if (mflags.fields.valFmt == MetricFlags_ValFmt_Int) {
+    return (double)x->values[i].i;
+  }
+  return x->values[i].r;
+}
+
+// Returns true if value 'i' passes 'filter' (or if there is no filter)
+static bool
+sparse_metrics_val_shown(const hpcrun_fmt_sparse_metrics_t* x, uint64_t i,
+          const metric_tbl_t* metricTbl,
+          const hpcrun_fmt_sparse_metrics_filter_t* filter)
+{
+  if (!filter) {
+    return true;
+  }
+  uint16_t mid = x->mids[i];
+  if (filter->mid_mask && (mid >= filter->num_mids || !filter->mid_mask[mid])) {
+    return false;
+  }
+  if (filter->has_min_value) {
+    double v = sparse_metrics_val_as_real(x, i, metricTbl);
+    if (v < 0) v = -v;
+    if (v < filter->min_value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
 int
 hpcrun_fmt_sparse_metrics_fprint(hpcrun_fmt_sparse_metrics_t* x, FILE* fs,
-          const metric_tbl_t* metricTbl, const char* pre, bool easy_grep)
+          const metric_tbl_t* metricTbl, const char* pre, bool easy_grep,
+          const hpcrun_fmt_sparse_metrics_filter_t* filter)
 {
   char* double_pre = "    ";
   fprintf(fs, "[sparse metrics:\n");
@@ -927,10 +1000,13 @@ hpcrun_fmt_sparse_metrics_fprint(hpcrun_fmt_sparse_metrics_t* x, FILE* fs,
           double_pre, x->num_vals, double_pre, x->num_nz_cct_nodes, pre);
 
   if(easy_grep){
-    HPCFMT_ThrowIfError(hpcrun_fmt_sparse_metrics_fprint_grep_helper(x, fs, metricTbl, pre));
+    HPCFMT_ThrowIfError(hpcrun_fmt_sparse_metrics_fprint_grep_helper(x, fs, metricTbl, pre, filter));
   }else{
     fprintf(fs, "%s[metrics:\n%s(NOTES: printed in file order, help checking if hpcrun file is correct)\n", pre, pre);
     for (unsigned int i = 0; i < x->num_vals; ++i) {
+      if (!sparse_metrics_val_shown(x, i, metricTbl, filter)) {
+        continue;
+      }
       fprintf(fs, "%s(value:", double_pre);
       hpcrun_metricFlags_t mflags = hpcrun_metricFlags_NULL;
       if (metricTbl) {
@@ -956,16 +1032,19 @@ hpcrun_fmt_sparse_metrics_fprint(hpcrun_fmt_sparse_metrics_t* x, FILE* fs,
     fprintf(fs, "%s]\n", pre);
   }
 
-  fprintf(fs, "%s[cct node indices:\n", pre);
-  for (unsigned int i = 0; i < x->num_nz_cct_nodes + 1; i++) {
-    if(i < x->num_nz_cct_nodes){
-      fprintf(fs, "%s(cct node id: %d, index: %ld)\n", double_pre, x->cct_node_ids[i], x->cct_node_idxs[i]);
-    }else{
-      if(x->cct_node_ids[i] == LastNodeEnd) fprintf(fs, "%s(cct node id: END, index: %ld)\n", double_pre, x->cct_node_idxs[i]);
+  // the node index table only describes the unfiltered value array
+  if (!filter) {
+    fprintf(fs, "%s[cct node indices:\n", pre);
+    for (unsigned int i = 0; i < x->num_nz_cct_nodes + 1; i++) {
+      if(i < x->num_nz_cct_nodes){
+        fprintf(fs, "%s(cct node id: %d, index: %ld)\n", double_pre, x->cct_node_ids[i], x->cct_node_idxs[i]);
+      }else{
+        if(x->cct_node_ids[i] == LastNodeEnd) fprintf(fs, "%s(cct node id: END, index: %ld)\n", double_pre, x->cct_node_idxs[i]);
+      }
     }
-  }
 
-  fprintf(fs, "%s]\n", pre);
+    fprintf(fs, "%s]\n", pre);
+  }
 
   fprintf(fs, "]\n");
 
@@ -974,7 +1053,8 @@ hpcrun_fmt_sparse_metrics_fprint(hpcrun_fmt_sparse_metrics_t* x, FILE* fs,
 
 int
 hpcrun_fmt_sparse_metrics_fprint_grep_helper(hpcrun_fmt_sparse_metrics_t* x, FILE* fs,
-          const metric_tbl_t* metricTbl, const char* pre)
+          const metric_tbl_t* metricTbl, const char* pre,
+          const hpcrun_fmt_sparse_metrics_filter_t* filter)
 {
   char* double_pre = "    ";
   fprintf(fs, "%s[metrics easy grep version:\n%s(NOTES: metrics for a cct node are printed together, easy to grep)\n", pre, pre);
@@ -983,9 +1063,16 @@ hpcrun_fmt_sparse_metrics_fprint_grep_helper(hpcrun_fmt_sparse_metrics_t* x, FIL
     uint32_t cct_node_id = x->cct_node_ids[i];
     uint64_t cct_node_off = x->cct_node_idxs[i];
     uint64_t cct_next_node_off = x->cct_node_idxs[i+1];
-    fprintf(fs, "%s(cct node id: %d) ", double_pre, cct_node_id);
+    bool node_printed = false;
 
     for(unsigned int j = cct_node_off; j < cct_next_node_off; j++){
+      if (!sparse_metrics_val_shown(x, j, metricTbl, filter)) {
+        continue;
+      }
+      if (!node_printed) {
+        fprintf(fs, "%s(cct node id: %d) ", double_pre, cct_node_id);
+        node_printed = true;
+      }
       fprintf(fs, "(metric %d:", x->mids[j]);
 
       hpcrun_metricFlags_t mflags = hpcrun_metricFlags_NULL;
@@ -1009,7 +1096,13 @@ hpcrun_fmt_sparse_metrics_fprint_grep_helper(hpcrun_fmt_sparse_metrics_t* x, FIL
 
       fprintf(fs, ") ");
     }
-    fprintf(fs, "\n");
+    // nodes without a surviving value are left out entirely
+    if (node_printed || !filter) {
+      if (!node_printed) {
+        fprintf(fs, "%s(cct node id: %d) ", double_pre, cct_node_id);
+      }
+      fprintf(fs, "\n");
+    }
 
   }
   fprintf(fs, "%s]\n", pre);
@@ -1129,6 +1222,12 @@ hpcrun_sparse_file_t* hpcrun_sparse_open(const char* path, size_t start_pos, siz
   sparse_fs->lm_bytes_read     = 0;    //number of bytes for loadmap section that have been read
   sparse_fs->sm_block_touched  = 0;    //number of sparse metrics blocks that have been touched (entries might not have been read yet)
                                        //(block = a chunk containing value and metric id pairs for one cct node)
+  sparse_fs->block_vals = NULL;
+  sparse_fs->block_mids = NULL;
+  sparse_fs->block_raw  = NULL;
+  sparse_fs->block_cap  = 0;
+  sparse_fs->block_len  = 0;
+  sparse_fs->block_next = 0;
 
   //initialize footer
   if(end_pos == 0) {
@@ -1203,6 +1302,9 @@ int hpcrun_sparse_resume(hpcrun_sparse_file_t* sparse_fs, const char* path)
 void hpcrun_sparse_close(hpcrun_sparse_file_t* sparse_fs)
 {
   if(sparse_fs->mode == OPENED) hpcio_fclose(sparse_fs->file);
+  free(sparse_fs->block_vals);
+  free(sparse_fs->block_mids);
+  free(sparse_fs->block_raw);
   free(sparse_fs);
 }
 
@@ -1355,15 +1457,33 @@ int hpcrun_sparse_next_block(hpcrun_sparse_file_t* sparse_fs)
   HPCFMT_ThrowIfError(hpcfmt_int8_fread(&next_block_start_idx,sparse_fs->file));
   sparse_fs->cur_block_end = sparse_fs->val_mid_offset + (SF_mid_SIZE + SF_val_SIZE) * next_block_start_idx;
   sparse_fs->sm_block_touched++;
-
-  //seek to the first val_metricID place
-  fseek(sparse_fs->file,(sparse_fs->val_mid_offset + (SF_mid_SIZE + SF_val_SIZE) * val_mid_idx), SEEK_SET);
+  if(next_block_start_idx < val_mid_idx || sparse_fs->cur_block_end > sparse_fs->footer.sm_end) return SF_ERR;
+
+  //read the whole block of val_metricID pairs and convert it in one go
+  size_t n = next_block_start_idx - val_mid_idx;
+  if(n > sparse_fs->block_cap){
+    size_t cap = (n > 2 * sparse_fs->block_cap) ? n : 2 * sparse_fs->block_cap;
+    hpcrun_metricVal_t* vals = realloc(sparse_fs->block_vals, cap * sizeof(hpcrun_metricVal_t));
+    if(vals) sparse_fs->block_vals = vals;
+    uint16_t* mids = realloc(sparse_fs->block_mids, cap * sizeof(uint16_t));
+    if(mids) sparse_fs->block_mids = mids;
+    char* raw = realloc(sparse_fs->block_raw, cap * SPARSE_VAL_REC_SIZE);
+    if(raw) sparse_fs->block_raw = raw;
+    if(!vals || !mids || !raw) return SF_ERR;
+    sparse_fs->block_cap = cap;
+  }
+  fseek(sparse_fs->file, sparse_fs->cur_block_start, SEEK_SET);
+  if(fread(sparse_fs->block_raw, SPARSE_VAL_REC_SIZE, n, sparse_fs->file) != n) return SF_ERR;
+  hpcio_be8_decode_n(&sparse_fs->block_vals[0].bits, sparse_fs->block_raw, SPARSE_VAL_REC_SIZE, n);
+  hpcio_be2_decode_n(sparse_fs->block_mids, sparse_fs->block_raw + SF_val_SIZE, SPARSE_VAL_REC_SIZE, n);
+  sparse_fs->block_len = n;
+  sparse_fs->block_next = 0;
 
   return cct_node_id;
 }
 
 /* succeed: returns positive metricID (matching metricTbl, start from 1); end of this block: 0;error: return -1*/
-/* ASSUMPTION: it is called continuously for one block, i.e. no other fseek happen between calls */
+/* the entries come from the block read by hpcrun_sparse_next_block, so other reads may happen between calls */
 int hpcrun_sparse_next_entry(hpcrun_sparse_file_t* sparse_fs, hpcrun_metricVal_t* val)
 {
   int ret = hpcrun_sparse_check_mode(sparse_fs, OPENED, __func__);
@@ -1373,19 +1493,10 @@ int hpcrun_sparse_next_entry(hpcrun_sparse_file_t* sparse_fs, hpcrun_metricVal_t
     fprintf(stderr, "ERROR: hpcrun_sparse_next_entry(...) has to be called after hpcrun_sparse_next_block(...) to set up entry point.\n");
     return SF_ERR;
   }
-  size_t cur_pos = ftell(sparse_fs->file);
-  size_t cur_block_start_pos = sparse_fs->cur_block_start;
-  size_t cur_block_end_pos   = sparse_fs->cur_block_end;
-  if(cur_pos > sparse_fs->footer.sm_end || cur_block_start_pos > sparse_fs->footer.sm_end || cur_block_end_pos > sparse_fs->footer.sm_end) return SF_ERR;
-  if((cur_pos < cur_block_start_pos) || (cur_pos > cur_block_end_pos)){
-    fprintf(stderr, "ERROR: cannot read next entry for current cct: current position of hpcrun_sparse_file object is not within current cct block's range.\n");
-    return SF_ERR;
-  }
-  if(cur_pos == cur_block_end_pos) return SF_END;
+  if(sparse_fs->block_next == sparse_fs->block_len) return SF_END;
 
-  uint16_t mid;
-  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(val->bits),sparse_fs->file));
-  HPCFMT_ThrowIfError(hpcfmt_int2_fread(&mid,sparse_fs->file));
+  *val = sparse_fs->block_vals[sparse_fs->block_next];
+  uint16_t mid = sparse_fs->block_mids[sparse_fs->block_next++];
   mid ++; //match the metric id in metricTbl(starting as 1), it was recorded starting as 0
 
   return mid;
@@ -1616,6 +1727,505 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 }
 
 
+//***************************************************************************
+// [hpctrace] blocks (version 1.02)
+//***************************************************************************
+
+static int
+hpctrace_fmt_be_outbuf(uint64_t val, int len, hpcio_outbuf_t* outbuf)
+{
+  unsigned char buf[8];
+  int k = 0;
+  for (int shift = 8 * (len - 1); shift >= 0; shift -= 8) {
+    buf[k] = (val >> shift) & 0xff;
+    k++;
+  }
+  return (hpcio_outbuf_write(outbuf, buf, k) == k) ? HPCFMT_OK : HPCFMT_ERR;
+}
+
+
+static uint64_t
+hpctrace_fmt_be_sread(const char* buf, int len)
+{
+  uint64_t val = 0;
+  for (int k = 0; k < len; k++) {
+    val = (val << 8) | (unsigned char)buf[k];
+  }
+  return val;
+}
+
+
+int
+hpctrace_fmt_block_hdr_fread(hpctrace_fmt_block_hdr_t* x, FILE* fs)
+{
+  int ret = hpcfmt_int4_fread(&(x->count), fs);
+  if (ret != HPCFMT_OK) {
+    return ret; // can be HPCFMT_EOF
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->flags), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->minTime), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->maxTime), fs));
+
+  if (x->count > HPCTRACE_FMT_BlockLen) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_block_hdr_outbuf(hpctrace_fmt_block_hdr_t* x, hpcio_outbuf_t* outbuf)
+{
+  HPCFMT_ThrowIfError(hpctrace_fmt_be_outbuf(x->count, 4, outbuf));
+  HPCFMT_ThrowIfError(hpctrace_fmt_be_outbuf(x->flags, 4, outbuf));
+  HPCFMT_ThrowIfError(hpctrace_fmt_be_outbuf(x->minTime, 8, outbuf));
+  HPCFMT_ThrowIfError(hpctrace_fmt_be_outbuf(x->maxTime, 8, outbuf));
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_block_hdr_fprint(hpctrace_fmt_block_hdr_t* x, uint64_t offset,
+                              FILE* fs)
+{
+  fprintf(fs, "[block: (offset: %"PRIu64") (count: %"PRIu32") (sorted: %s)"
+          " (time: %"PRIu64" .. %"PRIu64")]\n", offset, x->count,
+          (x->flags & HPCTRACE_FMT_BLOCK_FLAGS_SORTED) ? "yes" : "no",
+          x->minTime, x->maxTime);
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_index_entry_fread(hpctrace_fmt_index_entry_t* x, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->offset), fs));
+  return hpctrace_fmt_block_hdr_fread(&(x->hdr), fs);
+}
+
+
+int
+hpctrace_fmt_index_entry_outbuf(hpctrace_fmt_index_entry_t* x,
+                                hpcio_outbuf_t* outbuf)
+{
+  HPCFMT_ThrowIfError(hpctrace_fmt_be_outbuf(x->offset, 8, outbuf));
+  return hpctrace_fmt_block_hdr_outbuf(&(x->hdr), outbuf);
+}
+
+
+int
+hpctrace_fmt_trailer_fread(hpctrace_fmt_trailer_t* x, FILE* fs)
+{
+  char magic[HPCTRACE_FMT_IndexMagicLen];
+
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->num_blocks), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->index_offset), fs));
+  if (fread(magic, 1, sizeof(magic), fs) != sizeof(magic)
+      || memcmp(magic, HPCTRACE_FMT_IndexMagic, sizeof(magic)) != 0) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_trailer_outbuf(hpctrace_fmt_trailer_t* x, hpcio_outbuf_t* outbuf)
+{
+  HPCFMT_ThrowIfError(hpctrace_fmt_be_outbuf(x->num_blocks, 8, outbuf));
+  HPCFMT_ThrowIfError(hpctrace_fmt_be_outbuf(x->index_offset, 8, outbuf));
+  if (hpcio_outbuf_write(outbuf, HPCTRACE_FMT_IndexMagic, HPCTRACE_FMT_IndexMagicLen)
+      != HPCTRACE_FMT_IndexMagicLen) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+uint64_t
+hpctrace_fmt_blocks_end(FILE* fs, hpctrace_fmt_trailer_t* trailer, bool* has_trailer)
+{
+  hpctrace_fmt_trailer_t t;
+  bool found = false;
+
+  off_t pos = ftello(fs);
+  fseeko(fs, 0, SEEK_END);
+  uint64_t end = ftello(fs);
+
+  if (end >= HPCTRACE_FMT_HeaderLen + HPCTRACE_FMT_TrailerLen) {
+    fseeko(fs, end - HPCTRACE_FMT_TrailerLen, SEEK_SET);
+    if (hpctrace_fmt_trailer_fread(&t, fs) == HPCFMT_OK
+        && t.index_offset >= (uint64_t)HPCTRACE_FMT_HeaderLen
+        && t.index_offset + t.num_blocks * HPCTRACE_FMT_IndexEntryLen
+           + HPCTRACE_FMT_TrailerLen == end) {
+      found = true;
+      end = t.index_offset;
+      if (trailer) *trailer = t;
+    }
+  }
+  fseeko(fs, pos, SEEK_SET);
+
+  if (has_trailer) *has_trailer = found;
+  return end;
+}
+
+
+void
+hpctrace_fmt_datum_sread_n(hpctrace_fmt_datum_t* x, size_t n,
+                           hpctrace_hdr_flags_t flags, const char* buf)
+{
+  bool dataCentric =
+    HPCTRACE_HDR_FLAGS_GET_BIT(flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS);
+
+  size_t recSz = dataCentric ? 16 : 12;
+
+  // convert each field as a column, a chunk of records at a time
+  uint64_t comp[256];
+  uint32_t cpId[256];
+  uint32_t metricId[256];
+  for (size_t i = 0; i < n; i += 256) {
+    size_t m = (n - i < 256) ? n - i : 256;
+    hpcio_be8_decode_n(comp, buf, recSz, m);
+    hpcio_be4_decode_n(cpId, buf + 8, recSz, m);
+    if (dataCentric) {
+      hpcio_be4_decode_n(metricId, buf + 12, recSz, m);
+    }
+    for (size_t j = 0; j < m; j++) {
+      x[i + j].comp = comp[j];
+      x[i + j].cpId = cpId[j];
+      x[i + j].metricId = dataCentric ? metricId[j] : HPCTRACE_FMT_MetricId_NULL;
+    }
+    buf += m * recSz;
+  }
+}
+
+
+//***************************************************************************
+// hpccontainer (located here for now)
+//***************************************************************************
+
+int
+hpccontainer_fmt_hdr_fwrite(FILE* fs)
+{
+  fwrite(HPCCONTAINER_FMT_Magic,   1, HPCCONTAINER_FMT_MagicLen, fs);
+  fwrite(HPCCONTAINER_FMT_Version, 1, HPCCONTAINER_FMT_VersionLen, fs);
+  size_t nw = fwrite(HPCCONTAINER_FMT_Endian, 1, HPCCONTAINER_FMT_EndianLen, fs);
+
+  return (nw == HPCCONTAINER_FMT_EndianLen) ? HPCFMT_OK : HPCFMT_ERR;
+}
+
+
+char*
+hpccontainer_fmt_hdr_swrite(uint64_t checkpoint_end, char* buf)
+{
+  memcpy(buf, HPCCONTAINER_FMT_Magic, HPCCONTAINER_FMT_MagicLen);
+  buf += HPCCONTAINER_FMT_MagicLen;
+  memcpy(buf, HPCCONTAINER_FMT_Version, HPCCONTAINER_FMT_VersionLen);
+  buf += HPCCONTAINER_FMT_VersionLen;
+  memcpy(buf, HPCCONTAINER_FMT_Endian, HPCCONTAINER_FMT_EndianLen);
+  buf += HPCCONTAINER_FMT_EndianLen;
+  return hpcfmt_int8_swrite(checkpoint_end, buf);
+}
+
+
+int
+hpccontainer_fmt_hdr_fread(FILE* infs)
+{
+  char tag[HPCCONTAINER_FMT_MagicLen + 1];
+  char version[HPCCONTAINER_FMT_VersionLen + 1];
+  char endian;
+
+  int nr = fread(tag, 1, HPCCONTAINER_FMT_MagicLen, infs);
+  tag[HPCCONTAINER_FMT_MagicLen] = '\0';
+  if (nr != HPCCONTAINER_FMT_MagicLen || strcmp(tag, HPCCONTAINER_FMT_Magic) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  nr = fread(version, 1, HPCCONTAINER_FMT_VersionLen, infs);
+  version[HPCCONTAINER_FMT_VersionLen] = '\0';
+  if (nr != HPCCONTAINER_FMT_VersionLen || atof(version) >= 2.0) {
+    return HPCFMT_ERR;
+  }
+
+  nr = fread(&endian, 1, HPCCONTAINER_FMT_EndianLen, infs);
+  if (nr != HPCCONTAINER_FMT_EndianLen || endian != HPCCONTAINER_FMT_Endian[0]) {
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpccontainer_fmt_entry_fwrite(hpccontainer_fmt_entry_t* x, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_intX_fwrite(&x->kind, sizeof(x->kind), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite((uint32_t) x->thread, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->seq, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->offset, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->length, fs));
+  HPCFMT_ThrowIfError(id_tuple_fwrite(&x->id_tuple, fs));
+
+  return HPCFMT_OK;
+}
+
+
+char*
+hpccontainer_fmt_entry_swrite(hpccontainer_fmt_entry_t* x, char* buf)
+{
+  *buf++ = (char) x->kind;
+  buf = hpcfmt_int4_swrite((uint32_t) x->thread, buf);
+  buf = hpcfmt_int4_swrite(x->seq, buf);
+  buf = hpcfmt_int8_swrite(x->offset, buf);
+  buf = hpcfmt_int8_swrite(x->length, buf);
+  buf = hpcfmt_int2_swrite(x->id_tuple.length, buf);
+  for (unsigned int j = 0; j < x->id_tuple.length; ++j) {
+    buf = hpcfmt_int2_swrite(x->id_tuple.ids[j].kind, buf);
+    buf = hpcfmt_int8_swrite(x->id_tuple.ids[j].physical_index, buf);
+    buf = hpcfmt_int8_swrite(x->id_tuple.ids[j].logical_index, buf);
+  }
+  return buf;
+}
+
+
+size_t
+hpccontainer_fmt_entry_len(hpccontainer_fmt_entry_t* x)
+{
+  // kind:1 thread:4 seq:4 offset:8 length:8 id-tuple: length:2 (kind:2 ids:16)*
+  return 1 + 4 + 4 + 8 + 8 + 2 + x->id_tuple.length * (2 + 8 + 8);
+}
+
+
+int
+hpccontainer_fmt_entry_fread(hpccontainer_fmt_entry_t* x, FILE* infs)
+{
+  uint32_t thread;
+
+  HPCFMT_ThrowIfError(hpcfmt_intX_fread(&x->kind, sizeof(x->kind), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&thread, infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&x->seq, infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->offset, infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->length, infs));
+  HPCFMT_ThrowIfError(id_tuple_fread(&x->id_tuple, infs));
+  x->thread = (int32_t) thread;
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpccontainer_fmt_trailer_fwrite(uint64_t index_offset, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(index_offset, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(HPCCONTAINER_FMT_Trailer, fs));
+
+  return HPCFMT_OK;
+}
+
+
+char*
+hpccontainer_fmt_trailer_swrite(uint64_t index_offset, char* buf)
+{
+  buf = hpcfmt_int8_swrite(index_offset, buf);
+  return hpcfmt_int8_swrite(HPCCONTAINER_FMT_Trailer, buf);
+}
+
+
+// Read the trailer that ends at index_end into index_offset.
+static int
+hpccontainer_fmt_trailer_fread(uint64_t* index_offset, uint64_t index_end,
+                               FILE* infs)
+{
+  uint64_t trailer;
+
+  if (index_end < HPCCONTAINER_FMT_DataOffset + HPCCONTAINER_FMT_TrailerLen
+      || fseek(infs, index_end - HPCCONTAINER_FMT_TrailerLen, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(index_offset, infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&trailer, infs));
+  if (trailer != HPCCONTAINER_FMT_Trailer
+      || *index_offset < HPCCONTAINER_FMT_DataOffset
+      || *index_offset > index_end - HPCCONTAINER_FMT_TrailerLen) {
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpccontainer_fmt_index_seek(uint32_t* num_entries, FILE* infs)
+{
+  uint64_t checkpoint_end, index_offset;
+
+  if (fseek(infs, 0, SEEK_SET) != 0
+      || hpccontainer_fmt_hdr_fread(infs) != HPCFMT_OK
+      || hpcfmt_int8_fread(&checkpoint_end, infs) != HPCFMT_OK
+      || fseek(infs, 0, SEEK_END) != 0) {
+    return HPCFMT_ERR;
+  }
+  long file_end = ftell(infs);
+  if (file_end < 0) {
+    return HPCFMT_ERR;
+  }
+
+  // a finished container ends with its index, otherwise fall back to the
+  // last checkpoint of the index
+  if (hpccontainer_fmt_trailer_fread(&index_offset, file_end, infs) != HPCFMT_OK
+      && (checkpoint_end > (uint64_t) file_end
+          || hpccontainer_fmt_trailer_fread(&index_offset, checkpoint_end,
+                                            infs) != HPCFMT_OK)) {
+    return HPCFMT_ERR;
+  }
+
+  if (fseek(infs, index_offset, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(num_entries, infs));
+
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// hpcsnap (located here for now)
+//***************************************************************************
+
+int
+hpcsnap_fmt_hdr_fwrite(FILE* fs, ...)
+{
+  va_list args;
+  va_start(args, fs);
+
+  fwrite(HPCSNAP_FMT_Magic,   1, HPCSNAP_FMT_MagicLen, fs);
+  fwrite(HPCSNAP_FMT_Version, 1, HPCSNAP_FMT_VersionLen, fs);
+  fwrite(HPCSNAP_FMT_Endian,  1, HPCSNAP_FMT_EndianLen, fs);
+
+  int ret = hpcfmt_nvpairs_vfwrite(fs, args);
+
+  va_end(args);
+
+  return ret;
+}
+
+
+int
+hpcsnap_fmt_hdr_fread(HPCFMT_List(hpcfmt_nvpair_t)* nvps, FILE* infs,
+                      hpcfmt_alloc_fn alloc)
+{
+  char tag[HPCSNAP_FMT_MagicLen + 1];
+  char version[HPCSNAP_FMT_VersionLen + 1];
+  char endian;
+
+  int nr = fread(tag, 1, HPCSNAP_FMT_MagicLen, infs);
+  tag[HPCSNAP_FMT_MagicLen] = '\0';
+  if (nr != HPCSNAP_FMT_MagicLen || strcmp(tag, HPCSNAP_FMT_Magic) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  nr = fread(version, 1, HPCSNAP_FMT_VersionLen, infs);
+  version[HPCSNAP_FMT_VersionLen] = '\0';
+  if (nr != HPCSNAP_FMT_VersionLen || atof(version) >= 2.0) {
+    return HPCFMT_ERR;
+  }
+
+  nr = fread(&endian, 1, HPCSNAP_FMT_EndianLen, infs);
+  if (nr != HPCSNAP_FMT_EndianLen || endian != HPCSNAP_FMT_Endian[0]) {
+    return HPCFMT_ERR;
+  }
+
+  return hpcfmt_nvpairList_fread(nvps, infs, alloc);
+}
+
+
+int
+hpcsnap_fmt_record_fwrite(hpcsnap_record_kind_t kind, const void* payload,
+                          uint64_t length, FILE* fs)
+{
+  uint8_t kind8 = kind;
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(HPCSNAP_FMT_RecordTag, fs));
+  HPCFMT_ThrowIfError(hpcfmt_intX_fwrite(&kind8, sizeof(kind8), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(length, fs));
+  if (length > 0 && fwrite(payload, 1, length, fs) != length) {
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcsnap_fmt_record_fread(hpcsnap_fmt_record_t* x, FILE* infs)
+{
+  uint32_t tag;
+
+  int ret = hpcfmt_int4_fread(&tag, infs);
+  if (ret != HPCFMT_OK) {
+    return ret;
+  }
+  if (tag != HPCSNAP_FMT_RecordTag) {
+    return HPCFMT_ERR;
+  }
+  HPCFMT_ThrowIfError(hpcfmt_intX_fread(&x->kind, sizeof(x->kind), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->length, infs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcsnap_fmt_delta_hdr_fwrite(hpcsnap_fmt_delta_hdr_t* x, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->generation, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->time, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite((uint32_t) x->thread, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite((uint32_t) x->rank, fs));
+  HPCFMT_ThrowIfError(id_tuple_fwrite(&x->id_tuple, fs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcsnap_fmt_delta_hdr_fread(hpcsnap_fmt_delta_hdr_t* x, FILE* infs)
+{
+  uint32_t thread, rank;
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&x->generation, infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->time, infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&thread, infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&rank, infs));
+  HPCFMT_ThrowIfError(id_tuple_fread(&x->id_tuple, infs));
+  x->thread = (int32_t) thread;
+  x->rank = (int32_t) rank;
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcsnap_fmt_value_fwrite(hpcsnap_fmt_value_t* x, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->id, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int2_fwrite(x->mid, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->value.bits, fs));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcsnap_fmt_value_fread(hpcsnap_fmt_value_t* x, FILE* infs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&x->id, infs));
+  HPCFMT_ThrowIfError(hpcfmt_int2_fread(&x->mid, infs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->value.bits, infs));
+
+  return HPCFMT_OK;
+}
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -98,6 +98,12 @@ static const char HPCRUN_TraceFnmSfx[] = "hpctrace";
 // hpcrun log filename suffix
 static const char HPCRUN_LogFnmSfx[] = "log";
 
+// hpcrun per-process container filename suffix
+static const char HPCRUN_ContainerFnmSfx[] = "hpccontainer";
+
+// hpcrun periodic snapshot filename suffix
+static const char HPCRUN_SnapshotFnmSfx[] = "hpcsnap";
+
 // hpcprof metric db filename suffix
 static const char HPCPROF_MetricDBSfx[] = "metric-db";
 
@@ -558,7 +564,7 @@ hpcrun_fmt_lip_fprint(lush_lip_t* x, FILE* fs, const char* pre);
 //***************************************************************************
 // id_tuple dictionary
 //***************************************************************************
-static const uint16_t HPCRUN_IDTUPLE_COUNT     = 8;
+static const uint16_t HPCRUN_IDTUPLE_COUNT     = 9;
 static const int  HPCRUN_IDTUPLE_COUNT_LEN     = 2;
 
 static const char HPCRUN_IDTUPLE_SUMMARY[]     = "SUMMARY";
@@ -569,6 +575,7 @@ static const char HPCRUN_IDTUPLE_GPUDEVICE[]   = "GPUDEVICE";
 static const char HPCRUN_IDTUPLE_GPUCONTEXT[]  = "GPUCONTEXT";
 static const char HPCRUN_IDTUPLE_GPUSTREAM[]   = "GPUSTREAM";
 static const char HPCRUN_IDTUPLE_CORE[]        = "CORE";
+static const char HPCRUN_IDTUPLE_SNAPSHOT[]    = "SNAPSHOT";
 
 typedef struct hpcrun_fmt_idtuple_dxnry_entry_t
 {
@@ -624,6 +631,17 @@ typedef struct hpcrun_fmt_sparse_metrics_t{
 
 typedef struct hpcrun_fmt_sparse_metrics_t hpcrun_fmt_sparse_metrics_t;
 
+// Row filter for the textual dump.  'mid_mask' (if non-NULL) has
+// 'num_mids' entries and selects the metric ids to show; values whose
+// magnitude is below 'min_value' are dropped when 'has_min_value' is
+// set.  A NULL filter shows everything.
+typedef struct hpcrun_fmt_sparse_metrics_filter_t {
+  const bool* mid_mask;
+  uint16_t num_mids;
+  bool has_min_value;
+  double min_value;
+} hpcrun_fmt_sparse_metrics_filter_t;
+
 extern int
 hpcrun_fmt_sparse_metrics_fread(hpcrun_fmt_sparse_metrics_t* x, FILE* fs);
 
@@ -632,11 +650,13 @@ hpcrun_fmt_sparse_metrics_fwrite(hpcrun_fmt_sparse_metrics_t* x, FILE* fs);
 
 extern int
 hpcrun_fmt_sparse_metrics_fprint(hpcrun_fmt_sparse_metrics_t* x, FILE* fs,
-                           const metric_tbl_t* metricTbl, const char* pre, bool easy_grep);
+                           const metric_tbl_t* metricTbl, const char* pre, bool easy_grep,
+                           const hpcrun_fmt_sparse_metrics_filter_t* filter);
 
 int
 hpcrun_fmt_sparse_metrics_fprint_grep_helper(hpcrun_fmt_sparse_metrics_t* x, FILE* fs,
-          const metric_tbl_t* metricTbl, const char* pre);
+          const metric_tbl_t* metricTbl, const char* pre,
+          const hpcrun_fmt_sparse_metrics_filter_t* filter);
 
 void
 hpcrun_fmt_sparse_metrics_free(hpcrun_fmt_sparse_metrics_t* x, hpcfmt_free_fn dealloc);
@@ -726,6 +746,14 @@ typedef struct hpcrun_sparse_file {
   size_t cct_node_id_idx_offset;
   size_t val_mid_offset;
 
+  //metric values and ids of the current block, read and converted all at
+  //once by hpcrun_sparse_next_block and handed out by hpcrun_sparse_next_entry
+  hpcrun_metricVal_t* block_vals;
+  uint16_t* block_mids;
+  char* block_raw;
+  size_t block_cap;
+  size_t block_len;
+  size_t block_next;
 
 } hpcrun_sparse_file_t;
 
@@ -758,9 +786,11 @@ int hpcrun_sparse_next_entry(hpcrun_sparse_file_t* sparse_fs, hpcrun_metricVal_t
 // Header sizes:
 // - version 1.00: 24 bytes
 // - version 1.01: 32 bytes: 24 + sizeof(hpctrace_hdr_flags_t)
+// - version 1.02: 32 bytes, as 1.01.  The records may be grouped into
+//   blocks (HPCTRACE_HDR_FLAGS_BLOCKED_BIT_POS), see below.
 
 static const char HPCTRACE_FMT_Magic[]   = "HPCRUN-trace______"; // 18 bytes
-static const char HPCTRACE_FMT_Version[] = "01.01";              // 5 bytes
+static const char HPCTRACE_FMT_Version[] = "01.02";              // 5 bytes
 static const char HPCTRACE_FMT_Endian[]  = "b";                  // 1 byte
 
 // Use of bit fields is not recommended as the order of fields
@@ -777,6 +807,7 @@ typedef struct hpctrace_hdr_flags_bitfield {
 #define HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS 0U
 #define HPCTRACE_HDR_FLAGS_LCA_RECORDED_BIT_POS 1U
 #define HPCTRACE_HDR_FLAGS_CALL_TRACE_BIT_POS 2U
+#define HPCTRACE_HDR_FLAGS_BLOCKED_BIT_POS 3U
 
 #define HPCTRACE_HDR_FLAGS_GET_BIT(flag, pos) \
   ((flag >> pos) & 1U)
@@ -879,6 +910,306 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
                           FILE* fs);
 
 
+//***************************************************************************
+// [hpctrace] blocks (version 1.02)
+//
+// With HPCTRACE_HDR_FLAGS_BLOCKED_BIT_POS set, the records following
+// the header are grouped into blocks of at most HPCTRACE_FMT_BlockLen
+// records, and the file ends with an index of the blocks:
+//
+//   [hdr]
+//   [block: block-hdr, 'count' records]*
+//   [index: (offset, block-hdr) per block]
+//   [trailer: num-blocks, index offset, HPCTRACE_FMT_IndexMagic]
+//
+// Offsets are from the start of the trace (the header).  A block
+// header records the time range of its records and whether they are
+// in nondecreasing time order, so readers can pass ordered blocks
+// through unsorted and merge only the blocks that overlap.  A trace
+// whose writer did not finish has no index; its blocks can still be
+// found by walking the block headers from the first one.
+//***************************************************************************
+
+#define HPCTRACE_FMT_BlockLen 1024
+
+#define HPCTRACE_FMT_BLOCK_FLAGS_SORTED 0x1U
+
+static const char HPCTRACE_FMT_IndexMagic[] = "HPCtrIdx"; // 8 bytes
+
+#define HPCTRACE_FMT_IndexMagicLen (sizeof(HPCTRACE_FMT_IndexMagic) - 1)
+
+// count (4), flags (4), min time (8), max time (8)
+#define HPCTRACE_FMT_BlockHdrLen 24
+// offset (8), block-hdr
+#define HPCTRACE_FMT_IndexEntryLen (8 + HPCTRACE_FMT_BlockHdrLen)
+// num-blocks (8), index offset (8), magic
+#define HPCTRACE_FMT_TrailerLen (8 + 8 + HPCTRACE_FMT_IndexMagicLen)
+
+typedef struct hpctrace_fmt_block_hdr_t {
+  uint32_t count;
+  uint32_t flags;
+  uint64_t minTime;
+  uint64_t maxTime;
+} hpctrace_fmt_block_hdr_t;
+
+typedef struct hpctrace_fmt_index_entry_t {
+  uint64_t offset;
+  hpctrace_fmt_block_hdr_t hdr;
+} hpctrace_fmt_index_entry_t;
+
+typedef struct hpctrace_fmt_trailer_t {
+  uint64_t num_blocks;
+  uint64_t index_offset;
+} hpctrace_fmt_trailer_t;
+
+
+// Size in bytes of one record for the given header flags
+static inline int
+hpctrace_fmt_datum_size(hpctrace_hdr_flags_t flags)
+{
+  return HPCTRACE_HDR_FLAGS_GET_BIT(flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS)
+    ? 8 + 4 + 4 : 8 + 4;
+}
+
+
+int
+hpctrace_fmt_block_hdr_fread(hpctrace_fmt_block_hdr_t* x, FILE* fs);
+
+int
+hpctrace_fmt_block_hdr_outbuf(hpctrace_fmt_block_hdr_t* x, hpcio_outbuf_t* outbuf);
+
+int
+hpctrace_fmt_block_hdr_fprint(hpctrace_fmt_block_hdr_t* x, uint64_t offset,
+                              FILE* fs);
+
+int
+hpctrace_fmt_index_entry_fread(hpctrace_fmt_index_entry_t* x, FILE* fs);
+
+int
+hpctrace_fmt_index_entry_outbuf(hpctrace_fmt_index_entry_t* x,
+                                hpcio_outbuf_t* outbuf);
+
+// Reads the trailer, which must be the last HPCTRACE_FMT_TrailerLen
+// bytes of the trace.  Returns HPCFMT_ERR if the magic does not match,
+// i.e. the trace has no index.
+int
+hpctrace_fmt_trailer_fread(hpctrace_fmt_trailer_t* x, FILE* fs);
+
+int
+hpctrace_fmt_trailer_outbuf(hpctrace_fmt_trailer_t* x, hpcio_outbuf_t* outbuf);
+
+// Returns the offset just past the last block of a blocked trace: the
+// index offset if the trace ends with a trailer, else the file size.
+// Fills in 'trailer' (if non-NULL) when one is found, and leaves the
+// stream position unchanged.
+uint64_t
+hpctrace_fmt_blocks_end(FILE* fs, hpctrace_fmt_trailer_t* trailer, bool* has_trailer);
+
+// Decodes 'n' records from 'buf', which holds them in file format
+void
+hpctrace_fmt_datum_sread_n(hpctrace_fmt_datum_t* x, size_t n,
+                           hpctrace_hdr_flags_t flags, const char* buf);
+
+
+//***************************************************************************
+// hpccontainer (located here for now)
+//
+// A container holds the profiles and traces of every thread of one
+// process, or, when written per node, of every process on a node with
+// the thread ids of each process shifted past the previous ones.  Each
+// region of the file is a byte-for-byte copy of what would otherwise be
+// a separate .hpcrun file or a piece of an .hpctrace file, so readers
+// can treat a region as a file of its own.
+//
+//   [hdr: magic, version, endian, checkpoint-end,
+//    padded to HPCCONTAINER_FMT_DataOffset]
+//   [regions, in the order they were reserved]
+//   [index: num-entries, entries...]
+//   [trailer: index-offset, HPCCONTAINER_FMT_Trailer]
+//
+// Trace data arrives in segments as the per-thread trace buffers fill.
+// A thread's trace is the concatenation of its trace segments in
+// increasing sequence order; a datum may straddle two segments.
+//
+// While the process runs, the index is checkpointed every so often: an
+// index and trailer of the regions so far is written among the regions
+// and checkpoint-end in the header is set to the end of its trailer (0
+// if there is none).  A container whose process did not finish has no
+// trailer at its end and is read through its last checkpoint instead.
+//***************************************************************************
+
+static const char HPCCONTAINER_FMT_Magic[]   = "HPCRUN-container__"; // 18 bytes
+static const char HPCCONTAINER_FMT_Version[] = "01.01";              // 5 bytes
+static const char HPCCONTAINER_FMT_Endian[]  = "b";                  // 1 byte
+
+#define HPCCONTAINER_FMT_MagicLenX   (sizeof(HPCCONTAINER_FMT_Magic) - 1)
+#define HPCCONTAINER_FMT_VersionLenX (sizeof(HPCCONTAINER_FMT_Version) - 1)
+#define HPCCONTAINER_FMT_EndianLenX  (sizeof(HPCCONTAINER_FMT_Endian) - 1)
+
+static const int HPCCONTAINER_FMT_MagicLen   = HPCCONTAINER_FMT_MagicLenX;
+static const int HPCCONTAINER_FMT_VersionLen = HPCCONTAINER_FMT_VersionLenX;
+static const int HPCCONTAINER_FMT_EndianLen  = HPCCONTAINER_FMT_EndianLenX;
+
+// offset of checkpoint-end in the header
+static const uint64_t HPCCONTAINER_FMT_CheckpointOffset =
+  HPCCONTAINER_FMT_MagicLenX + HPCCONTAINER_FMT_VersionLenX + HPCCONTAINER_FMT_EndianLenX;
+
+// first byte of region data
+static const uint64_t HPCCONTAINER_FMT_DataOffset = 1024;
+
+// index-offset:8 trailer:8
+static const int HPCCONTAINER_FMT_TrailerLen = 16;
+static const uint64_t HPCCONTAINER_FMT_Trailer = 0x485043636F6E7478; // "HPCcontx"
+
+typedef enum hpccontainer_region_kind_t {
+  hpccontainer_region_profile = 1,
+  hpccontainer_region_trace   = 2,
+} hpccontainer_region_kind_t;
+
+typedef struct hpccontainer_fmt_entry_t {
+  uint8_t  kind;      // hpccontainer_region_kind_t
+  int32_t  thread;    // hpcrun thread id, unique within the container
+  uint32_t seq;       // order of trace segments within a thread
+  uint64_t offset;    // absolute offset of the region in the container
+  uint64_t length;    // length of the region in bytes
+  id_tuple_t id_tuple; // profiles only, empty for trace segments
+} hpccontainer_fmt_entry_t;
+
+int
+hpccontainer_fmt_hdr_fwrite(FILE* fs);
+
+int
+hpccontainer_fmt_hdr_fread(FILE* infs);
+
+char*
+hpccontainer_fmt_hdr_swrite(uint64_t checkpoint_end, char* buf);
+
+int
+hpccontainer_fmt_entry_fwrite(hpccontainer_fmt_entry_t* x, FILE* fs);
+
+char*
+hpccontainer_fmt_entry_swrite(hpccontainer_fmt_entry_t* x, char* buf);
+
+// the number of bytes hpccontainer_fmt_entry_swrite writes for x
+size_t
+hpccontainer_fmt_entry_len(hpccontainer_fmt_entry_t* x);
+
+// N.B.: the id tuple is malloc'd, release it with id_tuple_free()
+int
+hpccontainer_fmt_entry_fread(hpccontainer_fmt_entry_t* x, FILE* infs);
+
+int
+hpccontainer_fmt_trailer_fwrite(uint64_t index_offset, FILE* fs);
+
+char*
+hpccontainer_fmt_trailer_swrite(uint64_t index_offset, char* buf);
+
+// Locate the index of a container, or of its last checkpoint if the
+// process did not finish it, and leave infs positioned at its first entry.
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR (e.g., the process
+// died before the first checkpoint).
+int
+hpccontainer_fmt_index_seek(uint32_t* num_entries, FILE* infs);
+
+
+//***************************************************************************
+// hpcsnap (located here for now)
+//
+// Periodic snapshots of the profiles of every thread of one process,
+// written while the process runs so that long or killed jobs still leave
+// usable data behind.
+//
+//   [hdr: magic, version, endian, nvpairs]
+//   [record]*
+//
+// Each record is a tag, a kind and a payload length followed by the
+// payload.  Records are only ever appended, a file cut short by a killed
+// process is readable up to its last complete record.
+//
+//   metrics: a metric table, byte-for-byte as in an .hpcrun file
+//   loadmap: num-entries, loadmap entries new since the last loadmap record
+//   delta:   [delta hdr]
+//            num-nodes, cct nodes new since the thread's last delta record,
+//                       parents before children (no metrics, no lush)
+//            num-values, values that changed since the last delta record
+//   done:    thread; the thread wrote its own profile
+//
+// Values in a delta record are cumulative: the value of a metric at a node
+// is the one in the latest delta record that mentions it.
+//***************************************************************************
+
+static const char HPCSNAP_FMT_Magic[]   = "HPCRUN-snapshot___"; // 18 bytes
+static const char HPCSNAP_FMT_Version[] = "01.00";              // 5 bytes
+static const char HPCSNAP_FMT_Endian[]  = "b";                  // 1 byte
+
+#define HPCSNAP_FMT_MagicLenX   (sizeof(HPCSNAP_FMT_Magic) - 1)
+#define HPCSNAP_FMT_VersionLenX (sizeof(HPCSNAP_FMT_Version) - 1)
+#define HPCSNAP_FMT_EndianLenX  (sizeof(HPCSNAP_FMT_Endian) - 1)
+
+static const int HPCSNAP_FMT_MagicLen   = HPCSNAP_FMT_MagicLenX;
+static const int HPCSNAP_FMT_VersionLen = HPCSNAP_FMT_VersionLenX;
+static const int HPCSNAP_FMT_EndianLen  = HPCSNAP_FMT_EndianLenX;
+
+static const uint32_t HPCSNAP_FMT_RecordTag = 0x534E4150; // "SNAP"
+
+typedef enum hpcsnap_record_kind_t {
+  hpcsnap_record_metrics = 1,
+  hpcsnap_record_loadmap = 2,
+  hpcsnap_record_delta   = 3,
+  hpcsnap_record_done    = 4,
+} hpcsnap_record_kind_t;
+
+typedef struct hpcsnap_fmt_record_t {
+  uint8_t  kind;    // hpcsnap_record_kind_t
+  uint64_t length;  // length of the payload in bytes
+} hpcsnap_fmt_record_t;
+
+typedef struct hpcsnap_fmt_delta_hdr_t {
+  uint32_t generation; // snapshot the record belongs to, increasing
+  uint64_t time;       // nanoseconds since the epoch
+  int32_t  thread;     // hpcrun thread id, unique within the process
+  int32_t  rank;       // mpi rank, -1 if not (yet) known
+  id_tuple_t id_tuple; // empty if not (yet) known
+} hpcsnap_fmt_delta_hdr_t;
+
+typedef struct hpcsnap_fmt_value_t {
+  uint32_t id;   // cct node id
+  uint16_t mid;  // metric id
+  hpcrun_metricVal_t value;
+} hpcsnap_fmt_value_t;
+
+int
+hpcsnap_fmt_hdr_fwrite(FILE* fs, ...);
+
+int
+hpcsnap_fmt_hdr_fread(HPCFMT_List(hpcfmt_nvpair_t)* nvps, FILE* infs,
+                      hpcfmt_alloc_fn alloc);
+
+// Write a complete record.
+int
+hpcsnap_fmt_record_fwrite(hpcsnap_record_kind_t kind, const void* payload,
+                          uint64_t length, FILE* fs);
+
+// Read the header of the next record, leaving infs at its payload.
+// Returns: HPCFMT_OK, HPCFMT_EOF at the end of the records or HPCFMT_ERR
+// if the record is malformed.
+int
+hpcsnap_fmt_record_fread(hpcsnap_fmt_record_t* x, FILE* infs);
+
+int
+hpcsnap_fmt_delta_hdr_fwrite(hpcsnap_fmt_delta_hdr_t* x, FILE* fs);
+
+// N.B.: the id tuple is malloc'd, release it with id_tuple_free()
+int
+hpcsnap_fmt_delta_hdr_fread(hpcsnap_fmt_delta_hdr_t* x, FILE* infs);
+
+int
+hpcsnap_fmt_value_fwrite(hpcsnap_fmt_value_t* x, FILE* fs);
+
+int
+hpcsnap_fmt_value_fread(hpcsnap_fmt_value_t* x, FILE* infs);
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -943,6 +1274,11 @@ typedef struct sampling_info_s {
   // 1 if the sample is for a time-based metric
   // 0 otherwise
   int is_time_based_metric;
+
+  // 1 if the caller does not use the sample's cct node, so the
+  // insertion of the sample into the cct may be deferred
+  // 0 otherwise
+  int may_defer;
 } sampling_info_t;
 
 
@@ -98,6 +98,7 @@ static void printKind(FILE* fs, const uint16_t kind) {
   case IDTUPLE_GPUCONTEXT: fprintf(fs, "GPUCONTEXT(%s)", intr); break;
   case IDTUPLE_GPUSTREAM: fprintf(fs, "GPUSTREAM(%s)", intr); break;
   case IDTUPLE_CORE: fprintf(fs, "CORE(%s)", intr); break;
+  case IDTUPLE_SNAPSHOT: fprintf(fs, "SNAPSHOT(%s)", intr); break;
   default: fprintf(fs, "[%"PRIu16"](%s)", IDTUPLE_GET_KIND(kind), intr); break;
   }
 }
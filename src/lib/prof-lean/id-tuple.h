@@ -91,9 +91,10 @@
 #define IDTUPLE_GPUCONTEXT          5
 #define IDTUPLE_GPUSTREAM           6
 #define IDTUPLE_CORE                7
+#define IDTUPLE_SNAPSHOT            8
 
 
-#define IDTUPLE_MAXTYPES            8
+#define IDTUPLE_MAXTYPES            9
 
 #define PMS_id_tuple_len_SIZE       2
 #define PMS_id_SIZE                 18
@@ -71,6 +71,7 @@ using std::dec;
 using std::string;
 
 #include <map>
+#include <memory>
 #include <algorithm>
 #include <sstream>
 
@@ -80,6 +81,9 @@ using std::string;
 
 #include <stdint.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -139,14 +143,36 @@ namespace Prof {
 
 namespace CallPath {
 
-void
-Profile::make(const char* fnm, FILE* outfs, bool sm_easyToGrep) //YUMENG: last arg change to a struct of flags?
+// Returns true if every (kind, logical index) pair in 'want' appears
+// in 'tuple'.
+static bool
+idTupleMatches(const id_tuple_t& tuple,
+               const std::vector<std::pair<uint16_t, uint64_t>>& want)
+{
+  for (const auto& w : want) {
+    bool found = false;
+    for (unsigned int i = 0; i < tuple.length && !found; ++i) {
+      const pms_id_t& id = tuple.ids[i];
+      found = (IDTUPLE_GET_KIND(id.kind) == w.first
+               && (w.second == UINT64_MAX || id.logical_index == w.second));
+    }
+    if (!found) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+bool
+Profile::make(const char* fnm, FILE* outfs, bool sm_easyToGrep,
+              const TextFilter* filter)
 {
   int ret;
 
-  FILE* fs = hpcio_fopen_r(fnm);
+  int fd = open(fnm, O_RDONLY);
 
-  if (!fs) {
+  if (fd < 0) {
     if (errno == ENOENT)
       fprintf(stderr, "ERROR: measurement file or directory '%s' does not exist\n",
               fnm);
@@ -159,21 +185,52 @@ Profile::make(const char* fnm, FILE* outfs, bool sm_easyToGrep) //YUMENG: last a
     prof_abort(-1);
   }
 
-  char* fsBuf = new char[HPCIO_RWBufferSz];
-  ret = setvbuf(fs, fsBuf, _IOFBF, HPCIO_RWBufferSz);
-  DIAG_AssertWarn(ret == 0, "Profile::make: setvbuf!");
+  // Decode through a private read-only mapping: the sections are
+  // visited out of order (footer first), and a memory stream makes
+  // those seeks free.  Fall back to buffered reads if the file cannot
+  // be mapped (e.g. it is empty or not a regular file).
+  struct stat st;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+
+  FILE* fs = NULL;
+  char* fsBuf = NULL;
+  if (map != MAP_FAILED) {
+    madvise(map, st.st_size, MADV_WILLNEED);
+    fs = fmemopen(map, st.st_size, "r");
+  }
+  if (!fs) {
+    fs = fdopen(dup(fd), "r");
+    if (!fs) {
+      fprintf(stderr, "ERROR: failed to open file '%s': system failure\n",
+              fnm);
+      prof_abort(-1);
+    }
+    fsBuf = new char[HPCIO_RWBufferSz];
+    ret = setvbuf(fs, fsBuf, _IOFBF, HPCIO_RWBufferSz);
+    DIAG_AssertWarn(ret == 0, "Profile::make: setvbuf!");
+  }
 
-  ret = fmt_fread(fs, fnm, fnm, outfs, sm_easyToGrep);
+  ret = fmt_fread(fs, fnm, fnm, outfs, sm_easyToGrep, filter);
 
   hpcio_fclose(fs);
+  if (map != MAP_FAILED) {
+    munmap(map, st.st_size);
+  }
+  close(fd);
 
   delete[] fsBuf;
+
+  return ret != HPCFMT_EOF;
 }
 
 
 int
 Profile::fmt_fread(FILE* infs,
-                   std::string ctxtStr, const char* filename, FILE* outfs, bool sm_easyToGrep)
+                   std::string ctxtStr, const char* filename, FILE* outfs, bool sm_easyToGrep,
+                   const TextFilter* filter)
 {
   int ret;
 
@@ -195,6 +252,26 @@ Profile::fmt_fread(FILE* infs,
     prof_abort(-1);
   }
 
+  // ------------------------------------------------------------
+  // id-tuple filter: the id tuple leads the sparse metrics section,
+  // so a non-matching profile is rejected without decoding the rest.
+  // ------------------------------------------------------------
+  if (filter && !filter->idTuple.empty()) {
+    fseek(infs, footer.sm_start, SEEK_SET);
+    id_tuple_t tuple;
+    tuple.ids = NULL;
+    ret = id_tuple_fread(&tuple, infs);
+    if (ret != HPCFMT_OK) {
+      free(tuple.ids);
+      DIAG_Throw("error reading 'id-tuple' of sparse metrics");
+    }
+    bool match = idTupleMatches(tuple, filter->idTuple);
+    id_tuple_free(&tuple);
+    if (!match) {
+      return HPCFMT_EOF;
+    }
+  }
+
   // ------------------------------------------------------------
   // hdr
   // ------------------------------------------------------------
@@ -238,7 +315,7 @@ Profile::fmt_fread(FILE* infs,
 
     try {
       ret = fmt_epoch_fread(infs, hdr, footer,
-                            ctxtStr, filename, outfs, sm_easyToGrep);
+                            ctxtStr, filename, outfs, sm_easyToGrep, filter);
       //if (ret == HPCFMT_EOF) {
             //  break;
       // }
@@ -281,7 +358,8 @@ int
 Profile::fmt_epoch_fread(FILE* infs,
                          const hpcrun_fmt_hdr_t& hdr, const hpcrun_fmt_footer_t& footer,
                          std::string ctxtStr, const char* filename,
-                         FILE* outfs, bool sm_easyToGrep)
+                         FILE* outfs, bool sm_easyToGrep,
+                         const TextFilter* filter)
 {
   using namespace Prof;
 
@@ -487,7 +565,33 @@ Profile::fmt_epoch_fread(FILE* infs,
      filename);
      prof_abort(-1);
   }
-  hpcrun_fmt_sparse_metrics_fprint(&sparse_metrics,outfs, &metricTbl, "  ", sm_easyToGrep);
+
+  // metric filters are resolved against this profile's metric table
+  std::unique_ptr<bool[]> midMask;
+  hpcrun_fmt_sparse_metrics_filter_t smFilter;
+  hpcrun_fmt_sparse_metrics_filter_t* smFilterp = NULL;
+  if (filter && (!filter->metrics.empty() || filter->hasMinValue)) {
+    smFilter.mid_mask = NULL;
+    smFilter.num_mids = metricTbl.len;
+    smFilter.has_min_value = filter->hasMinValue;
+    smFilter.min_value = filter->minValue;
+    if (!filter->metrics.empty()) {
+      midMask.reset(new bool[metricTbl.len]());
+      for (unsigned int i = 0; i < metricTbl.len; ++i) {
+        string mid = StrUtil::toStr(i);
+        const char* nm = metricTbl.lst[i].name;
+        for (const string& m : filter->metrics) {
+          if (m == mid || (nm && m == nm)) {
+            midMask[i] = true;
+          }
+        }
+      }
+      smFilter.mid_mask = midMask.get();
+    }
+    smFilterp = &smFilter;
+  }
+  hpcrun_fmt_sparse_metrics_fprint(&sparse_metrics,outfs, &metricTbl, "  ", sm_easyToGrep,
+                                   smFilterp);
   hpcrun_fmt_sparse_metrics_free(&sparse_metrics, free);
 
   //YUMENG: no epoch info
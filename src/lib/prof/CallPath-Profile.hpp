@@ -68,6 +68,7 @@
 #include <vector>
 #include <set>
 #include <string>
+#include <utility>
 
 
 //*************************** User Include Files ****************************
@@ -90,8 +91,28 @@ namespace CallPath {
 class Profile
 {
 public:
-  static void
-  make(const char* fnm, FILE* outfs, bool sm_easyToGrep);
+  // TextFilter: restricts what make() echoes to 'outfs'.  'metrics'
+  // holds metric names or numeric metric ids; 'idTuple' holds (kind,
+  // logical index) pairs that must all appear in the profile's id
+  // tuple, where a logical index of UINT64_MAX matches any index.
+  // Profiles whose id tuple does not match are skipped before any of
+  // their other sections are decoded.
+  struct TextFilter {
+    std::vector<std::string> metrics;
+    bool hasMinValue = false;
+    double minValue = 0;
+    std::vector<std::pair<uint16_t, uint64_t>> idTuple;
+
+    bool
+    empty() const
+    { return metrics.empty() && !hasMinValue && idTuple.empty(); }
+  };
+
+  // make: Decodes the profile 'fnm' through a read-only mapping of the
+  // file.  Returns false if the profile was skipped by 'filter'.
+  static bool
+  make(const char* fnm, FILE* outfs, bool sm_easyToGrep,
+       const TextFilter* filter = NULL);
 
 
   // fmt_*_fread(): Reads the appropriate hpcrun_fmt object from the
@@ -101,14 +122,17 @@ public:
   // human inspection.
 
 
+  // fmt_fread() returns HPCFMT_EOF if 'filter' rejected the profile.
   static int
   fmt_fread(FILE* infs,
-            std::string ctxtStr, const char* filename, FILE* outfs, bool sm_easyToGrep);
+            std::string ctxtStr, const char* filename, FILE* outfs, bool sm_easyToGrep,
+            const TextFilter* filter = NULL);
 
   static int
   fmt_epoch_fread(FILE* infs,
                   const hpcrun_fmt_hdr_t& hdr, const hpcrun_fmt_footer_t& footer,
-                  std::string ctxtStr, const char* filename, FILE* outfs, bool sm_easyToGrep);
+                  std::string ctxtStr, const char* filename, FILE* outfs, bool sm_easyToGrep,
+                  const TextFilter* filter = NULL);
 
 static int
   fmt_cct_fread(FILE* infs,
@@ -49,6 +49,7 @@
 #include "context.hpp"
 #include "metric.hpp"
 
+#include <algorithm>
 #include <ostream>
 #include <stack>
 
@@ -78,6 +79,15 @@ static double atomic_add(std::atomic<double>& a, const double v) noexcept {
   return old;
 }
 
+static double combine(const double old, const double v, Statistic::combination_t op) noexcept {
+  switch(op) {
+  case Statistic::combination_t::sum: return old + v;
+  case Statistic::combination_t::min: return v < old || old == 0 ? v : old;
+  case Statistic::combination_t::max: return v > old || old == 0 ? v : old;
+  }
+  std::abort();
+}
+
 static double atomic_op(std::atomic<double>& a, const double v, Statistic::combination_t op) noexcept {
   double old = a.load(std::memory_order_relaxed);
   switch(op) {
@@ -179,7 +189,7 @@ void PerContextAccumulators::markUsed(const Metric& m, MetricScopeSet ms) noexce
   m_metricUsage[m] |= ms & m.scopes();
 }
 
-void PerThreadTemporary::finalize() noexcept {
+void PerThreadTemporary::finalize(StatisticReduction& stats) noexcept {
   // Before doing anything else, we need to redistribute the metric values
   // attributed to Reconstructions and FlowGraphs within this Thread.
   {
@@ -383,22 +393,22 @@ void PerThreadTemporary::finalize() noexcept {
       }
     }
 
-    // Now that our bits are stable, accumulate back into the per-Context data
-    auto& cdata = const_cast<Context&>(c).m_data.m_statistics;
-    auto& musage = const_cast<Context&>(c).m_data.m_metricUsage;
+    // Now that our bits are stable, accumulate into the reduction buffer. The
+    // shared per-Context data is only touched once all Threads are in.
     for(const auto& mx: data.citerate()) {
-      musage[mx.first] |= mx.second.getNonZero() & mx.first->scopes();
-      auto& accum = cdata.emplace(std::piecewise_construct,
-        std::forward_as_tuple(mx.first), std::forward_as_tuple(mx.first)).first;
-      for(size_t i = 0; i < mx.first->partials().size(); i++) {
-        auto& partial = mx.first->partials()[i];
-        auto& atomics = accum.partials[i];
-        if(atomics.isLoop.load(std::memory_order_relaxed) != isLoop)
-          atomics.isLoop.store(isLoop, std::memory_order_relaxed);
-        atomic_op(atomics.point, partial.m_accum.evaluate(mx.second.point.load(std::memory_order_relaxed)), partial.combinator());
-        atomic_op(atomics.function, partial.m_accum.evaluate(mx.second.function), partial.combinator());
-        atomic_op(atomics.function_noloops, partial.m_accum.evaluate(mx.second.function_noloops), partial.combinator());
-        atomic_op(atomics.execution, partial.m_accum.evaluate(mx.second.execution), partial.combinator());
+      const Metric& m = mx.first;
+      auto [vals, first] = stats.block(c, m, isLoop, mx.second.getNonZero() & m.scopes());
+      const double point = mx.second.point.load(std::memory_order_relaxed);
+      for(size_t i = 0; i < m.partials().size(); i++, vals += 4) {
+        auto& partial = m.partials()[i];
+        const std::array<double, 4> v = {
+          partial.m_accum.evaluate(point),
+          partial.m_accum.evaluate(mx.second.function),
+          partial.m_accum.evaluate(mx.second.function_noloops),
+          partial.m_accum.evaluate(mx.second.execution),
+        };
+        for(size_t j = 0; j < v.size(); j++)
+          vals[j] = first ? v[j] : combine(vals[j], v[j], partial.combinator());
       }
     }
 
@@ -406,3 +416,85 @@ void PerThreadTemporary::finalize() noexcept {
     if(!stack.empty()) stack.top().submds.emplace_back(c, data);
   }
 }
+
+std::pair<double*, bool> StatisticReduction::block(const Context& c,
+    const Metric& m, bool isLoop, MetricScopeSet usage) {
+  auto [it, first] = m_data[c].try_emplace(m, Block{m_values.size(), isLoop, usage});
+  if(first) {
+    m_values.resize(m_values.size() + 4 * m.partials().size(), 0);
+    m_blocks++;
+  } else it->second.usage |= usage;
+  return {&m_values[it->second.offset], first};
+}
+
+void StatisticReduction::merge(StatisticReduction&& o) noexcept {
+  // Merge the smaller buffer into the larger one
+  if(o.m_values.size() > m_values.size()) std::swap(*this, o);
+
+  for(const auto& [c, mbs]: o.m_data) {
+    for(const auto& [m, ob]: mbs) {
+      const double* ovals = &o.m_values[ob.offset];
+      auto [vals, first] = block(c, m, ob.isLoop, ob.usage);
+      if(first) {
+        std::copy_n(ovals, 4 * m->partials().size(), vals);
+        continue;
+      }
+      for(const auto& partial: m->partials()) {
+        for(size_t j = 0; j < 4; j++, vals++, ovals++)
+          *vals = combine(*vals, *ovals, partial.combinator());
+      }
+    }
+  }
+  o.clear();
+}
+
+void StatisticReduction::apply(std::size_t slice) const noexcept {
+  for(auto cit = m_data.begin(slice), cend = m_data.end(slice); cit != cend; ++cit) {
+    auto& cdata = const_cast<Context&>(cit->first.get()).data();
+    for(const auto& [m, b]: cit->second) {
+      cdata.m_metricUsage[m] |= b.usage;
+      auto& accum = cdata.m_statistics.emplace(std::piecewise_construct,
+        std::forward_as_tuple(m), std::forward_as_tuple(m)).first;
+      const double* vals = &m_values[b.offset];
+      for(size_t i = 0; i < m->partials().size(); i++, vals += 4) {
+        auto& partial = m->partials()[i];
+        auto& atomics = accum.partials[i];
+        if(atomics.isLoop.load(std::memory_order_relaxed) != b.isLoop)
+          atomics.isLoop.store(b.isLoop, std::memory_order_relaxed);
+        atomic_op(atomics.point, vals[0], partial.combinator());
+        atomic_op(atomics.function, vals[1], partial.combinator());
+        atomic_op(atomics.function_noloops, vals[2], partial.combinator());
+        atomic_op(atomics.execution, vals[3], partial.combinator());
+      }
+    }
+  }
+}
+
+void StatisticReduction::flush() noexcept {
+  for(std::size_t i = 0; i < slices(); ++i) apply(i);
+  clear();
+}
+
+void StatisticReduction::clear() noexcept {
+  m_data.clear();
+  m_values.clear();
+  m_values.shrink_to_fit();
+  m_blocks = 0;
+}
+
+std::size_t StatisticReduction::size() const noexcept {
+  // Each Block costs a node in the inner map, plus some slack for the buckets
+  // and the outer map. Close enough to decide when to flush.
+  return m_values.capacity() * sizeof(double)
+         + m_blocks * (sizeof(Block) + 4 * sizeof(void*));
+}
+
+static std::size_t reductionLimit = 64 * 1024 * 1024;
+
+void StatisticReduction::setLimit(std::size_t bytes) noexcept {
+  reductionLimit = bytes;
+}
+
+std::size_t StatisticReduction::limit() noexcept {
+  return reductionLimit;
+}
@@ -57,6 +57,7 @@
 #include <chrono>
 #include <iosfwd>
 #include <optional>
+#include <unordered_map>
 #include <vector>
 
 namespace hpctoolkit {
@@ -67,6 +68,7 @@ class Thread;
 class Context;
 class ContextReconstruction;
 class ContextFlowGraph;
+class StatisticReduction;
 
 /// Every Metric can have values at multiple Scopes pertaining to the subtree
 /// rooted at a particular Context with Metric data.
@@ -240,9 +242,10 @@ private:
   friend class ProfilePipeline;
   PerThreadTemporary(Thread& t) : m_thread(t) {};
 
-  // Finalize the MetricAccumulators for a Thread.
-  // MT: Internally Synchronized
-  void finalize() noexcept;
+  // Finalize the MetricAccumulators for a Thread. The resulting Statistic
+  // values are accumulated into the given (worker-private) reduction buffer.
+  // MT: Internally Synchronized, Externally Synchronized (StatisticReduction)
+  void finalize(StatisticReduction&) noexcept;
 
   // Bits needed for handling timepoints
   std::chrono::nanoseconds minTime = std::chrono::nanoseconds::max();
@@ -314,6 +317,7 @@ private:
 
     friend class StatisticAccumulator;
     friend class PerThreadTemporary;
+    friend class StatisticReduction;
     std::atomic<bool> isLoop = false;
     std::atomic<double> point = 0;
     std::atomic<double> function = 0;
@@ -407,6 +411,7 @@ public:
 
 private:
   friend class PerThreadTemporary;
+  friend class StatisticReduction;
   std::vector<Partial> partials;
 };
 
@@ -477,6 +482,7 @@ public:
 
 private:
   friend class PerThreadTemporary;
+  friend class StatisticReduction;
   friend class Metric;
   friend class ProfilePipeline;
   util::locked_unordered_map<util::reference_index<const Metric>,
@@ -485,6 +491,83 @@ private:
     AtomicMetricScopeSet> m_metricUsage;
 };
 
+/// Worker-private buffer of Statistic values for many Contexts. Threads are
+/// finalized into one of these without touching the shared per-Context
+/// accumulators, the buffers are then merged pairwise and the result applied
+/// to the Contexts once. This keeps hot Contexts (e.g. the root) from seeing
+/// an atomic update from every Thread.
+///
+/// To keep the memory bounded regardless of the number of workers, a buffer
+/// that grows past limit() should be flushed to the Contexts early.
+class StatisticReduction final {
+public:
+  StatisticReduction() = default;
+  ~StatisticReduction() = default;
+
+  StatisticReduction(const StatisticReduction&) = delete;
+  StatisticReduction(StatisticReduction&&) = default;
+  StatisticReduction& operator=(const StatisticReduction&) = delete;
+  StatisticReduction& operator=(StatisticReduction&&) = default;
+
+  /// Merge another buffer into this one, combining the values for any shared
+  /// Contexts with the Statistics' combinators. Leaves `o` empty.
+  // MT: Externally Synchronized (this, o)
+  void merge(StatisticReduction&& o) noexcept;
+
+  /// Number of disjoint slices this buffer can be applied in.
+  // MT: Safe (const)
+  std::size_t slices() const noexcept { return m_data.bucket_count(); }
+
+  /// Apply one slice of this buffer to the Contexts' Statistics. Different
+  /// slices touch disjoint sets of Contexts and can be applied in parallel.
+  // MT: Safe (const), Internally Synchronized (Contexts)
+  void apply(std::size_t slice) const noexcept;
+
+  /// Apply the entire buffer to the Contexts' Statistics and free it.
+  // MT: Externally Synchronized, Internally Synchronized (Contexts)
+  void flush() noexcept;
+
+  /// Free all the memory held by this buffer.
+  // MT: Externally Synchronized
+  void clear() noexcept;
+
+  /// Approximate number of bytes of memory held by this buffer.
+  // MT: Safe (const)
+  std::size_t size() const noexcept;
+
+  /// Set the size above which a buffer should be flushed early. A limit of 0
+  /// flushes after every Thread, applying every Thread's Statistics directly.
+  /// Should be called before any Profiles are processed.
+  // MT: Externally Synchronized
+  static void setLimit(std::size_t bytes) noexcept;
+
+  /// Get the size above which a buffer should be flushed early.
+  // MT: Safe
+  static std::size_t limit() noexcept;
+
+private:
+  friend class PerThreadTemporary;
+
+  // Accumulated values for a single Metric within a Context. The values
+  // themselves are stored densely in m_values, starting at `offset`: the 4
+  // non-isLoop fields of a StatisticAccumulator::Partial per StatisticPartial.
+  struct Block {
+    std::size_t offset;
+    bool isLoop;
+    MetricScopeSet usage;
+  };
+
+  // Get the values for a Block, allocating a new zero'd Block if required.
+  // Returns a pointer to the values and whether the Block is new.
+  std::pair<double*, bool> block(const Context&, const Metric&, bool isLoop,
+                                 MetricScopeSet usage);
+
+  std::unordered_map<util::reference_index<const Context>,
+    std::unordered_map<util::reference_index<const Metric>, Block>> m_data;
+  std::vector<double> m_values;
+  std::size_t m_blocks = 0;
+};
+
 }  // namespace hpctoolkit
 
 #endif  // HPCTOOLKIT_PROFILE_ACCUMULATORS_H
@@ -248,6 +248,7 @@ std::ostream& std::operator<<(std::ostream& os, const ThreadAttributes& ta) noex
     case IDTUPLE_GPUCONTEXT: os << "GPUCONTEXT(" << intr << "){"; break;
     case IDTUPLE_GPUSTREAM: os << "GPUSTREAM(" << intr << "){"; break;
     case IDTUPLE_CORE: os << "CORE(" << intr << "){"; break;
+    case IDTUPLE_SNAPSHOT: os << "SNAPSHOT(" << intr << "){"; break;
     default: os << "[" << IDTUPLE_GET_KIND(kv.kind) << "](" << intr << "){"; break;
     }
     if(IDTUPLE_GET_INTERPRET(kv.kind) != IDTUPLE_IDS_LOGIC_ONLY)
@@ -49,11 +49,13 @@
 #include "pipeline.hpp"
 
 #include "util/log.hpp"
+#include "util/telemetry.hpp"
 #include "source.hpp"
 #include "sink.hpp"
 #include "finalizer.hpp"
 
 #include <iomanip>
+#include <omp.h>
 #include <stdexcept>
 #include <limits>
 
@@ -137,17 +139,25 @@ Settings& Settings::operator<<(std::unique_ptr<ProfileFinalizer>&& fp) {
 
 ProfilePipeline::ProfilePipeline(Settings&& b, std::size_t team_sz)
   : detail::ProfilePipelineBase(std::move(b)), team_size(team_sz),
-    waves(sources.size()),
+    telemetryId(std::numeric_limits<std::size_t>::max()), waves(sources.size()),
     sourcePrewaveRegionDepChain(std::numeric_limits<std::size_t>::max()),
     sinkWavefrontDepChain(std::numeric_limits<std::size_t>::max()),
     sourcePostwaveRegionDepChain(std::numeric_limits<std::size_t>::max()),
     sinkWriteDepChain(std::numeric_limits<std::size_t>::max()),
     depChainComplete(false), sourceLocals(sources.size()), cct(nullptr) {
   using namespace literals::data;
+  if(util::telemetry::enabled()) {
+    std::vector<std::string> srcNames, sinkNames;
+    for(auto& s: sources) srcNames.emplace_back(util::telemetry::typeName(typeid(s())));
+    for(auto& s: sinks) sinkNames.emplace_back(util::telemetry::typeName(typeid(s())));
+    telemetryId = util::telemetry::pipeline(std::move(srcNames), std::move(sinkNames));
+  }
+
   // Prep the Extensions first thing.
   if(requested.hasIdentifier()) {
     uds.identifier.file = structs.file.add_default<unsigned int>(
       [this](unsigned int& id, const File& f){
+        util::telemetry::Timer timer("finalizer.identify");
         id = std::numeric_limits<unsigned int>::max();
         for(ProfileFinalizer& fp: finalizers.identifier) {
           if(auto v = fp.identify(f)) {
@@ -158,6 +168,7 @@ ProfilePipeline::ProfilePipeline(Settings&& b, std::size_t team_sz)
       });
     uds.identifier.context = structs.context.add_default<unsigned int>(
       [this](unsigned int& id, const Context& c){
+        util::telemetry::Timer timer("finalizer.identify");
         id = std::numeric_limits<unsigned int>::max();
         for(ProfileFinalizer& fp: finalizers.identifier) {
           if(auto v = fp.identify(c)) {
@@ -168,6 +179,7 @@ ProfilePipeline::ProfilePipeline(Settings&& b, std::size_t team_sz)
       });
     uds.identifier.module = structs.module.add_default<unsigned int>(
       [this](unsigned int& id, const Module& m){
+        util::telemetry::Timer timer("finalizer.identify");
         id = std::numeric_limits<unsigned int>::max();
         for(ProfileFinalizer& fp: finalizers.identifier) {
           if(auto v = fp.identify(m)) {
@@ -178,6 +190,7 @@ ProfilePipeline::ProfilePipeline(Settings&& b, std::size_t team_sz)
       });
     uds.identifier.metric = structs.metric.add_initializer<Metric::Identifier>(
       [this](Metric::Identifier& id, const Metric& m){
+        util::telemetry::Timer timer("finalizer.identify");
         for(ProfileFinalizer& fp: finalizers.identifier) {
           if(auto v = fp.identify(m)) {
             assert(&v->getMetric() == &m);
@@ -188,6 +201,7 @@ ProfilePipeline::ProfilePipeline(Settings&& b, std::size_t team_sz)
       });
     uds.identifier.thread = structs.thread.add_default<unsigned int>(
       [this](unsigned int& id, const Thread& t){
+        util::telemetry::Timer timer("finalizer.identify");
         id = std::numeric_limits<unsigned int>::max();
         for(ProfileFinalizer& fp: finalizers.identifier) {
           if(auto v = fp.identify(t)) {
@@ -200,6 +214,7 @@ ProfilePipeline::ProfilePipeline(Settings&& b, std::size_t team_sz)
   if(requested.hasResolvedPath()) {
     uds.resolvedPath.file = structs.file.add_default<stdshim::filesystem::path>(
       [this](stdshim::filesystem::path& sp, const File& f){
+        util::telemetry::Timer timer("finalizer.resolvePath");
         for(ProfileFinalizer& fp: finalizers.resolvedPath) {
           if(auto v = fp.resolvePath(f)) {
             assert(v->empty() || v->is_absolute());
@@ -212,6 +227,7 @@ ProfilePipeline::ProfilePipeline(Settings&& b, std::size_t team_sz)
       });
     uds.resolvedPath.module = structs.module.add_default<stdshim::filesystem::path>(
       [this](stdshim::filesystem::path& sp, const Module& m){
+        util::telemetry::Timer timer("finalizer.resolvePath");
         for(ProfileFinalizer& fp: finalizers.resolvedPath) {
           if(auto v = fp.resolvePath(m)) {
             assert(v->empty() || v->is_absolute());
@@ -265,7 +281,7 @@ ProfilePipeline::ProfilePipeline(Settings&& b, std::size_t team_sz)
   scheduledWaves &= scheduled;
 }
 
-void ProfilePipeline::complete(PerThreadTemporary&& tt, std::optional<std::pair<std::chrono::nanoseconds, std::chrono::nanoseconds>>& localTimepointBounds) {
+void ProfilePipeline::complete(PerThreadTemporary&& tt, StatisticReduction& localStats, std::optional<std::pair<std::chrono::nanoseconds, std::chrono::nanoseconds>>& localTimepointBounds) {
   auto drain = [&](auto& tpd, auto type, auto notify) {
     // Drain the remaining timepoints from the staging buffer first
     if(!tpd.staging.empty()) {
@@ -275,7 +291,7 @@ void ProfilePipeline::complete(PerThreadTemporary&& tt, std::optional<std::pair<
       }
       for(auto& s: sinks) {
         if(!s.dataLimit.has(type)) continue;
-        notify(s(), tpd.staging);
+        notify(s, tpd.staging);
       }
       tpd.staging.clear();
     }
@@ -284,7 +300,7 @@ void ProfilePipeline::complete(PerThreadTemporary&& tt, std::optional<std::pair<
       auto tps = std::move(tpd.sortBuf).sorted();
       for(auto& s: sinks) {
         if(!s.dataLimit.has(type)) continue;
-        notify(s(), tps);
+        notify(s, tps);
       }
     }
 
@@ -297,21 +313,36 @@ void ProfilePipeline::complete(PerThreadTemporary&& tt, std::optional<std::pair<
         localTimepointBounds = {tt.minTime, tt.maxTime};
     }
   };
-  drain(tt.ctxTpData, DataClass::ctxTimepoints, [&](ProfileSink& s, const auto& tps){
-    s.notifyTimepoints(tt.thread(), tps);
+  util::telemetry::Span span("thread.complete", "thread");
+  drain(tt.ctxTpData, DataClass::ctxTimepoints, [&](SinkEntry& s, const auto& tps){
+    util::telemetry::SinkCall call(telemetryId, &s - sinks.data());
+    s().notifyTimepoints(tt.thread(), tps);
   });
   for(auto& [m, tpd]: tt.metricTpData.iterate()) {
     const Metric& mm = m;
-    drain(tpd, DataClass::metricTimepoints, [&](ProfileSink& s, const auto& tps){
-      s.notifyTimepoints(tt.thread(), mm, tps);
+    drain(tpd, DataClass::metricTimepoints, [&](SinkEntry& s, const auto& tps){
+      util::telemetry::SinkCall call(telemetryId, &s - sinks.data());
+      s().notifyTimepoints(tt.thread(), mm, tps);
     });
   }
 
   // Finish off the Thread's metrics and let the Sinks know
-  tt.finalize();
+  {
+    util::telemetry::Span span("thread.finalize", "thread");
+    tt.finalize(localStats);
+  }
+  // Keep the worker-private buffer bounded, flushing it to the Contexts early
+  // if it has grown too large. Later Threads start a fresh buffer.
+  if(localStats.size() > StatisticReduction::limit()) {
+    util::telemetry::Span span("statistics.flush", "statistics");
+    localStats.flush();
+  }
   std::shared_ptr<PerThreadTemporary> ttptr = std::make_shared<PerThreadTemporary>(std::move(tt));
-  for(auto& s: sinks)
-    if(s.dataLimit.hasThreads()) s().notifyThreadFinal(ttptr);
+  for(auto& s: sinks) {
+    if(!s.dataLimit.hasThreads()) continue;
+    util::telemetry::SinkCall call(telemetryId, &s - sinks.data());
+    s().notifyThreadFinal(ttptr);
+  }
 }
 
 void ProfilePipeline::run() {
@@ -320,14 +351,22 @@ void ProfilePipeline::run() {
   char barrier_arc;
   char single_arc;
   char barrier2_arc;
+  char reduce_arc;
   char end_arc;
 #endif  // !NVALGRIND
 
+  util::telemetry::Span span("pipeline.run", "pipeline");
+  util::telemetry::sampleMemory("pipeline.start");
+
   std::array<std::atomic<std::size_t>, 4> countdowns;
   for(auto& c: countdowns) c.store(sources.size(), std::memory_order_relaxed);
 
   std::deque<std::reference_wrapper<PerThreadTemporary>> allMergedThreads;
 
+  // Worker-private Statistic buffers, indexed by OpenMP thread number. Each is
+  // bounded by StatisticReduction::limit(), see complete().
+  std::vector<StatisticReduction> stats(team_size);
+
   ANNOTATE_HAPPENS_BEFORE(&start_arc);
   #pragma omp parallel num_threads(team_size)
   {
@@ -353,6 +392,7 @@ void ProfilePipeline::run() {
       }
 
       // Deliver a notification, potentially out of order
+      util::telemetry::SinkCall call(telemetryId, &e - sinks.data());
       e().notifyWavefront(allwaves);
     };
 
@@ -370,8 +410,9 @@ void ProfilePipeline::run() {
     }
 
     // The rest of the waves have the same general format
-    auto wave = [&](DataClass d, std::size_t idx) {
+    auto wave = [&](DataClass d, std::size_t idx, const char* name) {
       if(!(d & scheduledWaves).hasAny()) return;
+      util::telemetry::Span span(name, "wave");
       #pragma omp for schedule(dynamic) nowait
       for(std::size_t i = 0; i < sources.size(); ++i) {
         {
@@ -380,6 +421,7 @@ void ProfilePipeline::run() {
                           & sources[i].dataLimit;
           sources[i].read |= req;
           if(req.hasAny()) {
+            util::telemetry::SourceRead r(telemetryId, i);
             sources[i]().read(req);
             // If there are (as of now) no more available waves for this source,
             // emit a signal to unblock the finishing wave
@@ -397,44 +439,52 @@ void ProfilePipeline::run() {
         }
       }
     };
-    wave(DataClass::attributes, 0);
-    wave(DataClass::references, 1);
-    wave(DataClass::threads, 2);
-    wave(DataClass::contexts, 3);
+    wave(DataClass::attributes, 0, "wave.attributes");
+    wave(DataClass::references, 1, "wave.references");
+    wave(DataClass::threads, 2, "wave.threads");
+    wave(DataClass::contexts, 3, "wave.contexts");
 
     std::optional<std::pair<std::chrono::nanoseconds, std::chrono::nanoseconds>>
       localTimepointBounds;
+    StatisticReduction& localStats = stats[omp_get_thread_num()];
 
     // Now for the finishing wave
-    #pragma omp for schedule(dynamic) nowait
-    for(std::size_t i = 0; i < sources.size(); ++i) {
-      auto& sl = sourceLocals[i];
-      {
-        sources[i].wavesComplete.wait();
-        std::unique_lock<std::mutex> l(sources[i].lock);
-        sl.lastWave = true;
-        DataClass req = (sources[i]().finalizeRequest(scheduled - scheduledWaves)
-                         - sources[i].read) & sources[i].dataLimit;
-        sources[i].read |= req;
-        if(req.hasAny()) sources[i]().read(req);
+    {
+      util::telemetry::Span span("wave.finish", "wave");
+      #pragma omp for schedule(dynamic) nowait
+      for(std::size_t i = 0; i < sources.size(); ++i) {
+        auto& sl = sourceLocals[i];
+        {
+          sources[i].wavesComplete.wait();
+          std::unique_lock<std::mutex> l(sources[i].lock);
+          sl.lastWave = true;
+          DataClass req = (sources[i]().finalizeRequest(scheduled - scheduledWaves)
+                           - sources[i].read) & sources[i].dataLimit;
+          sources[i].read |= req;
+          if(req.hasAny()) {
+            util::telemetry::SourceRead r(telemetryId, i);
+            sources[i]().read(req);
+          }
 #ifndef NDEBUG
-        sl.disabled |= req;
+          sl.disabled |= req;
 #endif
-      }
+        }
 
-      // Complete the threads unit to this Source in particular
-      for(auto& tt: sl.threads) complete(std::move(tt), localTimepointBounds);
+        // Complete the threads unit to this Source in particular
+        for(auto& tt: sl.threads) complete(std::move(tt), localStats, localTimepointBounds);
 
-      // Clean up the Source-local data.
-      sl.threads.clear();
-      assert(sl.thawedMetrics.empty() && "Source exited before freezing all of its referenced Metrics!");
-      sl.thawedMetrics.clear();
+        // Clean up the Source-local data.
+        sl.threads.clear();
+        assert(sl.thawedMetrics.empty() && "Source exited before freezing all of its referenced Metrics!");
+        sl.thawedMetrics.clear();
+      }
     }
 
     // Make sure everything has been read before we handle the merged threads
     ANNOTATE_HAPPENS_BEFORE(&barrier_arc);
     #pragma omp barrier
     ANNOTATE_HAPPENS_AFTER(&barrier_arc);
+    if(omp_get_thread_num() == 0) util::telemetry::sampleMemory("sources.read");
 
     // One thread fills allMergedThreads from the mergedThreads map, all others
     // wait for that to complete.
@@ -448,9 +498,12 @@ void ProfilePipeline::run() {
     ANNOTATE_HAPPENS_AFTER(&single_arc);
 
     // Handle all the Threads that were merged, same as for any other Thread
-    #pragma omp for schedule(dynamic) nowait
-    for(std::size_t i = 0; i < allMergedThreads.size(); ++i) {
-      complete(std::move(allMergedThreads[i].get()), localTimepointBounds);
+    {
+      util::telemetry::Span span("threads.merged", "wave");
+      #pragma omp for schedule(dynamic) nowait
+      for(std::size_t i = 0; i < allMergedThreads.size(); ++i) {
+        complete(std::move(allMergedThreads[i].get()), localStats, localTimepointBounds);
+      }
     }
 
     // Update the main timepoint bounds with our thread-local data
@@ -467,6 +520,36 @@ void ProfilePipeline::run() {
     ANNOTATE_HAPPENS_BEFORE(&barrier2_arc);
     #pragma omp barrier
     ANNOTATE_HAPPENS_AFTER(&barrier2_arc);
+    if(omp_get_thread_num() == 0) util::telemetry::sampleMemory("threads.complete");
+
+    // Reduce the per-worker Statistics in a binary tree, so every level merges
+    // disjoint pairs of buffers without any contention between workers.
+    {
+      util::telemetry::Span span("statistics.reduce", "statistics");
+      const std::size_t tid = omp_get_thread_num();
+      const std::size_t nth = omp_get_num_threads();
+      for(std::size_t stride = 1; stride < nth; stride *= 2) {
+        if(tid % (2 * stride) == 0 && tid + stride < nth)
+          stats[tid].merge(std::move(stats[tid + stride]));
+        ANNOTATE_HAPPENS_BEFORE(&reduce_arc);
+        #pragma omp barrier
+        ANNOTATE_HAPPENS_AFTER(&reduce_arc);
+      }
+    }
+
+    // Apply the final Statistics to the Contexts. Slices are disjoint, so each
+    // Context's accumulators are only updated once and never contended.
+    {
+      util::telemetry::Span span("statistics.apply", "statistics");
+      #pragma omp for schedule(dynamic)
+      for(std::size_t i = 0; i < stats[0].slices(); ++i)
+        stats[0].apply(i);
+    }
+    if(omp_get_thread_num() == 0) util::telemetry::sampleMemory("statistics");
+
+    // Free the reduced Statistics early, they're no longer needed
+    #pragma omp single nowait
+    stats[0].clear();
 
     // Clean up the Sources early, to save some serialized time later
     #pragma omp for schedule(dynamic) nowait
@@ -475,10 +558,14 @@ void ProfilePipeline::run() {
 
     // Let the Sinks finish up their writing
     #pragma omp for schedule(dynamic) nowait
-    for(std::size_t idx = 0; idx < sinks.size(); ++idx)
+    for(std::size_t idx = 0; idx < sinks.size(); ++idx) {
+      util::telemetry::Span span("sink.write", "sink", "sink", idx);
+      util::telemetry::SinkCall call(telemetryId, idx);
       sinks[idx]().write();
+    }
 
     // We don't have any work to do, so attempt to assist the others.
+    util::telemetry::Span helpSpan("sink.help", "sink");
     std::forward_list<std::reference_wrapper<SinkEntry>> workingSinks(sinks.begin(), sinks.end());
     bool didwork = true;
     do {
@@ -490,7 +577,9 @@ void ProfilePipeline::run() {
       auto before_it = workingSinks.before_begin();
       auto it = workingSinks.begin();
       while(it != workingSinks.end()) {
-        auto result = (*it)().help();
+        SinkEntry& e = *it;
+        util::telemetry::SinkCall call(telemetryId, &e - sinks.data());
+        auto result = e().help();
         didwork = didwork || result.contributed;
         if(result.completed) {
           it = workingSinks.erase_after(before_it);
@@ -504,6 +593,7 @@ void ProfilePipeline::run() {
     ANNOTATE_HAPPENS_BEFORE(&end_arc);
   }
   ANNOTATE_HAPPENS_AFTER(&end_arc);
+  util::telemetry::sampleMemory("pipeline.end");
 }
 
 Source::Source() : pipe(nullptr), finalizeContexts(false) {};
@@ -598,6 +688,7 @@ Metric& Source::metric(Metric::Settings s) {
   SRC_ASSERT_LIMITS(attributes);
   auto x = pipe->mets.emplace(pipe->structs.metric, std::move(s));
   slocal->thawedMetrics.insert(&x.first());
+  util::telemetry::Timer timer("finalizer.statistics");
   for(ProfileFinalizer& f: pipe->finalizers.statistics)
     f.appendStatistics(x.first(), x.first().statsAccess());
   return x.first();
@@ -635,6 +726,7 @@ std::pair<Context&, Context&> Source::context(Context& p, const NestedScope& ns)
   std::reference_wrapper<Context> res_flat = p;
   NestedScope res_ns = ns;
   if(finalizeContexts) {
+    util::telemetry::Timer timer("finalizer.classify");
     for(ProfileFinalizer& f: pipe->finalizers.classification) {
       NestedScope this_ns = ns;
       auto r = f.classify(p, this_ns);
@@ -660,8 +752,11 @@ util::optional_ref<ContextFlowGraph> Source::contextFlowGraph(const Scope& s) {
   std::pair<const util::uniqued<ContextFlowGraph>&, bool> x = pipe->cgraphs.emplace(s);
   ContextFlowGraph& fg = x.first();
   if(x.second) {
-    for(ProfileFinalizer& f: pipe->finalizers.classification) {
-      if(f.resolve(fg)) break;
+    {
+      util::telemetry::Timer timer("finalizer.resolve");
+      for(ProfileFinalizer& f: pipe->finalizers.classification) {
+        if(f.resolve(fg)) break;
+      }
     }
     fg.freeze([&](const Scope& ss){
       assert(ss != s);
@@ -553,7 +553,7 @@ public:
 private:
   // Finalize the data in a PerThreadTemporary, and commit it to the Sinks
   // MT: Externally Synchronized (tt, localTimepointBounds), Internally Synchronized (this)
-  void complete(PerThreadTemporary&& tt, std::optional<std::pair<std::chrono::nanoseconds, std::chrono::nanoseconds>>& localTimepointBounds);
+  void complete(PerThreadTemporary&& tt, StatisticReduction& localStats, std::optional<std::pair<std::chrono::nanoseconds, std::chrono::nanoseconds>>& localTimepointBounds);
 
   // Scheduled data transfer. Minimal requested and available set.
   DataClass scheduled;
@@ -563,6 +563,8 @@ private:
   DataClass unscheduledWaves;
   // Size of the worker thread teams for doing things.
   std::size_t team_size;
+  // Identifier for this Pipeline in the telemetry, if enabled.
+  std::size_t telemetryId;
 
   // Atomic counters for the early wavefronts.
   struct Waves {
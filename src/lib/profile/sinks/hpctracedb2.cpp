@@ -58,6 +58,7 @@
 
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstring>
@@ -71,7 +72,10 @@ static constexpr uint64_t align(uint64_t v, uint8_t a) {
   return (v + a - 1) / a * a;
 }
 
-HPCTraceDB2::HPCTraceDB2(const stdshim::filesystem::path& dir) {
+HPCTraceDB2::HPCTraceDB2(const stdshim::filesystem::path& dir,
+                         unsigned int summaryLevels, unsigned int summaryDepth)
+  : summaryLevels(summaryLevels), summaryDepth(summaryDepth) {
+  assert(summaryLevels <= 16 && summaryDepth <= 0xff);
   if(!dir.empty()) {
     stdshim::filesystem::create_directory(dir);
     tracefile = util::File(dir / "trace.db", true);
@@ -106,6 +110,10 @@ void HPCTraceDB2::notifyWavefront(DataClass d){
     }
     has_traces = mpi::allreduce<uint32_t>(myRealTraces, mpi::Op::sum()) > 0;
 
+    // Sections following the Context Trace Headers depend on the number of traces
+    pCtxTraceSums = align(ctx_pTraces + totalNumTraces * FMT_TRACEDB_SZ_CtxTrace, 8);
+    sums_pSummaries = align(pCtxTraceSums + FMT_TRACEDB_SZ_CtxTraceSumSHdr, 8);
+
     //calculate the offsets for later stored in start and end
     //assign the values of the hdrs
     assignHdrs(calcStartEnd());
@@ -122,7 +130,7 @@ void HPCTraceDB2::notifyWavefront(DataClass d){
     ud.prebuffer_done = true;
     l.unlock();
 
-    traceinst.writeat(ud.hdr.start, prebuffer);
+    traceinst.writeat(ud.hdr.start, std::move(prebuffer));
     if(ud.hdr_prebuffered)
       writeHdrFor(ud, traceinst);
   }
@@ -182,6 +190,9 @@ void HPCTraceDB2::notifyTimepoints(const Thread& t, const std::vector<
       return c->userdata[src.identifier()];
     });
 
+    if(summaryLevels > 0)
+      ud.summary.timepoint(summaryLevels, tm.count(), id, summaryIdFor(c));
+
     fmt_tracedb_ctxSample_t datum = {
       .timestamp = static_cast<uint64_t>(tm.count()),
       .ctxId = id,
@@ -216,6 +227,7 @@ void HPCTraceDB2::notifyCtxTimepointRewindStart(const Thread& t) {
   ud.buffer_cursor = 0;
   ud.off = -1;
   ud.tmcntr = 0;
+  ud.summary.clear();
 
   std::unique_lock<std::shared_mutex> l(ud.prebuffer_lock);
   if(!ud.prebuffer_done)
@@ -272,11 +284,188 @@ void HPCTraceDB2::writeHdrFor(udThread& ud, util::File::Instance& inst) {
   fmt_tracedb_ctxTrace_write(buf, &hdr);
   inst.writeat(ctx_pTraces + (ud.hdr.prof_info_idx - 1) * FMT_TRACEDB_SZ_CtxTrace,
                sizeof buf, buf);
+
+  if(summaryLevels > 0)
+    writeSummaryFor(ud, inst);
+}
+
+//***************************************************************************
+// trace summaries
+//***************************************************************************
+
+// Maximum number of contexts tracked per summary bucket. Beyond this the
+// lightest entry is replaced, its weight carried over (space-saving), so the
+// heaviest contexts of a bucket are retained but may be slightly overweight.
+static constexpr std::size_t summaryTableSize = 8;
+
+void HPCTraceDB2::Summary::tableAdd(Table& t, uint32_t id, uint64_t w) {
+  for(auto& [eid, ew]: t) {
+    if(eid == id) {
+      ew += w;
+      return;
+    }
+  }
+  if(t.size() < summaryTableSize) {
+    t.emplace_back(id, w);
+    return;
+  }
+  auto lightest = std::min_element(t.begin(), t.end(), [](const auto& a, const auto& b){
+    return a.second < b.second;
+  });
+  *lightest = {id, lightest->second + w};
+}
+
+void HPCTraceDB2::Summary::merge(Bucket& dst, Bucket&& src) {
+  if(dst.leaf.empty() && dst.depth.empty()) {
+    dst = std::move(src);
+    return;
+  }
+  for(const auto& [id, w]: src.leaf) tableAdd(dst.leaf, id, w);
+  for(const auto& [id, w]: src.depth) tableAdd(dst.depth, id, w);
+}
+
+void HPCTraceDB2::Summary::add(unsigned int levels, uint64_t start, uint64_t end,
+                               uint32_t leaf, uint32_t depth) {
+  const uint64_t n = UINT64_C(1) << (levels - 1);
+  if(buckets.empty()) {
+    buckets.resize(n);
+    base = start;
+    shift = 0;
+  }
+  // Timepoints arrive in order, but don't trust that blindly
+  start = std::max(start, base << shift);
+  if(start >= end) return;
+
+  // Widen the buckets until the whole interval fits in the finest level
+  while(((end - 1) >> shift) >= base + n)
+    coarsen();
+
+  for(uint64_t b = start >> shift; b < base + n && (b << shift) < end; b++) {
+    const uint64_t w = std::min(end, (b + 1) << shift) - std::max(start, b << shift);
+    auto& bkt = buckets[b - base];
+    tableAdd(bkt.leaf, leaf, w);
+    tableAdd(bkt.depth, depth, w);
+  }
+}
+
+void HPCTraceDB2::Summary::coarsen() {
+  std::vector<Bucket> next(buckets.size());
+  for(std::size_t i = 0; i < buckets.size(); i++)
+    Summary::merge(next[((base + i) >> 1) - (base >> 1)], std::move(buckets[i]));
+  buckets = std::move(next);
+  base >>= 1;
+  shift++;
+}
+
+void HPCTraceDB2::Summary::timepoint(unsigned int levels, uint64_t tm,
+                                     uint32_t leaf, uint32_t depth) {
+  if(last) {
+    auto [ltm, lleaf, ldepth] = *last;
+    add(levels, ltm, tm, lleaf, ldepth);
+  }
+  last = {tm, leaf, depth};
+}
+
+void HPCTraceDB2::Summary::clear() {
+  buckets.clear();
+  base = 0;
+  shift = 0;
+  last.reset();
+}
+
+uint32_t HPCTraceDB2::summaryIdFor(const Context& c) {
+  auto& ud = c.userdata[uds.context];
+  uint32_t id = ud.summaryId.load(std::memory_order_relaxed);
+  if(id != (uint32_t)-1) return id;
+
+  // Path from the root to c, skipping Contexts that are not in the output
+  std::vector<util::reference_index<const Context>> path;
+  for(util::optional_ref<const Context> p = c; p; p = p->direct_parent()) {
+    if(!MetaDB::elide(*p))
+      path.emplace_back(*p);
+  }
+  std::reverse(path.begin(), path.end());
+  id = path[std::min<std::size_t>(summaryDepth, path.size() - 1)]->userdata[src.identifier()];
+  ud.summaryId.store(id, std::memory_order_relaxed);
+  return id;
+}
+
+uint64_t HPCTraceDB2::summarySize() const noexcept {
+  const uint64_t szBucket = FMT_TRACEDB_SZ_CtxSumBucket + summaryHist * FMT_TRACEDB_SZ_CtxSumHist;
+  return ((UINT64_C(1) << summaryLevels) - 1) * szBucket;
+}
+
+void HPCTraceDB2::writeSummaryFor(udThread& ud, util::File::Instance& inst) {
+  auto& sum = ud.summary;
+  fmt_tracedb_ctxTraceSum_t cts = {
+    .profIndex = ud.hdr.prof_info_idx,
+    .startTimestamp = sum.base << sum.shift,
+    .bucketWidth = UINT64_C(1) << sum.shift,
+    .pBuckets = 0,
+  };
+
+  if(!sum.buckets.empty()) {
+    assert(ud.hdr.summary != (uint64_t)INVALID_HDR);
+    cts.pBuckets = ud.hdr.summary;
+    const std::size_t szBucket = FMT_TRACEDB_SZ_CtxSumBucket + summaryHist * FMT_TRACEDB_SZ_CtxSumHist;
+    std::vector<char> buf(summarySize());
+
+    // Levels are stored coarsest-first, so level l starts after 2^l - 1
+    // buckets. Derive each level from the next-finer one by merging pairs.
+    std::vector<Summary::Bucket> level = std::move(sum.buckets);
+    for(unsigned int l = summaryLevels; l-- > 0; ) {
+      const double width = cts.bucketWidth << (summaryLevels - 1 - l);
+      char* cur = &buf[((std::size_t(1) << l) - 1) * szBucket];
+      for(auto& b: level) {
+        fmt_tracedb_ctxSumBucket_t bkt = {.ctxId = 0};
+        uint64_t heaviest = 0;
+        for(const auto& [id, w]: b.leaf) {
+          if(w > heaviest) {
+            heaviest = w;
+            bkt.ctxId = id;
+          }
+        }
+        fmt_tracedb_ctxSumBucket_write(cur, &bkt);
+
+        auto hist = b.depth;
+        std::sort(hist.begin(), hist.end(), [](const auto& a, const auto& b){
+          return a.second > b.second;
+        });
+        for(unsigned int i = 0; i < summaryHist; i++) {
+          fmt_tracedb_ctxSumHist_t h = {.ctxId = 0, .share = 0};
+          if(i < hist.size()) {
+            h.ctxId = hist[i].first;
+            h.share = std::min(std::round(hist[i].second / width * UINT32_MAX),
+                               (double)UINT32_MAX);
+          }
+          fmt_tracedb_ctxSumHist_write(cur + FMT_TRACEDB_SZ_CtxSumBucket
+                                       + i * FMT_TRACEDB_SZ_CtxSumHist, &h);
+        }
+        cur += szBucket;
+      }
+
+      if(l > 0) {
+        std::vector<Summary::Bucket> next(level.size() / 2);
+        for(std::size_t i = 0; i < level.size(); i++)
+          Summary::merge(next[i / 2], std::move(level[i]));
+        level = std::move(next);
+      }
+    }
+    inst.writeat(cts.pBuckets, buf);
+    sum.clear();
+  }
+
+  char buf[FMT_TRACEDB_SZ_CtxTraceSum];
+  fmt_tracedb_ctxTraceSum_write(buf, &cts);
+  inst.writeat(sums_pSummaries + (ud.hdr.prof_info_idx - 1) * FMT_TRACEDB_SZ_CtxTraceSum,
+               sizeof buf, buf);
 }
 
 void HPCTraceDB2::notifyPipeline() noexcept {
   auto& ss = src.structs();
   uds.thread = ss.thread.add<udThread>(std::ref(*this));
+  if(summaryLevels > 0)
+    uds.context = ss.context.add<udContext>(std::ref(*this));
   src.registerOrderedWavefront();
 
   if(tracefile)
@@ -306,7 +495,14 @@ void HPCTraceDB2::write() {
     fmt_tracedb_fHdr_t fhdr = {
       .szCtxTraces = ctx_pTraces + totalNumTraces * FMT_TRACEDB_SZ_CtxTrace - pCtxTraces,
       .pCtxTraces = pCtxTraces,
+      .szCtxTraceSums = 0,
+      .pCtxTraceSums = 0,
     };
+    if(summaryLevels > 0) {
+      fhdr.szCtxTraceSums = sums_pSummaries + totalNumTraces * FMT_TRACEDB_SZ_CtxTraceSum
+                            - pCtxTraceSums;
+      fhdr.pCtxTraceSums = pCtxTraceSums;
+    }
     char buf[FMT_TRACEDB_SZ_FHdr];
     fmt_tracedb_fHdr_write(buf, &fhdr);
     traceinst.writeat(0, sizeof buf, buf);
@@ -322,6 +518,20 @@ void HPCTraceDB2::write() {
     fmt_tracedb_ctxTraceSHdr_write(buf, &shdr);
     traceinst.writeat(pCtxTraces, sizeof buf, buf);
   }
+  if(summaryLevels > 0) {
+    fmt_tracedb_ctxTraceSumSHdr_t shdr = {
+      .pSummaries = sums_pSummaries,
+      .nSummaries = (uint32_t)totalNumTraces,
+      .szSummary = 0,
+      .nLevels = (uint8_t)summaryLevels,
+      .nHist = (uint8_t)summaryHist,
+      .ctxDepth = (uint8_t)summaryDepth,
+      .szBucket = 0,
+    };
+    char buf[FMT_TRACEDB_SZ_CtxTraceSumSHdr];
+    fmt_tracedb_ctxTraceSumSHdr_write(buf, &shdr);
+    traceinst.writeat(pCtxTraceSums, sizeof buf, buf);
+  }
 
 }
 
@@ -331,7 +541,7 @@ void HPCTraceDB2::write() {
 //***************************************************************************
 HPCTraceDB2::traceHdr::traceHdr(const Thread& t, HPCTraceDB2& tdb)
   : prof_info_idx(t.userdata[tdb.src.identifier()] + 1),
-   start(INVALID_HDR), end(INVALID_HDR) {}
+   start(INVALID_HDR), end(INVALID_HDR), summary(INVALID_HDR) {}
 
 std::vector<uint64_t> HPCTraceDB2::calcStartEnd() {
   //get the size of all traces
@@ -339,13 +549,19 @@ std::vector<uint64_t> HPCTraceDB2::calcStartEnd() {
   uint64_t total_size = 0;
   for(const auto& t : src.threads().iterate()){
     uint64_t trace_sz = align(t->attributes.ctxTimepointMaxCount() * FMT_TRACEDB_SZ_CtxSample, 8);
+    // The summary of a trace directly follows its trace line
+    if(summaryLevels > 0 && t->attributes.ctxTimepointMaxCount() > 0)
+      trace_sz += align(summarySize(), 8);
     trace_sizes.emplace_back(trace_sz);
     total_size += trace_sz;
   }
 
   //get the offset of this rank's traces section
   uint64_t my_off = mpi::exscan(total_size, mpi::Op::sum()).value_or(0);
-  my_off += align(ctx_pTraces + totalNumTraces * FMT_TRACEDB_SZ_CtxTrace, 8);
+  if(summaryLevels > 0)
+    my_off += align(sums_pSummaries + totalNumTraces * FMT_TRACEDB_SZ_CtxTraceSum, 8);
+  else
+    my_off += align(ctx_pTraces + totalNumTraces * FMT_TRACEDB_SZ_CtxTrace, 8);
 
   //get the individual offsets of this rank's traces
   std::vector<uint64_t> trace_offs(trace_sizes.size() + 1);
@@ -365,6 +581,7 @@ void HPCTraceDB2::assignHdrs(const std::vector<uint64_t>& trace_offs) {
     auto& hdr = t->userdata[uds.thread].hdr;
     hdr.start = trace_offs[i];
     hdr.end = trace_offs[i] + t->attributes.ctxTimepointMaxCount() * FMT_TRACEDB_SZ_CtxSample;
+    hdr.summary = trace_offs[i] + align(t->attributes.ctxTimepointMaxCount() * FMT_TRACEDB_SZ_CtxSample, 8);
     i++;
   }
   footerPos = trace_offs.back();
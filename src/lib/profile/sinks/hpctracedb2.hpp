@@ -52,7 +52,10 @@
 #include "../util/file.hpp"
 
 #include <chrono>
+#include <optional>
 #include <shared_mutex>
+#include <tuple>
+#include <vector>
 
 namespace hpctoolkit::sinks {
 
@@ -61,7 +64,11 @@ public:
   ~HPCTraceDB2() = default;
 
   /// Constructor, with a reference to the output database directory.
-  HPCTraceDB2(const stdshim::filesystem::path&);
+  /// If `summaryLevels` is non-zero, each trace is also summarized into a
+  /// pyramid of that many levels of power-of-two time buckets, with
+  /// histograms of the contexts `summaryDepth` levels below the root.
+  HPCTraceDB2(const stdshim::filesystem::path&, unsigned int summaryLevels = 0,
+              unsigned int summaryDepth = 0);
 
   /// Write out as much data as possible. See ProfileSink::write.
   void write() override;
@@ -92,9 +99,53 @@ private:
   bool has_traces;
   size_t totalNumTraces;
   uint64_t footerPos;
+  uint64_t pCtxTraceSums;
+  uint64_t sums_pSummaries;
+
+  // Shape of the per-trace summaries, summaryLevels == 0 if disabled
+  unsigned int summaryLevels;
+  unsigned int summaryDepth;
+  static constexpr unsigned int summaryHist = 4;
 
   struct uds;
 
+  /// Level-of-detail summary of a single trace, accumulated as timepoints
+  /// arrive. Only the finest level is kept, coarser levels are derived from
+  /// it when the summary is written.
+  class Summary {
+  public:
+    /// Bounded (space-saving) table of the contexts covering a bucket
+    using Table = std::vector<std::pair<uint32_t, uint64_t>>;
+    struct Bucket {
+      Table leaf;   ///< By full (leaf) context
+      Table depth;  ///< By ancestor context at the summary depth
+    };
+
+    /// Attribute the interval [start, end) to the given contexts
+    void add(unsigned int levels, uint64_t start, uint64_t end,
+             uint32_t leaf, uint32_t depth);
+    /// Add a timepoint, attributing the interval since the previous one
+    void timepoint(unsigned int levels, uint64_t tm, uint32_t leaf, uint32_t depth);
+    /// Discard all accumulated data
+    void clear();
+
+    /// Add weight to a context in a bucket table
+    static void tableAdd(Table&, uint32_t id, uint64_t weight);
+    /// Merge the data of one bucket into another
+    static void merge(Bucket& dst, Bucket&& src);
+
+    /// Finest-level buckets, bucket i spans [(base+i) << shift, (base+i+1) << shift)
+    std::vector<Bucket> buckets;
+    uint64_t base = 0;
+    unsigned int shift = 0;
+
+    /// Previous timepoint, whose interval ends at the next timepoint
+    std::optional<std::tuple<uint64_t, uint32_t, uint32_t>> last;
+
+  private:
+    void coarsen();
+  };
+
   class traceHdr {
   public:
     traceHdr(const Thread&, HPCTraceDB2& tdb);
@@ -103,6 +154,7 @@ private:
     uint32_t prof_info_idx;
     uint64_t start;
     uint64_t end;
+    uint64_t summary;
   };
 
   class udContext {
@@ -112,6 +164,9 @@ private:
 
     struct uds& uds;
     std::atomic<bool> used;
+
+    /// Identifier of the ancestor at the summary depth, -1 if not yet known
+    std::atomic<uint32_t> summaryId = -1;
   };
 
   class udThread {
@@ -134,6 +189,8 @@ private:
     bool prebuffer_done = false;
     bool hdr_prebuffered = false;
     std::vector<char> prebuffer;
+
+    Summary summary;
   };
 
   struct uds {
@@ -142,6 +199,9 @@ private:
   } uds;
 
   void writeHdrFor(udThread&, util::File::Instance&);
+  void writeSummaryFor(udThread&, util::File::Instance&);
+  uint32_t summaryIdFor(const Context&);
+  uint64_t summarySize() const noexcept;
 
 
   //***************************************************************************
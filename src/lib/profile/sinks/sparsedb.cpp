@@ -363,14 +363,17 @@ void SparseDB::DoubleBufferedOutput::write(
 
 void SparseDB::DoubleBufferedOutput::Buffer::flush(util::File& file,
                                                    uint64_t offset) {
-  if(!blob.empty())
-    file.open(true, true).writeat(offset, blob.size(), blob.data());
+  if(!blob.empty()) {
+    if(!inst) inst = file.open(true, true);
+    // Hand the blob over to the File, the write may still be in progress
+    inst->writeat(offset, std::move(blob));
+  }
 
   // Update the saved offsets with the final answers
   for(uint64_t& target: toUpdate) target += offset;
 
   // Reset this Buffer for the next time around
-  blob.clear();
+  blob = {};
   blob.reserve(bufferSize);
   toUpdate.clear();
 }
@@ -380,6 +383,8 @@ void SparseDB::DoubleBufferedOutput::flush() {
   for(Buffer& buf: bufs) {
     std::unique_lock<std::mutex> l(buf.lowlock);
     buf.flush(*file, allocate(buf.blob.size()));
+    // Wait for all the data to be on its way to storage
+    if(buf.inst) buf.inst->flush();
   }
 }
 
@@ -520,9 +525,10 @@ static void writeContexts(uint32_t firstCtx, uint32_t lastCtx,
   // our search so we can jump straight to the next context we want.
   const auto firstCtxId = heap.front().first->first;
   std::vector<char> buf;
+  std::vector<fmt_profiledb_mVal_t> mvals;
   while(!heap.empty() && heap.front().first->first < lastCtx) {
     const uint32_t ctx_id = heap.front().first->first;
-    std::map<uint16_t, std::vector<char>> valuebufs;
+    std::map<uint16_t, std::vector<fmt_cctdb_pVal_t>> valuebufs;
     uint64_t allpvs = 0;
 
     // Pull the data out for one context and save it to cmb
@@ -534,21 +540,14 @@ static void writeContexts(uint32_t firstCtx, uint32_t lastCtx,
       // Fill cmb with metric/value pairs for this context, from the top profile
       const ProfileMetricData& profile = heap.back().second;
       const char* cur = &profile.mvBlob[(curPair.second - profile.first->second) * FMT_PROFILEDB_SZ_MVal];
-      for(uint64_t i = 0, e = heap.back().first->second - curPair.second;
-          i < e; i++, cur += FMT_PROFILEDB_SZ_MVal) {
-        allpvs++;
-        fmt_profiledb_mVal_t val;
-        fmt_profiledb_mVal_read(&val, cur);
-        auto& subbuf = valuebufs.try_emplace(val.metricId).first->second;
-        fmt_cctdb_pVal_t outval = {
+      mvals.resize(heap.back().first->second - curPair.second);
+      fmt_profiledb_mVal_read_n(mvals.data(), mvals.size(), cur);
+      allpvs += mvals.size();
+      for(const auto& val: mvals) {
+        valuebufs.try_emplace(val.metricId).first->second.push_back({
           .profIndex = profile.index,
           .value = val.value,
-        };
-
-        // Write in this prof_idx/value pair, in bytes.
-        auto oldsz = subbuf.size();
-        subbuf.resize(oldsz + FMT_CCTDB_SZ_PVal, 0);
-        fmt_cctdb_pVal_write(&subbuf[oldsz], &outval);
+        });
       }
 
       // If the updated entry is still in range, push it back into the heap.
@@ -569,8 +568,11 @@ static void writeContexts(uint32_t firstCtx, uint32_t lastCtx,
     buf.reserve(buf.size() + newsz);
 
     // Concatenate the prof_idx/value pairs, in bytes form, in metric order
-    for(const auto& [mid, pvbuf]: valuebufs)
-      buf.insert(buf.end(), pvbuf.begin(), pvbuf.end());
+    for(const auto& [mid, pvbuf]: valuebufs) {
+      auto oldsz = buf.size();
+      buf.resize(oldsz + pvbuf.size() * FMT_CCTDB_SZ_PVal);
+      fmt_cctdb_pVal_write_n(&buf[oldsz], pvbuf.data(), pvbuf.size());
+    }
 
     // Construct the metric_id/idx pairs for this context, in bytes
     {
@@ -585,7 +587,7 @@ static void writeContexts(uint32_t firstCtx, uint32_t lastCtx,
         };
         fmt_cctdb_mIdx_write(cur, &idx);
         cur += FMT_CCTDB_SZ_MIdx;
-        pvs += pvbuf.size() / FMT_CCTDB_SZ_PVal;
+        pvs += pvbuf.size();
       }
       assert(pvs == allpvs);
     }
@@ -164,6 +164,9 @@ private:
       std::vector<char> blob;
       // Offsets to update once this Buffer is flushed
       std::vector<std::reference_wrapper<uint64_t>> toUpdate;
+      // Instance used to write out flushed data. With an asynchronous File
+      // backend the writes complete in the background.
+      std::optional<util::File::Instance> inst;
 
       // Flush this Buffer's data to the given File.
       // MT: Externally Synchronized (holding lowlock)
@@ -48,6 +48,7 @@
 
 #include "util/log.hpp"
 #include "sources/hpcrun4.hpp"
+#include "sources/hpcsnap.hpp"
 
 #include <stdexcept>
 
@@ -63,6 +64,12 @@ std::unique_ptr<ProfileSource> ProfileSource::create_for(const stdshim::filesyst
   return nullptr;
 }
 
+std::vector<stdshim::filesystem::path> ProfileSource::expand(const stdshim::filesystem::path& p, bool snapshotSeries) {
+  if(auto ps = sources::Hpcrun4::expand(p)) return std::move(*ps);
+  if(auto ps = sources::hpcsnap::fold(p, snapshotSeries)) return std::move(*ps);
+  return {p};
+}
+
 bool ProfileSource::valid() const noexcept { return true; }
 
 void ProfileSource::bindPipeline(ProfilePipeline::Source&& se) noexcept {
@@ -68,6 +68,14 @@ public:
   // MT: Internally Synchronized
   static std::unique_ptr<ProfileSource> create_for(const stdshim::filesystem::path&, const stdshim::filesystem::path&);
 
+  /// Expands a path into the paths that create_for should be called with.
+  /// Most paths stand for themselves, but a per-process container expands into
+  /// one (pseudo-)path for every thread it holds, and a snapshot file into the
+  /// profiles folded from it (see sources::hpcsnap::fold).
+  // MT: Internally Synchronized
+  static std::vector<stdshim::filesystem::path> expand(const stdshim::filesystem::path&,
+                                                      bool snapshotSeries = false);
+
   /// Most format errors from a Source can be handled within the Source itself,
   /// but if errors happen during construction callers (create_for) will want to
   /// know. This gives a path for that information.
@@ -50,6 +50,15 @@
 #include "../../prof-lean/hpcrun-fmt.h"
 #include "../../prof-lean/placeholders.h"
 
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+
 namespace fs = hpctoolkit::stdshim::filesystem;
 
 // TODO: Remove and change this once new-cupti is finalized
@@ -79,14 +88,172 @@ template<class F>
 scope_exit<std::decay_t<F>> make_scope_exit(F&& f) {
   return scope_exit<F>(std::forward<F>(f));
 }
+
+// Regions of a single thread within a per-process container.
+struct ContainerThread {
+  std::uint64_t start = 0;
+  std::uint64_t end = 0;
+  // (offset, length) of the trace segments, in trace order
+  std::vector<std::pair<std::uint64_t, std::uint64_t>> trace;
+};
+using ContainerIndex = std::map<std::int32_t, ContainerThread>;
+
+// Read (once) the index of a container. Every thread in a container becomes
+// a separate Source, so the parsed index is shared between them.
+std::shared_ptr<const ContainerIndex> containerIndex(const fs::path& p) {
+  static std::mutex lock;
+  static std::unordered_map<std::string, std::shared_ptr<const ContainerIndex>> cache;
+  std::unique_lock<std::mutex> l(lock);
+  if(auto it = cache.find(p.string()); it != cache.end()) return it->second;
+  auto& result = cache[p.string()];
+
+  std::FILE* f = std::fopen(p.c_str(), "rb");
+  if(!f) return nullptr;
+  auto fclose = make_scope_exit([&]{ std::fclose(f); });
+
+  std::uint32_t cnt;
+  if(hpccontainer_fmt_index_seek(&cnt, f) != HPCFMT_OK) return nullptr;
+  ContainerIndex index;
+  std::map<std::int32_t, std::map<std::uint32_t, std::pair<std::uint64_t, std::uint64_t>>> segments;
+  for(std::uint32_t i = 0; i < cnt; i++) {
+    hpccontainer_fmt_entry_t entry;
+    if(hpccontainer_fmt_entry_fread(&entry, f) != HPCFMT_OK) {
+      util::log::warning{} << "Corrupted index in container " << p.string();
+      return nullptr;
+    }
+    id_tuple_free(&entry.id_tuple);
+    if(entry.kind == hpccontainer_region_profile) {
+      auto& t = index[entry.thread];
+      t.start = entry.offset;
+      t.end = entry.offset + entry.length;
+    } else if(entry.kind == hpccontainer_region_trace) {
+      segments[entry.thread].emplace(entry.seq, std::make_pair(entry.offset, entry.length));
+    }
+  }
+  for(auto& [tid, segs]: segments) {
+    auto it = index.find(tid);
+    if(it == index.end()) continue;  // Trace without a profile, skip it
+    it->second.trace.reserve(segs.size());
+    for(const auto& [seq, seg]: segs) it->second.trace.push_back(seg);
+  }
+
+  result = std::make_shared<const ContainerIndex>(std::move(index));
+  return result;
+}
+
+// Split a "container#thread" path as produced by Hpcrun4::expand.
+std::optional<std::pair<fs::path, std::int32_t>> containerThreadPath(const fs::path& p) {
+  const auto& str = p.string();
+  auto hash = str.rfind('#');
+  if(hash == std::string::npos || hash + 1 == str.size()) return std::nullopt;
+  fs::path container = str.substr(0, hash);
+  if(container.extension() != std::string(".")+HPCRUN_ContainerFnmSfx)
+    return std::nullopt;
+  char* end;
+  long tid = std::strtol(str.c_str() + hash + 1, &end, 10);
+  if(*end != '\0') return std::nullopt;
+  return std::make_pair(std::move(container), (std::int32_t)tid);
+}
+
+// State for a tracefile stitched together from segments of a container.
+// The segments are read in place with pread, nothing is copied out.
+struct SegmentedTrace {
+  int fd;
+  const std::vector<Hpcrun4::traceSegment_t>* segments;
+  std::uint64_t size;
+  std::uint64_t pos = 0;
+};
+
+ssize_t segmentedTraceRead(void* cookie, char* buf, std::size_t size) {
+  auto& t = *static_cast<SegmentedTrace*>(cookie);
+  std::size_t done = 0;
+  while(done < size && t.pos < t.size) {
+    // Find the segment containing the cursor
+    auto it = std::upper_bound(t.segments->begin(), t.segments->end(), t.pos,
+        [](std::uint64_t pos, const auto& seg){ return pos < seg.start; });
+    assert(it != t.segments->begin());
+    --it;
+    auto within = t.pos - it->start;
+    auto n = std::min<std::uint64_t>(it->length - within, size - done);
+    auto r = ::pread(t.fd, buf + done, n, it->offset + within);
+    if(r < 0) return done > 0 ? (ssize_t)done : -1;
+    if(r == 0) break;
+    done += r;
+    t.pos += r;
+  }
+  return done;
+}
+
+int segmentedTraceSeek(void* cookie, off64_t* off, int whence) {
+  auto& t = *static_cast<SegmentedTrace*>(cookie);
+  off64_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? t.pos : t.size;
+  if(base + *off < 0) return -1;
+  t.pos = base + *off;
+  *off = t.pos;
+  return 0;
+}
+
+int segmentedTraceClose(void* cookie) {
+  auto* t = static_cast<SegmentedTrace*>(cookie);
+  int ret = ::close(t->fd);
+  delete t;
+  return ret;
+}
+}
+
+std::optional<std::vector<fs::path>> Hpcrun4::expand(const fs::path& p) {
+  if(p.extension() != std::string(".")+HPCRUN_ContainerFnmSfx) return std::nullopt;
+  auto index = containerIndex(p);
+  if(!index) return std::nullopt;
+  std::vector<fs::path> ret;
+  ret.reserve(index->size());
+  for(const auto& [tid, t]: *index)
+    ret.emplace_back(p.string() + "#" + std::to_string(tid));
+  return ret;
+}
+
+std::FILE* Hpcrun4::openTrace() const {
+  if(traceSegments.empty()) return std::fopen(tracepath.c_str(), "rb");
+
+  int fd = ::open(tracepath.c_str(), O_RDONLY);
+  if(fd < 0) return nullptr;
+  const auto& last = traceSegments.back();
+  auto* t = new SegmentedTrace{fd, &traceSegments, last.start + last.length};
+  cookie_io_functions_t funcs = {
+    segmentedTraceRead, nullptr, segmentedTraceSeek, segmentedTraceClose
+  };
+  std::FILE* f = fopencookie(t, "rb", funcs);
+  if(!f) segmentedTraceClose(t);
+  return f;
 }
 
 Hpcrun4::Hpcrun4(const stdshim::filesystem::path& fn, const stdshim::filesystem::path& meas)
   : ProfileSource(), fileValid(true), attrsValid(true), tattrsValid(true),
     thread(nullptr), path(fn), measDirPath(fs::canonical(meas)), tracepath(fn) {
-  tracepath.replace_extension(".hpctrace");
+  // Profiles in a per-process container are a region of the container, and
+  // their traces are a series of segments within it.
+  std::size_t start = 0;
+  std::size_t end = 0;
+  if(auto ct = containerThreadPath(fn)) {
+    path = tracepath = ct->first;
+    auto index = containerIndex(path);
+    auto it = index ? index->find(ct->second) : ContainerIndex::const_iterator();
+    if(!index || it == index->end()) {
+      fileValid = false;
+      return;
+    }
+    start = it->second.start;
+    end = it->second.end;
+    std::uint64_t pos = 0;
+    for(const auto& [offset, length]: it->second.trace) {
+      traceSegments.push_back({pos, offset, length});
+      pos += length;
+    }
+    if(traceSegments.empty()) tracepath.clear();
+  } else
+    tracepath.replace_extension(".hpctrace");
   // Try to open up the file. Errors handled inside somewhere.
-  file = hpcrun_sparse_open(path.c_str(), 0, 0);
+  file = hpcrun_sparse_open(path.c_str(), start, end);
   if(file == nullptr) {
     fileValid = false;
     return;
@@ -198,7 +365,8 @@ DataClass Hpcrun4::finalizeRequest(const DataClass& d) const noexcept {
 }
 
 bool Hpcrun4::setupTrace(unsigned int traceDisorder) noexcept {
-  std::FILE* file = std::fopen(tracepath.c_str(), "rb");
+  if(tracepath.empty()) return false;
+  std::FILE* file = openTrace();
   if(!file) return false;
   // Read in the file header.
   hpctrace_fmt_hdr_t thdr;
@@ -206,7 +374,7 @@ bool Hpcrun4::setupTrace(unsigned int traceDisorder) noexcept {
     std::fclose(file);
     return false;
   }
-  if(thdr.version != 1.01) { std::fclose(file); return false; }
+  if(thdr.version != 1.01 && thdr.version != 1.02) { std::fclose(file); return false; }
   if(HPCTRACE_HDR_FLAGS_GET_BIT(thdr.flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS)) {
     std::fclose(file);
     return false;
@@ -215,6 +383,22 @@ bool Hpcrun4::setupTrace(unsigned int traceDisorder) noexcept {
   // The file is now placed right at the start of the data.
   trace_off = std::ftell(file);
 
+  traceFlags = thdr.flags;
+  traceBlocked = HPCTRACE_HDR_FLAGS_GET_BIT(thdr.flags, HPCTRACE_HDR_FLAGS_BLOCKED_BIT_POS);
+  if(traceBlocked) {
+    if(!setupTraceBlocks(file)) {
+      std::fclose(file);
+      return false;
+    }
+    unsigned long long count = 0;
+    for(const auto& b: traceBlocks) count += b.count;
+    // Blocked traces are merged into time order as they are read (see
+    // realread), so the Pipeline never needs to sort them.
+    tattrs.ctxTimepointStats(count, 0);
+    std::fclose(file);
+    return true;
+  }
+
   // Count the number of timepoints in the file, and save it for later.
   std::fseek(file, 0, SEEK_END);
   auto trace_end = std::ftell(file);
@@ -228,6 +412,111 @@ bool Hpcrun4::setupTrace(unsigned int traceDisorder) noexcept {
   return true;
 }
 
+bool Hpcrun4::setupTraceBlocks(std::FILE* file) noexcept {
+  const std::uint64_t recSz = hpctrace_fmt_datum_size(traceFlags);
+  hpctrace_fmt_trailer_t trailer;
+  bool hasTrailer;
+  const std::uint64_t end = hpctrace_fmt_blocks_end(file, &trailer, &hasTrailer);
+
+  traceBlocks.clear();
+  if(hasTrailer) {
+    // Everything we need is in the index at the end of the file
+    std::fseek(file, trailer.index_offset, SEEK_SET);
+    traceBlocks.reserve(trailer.num_blocks);
+    std::uint64_t next = trace_off;
+    for(std::uint64_t i = 0; i < trailer.num_blocks; i++) {
+      hpctrace_fmt_index_entry_t e;
+      if(hpctrace_fmt_index_entry_fread(&e, file) != HPCFMT_OK) return false;
+      if(e.offset != next) return false;
+      next = e.offset + HPCTRACE_FMT_BlockHdrLen + e.hdr.count * recSz;
+      if(next > end) return false;
+      traceBlocks.push_back({e.offset, e.hdr.count,
+          (e.hdr.flags & HPCTRACE_FMT_BLOCK_FLAGS_SORTED) != 0, e.hdr.minTime});
+    }
+    return true;
+  }
+
+  // No index, hpcrun didn't get to finish the trace. Walk the block headers,
+  // keeping whatever complete records the last block has.
+  std::fseek(file, trace_off, SEEK_SET);
+  std::uint64_t off = trace_off;
+  while(off + HPCTRACE_FMT_BlockHdrLen <= end) {
+    hpctrace_fmt_block_hdr_t h;
+    if(hpctrace_fmt_block_hdr_fread(&h, file) != HPCFMT_OK) break;
+    std::uint64_t avail = (end - off - HPCTRACE_FMT_BlockHdrLen) / recSz;
+    std::uint32_t count = std::min<std::uint64_t>(h.count, avail);
+    if(count > 0)
+      traceBlocks.push_back({off, count,
+          (h.flags & HPCTRACE_FMT_BLOCK_FLAGS_SORTED) != 0, h.minTime});
+    off += HPCTRACE_FMT_BlockHdrLen + h.count * recSz;
+    std::fseek(file, off, SEEK_SET);
+  }
+  return true;
+}
+
+template<class Emit>
+bool Hpcrun4::readTraceBlocks(std::FILE* f, const Emit& emit) {
+  const std::size_t recSz = hpctrace_fmt_datum_size(traceFlags);
+  const auto time = [](const hpctrace_fmt_datum_t& d) {
+    return HPCTRACE_FMT_GET_TIME(d.comp);
+  };
+  const auto byTime = [&](const hpctrace_fmt_datum_t& a, const hpctrace_fmt_datum_t& b) {
+    return time(a) < time(b);
+  };
+
+  // Records at or before the earliest time of any later block can be emitted
+  // as soon as the blocks up to here have been merged.
+  std::vector<std::uint64_t> laterMin(traceBlocks.size() + 1,
+                                      std::numeric_limits<std::uint64_t>::max());
+  for(std::size_t i = traceBlocks.size(); i > 0; i--)
+    laterMin[i-1] = std::min(laterMin[i], traceBlocks[i-1].minTime);
+
+  std::vector<char> raw;
+  std::vector<hpctrace_fmt_datum_t> recs;
+  std::vector<hpctrace_fmt_datum_t> pending;  // Merged, not yet emitted
+  std::size_t head = 0;  // First record of pending not yet emitted
+
+  // One pass over the blocks. Returns std::nullopt if a rewind was requested.
+  auto pass = [&]() -> std::optional<bool> {
+    pending.clear();
+    head = 0;
+    for(std::size_t i = 0; i < traceBlocks.size(); i++) {
+      const auto& b = traceBlocks[i];
+      raw.resize(b.count * recSz);
+      recs.resize(b.count);
+      if(std::fseek(f, b.offset + HPCTRACE_FMT_BlockHdrLen, SEEK_SET) != 0
+         || std::fread(raw.data(), 1, raw.size(), f) != raw.size())
+        return false;
+      hpctrace_fmt_datum_sread_n(recs.data(), recs.size(), traceFlags, raw.data());
+      if(!b.sorted) std::stable_sort(recs.begin(), recs.end(), byTime);
+
+      const auto bound = laterMin[i+1];
+      if(head == pending.size() && !recs.empty() && time(recs.back()) <= bound) {
+        // Ordered block that doesn't overlap anything after it, no merge needed
+        for(const auto& r: recs) if(emit(r)) return std::nullopt;
+        continue;
+      }
+
+      // Merge into the pending records and emit everything that is now final
+      auto mid = pending.size();
+      pending.insert(pending.end(), recs.begin(), recs.end());
+      std::inplace_merge(pending.begin() + head, pending.begin() + mid,
+                         pending.end(), byTime);
+      for(; head < pending.size() && time(pending[head]) <= bound; head++)
+        if(emit(pending[head])) return std::nullopt;
+      if(head > pending.size() / 2) {
+        pending.erase(pending.begin(), pending.begin() + head);
+        head = 0;
+      }
+    }
+    return true;
+  };
+
+  while(1) {
+    if(auto ok = pass()) return *ok;
+  }
+}
+
 void Hpcrun4::read(const DataClass& needed) {
   if(!fileValid) return;  // We don't have anything more to say
   if(!realread(needed)) {
@@ -632,17 +921,11 @@ bool Hpcrun4::realread(const DataClass& needed) try {
   if(needed.hasCtxTimepoints() && !tracepath.empty()) {
     assert(thread);
 
-    std::FILE* f = std::fopen(tracepath.c_str(), "rb");
-    std::fseek(f, trace_off, SEEK_SET);
-    hpctrace_fmt_datum_t tpoint;
-    while(1) {
-      int err = hpctrace_fmt_datum_fread(&tpoint, 0, f);
-      if(err == HPCFMT_EOF) break;
-      else if(err != HPCFMT_OK) {
-        util::log::info{} << "Error reading trace datum from "
-                          << tracepath.filename().string();
-        return false;
-      }
+    std::FILE* f = openTrace();
+    if(!f) return false;
+
+    // Emit one trace record, returns true if the Pipeline asked to rewind
+    auto emit = [&](const hpctrace_fmt_datum_t& tpoint) -> bool {
       auto it = nodes.find(tpoint.cpId);
       if(it != nodes.end()) {
         if(auto* p_x = std::get_if<singleCtx_t>(&it->second)) {
@@ -651,12 +934,38 @@ bool Hpcrun4::realread(const DataClass& needed) try {
           case ProfilePipeline::Source::TimepointStatus::next:
             break;  // 'Round the loop
           case ProfilePipeline::Source::TimepointStatus::rewindStart:
-            // Put the cursor back at the beginning
-            std::fseek(f, trace_off, SEEK_SET);
-            break;
+            return true;
           }
         }
       }
+      return false;
+    };
+
+    if(traceBlocked) {
+      if(!readTraceBlocks(f, emit)) {
+        std::fclose(f);
+        util::log::info{} << "Error reading trace block from "
+                          << tracepath.filename().string();
+        return false;
+      }
+      std::fclose(f);
+      return true;
+    }
+
+    std::fseek(f, trace_off, SEEK_SET);
+    hpctrace_fmt_datum_t tpoint;
+    while(1) {
+      int err = hpctrace_fmt_datum_fread(&tpoint, 0, f);
+      if(err == HPCFMT_EOF) break;
+      else if(err != HPCFMT_OK) {
+        util::log::info{} << "Error reading trace datum from "
+                          << tracepath.filename().string();
+        return false;
+      }
+      if(emit(tpoint)) {
+        // Put the cursor back at the beginning
+        std::fseek(f, trace_off, SEEK_SET);
+      }
     }
     std::fclose(f);
   }
@@ -53,7 +53,10 @@
 #include "../util/locked_unordered.hpp"
 #include "../util/ref_wrappers.hpp"
 
+#include <cstdio>
 #include <memory>
+#include <optional>
+#include <vector>
 #include "../stdshim/filesystem.hpp"
 
 // Forward declaration of a structure.
@@ -75,6 +78,13 @@ public:
   /// Get the basename of the measured executable.
   std::string exe_basename() const;
 
+  /// Expand a per-process container into one path per thread profile it
+  /// holds, suitable for ProfileSource::create_for. Returns nothing if the
+  /// given path is not a complete container.
+  // MT: Internally Synchronized
+  static std::optional<std::vector<stdshim::filesystem::path>>
+  expand(const stdshim::filesystem::path&);
+
   /// Read in enough data to satisfy a request or until a timeout is reached.
   /// See `ProfileSource::read(...)`.
   void read(const DataClass&) override;
@@ -82,6 +92,13 @@ public:
   DataClass provides() const noexcept override;
   DataClass finalizeRequest(const DataClass&) const noexcept override;
 
+  /// Piece of a tracefile stored within a per-process container.
+  struct traceSegment_t {
+    std::uint64_t start;  ///< Offset within the logical tracefile
+    std::uint64_t offset;  ///< Offset within the container
+    std::uint64_t length;
+  };
+
 private:
   bool realread(const DataClass&);
 
@@ -172,6 +189,36 @@ private:
   long trace_off;
   bool trace_sort;
 
+  // Blocks of a blocked (version 1.02) tracefile, in file order. Empty for
+  // flat tracefiles, where the records follow the header directly.
+  struct traceBlock_t {
+    std::uint64_t offset;
+    std::uint32_t count;
+    bool sorted;
+    std::uint64_t minTime;
+  };
+  bool traceBlocked = false;
+  std::uint64_t traceFlags = 0;
+  std::vector<traceBlock_t> traceBlocks;
+
+  // Fill traceBlocks from the block index, or by walking the block headers
+  // if the index is missing. Returns false if the tracefile is unusable.
+  bool setupTraceBlocks(std::FILE*) noexcept;
+
+  // Read the records of a blocked tracefile and pass them to `emit` in time
+  // order. Ordered blocks that don't overlap later ones go straight through,
+  // only the records of overlapping blocks are merged. `emit` returns true
+  // to request a rewind to the start of the trace.
+  template<class Emit>
+  bool readTraceBlocks(std::FILE*, const Emit& emit);
+
+  // For profiles stored in a per-process container, the pieces of the
+  // container that make up the tracefile, in order. Empty otherwise.
+  std::vector<traceSegment_t> traceSegments;
+
+  // Open the tracefile for reading, stitching segments together if needed.
+  std::FILE* openTrace() const;
+
   // We're all friends here.
   friend std::unique_ptr<ProfileSource> ProfileSource::create_for(const stdshim::filesystem::path&, const stdshim::filesystem::path&);
   Hpcrun4(const stdshim::filesystem::path&, const stdshim::filesystem::path&);
@@ -0,0 +1,513 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+#include "hpcsnap.hpp"
+
+#include "../util/log.hpp"
+#include "../../prof-lean/hpcrun-fmt.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <stdlib.h>
+
+namespace fs = hpctoolkit::stdshim::filesystem;
+
+using namespace hpctoolkit;
+using namespace sources;
+
+namespace {
+
+struct Node {
+  std::uint32_t parent;
+  std::uint16_t lm_id;
+  std::uint64_t lm_ip;
+  bool unwound;
+};
+
+using ValueKey = std::pair<std::uint32_t, std::uint16_t>;  // (node, metric)
+
+struct Delta {
+  std::uint32_t generation;
+  std::vector<std::pair<ValueKey, hpcrun_metricVal_t>> values;
+};
+
+struct Thread {
+  std::int32_t rank = -1;
+  bool done = false;
+  std::vector<Delta> deltas;
+};
+
+// Everything recorded in a snapshot file, folded over its records.
+struct Snapshot {
+  std::vector<std::pair<std::string, std::string>> nvps;
+  std::map<std::uint16_t, std::pair<std::string, std::uint64_t>> loadmap;
+  std::string metrics;  // latest metric table, as in an .hpcrun file
+  std::vector<bool> realMetrics;  // per metric id, whether values are reals
+  std::unordered_map<std::uint32_t, Node> nodes;
+  std::map<std::int32_t, Thread> threads;
+
+  std::string nvp(const std::string& name) const {
+    for(const auto& [k, v]: nvps) if(k == name) return v;
+    return "";
+  }
+};
+
+bool parseMetrics(Snapshot& snap, std::FILE* f) {
+  std::uint32_t numKinds;
+  if(hpcfmt_int4_fread(&numKinds, f) != HPCFMT_OK) return false;
+  snap.realMetrics.clear();
+  while(true) {
+    int c = std::fgetc(f);
+    if(c == EOF) break;
+    std::ungetc(c, f);
+    metric_desc_t m;
+    if(hpcrun_fmt_metricDesc_fread(&m, f, 4.0, std::malloc) != HPCFMT_OK)
+      return false;
+    snap.realMetrics.push_back(m.flags.fields.valFmt == MetricFlags_ValFmt_Real);
+    hpcrun_fmt_metricDesc_free(&m, std::free);
+  }
+  return true;
+}
+
+bool parseLoadmap(Snapshot& snap, std::FILE* f) {
+  std::uint32_t cnt;
+  if(hpcfmt_int4_fread(&cnt, f) != HPCFMT_OK) return false;
+  for(std::uint32_t i = 0; i < cnt; i++) {
+    loadmap_entry_t lm;
+    if(hpcrun_fmt_loadmapEntry_fread(&lm, f, std::malloc) != HPCFMT_OK)
+      return false;
+    snap.loadmap[lm.id] = {lm.name, lm.flags};
+    hpcrun_fmt_loadmapEntry_free(&lm, std::free);
+  }
+  return true;
+}
+
+bool parseDelta(Snapshot& snap, std::FILE* f) {
+  hpcsnap_fmt_delta_hdr_t hdr;
+  if(hpcsnap_fmt_delta_hdr_fread(&hdr, f) != HPCFMT_OK) return false;
+  id_tuple_free(&hdr.id_tuple);
+  auto& t = snap.threads[hdr.thread];
+  if(hdr.rank >= 0) t.rank = hdr.rank;
+
+  std::uint32_t cnt;
+  if(hpcfmt_int4_fread(&cnt, f) != HPCFMT_OK) return false;
+  epoch_flags_t flags;
+  flags.bits = 0;
+  for(std::uint32_t i = 0; i < cnt; i++) {
+    hpcrun_fmt_cct_node_t n;
+    if(hpcrun_fmt_cct_node_fread(&n, flags, f) != HPCFMT_OK) return false;
+    snap.nodes[n.id] = {n.id_parent, n.lm_id, n.lm_ip, n.unwound};
+  }
+
+  Delta d;
+  d.generation = hdr.generation;
+  if(hpcfmt_int4_fread(&cnt, f) != HPCFMT_OK) return false;
+  d.values.reserve(cnt);
+  for(std::uint32_t i = 0; i < cnt; i++) {
+    hpcsnap_fmt_value_t v;
+    if(hpcsnap_fmt_value_fread(&v, f) != HPCFMT_OK) return false;
+    d.values.push_back({{v.id, v.mid}, v.value});
+  }
+  t.deltas.push_back(std::move(d));
+  return true;
+}
+
+// Read a snapshot file, up to the last complete record. Returns false if the
+// file is not a snapshot file at all.
+bool parse(const fs::path& p, Snapshot& snap) {
+  std::FILE* f = std::fopen(p.c_str(), "rb");
+  if(!f) return false;
+
+  HPCFMT_List(hpcfmt_nvpair_t) nvps;
+  if(hpcsnap_fmt_hdr_fread(&nvps, f, std::malloc) != HPCFMT_OK) {
+    std::fclose(f);
+    return false;
+  }
+  for(uint32_t i = 0; i < nvps.len; i++)
+    snap.nvps.emplace_back(nvps.lst[i].name, nvps.lst[i].val);
+  hpcfmt_nvpairList_free(&nvps, std::free);
+
+  std::vector<char> payload;
+  while(true) {
+    hpcsnap_fmt_record_t rec;
+    int ret = hpcsnap_fmt_record_fread(&rec, f);
+    if(ret == HPCFMT_EOF) break;
+    if(ret != HPCFMT_OK) {
+      util::log::warning{} << "Corrupted record in snapshot file " << p.string()
+                           << ", ignoring the rest of the file";
+      break;
+    }
+    payload.resize(rec.length);
+    if(std::fread(payload.data(), 1, rec.length, f) != rec.length) break;  // Cut short
+    if(rec.length == 0) continue;
+
+    std::FILE* pf = fmemopen(payload.data(), payload.size(), "rb");
+    if(!pf) break;
+    bool ok = true;
+    switch(rec.kind) {
+    case hpcsnap_record_metrics:
+      ok = parseMetrics(snap, pf);
+      if(ok) snap.metrics.assign(payload.begin(), payload.end());
+      break;
+    case hpcsnap_record_loadmap:
+      ok = parseLoadmap(snap, pf);
+      break;
+    case hpcsnap_record_delta:
+      ok = parseDelta(snap, pf);
+      break;
+    case hpcsnap_record_done: {
+      std::uint32_t thread;
+      ok = hpcfmt_int4_fread(&thread, pf) == HPCFMT_OK;
+      if(ok) snap.threads[(std::int32_t)thread].done = true;
+      break;
+    }
+    default:
+      break;  // Unknown record, skip it
+    }
+    std::fclose(pf);
+    if(!ok) {
+      util::log::warning{} << "Malformed record in snapshot file " << p.string()
+                           << ", ignoring the rest of the file";
+      break;
+    }
+  }
+  std::fclose(f);
+  return true;
+}
+
+// Write a v4 .hpcrun profile for one thread, holding the given values.
+// The layout follows write_epochs in hpcrun.
+bool writeProfile(const fs::path& out, const Snapshot& snap, std::int32_t thread,
+                  std::int32_t rank, std::optional<std::uint32_t> interval,
+                  const std::map<ValueKey, hpcrun_metricVal_t>& values) {
+  // The nodes of the profile are the nodes with values, and their ancestors
+  std::unordered_set<std::uint32_t> used;
+  std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> children;
+  std::vector<std::uint32_t> roots;
+  for(const auto& [key, val]: values) {
+    for(auto id = key.first; id != 0 && used.count(id) == 0; ) {
+      auto it = snap.nodes.find(id);
+      if(it == snap.nodes.end()) break;
+      used.insert(id);
+      if(it->second.parent == 0 || snap.nodes.count(it->second.parent) == 0)
+        roots.push_back(id);
+      else
+        children[it->second.parent].push_back(id);
+      id = it->second.parent;
+    }
+  }
+  if(used.empty()) return false;
+
+  // Parents before children, as hpcrun writes them
+  std::vector<std::uint32_t> order;
+  order.reserve(used.size());
+  std::sort(roots.begin(), roots.end(), std::greater<>());
+  std::vector<std::uint32_t> stack(roots.begin(), roots.end());
+  while(!stack.empty()) {
+    auto id = stack.back();
+    stack.pop_back();
+    order.push_back(id);
+    if(auto it = children.find(id); it != children.end()) {
+      std::sort(it->second.begin(), it->second.end(), std::greater<>());
+      stack.insert(stack.end(), it->second.begin(), it->second.end());
+    }
+  }
+
+  std::FILE* f = std::fopen(out.c_str(), "w");
+  if(!f) {
+    util::log::warning{} << "Unable to write folded snapshot profile "
+                         << out.string();
+    return false;
+  }
+  auto align = [f](std::uint64_t& end) {
+    end = std::ftell(f);
+    std::fseek(f, (end + 1023) & ~UINT64_C(1023), SEEK_SET);
+  };
+  hpcrun_fmt_footer_t footer;
+  std::memset(&footer, 0, sizeof footer);
+
+  // Header, with the attributes of the process and the thread
+  std::vector<std::pair<std::string, std::string>> nvps;
+  for(const auto& nvp: snap.nvps) nvps.push_back(nvp);
+  nvps.emplace_back(HPCRUN_FMT_NV_mpiRank, std::to_string(rank < 0 ? 0 : rank));
+  nvps.emplace_back(HPCRUN_FMT_NV_tid, std::to_string(thread));
+  std::fwrite(HPCRUN_FMT_Magic, 1, HPCRUN_FMT_MagicLen, f);
+  std::fwrite(HPCRUN_FMT_Version, 1, HPCRUN_FMT_VersionLen, f);
+  std::fwrite(HPCRUN_FMT_Endian, 1, HPCRUN_FMT_EndianLen, f);
+  hpcfmt_int4_fwrite(nvps.size(), f);
+  for(auto& [k, v]: nvps) {
+    hpcfmt_nvpair_t nvp = {k.data(), v.data()};
+    hpcfmt_nvpair_fwrite(&nvp, f);
+  }
+  align(footer.hdr_end);
+
+  // Loadmap
+  footer.loadmap_start = std::ftell(f);
+  hpcfmt_int4_fwrite(snap.loadmap.size(), f);
+  for(const auto& [id, lm]: snap.loadmap) {
+    loadmap_entry_t e = {id, const_cast<char*>(lm.first.c_str()), lm.second};
+    hpcrun_fmt_loadmapEntry_fwrite(&e, f);
+  }
+  align(footer.loadmap_end);
+
+  // CCT
+  footer.cct_start = std::ftell(f);
+  hpcfmt_int8_fwrite(order.size(), f);
+  epoch_flags_t flags;
+  flags.bits = 0;
+  for(auto id: order) {
+    const auto& n = snap.nodes.at(id);
+    hpcrun_fmt_cct_node_t node;
+    hpcrun_fmt_cct_node_init(&node);
+    node.id = id;
+    node.id_parent = used.count(n.parent) > 0 ? n.parent : 0;
+    node.lm_id = n.lm_id;
+    node.lm_ip = n.lm_ip;
+    node.unwound = n.unwound;
+    hpcrun_fmt_cct_node_fwrite(&node, flags, f);
+  }
+  align(footer.cct_end);
+
+  // Metric table, as recorded
+  footer.met_tbl_start = std::ftell(f);
+  std::fwrite(snap.metrics.data(), 1, snap.metrics.size(), f);
+  align(footer.met_tbl_end);
+
+  // Identifier tuple dictionary
+  footer.idtpl_dxnry_start = std::ftell(f);
+  hpcrun_fmt_idtuple_dxnry_fwrite(f);
+  align(footer.idtpl_dxnry_end);
+
+  // Sparse metric values, in the same order as the nodes
+  std::vector<hpcrun_metricVal_t> vals;
+  std::vector<std::uint16_t> mids;
+  std::vector<std::uint32_t> nodeIds;
+  std::vector<std::uint64_t> nodeIdxs;
+  {
+    std::unordered_map<std::uint32_t, std::vector<std::pair<std::uint16_t, hpcrun_metricVal_t>>> byNode;
+    for(const auto& [key, val]: values)
+      if(used.count(key.first) > 0) byNode[key.first].emplace_back(key.second, val);
+    for(auto id: order) {
+      auto it = byNode.find(id);
+      if(it == byNode.end()) continue;
+      nodeIds.push_back(id);
+      nodeIdxs.push_back(vals.size());
+      for(const auto& [mid, val]: it->second) {
+        mids.push_back(mid);
+        vals.push_back(val);
+      }
+    }
+    nodeIds.push_back(LastNodeEnd);
+    nodeIdxs.push_back(vals.size());
+  }
+
+  std::vector<pms_id_t> ids;
+  std::uint64_t hostid = std::strtoull(snap.nvp(HPCRUN_FMT_NV_hostid).c_str(), nullptr, 16);
+  ids.push_back({IDTUPLE_COMPOSE(IDTUPLE_NODE, IDTUPLE_IDS_LOGIC_LOCAL), hostid, 0});
+  if(rank >= 0)
+    ids.push_back({IDTUPLE_COMPOSE(IDTUPLE_RANK, IDTUPLE_IDS_LOGIC_ONLY),
+                   (std::uint64_t)rank, (std::uint64_t)rank});
+  ids.push_back({IDTUPLE_COMPOSE(IDTUPLE_THREAD, IDTUPLE_IDS_LOGIC_ONLY),
+                 (std::uint64_t)thread, (std::uint64_t)thread});
+  if(interval)
+    ids.push_back({IDTUPLE_COMPOSE(IDTUPLE_SNAPSHOT, IDTUPLE_IDS_LOGIC_ONLY),
+                   *interval, *interval});
+
+  hpcrun_fmt_sparse_metrics_t sm;
+  std::memset(&sm, 0, sizeof sm);
+  sm.id_tuple.length = sm.id_tuple.ids_length = ids.size();
+  sm.id_tuple.ids = ids.data();
+  sm.num_vals = vals.size();
+  sm.num_cct_nodes = order.size();
+  sm.values = vals.data();
+  sm.mids = mids.data();
+  sm.num_nz_cct_nodes = nodeIds.size() - 1;
+  sm.cct_node_ids = nodeIds.data();
+  sm.cct_node_idxs = nodeIdxs.data();
+
+  footer.sm_start = std::ftell(f);
+  hpcrun_fmt_sparse_metrics_fwrite(&sm, f);
+  align(footer.sm_end);
+  footer.footer_start = std::ftell(f);
+
+  footer.HPCRUNsm = HPCRUNsm;
+  hpcrun_fmt_footer_fwrite(&footer, f);
+
+  if(std::fclose(f) != 0) {
+    util::log::warning{} << "Unable to write folded snapshot profile "
+                         << out.string();
+    return false;
+  }
+  return true;
+}
+
+// Private directory for the folded profiles, under the system's temporary
+// directory and removed again when the process exits. The profiles must
+// outlive fold() since their Sources reopen them while they are read.
+class FoldDir {
+public:
+  FoldDir() = default;
+  ~FoldDir() {
+    if(root.empty()) return;
+    std::error_code ec;
+    fs::remove_all(root, ec);
+  }
+
+  // A fresh subdirectory for the profiles folded from one snapshot file
+  std::optional<fs::path> next() {
+    std::unique_lock<std::mutex> l(lock);
+    try {
+      if(root.empty()) {
+        std::string tmpl = (fs::temp_directory_path() / "hpcprof-snapshots-XXXXXX").string();
+        if(::mkdtemp(tmpl.data()) == nullptr) {
+          util::log::warning{} << "Unable to create a directory for folded snapshots in "
+                               << fs::temp_directory_path().string();
+          return std::nullopt;
+        }
+        root = tmpl;
+      }
+      fs::path dir = root / std::to_string(count++);
+      fs::create_directory(dir);
+      return dir;
+    } catch(std::exception& e) {
+      util::log::warning{} << "Unable to create a directory for folded snapshots: "
+                           << e.what();
+      return std::nullopt;
+    }
+  }
+
+private:
+  std::mutex lock;
+  fs::path root;
+  unsigned int count = 0;
+};
+FoldDir foldDir;
+
+// Add or subtract two values of the same metric
+hpcrun_metricVal_t combine(const Snapshot& snap, std::uint16_t mid,
+                           hpcrun_metricVal_t a, hpcrun_metricVal_t b, int sign) {
+  hpcrun_metricVal_t r;
+  if(mid < snap.realMetrics.size() && snap.realMetrics[mid])
+    r.r = sign < 0 ? a.r - b.r : a.r + b.r;
+  else
+    r.i = sign < 0 ? a.i - b.i : a.i + b.i;
+  return r;
+}
+
+}  // namespace
+
+std::optional<std::vector<fs::path>> hpcsnap::fold(const fs::path& p, bool series) {
+  if(p.extension() != std::string(".")+HPCRUN_SnapshotFnmSfx) return std::nullopt;
+
+  Snapshot snap;
+  if(!parse(p, snap)) return std::nullopt;
+  std::vector<fs::path> ret;
+  if(snap.metrics.empty()) return ret;
+
+  auto dirOpt = foldDir.next();
+  if(!dirOpt) return ret;
+  const fs::path& dir = *dirOpt;
+  const auto stem = p.stem().string();
+
+  for(const auto& [tid, t]: snap.threads) {
+    if(!series) {
+      // Threads that finished wrote a complete profile of their own
+      if(t.done || t.deltas.empty()) continue;
+      std::map<ValueKey, hpcrun_metricVal_t> values;
+      for(const auto& d: t.deltas)
+        for(const auto& [key, val]: d.values) values[key] = val;
+      fs::path out = dir / (stem + "-" + std::to_string(tid) + "." + HPCRUN_ProfileFnmSfx);
+      if(writeProfile(out, snap, tid, t.rank, std::nullopt, values))
+        ret.push_back(std::move(out));
+      continue;
+    }
+
+    // Each delta holds the latest values, the interval is what changed
+    std::map<ValueKey, hpcrun_metricVal_t> last;
+    for(const auto& d: t.deltas) {
+      std::map<ValueKey, hpcrun_metricVal_t> values;
+      for(const auto& [key, val]: d.values) {
+        auto it = last.find(key);
+        auto diff = it == last.end() ? val : combine(snap, key.second, val, it->second, -1);
+        last[key] = val;
+        if(hpcrun_metricVal_isZero(diff)) continue;
+        // A node may be listed twice in one delta, sum up the changes
+        auto [vit, fresh] = values.emplace(key, diff);
+        if(!fresh) vit->second = combine(snap, key.second, vit->second, diff, +1);
+      }
+      if(values.empty()) continue;
+      fs::path out = dir / (stem + "-" + std::to_string(tid) + "-"
+                            + std::to_string(d.generation) + "." + HPCRUN_ProfileFnmSfx);
+      if(writeProfile(out, snap, tid, t.rank, d.generation, values))
+        ret.push_back(std::move(out));
+    }
+  }
+  return ret;
+}
+
+fs::path hpcsnap::snapshotOf(const fs::path& p) {
+  // <prog>-<rank>-<thread>-<host>-<pid>-<gen>.<ext>, as named by hpcrun.
+  // The snapshot file of a process carries thread 0.
+  std::string stem = p.stem().string();
+  auto dash = std::string::npos;
+  for(int i = 0; i < 4; i++) {
+    if(dash == 0) return {};
+    dash = stem.rfind('-', dash == std::string::npos ? dash : dash - 1);
+    if(dash == std::string::npos) return {};
+  }
+  auto end = stem.find('-', dash + 1);
+  stem.replace(dash + 1, end - dash - 1, "000");
+  return p.parent_path() / (stem + "." + HPCRUN_SnapshotFnmSfx);
+}
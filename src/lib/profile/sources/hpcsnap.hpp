@@ -0,0 +1,78 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+#ifndef HPCTOOLKIT_PROFILE_SOURCES_HPCSNAP_H
+#define HPCTOOLKIT_PROFILE_SOURCES_HPCSNAP_H
+
+#include <optional>
+#include <vector>
+#include "../stdshim/filesystem.hpp"
+
+namespace hpctoolkit::sources::hpcsnap {
+
+/// Fold the periodic snapshots of a process (an .hpcsnap file) into
+/// ordinary .hpcrun profiles, written to a private temporary directory that
+/// is removed when the process exits. Returns nothing if the given path is
+/// not a snapshot file.
+///
+/// By default only the threads that never wrote a profile of their own
+/// (i.e. the process was killed) are folded, each into a single profile.
+/// If `series` is true every thread is folded into one profile per
+/// snapshot interval, holding the changes within that interval and
+/// identified by an extra SNAPSHOT level in its identifier tuple.
+// MT: Internally Synchronized
+std::optional<std::vector<stdshim::filesystem::path>>
+fold(const stdshim::filesystem::path&, bool series);
+
+/// Path of the snapshot file written by the same process as the given
+/// .hpcrun or .hpccontainer file, which may not exist. Returns an empty path
+/// if the name does not follow hpcrun's naming scheme.
+stdshim::filesystem::path snapshotOf(const stdshim::filesystem::path&);
+
+}
+
+#endif  // HPCTOOLKIT_PROFILE_SOURCES_HPCSNAP_H
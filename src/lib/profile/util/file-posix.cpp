@@ -46,16 +46,34 @@
 
 #define _FILE_OFFSET_BITS 64
 
+#include "vgannotations.hpp"
+
 #include "file.hpp"
 
 #include "log.hpp"
+#include "telemetry.hpp"
 #include "../mpi/bcast.hpp"
 
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <fcntl.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HPCTOOLKIT_FILE_IO_URING 1
+#endif
+#endif
+
 namespace hpctoolkit::util::detail {
 struct FileImpl {
   FileImpl(stdshim::filesystem::path path, bool create)
@@ -64,15 +82,433 @@ struct FileImpl {
   bool create;
   int fd = -1;
 };
+
+/// Completion state for the asynchronous requests of a single Instance.
+struct IOCompletion {
+  std::mutex lock;
+  std::condition_variable cv;
+  std::size_t pendingOps = 0;
+  std::size_t pendingBytes = 0;
+
+  void issued(std::size_t bytes) {
+    std::unique_lock<std::mutex> l(lock);
+    pendingOps++;
+    pendingBytes += bytes;
+  }
+  void completed(std::size_t bytes) {
+    std::unique_lock<std::mutex> l(lock);
+    pendingOps--;
+    pendingBytes -= bytes;
+    cv.notify_all();
+  }
+};
+
+/// Single asynchronous read or write request.
+struct IORequest {
+  bool write;
+  int fd;
+  std::uint_fast64_t offset;
+  char* data;
+  std::size_t size;
+  std::size_t done = 0;
+  std::vector<char> owned;  // Backing storage for writes
+  std::shared_ptr<IOCompletion> completion;
+#ifdef HPCTOOLKIT_FILE_IO_URING
+  struct iovec iov;
+#endif
+};
+
+/// Engine performing asynchronous requests on behalf of Instances.
+class IOEngine {
+public:
+  virtual ~IOEngine() = default;
+
+  /// Submit a batch of requests. The engine takes ownership of the requests
+  /// and marks them completed in their IOCompletion when finished.
+  // MT: Internally Synchronized
+  virtual void submit(std::vector<std::unique_ptr<IORequest>>&) = 0;
+};
+
 struct FileInstanceImpl {
-  FileInstanceImpl(int fd) : fd(fd) {};
+  FileInstanceImpl(int fd, IOEngine* engine)
+    : fd(fd), engine(engine),
+      completion(engine != nullptr ? std::make_shared<IOCompletion>() : nullptr) {};
+  ~FileInstanceImpl() { flush(); }
+
   int fd;
+  IOEngine* engine;  // nullptr for synchronous I/O
+  std::shared_ptr<IOCompletion> completion;
+
+  // Contiguous writes that have not been submitted yet
+  std::uint_fast64_t stagedOffset = 0;
+  std::vector<char> staged;
+
+  // Writes smaller than this are coalesced before submission
+  static constexpr std::size_t stageSize = 4 * 1024 * 1024;  // 4MiB
+  // Writers wait for earlier writes once this many bytes are in flight
+  static constexpr std::size_t maxPendingBytes = 256 * 1024 * 1024;  // 256MiB
+
+  std::unique_ptr<IORequest> request(bool write, std::uint_fast64_t offset,
+                                     std::size_t size, char* data) {
+    auto req = std::make_unique<IORequest>();
+    req->write = write;
+    req->fd = fd;
+    req->offset = offset;
+    req->size = size;
+    req->data = data;
+    req->completion = completion;
+    return req;
+  }
+
+  void submit(std::vector<std::unique_ptr<IORequest>>& batch) {
+    {
+      std::unique_lock<std::mutex> l(completion->lock);
+      completion->cv.wait(l, [&]{ return completion->pendingBytes < maxPendingBytes; });
+    }
+    for(const auto& req: batch) completion->issued(req->size);
+    engine->submit(batch);
+    batch.clear();
+  }
+
+  void stage(std::vector<std::unique_ptr<IORequest>>& batch) {
+    if(staged.empty()) return;
+    auto req = request(true, stagedOffset, staged.size(), nullptr);
+    req->owned = std::move(staged);
+    req->data = req->owned.data();
+    batch.emplace_back(std::move(req));
+    staged = {};
+  }
+
+  void flush() {
+    if(engine == nullptr) return;
+    std::vector<std::unique_ptr<IORequest>> batch;
+    stage(batch);
+    if(!batch.empty()) submit(batch);
+    std::unique_lock<std::mutex> l(completion->lock);
+    completion->cv.wait(l, [&]{ return completion->pendingOps == 0; });
+  }
 };
 }
 
 using namespace hpctoolkit;
 using namespace hpctoolkit::util;
 
+// Perform a full pread/pwrite, handling short transfers
+static void syncio(bool write, int fd, std::uint_fast64_t offset, std::size_t size, char* buf) noexcept {
+  const auto orig_size = size;
+  while(size > 0) {
+    auto cnt = write ? pwrite(fd, buf, size, offset) : pread(fd, buf, size, offset);
+    if(cnt < 0) {
+      if(errno == EINTR) continue;
+      char buf[1024];
+      util::log::fatal{} << "Error during " << (write ? "write" : "read") << ": "
+                         << strerror_r(errno, buf, sizeof buf);
+    } else if(cnt == 0) {
+      util::log::fatal{} << "Error during " << (write ? "write" : "read")
+                         << ": EOF after " << (orig_size - size)
+                         << " bytes (of " << orig_size << " byte "
+                         << (write ? "write" : "read") << ")";
+    }
+
+    // Adjust the arguments for the next time attempt
+    offset += cnt;
+    size -= cnt;
+    buf += cnt;
+  }
+}
+
+namespace {
+
+/// Portable engine, requests are performed by a pool of I/O threads.
+class ThreadPoolEngine final : public detail::IOEngine {
+public:
+  ThreadPoolEngine(unsigned int nthreads) {
+    for(unsigned int i = 0; i < nthreads; i++)
+      workers.emplace_back([this]{ run(); });
+  }
+  ~ThreadPoolEngine() {
+    {
+      std::unique_lock<std::mutex> l(lock);
+      stop = true;
+    }
+    cv.notify_all();
+    for(auto& t: workers) t.join();
+  }
+
+  void submit(std::vector<std::unique_ptr<detail::IORequest>>& batch) override {
+    {
+      std::unique_lock<std::mutex> l(lock);
+      for(auto& req: batch) queue.emplace_back(std::move(req));
+    }
+    cv.notify_all();
+  }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> l(lock);
+    while(true) {
+      cv.wait(l, [&]{ return stop || !queue.empty(); });
+      if(queue.empty()) return;
+      auto req = std::move(queue.front());
+      queue.pop_front();
+      l.unlock();
+      syncio(req->write, req->fd, req->offset, req->size, req->data);
+      req->completion->completed(req->size);
+      req.reset();
+      l.lock();
+    }
+  }
+
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<std::unique_ptr<detail::IORequest>> queue;
+  bool stop = false;
+  std::vector<std::thread> workers;
+};
+
+#ifdef HPCTOOLKIT_FILE_IO_URING
+/// Linux io_uring engine. Batches are submitted with a single system call,
+/// a reaper thread handles completions (and resubmits short transfers).
+class IOUringEngine final : public detail::IOEngine {
+public:
+  /// Set up a new ring, or return nullptr if io_uring is unavailable.
+  static std::unique_ptr<IOUringEngine> create(unsigned int entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof params);
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if(fd < 0) return nullptr;
+    std::unique_ptr<IOUringEngine> e(new IOUringEngine(fd, params));
+    if(!e->map(params)) return nullptr;
+    e->reaper = std::thread([e = e.get()]{ e->reap(); });
+    return e;
+  }
+
+  ~IOUringEngine() {
+    if(reaper.joinable()) {
+      // Wake up the reaper with a no-op, tagged with a null request
+      std::unique_lock<std::mutex> l(sqlock);
+      io_uring_sqe* sqe = claimSqe();
+      sqe->opcode = IORING_OP_NOP;
+      sqe->user_data = 0;
+      publishSqe();
+      enter(1, 0, 0);
+      l.unlock();
+      reaper.join();
+    }
+    if(sqes != MAP_FAILED) munmap(sqes, sqesSize);
+    if(cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+    if(sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+    close(ringfd);
+  }
+
+  void submit(std::vector<std::unique_ptr<detail::IORequest>>& batch) override {
+    std::unique_lock<std::mutex> l(sqlock);
+    unsigned int n = 0;
+    for(auto& req: batch) {
+      // Keep the number of requests in flight within the capacity of the ring
+      if(inflight == sqEntries) {
+        enter(n, 0, 0);
+        n = 0;
+        space.wait(l, [&]{ return inflight < sqEntries; });
+      }
+      prepare(req.release());
+      inflight++;
+      n++;
+    }
+    enter(n, 0, 0);
+  }
+
+private:
+  IOUringEngine(int fd, const io_uring_params& p)
+    : ringfd(fd), sqEntries(p.sq_entries) {}
+
+  bool map(const io_uring_params& p) {
+    sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if(single) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ringfd, IORING_OFF_SQ_RING);
+    if(sqRing == MAP_FAILED) return false;
+    cqRing = single ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+    if(cqRing == MAP_FAILED) return false;
+    sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    sqes = (io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) return false;
+
+    char* sq = (char*)sqRing;
+    sqTail = (unsigned int*)(sq + p.sq_off.tail);
+    sqMask = *(unsigned int*)(sq + p.sq_off.ring_mask);
+    sqArray = (unsigned int*)(sq + p.sq_off.array);
+    char* cq = (char*)cqRing;
+    cqHead = (unsigned int*)(cq + p.cq_off.head);
+    cqTail = (unsigned int*)(cq + p.cq_off.tail);
+    cqMask = *(unsigned int*)(cq + p.cq_off.ring_mask);
+    cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+    return true;
+  }
+
+  // MT: Externally Synchronized (holding sqlock)
+  io_uring_sqe* claimSqe() {
+    unsigned int idx = *sqTail & sqMask;
+    sqArray[idx] = idx;
+    memset(&sqes[idx], 0, sizeof sqes[idx]);
+    return &sqes[idx];
+  }
+
+  // MT: Externally Synchronized (holding sqlock)
+  void publishSqe() {
+    __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+  }
+
+  // MT: Externally Synchronized (holding sqlock)
+  void prepare(detail::IORequest* req) {
+    io_uring_sqe* sqe = claimSqe();
+    req->iov.iov_base = req->data + req->done;
+    req->iov.iov_len = req->size - req->done;
+    sqe->opcode = req->write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = req->fd;
+    sqe->off = req->offset + req->done;
+    sqe->addr = (std::uintptr_t)&req->iov;
+    sqe->len = 1;
+    sqe->user_data = (std::uintptr_t)req;
+    // The kernel hands the request over to the reaper, hidden from race checkers
+    ANNOTATE_HAPPENS_BEFORE(req);
+    publishSqe();
+  }
+
+  int enter(unsigned int submit, unsigned int wait, unsigned int flags) {
+    while(true) {
+      int ret = syscall(__NR_io_uring_enter, ringfd, submit, wait, flags, nullptr, 0);
+      if(ret >= 0 || errno != EINTR) {
+        if(ret < 0) {
+          char buf[1024];
+          util::log::fatal{} << "Error submitting I/O: " << strerror_r(errno, buf, sizeof buf);
+        }
+        return ret;
+      }
+    }
+  }
+
+  void reap() {
+    while(true) {
+      enter(0, 1, IORING_ENTER_GETEVENTS);
+      unsigned int head = *cqHead;
+      const unsigned int tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+      bool stop = false;
+      for(; head != tail; head++) {
+        const io_uring_cqe& cqe = cqes[head & cqMask];
+        auto* req = (detail::IORequest*)(std::uintptr_t)cqe.user_data;
+        if(req == nullptr) {
+          stop = true;
+          continue;
+        }
+        complete(req, cqe.res);
+      }
+      __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+      if(stop) return;
+    }
+  }
+
+  void complete(detail::IORequest* req, int res) {
+    ANNOTATE_HAPPENS_AFTER(req);
+    if(res == -EINTR || res == -EAGAIN) {
+      resubmit(req);
+      return;
+    }
+    if(res == -EINVAL || res == -EOPNOTSUPP) {
+      // Kernel does not support this operation, do it the old-fashioned way
+      syncio(req->write, req->fd, req->offset + req->done, req->size - req->done,
+             req->data + req->done);
+      res = req->size - req->done;
+    } else if(res < 0) {
+      char buf[1024];
+      util::log::fatal{} << "Error during " << (req->write ? "write" : "read") << ": "
+                         << strerror_r(-res, buf, sizeof buf);
+    } else if(res == 0) {
+      util::log::fatal{} << "Error during " << (req->write ? "write" : "read")
+                         << ": EOF after " << req->done << " bytes (of "
+                         << req->size << " byte " << (req->write ? "write" : "read") << ")";
+    }
+    req->done += res;
+    if(req->done < req->size) {
+      resubmit(req);
+      return;
+    }
+
+    req->completion->completed(req->size);
+    delete req;
+    std::unique_lock<std::mutex> l(sqlock);
+    inflight--;
+    space.notify_all();
+  }
+
+  void resubmit(detail::IORequest* req) {
+    // The request is already counted in flight, so there is room in the ring
+    std::unique_lock<std::mutex> l(sqlock);
+    prepare(req);
+    enter(1, 0, 0);
+  }
+
+  int ringfd;
+  unsigned int sqEntries;
+  void* sqRing = MAP_FAILED;
+  std::size_t sqRingSize = 0;
+  void* cqRing = MAP_FAILED;
+  std::size_t cqRingSize = 0;
+  io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+  std::size_t sqesSize = 0;
+  unsigned int* sqTail;
+  unsigned int sqMask;
+  unsigned int* sqArray;
+  unsigned int* cqHead;
+  unsigned int* cqTail;
+  unsigned int cqMask;
+  io_uring_cqe* cqes;
+
+  std::mutex sqlock;
+  std::condition_variable space;
+  unsigned int inflight = 0;
+  std::thread reaper;
+};
+#endif  // HPCTOOLKIT_FILE_IO_URING
+
+std::atomic<File::Backend> currentBackend = File::Backend::sync;
+
+// Engine shared by all asynchronous Instances, created on first use
+detail::IOEngine* engine() {
+  static std::unique_ptr<detail::IOEngine> engine = []() -> std::unique_ptr<detail::IOEngine> {
+    static constexpr unsigned int nthreads = 4;
+    switch(currentBackend.load(std::memory_order_relaxed)) {
+    case File::Backend::sync:
+      return nullptr;
+    case File::Backend::io_uring:
+#ifdef HPCTOOLKIT_FILE_IO_URING
+      if(auto e = IOUringEngine::create(256))
+        return e;
+#endif
+      util::log::info{} << "io_uring is not available, using I/O threads instead";
+      // fallthrough
+    case File::Backend::threads:
+      return std::make_unique<ThreadPoolEngine>(nthreads);
+    }
+    std::abort();  // unreachable
+  }();
+  return engine.get();
+}
+
+}  // namespace
+
+void File::setBackend(Backend b) noexcept {
+  currentBackend.store(b, std::memory_order_relaxed);
+}
+
+File::Backend File::backend() noexcept {
+  return currentBackend.load(std::memory_order_relaxed);
+}
+
 File::File(stdshim::filesystem::path path, bool create) noexcept
   : impl(std::make_unique<detail::FileImpl>(std::move(path), create)) {}
 File::~File() {
@@ -133,7 +569,8 @@ void File::remove() noexcept {
 
 File::Instance::Instance() = default;
 File::Instance::Instance(const File& file, bool writable, bool mapped) noexcept
-  : impl(std::make_unique<detail::FileInstanceImpl>(file.impl->fd)) {
+  : impl(std::make_unique<detail::FileInstanceImpl>(file.impl->fd,
+      File::backend() == File::Backend::sync ? nullptr : engine())) {
   assert(impl && "Attempt to call File::open after ::remove!");
   assert(impl->fd != -1 && "Attempt to call File::open before ::synchronize!");
 }
@@ -144,40 +581,62 @@ File::Instance& File::Instance::operator=(File::Instance&&) = default;
 
 void File::Instance::readat(std::uint_fast64_t offset, std::size_t size, char* buf) noexcept {
   assert(impl && "Attempt to call readat on an empty File::Instance!");
-  const auto orig_size = size;
-  while(size > 0) {
-    auto cnt = pread(impl->fd, buf, size, offset);
-    if(cnt < 0) {
-      char buf[1024];
-      util::log::fatal{} << "Error during read: " << strerror_r(errno, buf, sizeof buf);
-    } else if(cnt == 0) {
-      util::log::fatal{} << "Error during read: EOF after " << (orig_size - size)
-                        << " bytes (of " << orig_size << " byte read)";
-    }
-
-    // Adjust the arguments for the next time attempt
-    offset += cnt;
-    size -= cnt;
-    buf += cnt;
+  telemetry::read(size, impl->engine == nullptr);
+  if(impl->engine == nullptr) {
+    syncio(false, impl->fd, offset, size, buf);
+    return;
   }
+
+  // Submit the read along with any staged writes, then wait for everything.
+  std::vector<std::unique_ptr<detail::IORequest>> batch;
+  impl->stage(batch);
+  batch.emplace_back(impl->request(false, offset, size, buf));
+  impl->submit(batch);
+  impl->flush();
 }
 
 void File::Instance::writeat(std::uint_fast64_t offset, std::size_t size, const char* buf) noexcept {
   assert(impl && "Attempt to call writeat on an empty File::Instance!");
-  const auto orig_size = size;
-  while(size > 0) {
-    auto cnt = pwrite(impl->fd, buf, size, offset);
-    if(cnt < 0) {
-      char buf[1024];
-      util::log::fatal{} << "Error during write: " << strerror_r(errno, buf, sizeof buf);
-    } else if(cnt == 0) {
-      util::log::fatal{} << "Error during write: EOF after " << (orig_size - size)
-                        << " bytes (of " << orig_size << " byte write)";
-    }
+  telemetry::written(size);
+  if(impl->engine == nullptr) {
+    syncio(true, impl->fd, offset, size, const_cast<char*>(buf));
+    return;
+  }
+  if(size == 0) return;
 
-    // Adjust the arguments for the next time attempt
-    offset += cnt;
-    size -= cnt;
-    buf += cnt;
+  // Coalesce with the staged write if this continues it, otherwise start anew
+  std::vector<std::unique_ptr<detail::IORequest>> batch;
+  if(!impl->staged.empty() && impl->stagedOffset + impl->staged.size() != offset)
+    impl->stage(batch);
+  if(impl->staged.empty()) {
+    impl->stagedOffset = offset;
+    impl->staged.reserve(std::max(size, detail::FileInstanceImpl::stageSize));
+  }
+  impl->staged.insert(impl->staged.end(), buf, buf + size);
+  if(impl->staged.size() >= detail::FileInstanceImpl::stageSize)
+    impl->stage(batch);
+  if(!batch.empty()) impl->submit(batch);
+}
+
+void File::Instance::writeat(std::uint_fast64_t offset, std::vector<char>&& data) noexcept {
+  assert(impl && "Attempt to call writeat on an empty File::Instance!");
+  if(impl->engine == nullptr || data.size() < detail::FileInstanceImpl::stageSize) {
+    writeat(offset, data.size(), data.data());
+    return;
   }
+
+  // Large enough to submit on its own, without copying
+  telemetry::written(data.size());
+  std::vector<std::unique_ptr<detail::IORequest>> batch;
+  impl->stage(batch);
+  auto req = impl->request(true, offset, data.size(), nullptr);
+  req->owned = std::move(data);
+  req->data = req->owned.data();
+  batch.emplace_back(std::move(req));
+  impl->submit(batch);
+}
+
+void File::Instance::flush() noexcept {
+  assert(impl && "Attempt to call flush on an empty File::Instance!");
+  impl->flush();
 }
@@ -51,6 +51,7 @@
 #include <functional>
 #include <ios>
 #include <memory>
+#include <vector>
 
 namespace hpctoolkit::util {
 
@@ -75,6 +76,25 @@ public:
   File(File&&);
   File& operator=(File&&);
 
+  /// Backends available to perform the I/O for File::Instances.
+  enum class Backend {
+    /// Synchronous pread/pwrite, performed by the calling thread. Default.
+    sync,
+    /// Asynchronous, performed by a small pool of dedicated I/O threads.
+    threads,
+    /// Asynchronous, submitted in batches through Linux io_uring. Falls back
+    /// to `threads` if io_uring is not available on this system.
+    io_uring,
+  };
+
+  /// Set the Backend used by all Instances opened after this call. Should be
+  /// called early, before any File is opened.
+  // MT: Externally Synchronized
+  static void setBackend(Backend) noexcept;
+
+  /// Get the Backend that will be used for newly opened Instances.
+  static Backend backend() noexcept;
+
   /// Synchronize this File's state between MPI ranks and the filesystem.
   /// This or #initialize should be called once and only once per File.
   /// May act as an MPI synchronization point.
@@ -115,19 +135,32 @@ public:
     Instance& operator=(Instance&&);
 
     /// Read a block of bytes from the given file offset, into the given buffer.
+    /// The read observes all writes previously issued through this Instance.
     /// Throws a fatal error on I/O errors.
     void readat(std::uint_fast64_t offset, std::size_t size, char* data) noexcept;
 
     /// Write a block of bytes at the given offset, from the given buffer.
     /// Throws a fatal error on I/O errors.
+    ///
+    /// With an asynchronous Backend the data is copied and the write completes
+    /// later, but always before flush() returns or this Instance is destroyed.
+    /// Pending writes through an Instance must not overlap each other.
     void writeat(std::uint_fast64_t offset, std::size_t size, const char* data) noexcept;
 
+    /// Variant of writeat that takes ownership of the buffer, avoiding the copy
+    /// with an asynchronous Backend.
+    void writeat(std::uint_fast64_t offset, std::vector<char>&& data) noexcept;
+
     /// Wrapper for writeat for things like std::array and std::vector
     template<class T>
     void writeat(std::uint_fast64_t offset, const T& data) noexcept {
       return writeat(offset, data.size(), data.data());
     }
 
+    /// Wait for all writes issued through this Instance to complete.
+    /// Throws a fatal error on I/O errors.
+    void flush() noexcept;
+
   private:
     friend class File;
     Instance(const File&, bool, bool) noexcept;
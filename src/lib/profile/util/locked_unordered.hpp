@@ -48,6 +48,7 @@
 #define HPCTOOLKIT_PROFILE_UTIL_LOCKED_UNORDERED_H
 
 #include "ref_wrappers.hpp"
+#include "telemetry.hpp"
 
 #include <unordered_map>
 #include <unordered_set>
@@ -77,6 +78,18 @@ namespace {
   // Helper: expands to the most read-friendly lock supported by a mutex.
   template<class M> using su_lock = typename std::conditional<
     SharedMutex<M>::value, std::shared_lock<M>, std::unique_lock<M>>::type;
+
+  // Helper: acquire a lock, accounting for the time spent if it was contended.
+  template<class L>
+  L acquire(typename L::mutex_type& m, telemetry::Lock kind) {
+    if(!telemetry::enabled()) return L(m);
+    L l(m, std::try_to_lock);
+    if(!l.owns_lock()) {
+      telemetry::LockWait w(kind);
+      l.lock();
+    }
+    return l;
+  }
 }
 
 /// A simple parallel wrapper around a std::unordered_map.
@@ -116,8 +129,8 @@ public:
 
   /// Get the value for a key, creating an entry if necessary.
   // MT: Internally Synchronized
-  V& operator[](const K& k) { return opget(su_lock<M>(lock), k).first; }
-  V& operator[](K&& k) { return opget(su_lock<M>(lock), std::move(k)).first; }
+  V& operator[](const K& k) { return opget(acquire<su_lock<M>>(lock, lock_kind), k).first; }
+  V& operator[](K&& k) { return opget(acquire<su_lock<M>>(lock, lock_kind), std::move(k)).first; }
 
   /// Get the value for a key, throwing if it doesn't exist.
   // MT: Internally Synchronized
@@ -135,7 +148,7 @@ public:
   /// Insert an entry into the map, if it didn't already exist.
   // MT: Internally Synchronized
   std::pair<V&,bool> insert(const typename real_t::value_type& v) {
-    return opget(su_lock<M>(lock), v.first, v.second);
+    return opget(acquire<su_lock<M>>(lock, lock_kind), v.first, v.second);
   }
 
   /// Add a new pair to the map, if it didn't already exist.
@@ -143,23 +156,23 @@ public:
   template<class... Args>
   std::pair<V&,bool> emplace(Args&&... args) {
     typename real_t::value_type v(std::forward<Args>(args)...);
-    return opget(su_lock<M>(lock), std::move(v.first), std::move(v.second));
+    return opget(acquire<su_lock<M>>(lock, lock_kind), std::move(v.first), std::move(v.second));
   }
 
   // Add a new element to the map, if the key was not found before.
   template<class... Args>
   std::pair<V&,bool> try_emplace(const K& k, Args&&... args) {
-    return opget(su_lock<M>(lock), k, std::forward<Args>(args)...);
+    return opget(acquire<su_lock<M>>(lock, lock_kind), k, std::forward<Args>(args)...);
   }
   template<class... Args>
   std::pair<V&,bool> try_emplace(K&& k, Args&&... args) {
-    return opget(su_lock<M>(lock), std::move(k), std::forward<Args>(args)...);
+    return opget(acquire<su_lock<M>>(lock, lock_kind), std::move(k), std::forward<Args>(args)...);
   }
 
   /// Look up an entry in the map. May return std::nullopt.
   // MT: Internally Synchronized, Unstable
-  optional_ref<V> find(const K& k) { return opget_r(su_lock<M>(lock), k); }
-  optional_ref<const V> find(const K& k) const { return opget_r(su_lock<M>(lock), k); }
+  optional_ref<V> find(const K& k) { return opget_r(acquire<su_lock<M>>(lock, lock_kind), k); }
+  optional_ref<const V> find(const K& k) const { return opget_r(acquire<su_lock<M>>(lock, lock_kind), k); }
 
   /// Clear the map.
   // MT: Externally Synchronized
@@ -172,7 +185,7 @@ public:
   // Erase an element from the map. Returns the number of elements removed (0 or 1).
   // MT: Internally Synchronized
   size_type erase(const K& key) noexcept {
-    std::unique_lock<M> l(lock);
+    auto l = acquire<std::unique_lock<M>>(lock, lock_kind);
     return real.erase(key);
   }
 
@@ -186,7 +199,7 @@ private:
     friend class locked_unordered_map;
     locked_unordered_map& from;
     std::unique_lock<M> lk;
-    iteration(locked_unordered_map& m) : from(m), lk(m.lock) {};
+    iteration(locked_unordered_map& m) : from(m), lk(acquire<decltype(lk)>(m.lock, lock_kind)) {};
   };
   class const_iteration {
   public:
@@ -196,7 +209,7 @@ private:
     friend class locked_unordered_map;
     const locked_unordered_map& from;
     su_lock<M> lk;
-    const_iteration(const locked_unordered_map& m) : from(m), lk(m.lock) {};
+    const_iteration(const locked_unordered_map& m) : from(m), lk(acquire<decltype(lk)>(m.lock, lock_kind)) {};
   };
 
 public:
@@ -212,6 +225,7 @@ public:
   }
 
 protected:
+  static constexpr telemetry::Lock lock_kind = telemetry::Lock::map;
   mutable M lock;
   real_t real;
 
@@ -230,7 +244,7 @@ private:
       auto x = real.find(k);
       if(x != real.end()) return {x->second, false};
     }
-    return opget(std::unique_lock<Mtx>(lock), std::forward<KA>(k), std::forward<Args>(args)...);
+    return opget(acquire<std::unique_lock<Mtx>>(lock, lock_kind), std::forward<KA>(k), std::forward<Args>(args)...);
   }
 
   optional_ref<V> opget_r(su_lock<M>&&, K k) {
@@ -264,7 +278,7 @@ public:
   // MT: Internally Synchronized
   template<class... Args>
   std::pair<const K&, bool> emplace(Args&&... args) {
-    return opget(K(std::forward<Args>(args)...), su_lock<M>(lock));
+    return opget(K(std::forward<Args>(args)...), acquire<su_lock<M>>(lock, lock_kind));
   }
 
   /// Variant of emplace() that strips the second argument.
@@ -276,8 +290,8 @@ public:
 
   /// Look for whether an element (or its equivalent) is in the set.
   // MT: Weird But Not Really Synchronized
-  iterator find(const K& k) { return opget_r(k, su_lock<M>(lock)); }
-  const_iterator find(const K& k) const { return opget_r(k, su_lock<M>(lock)); }
+  iterator find(const K& k) { return opget_r(k, acquire<su_lock<M>>(lock, lock_kind)); }
+  const_iterator find(const K& k) const { return opget_r(k, acquire<su_lock<M>>(lock, lock_kind)); }
 
   /// Check whether the map is empty.
   // MT: Externally Synchronized
@@ -290,7 +304,7 @@ public:
   /// Erase an element.
   // MT: Internally Synchronized
   std::size_t erase(const K& k) {
-    std::unique_lock<M> lk(lock);
+    auto lk = acquire<std::unique_lock<M>>(lock, lock_kind);
     return real.erase(k);
   }
 
@@ -304,7 +318,7 @@ private:
     friend class locked_unordered_set;
     locked_unordered_set& from;
     std::unique_lock<M> lk;
-    iteration(locked_unordered_set& m) : from(m), lk(m.lock) {};
+    iteration(locked_unordered_set& m) : from(m), lk(acquire<decltype(lk)>(m.lock, lock_kind)) {};
   };
   class const_iteration {
   public:
@@ -314,7 +328,7 @@ private:
     friend class locked_unordered_set;
     const locked_unordered_set& from;
     su_lock<M> lk;
-    const_iteration(const locked_unordered_set& m) : from(m), lk(m.lock) {};
+    const_iteration(const locked_unordered_set& m) : from(m), lk(acquire<decltype(lk)>(m.lock, lock_kind)) {};
   };
 
 public:
@@ -324,6 +338,7 @@ public:
   const_iteration citerate() const noexcept { return *this; }
 
 protected:
+  static constexpr telemetry::Lock lock_kind = telemetry::Lock::set;
   mutable M lock;
   real_t real;
 
@@ -339,7 +354,7 @@ private:
       auto x = real.find(k);
       if(x != real.end()) return {*x, false};
     }
-    return opget(k, std::unique_lock<Mtx>(lock));
+    return opget(k, acquire<std::unique_lock<Mtx>>(lock, lock_kind));
   }
   template<class Mtx>
   std::pair<const K&, bool> opget(K&& k, std::shared_lock<Mtx>&& l) {
@@ -348,7 +363,7 @@ private:
       auto x = real.find(k);
       if(x != real.end()) return {*x, false};
     }
-    return opget(std::move(k), std::unique_lock<Mtx>(lock));
+    return opget(std::move(k), acquire<std::unique_lock<Mtx>>(lock, lock_kind));
   }
 
   iterator opget_r(const K& k, su_lock<M>&&) {
@@ -48,6 +48,7 @@
 
 #include "../util/log.hpp"
 #include "once.hpp"
+#include "telemetry.hpp"
 
 #include <cassert>
 #include <stdexcept>
@@ -75,7 +76,12 @@ Once::Caller Once::signal() {
 void Once::wait() const {
   assert(callerId.load(std::memory_order_relaxed) != std::this_thread::get_id()
          && "Single-thread deadlock detected on Once!");
-  future.wait();
+  if(telemetry::enabled()
+     && future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    telemetry::LockWait w(telemetry::Lock::once);
+    future.wait();
+  } else
+    future.wait();
   ANNOTATE_HAPPENS_AFTER(this);
 }
 
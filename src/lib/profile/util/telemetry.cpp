@@ -0,0 +1,505 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+#include "telemetry.hpp"
+
+#include "log.hpp"
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <cxxabi.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace hpctoolkit::util;
+using namespace hpctoolkit::util::telemetry;
+using clk = std::chrono::steady_clock;
+using std::chrono::nanoseconds;
+
+static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+namespace {
+struct Totals {
+  std::uint64_t count = 0;
+  nanoseconds wall{0};
+  nanoseconds cpu{0};
+  nanoseconds maxWall{0};
+};
+
+struct Event {
+  const char* name;
+  const char* cat;
+  const char* argName;
+  std::int64_t arg;
+  clk::time_point start;
+  nanoseconds dur;
+};
+
+struct IOTotals {
+  std::uint64_t calls = 0;
+  nanoseconds wall{0};
+  std::uint64_t bytes = 0;
+  std::uint64_t bytesRead = 0;
+};
+
+// Telemetry recorded by a single thread. Only ever touched by its owner until
+// the report is written.
+struct ThreadData {
+  unsigned int tid;
+  std::vector<Event> events;
+  std::unordered_map<const char*, Totals> phases;
+  std::array<std::pair<std::uint64_t, nanoseconds>, 3> locks{};
+  std::map<std::pair<std::size_t, std::size_t>, IOTotals> reads;
+  std::map<std::pair<std::size_t, std::size_t>, IOTotals> sinks;
+  std::uint64_t unattributed = 0;
+  std::uint64_t unattributedRead = 0;
+  std::uint64_t onThread = 0;  // Bytes passed to read() the thread read itself
+  std::size_t curPipe = npos;
+  std::size_t curSink = npos;
+  std::size_t curSource = npos;
+};
+
+struct MemSample {
+  const char* label;
+  clk::time_point when;
+  std::uint64_t rss;
+};
+
+struct Pipeline {
+  std::vector<std::string> sources;
+  std::vector<std::string> sinks;
+};
+
+struct Global {
+  std::mutex lock;
+  clk::time_point epoch;
+  std::vector<std::unique_ptr<ThreadData>> threads;
+  std::vector<Pipeline> pipelines;
+  std::vector<MemSample> memory;
+};
+Global& global() {
+  static Global g;
+  return g;
+}
+
+ThreadData& local() {
+  thread_local ThreadData* td = nullptr;
+  if(td == nullptr) {
+    auto& g = global();
+    std::unique_lock<std::mutex> l(g.lock);
+    g.threads.emplace_back(std::make_unique<ThreadData>());
+    td = g.threads.back().get();
+    td->tid = g.threads.size() - 1;
+  }
+  return *td;
+}
+
+nanoseconds threadCPU() noexcept {
+  struct timespec ts;
+  if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return nanoseconds(0);
+  return std::chrono::seconds(ts.tv_sec) + nanoseconds(ts.tv_nsec);
+}
+
+// Read a single numeric field from a small /proc file, 0 if not available.
+std::uint64_t procField(const char* path, const char* field) noexcept {
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if(fd < 0) return 0;
+  char buf[1024];
+  ssize_t len = ::read(fd, buf, sizeof buf - 1);
+  ::close(fd);
+  if(len <= 0) return 0;
+  buf[len] = '\0';
+  const char* p = field == nullptr ? buf : std::strstr(buf, field);
+  if(p == nullptr) return 0;
+  if(field != nullptr) p += std::strlen(field);
+  return std::strtoull(p, nullptr, 10);
+}
+
+// Bytes read by the calling thread so far, including through the page cache.
+std::uint64_t threadBytesRead() noexcept {
+  return procField("/proc/thread-self/io", "rchar:");
+}
+
+std::uint64_t currentRSS() noexcept {
+  // /proc/self/statm: size resident shared ..., all in pages
+  int fd = ::open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+  if(fd < 0) return 0;
+  char buf[256];
+  ssize_t len = ::read(fd, buf, sizeof buf - 1);
+  ::close(fd);
+  if(len <= 0) return 0;
+  buf[len] = '\0';
+  char* end;
+  std::strtoull(buf, &end, 10);
+  return std::strtoull(end, nullptr, 10) * sysconf(_SC_PAGESIZE);
+}
+
+void record(const char* name, nanoseconds wall, nanoseconds cpu) noexcept {
+  auto& t = local().phases[name];
+  t.count++;
+  t.wall += wall;
+  t.cpu += cpu;
+  t.maxWall = std::max(t.maxWall, wall);
+}
+
+double seconds(nanoseconds ns) {
+  return std::chrono::duration<double>(ns).count();
+}
+
+// Minimal escaping for JSON strings, sufficient for type names and paths.
+std::string quote(const std::string& s) {
+  std::ostringstream ss;
+  ss << '"';
+  for(char c: s) {
+    switch(c) {
+    case '"': ss << "\\\""; break;
+    case '\\': ss << "\\\\"; break;
+    case '\n': ss << "\\n"; break;
+    case '\t': ss << "\\t"; break;
+    default:
+      if(static_cast<unsigned char>(c) < 0x20)
+        ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c
+           << std::dec << std::setfill(' ');
+      else ss << c;
+    }
+  }
+  ss << '"';
+  return ss.str();
+}
+}
+
+void telemetry::enable() noexcept {
+  global().epoch = clk::now();
+  detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+Span::Span(const char* n, const char* c, const char* an, std::int64_t a) noexcept
+  : name(n), cat(c), argName(an), arg(a), active(enabled()) {
+  if(!active) return;
+  cpuStart = threadCPU();
+  start = clk::now();
+}
+
+Span::~Span() {
+  if(!active) return;
+  const auto dur = clk::now() - start;
+  record(name, dur, threadCPU() - cpuStart);
+  local().events.push_back({name, cat, argName, arg, start, dur});
+}
+
+nanoseconds Span::elapsed() const noexcept {
+  return active ? clk::now() - start : nanoseconds(0);
+}
+
+Timer::~Timer() {
+  if(!active) return;
+  record(name, clk::now() - start, nanoseconds(0));
+}
+
+LockWait::~LockWait() {
+  auto& l = local().locks[static_cast<unsigned int>(kind)];
+  l.first++;
+  l.second += clk::now() - start;
+}
+
+std::size_t telemetry::pipeline(std::vector<std::string> sources,
+                                std::vector<std::string> sinks) {
+  auto& g = global();
+  std::unique_lock<std::mutex> l(g.lock);
+  g.pipelines.push_back({std::move(sources), std::move(sinks)});
+  return g.pipelines.size() - 1;
+}
+
+std::string telemetry::typeName(const std::type_info& ti) {
+  int status = -1;
+  std::unique_ptr<char, void(*)(void*)> name(
+      abi::__cxa_demangle(ti.name(), nullptr, nullptr, &status), std::free);
+  return status == 0 ? std::string(name.get()) : std::string(ti.name());
+}
+
+SourceRead::SourceRead(std::size_t p, std::size_t s) noexcept
+  : pipe(p), source(s), active(enabled()),
+    span("source.read", "source", "source", s) {
+  if(!active) return;
+  auto& td = local();
+  prevPipe = td.curPipe;
+  prevSource = td.curSource;
+  td.curPipe = p;
+  td.curSource = s;
+  rcharStart = threadBytesRead();
+  onThreadStart = td.onThread;
+};
+
+SourceRead::~SourceRead() {
+  if(!active) return;
+  const auto wall = span.elapsed();
+  auto& td = local();
+  // Bytes read() already attributed are excluded from the rchar delta, since
+  // the reads the thread did itself are also counted there.
+  const auto rchar = threadBytesRead() - rcharStart;
+  const auto onThread = td.onThread - onThreadStart;
+  auto& r = td.reads[{pipe, source}];
+  r.calls++;
+  r.wall += wall;
+  r.bytes += (rchar > onThread ? rchar - onThread : 0);
+  td.curPipe = prevPipe;
+  td.curSource = prevSource;
+}
+
+SinkCall::SinkCall(std::size_t p, std::size_t s) noexcept
+  : active(enabled()) {
+  if(!active) return;
+  auto& td = local();
+  prevPipe = td.curPipe;
+  prevSink = td.curSink;
+  td.curPipe = p;
+  td.curSink = s;
+  start = clk::now();
+}
+
+SinkCall::~SinkCall() {
+  if(!active) return;
+  auto& td = local();
+  auto& s = td.sinks[{td.curPipe, td.curSink}];
+  s.calls++;
+  s.wall += clk::now() - start;
+  td.curPipe = prevPipe;
+  td.curSink = prevSink;
+}
+
+void telemetry::written(std::size_t bytes) noexcept {
+  if(!enabled()) return;
+  auto& td = local();
+  if(td.curSink == npos) td.unattributed += bytes;
+  else td.sinks[{td.curPipe, td.curSink}].bytes += bytes;
+}
+
+void telemetry::read(std::size_t bytes, bool onThread) noexcept {
+  if(!enabled()) return;
+  auto& td = local();
+  if(onThread) td.onThread += bytes;
+  if(td.curSource != npos) td.reads[{td.curPipe, td.curSource}].bytes += bytes;
+  else if(td.curSink != npos) td.sinks[{td.curPipe, td.curSink}].bytesRead += bytes;
+  else td.unattributedRead += bytes;
+}
+
+void telemetry::sampleMemory(const char* label) noexcept {
+  if(!enabled()) return;
+  MemSample s{label, clk::now(), currentRSS()};
+  auto& g = global();
+  std::unique_lock<std::mutex> l(g.lock);
+  g.memory.push_back(s);
+}
+
+void telemetry::write(const stdshim::filesystem::path& report,
+                      const stdshim::filesystem::path& trace, unsigned int pid) {
+  auto& g = global();
+  std::unique_lock<std::mutex> l(g.lock);
+  const auto now = clk::now();
+  const auto since = [&](clk::time_point t) {
+    return std::chrono::duration<double, std::micro>(t - g.epoch).count();
+  };
+
+  // Combine the per-thread data into the global totals
+  std::map<std::string, Totals> phases;
+  std::array<std::pair<std::uint64_t, nanoseconds>, 3> locks{};
+  std::map<std::pair<std::size_t, std::size_t>, IOTotals> reads;
+  std::map<std::pair<std::size_t, std::size_t>, IOTotals> sinks;
+  std::uint64_t unattributed = 0;
+  std::uint64_t unattributedRead = 0;
+  for(const auto& td: g.threads) {
+    for(const auto& [n, t]: td->phases) {
+      auto& p = phases[n];
+      p.count += t.count;
+      p.wall += t.wall;
+      p.cpu += t.cpu;
+      p.maxWall = std::max(p.maxWall, t.maxWall);
+    }
+    for(std::size_t i = 0; i < locks.size(); i++) {
+      locks[i].first += td->locks[i].first;
+      locks[i].second += td->locks[i].second;
+    }
+    const auto merge = [](auto& into, const auto& from) {
+      for(const auto& [k, v]: from) {
+        auto& t = into[k];
+        t.calls += v.calls;
+        t.wall += v.wall;
+        t.bytes += v.bytes;
+        t.bytesRead += v.bytesRead;
+      }
+    };
+    merge(reads, td->reads);
+    merge(sinks, td->sinks);
+    unattributed += td->unattributed;
+    unattributedRead += td->unattributedRead;
+  }
+
+  struct rusage ru;
+  std::memset(&ru, 0, sizeof ru);
+  getrusage(RUSAGE_SELF, &ru);
+  const auto tv = [](const struct timeval& t) {
+    return (double)t.tv_sec + (double)t.tv_usec / 1e6;
+  };
+
+  {
+    std::ofstream os(report.string());
+    if(!os) {
+      util::log::error{} << "Unable to write telemetry report to " << report.string();
+      return;
+    }
+    os << std::setprecision(9)
+       << "{\n"
+       << "  \"version\": 1,\n"
+       << "  \"wall_seconds\": " << seconds(now - g.epoch) << ",\n"
+       << "  \"cpu_seconds\": {\"user\": " << tv(ru.ru_utime)
+       << ", \"system\": " << tv(ru.ru_stime) << "},\n"
+       << "  \"peak_rss_bytes\": " << (std::uint64_t)ru.ru_maxrss * 1024 << ",\n"
+       << "  \"phases\": {";
+    bool first = true;
+    for(const auto& [n, t]: phases) {
+      os << (first ? "\n" : ",\n") << "    " << quote(n) << ": {"
+         << "\"count\": " << t.count
+         << ", \"wall_seconds\": " << seconds(t.wall)
+         << ", \"cpu_seconds\": " << seconds(t.cpu)
+         << ", \"max_wall_seconds\": " << seconds(t.maxWall) << "}";
+      first = false;
+    }
+    os << "\n  },\n"
+       << "  \"locks\": {";
+    static const std::array<const char*, 3> lockNames = {
+      "locked_unordered_map", "locked_unordered_set", "Once"};
+    for(std::size_t i = 0; i < locks.size(); i++) {
+      os << (i == 0 ? "\n" : ",\n") << "    \"" << lockNames[i] << "\": {"
+         << "\"contended\": " << locks[i].first
+         << ", \"wait_seconds\": " << seconds(locks[i].second) << "}";
+    }
+    os << "\n  },\n"
+       << "  \"memory\": [";
+    first = true;
+    for(const auto& m: g.memory) {
+      os << (first ? "\n" : ",\n") << "    {\"label\": " << quote(m.label)
+         << ", \"time_seconds\": " << seconds(m.when - g.epoch)
+         << ", \"rss_bytes\": " << m.rss << "}";
+      first = false;
+    }
+    os << "\n  ],\n"
+       << "  \"unattributed_bytes_read\": " << unattributedRead << ",\n"
+       << "  \"unattributed_bytes_written\": " << unattributed << ",\n"
+       << "  \"pipelines\": [";
+    for(std::size_t p = 0; p < g.pipelines.size(); p++) {
+      const auto& pipe = g.pipelines[p];
+      os << (p == 0 ? "\n" : ",\n") << "    {\n      \"sources\": [";
+      for(std::size_t i = 0; i < pipe.sources.size(); i++) {
+        IOTotals t;
+        if(auto it = reads.find({p, i}); it != reads.end()) t = it->second;
+        const double s = seconds(t.wall);
+        os << (i == 0 ? "\n" : ",\n") << "        {\"index\": " << i
+           << ", \"type\": " << quote(pipe.sources[i])
+           << ", \"reads\": " << t.calls
+           << ", \"wall_seconds\": " << s
+           << ", \"bytes_read\": " << t.bytes
+           << ", \"bytes_per_second\": " << (s > 0 ? t.bytes / s : 0) << "}";
+      }
+      os << "\n      ],\n      \"sinks\": [";
+      for(std::size_t i = 0; i < pipe.sinks.size(); i++) {
+        IOTotals t;
+        if(auto it = sinks.find({p, i}); it != sinks.end()) t = it->second;
+        os << (i == 0 ? "\n" : ",\n") << "        {\"index\": " << i
+           << ", \"type\": " << quote(pipe.sinks[i])
+           << ", \"calls\": " << t.calls
+           << ", \"wall_seconds\": " << seconds(t.wall)
+           << ", \"bytes_read\": " << t.bytesRead
+           << ", \"bytes_written\": " << t.bytes << "}";
+      }
+      os << "\n      ]\n    }";
+    }
+    os << "\n  ]\n}\n";
+  }
+
+  {
+    std::ofstream os(trace.string());
+    if(!os) {
+      util::log::error{} << "Unable to write telemetry trace to " << trace.string();
+      return;
+    }
+    os << std::fixed << std::setprecision(3)
+       << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n"
+       << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << pid
+       << ", \"args\": {\"name\": \"hpcprof " << pid << "\"}}";
+    for(const auto& td: g.threads) {
+      os << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << pid
+         << ", \"tid\": " << td->tid << ", \"args\": {\"name\": \"thread "
+         << td->tid << "\"}}";
+      for(const auto& e: td->events) {
+        os << ",\n{\"name\": " << quote(e.name) << ", \"cat\": " << quote(e.cat)
+           << ", \"ph\": \"X\", \"pid\": " << pid << ", \"tid\": " << td->tid
+           << ", \"ts\": " << since(e.start)
+           << ", \"dur\": " << std::chrono::duration<double, std::micro>(e.dur).count();
+        if(e.argName != nullptr)
+          os << ", \"args\": {" << quote(e.argName) << ": " << e.arg << "}";
+        os << "}";
+      }
+    }
+    for(const auto& m: g.memory) {
+      os << ",\n{\"name\": \"rss\", \"ph\": \"C\", \"pid\": " << pid
+         << ", \"ts\": " << since(m.when)
+         << ", \"args\": {\"MiB\": " << (double)m.rss / (1024 * 1024) << "}}";
+    }
+    os << "\n]}\n";
+  }
+}
@@ -0,0 +1,231 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+#ifndef HPCTOOLKIT_PROFILE_UTIL_TELEMETRY_H
+#define HPCTOOLKIT_PROFILE_UTIL_TELEMETRY_H
+
+#include "../stdshim/filesystem.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+/// Lightweight timing and memory telemetry for the Pipeline. Everything here is
+/// disabled by default, and costs a single relaxed load when disabled. Once
+/// enabled, each thread records into its own buffers, which are only combined
+/// when the final report is written.
+namespace hpctoolkit::util::telemetry {
+
+namespace detail {
+inline std::atomic<bool> enabled = false;
+}
+
+/// Enable the collection of telemetry. Should be called early, before any
+/// Pipeline is constructed. Also marks the zero point of the timeline.
+// MT: Externally Synchronized (global)
+void enable() noexcept;
+
+/// Check whether telemetry is currently being collected.
+// MT: Safe
+inline bool enabled() noexcept {
+  return detail::enabled.load(std::memory_order_relaxed);
+}
+
+/// Scope-class for a phase of processing. Records the wall and CPU time of the
+/// calling thread into the per-phase totals, and as an event on the timeline.
+/// `name` and `cat` must be string literals (or otherwise outlive the report).
+class Span final {
+public:
+  Span(const char* name, const char* cat) noexcept
+    : Span(name, cat, nullptr, 0) {};
+  Span(const char* name, const char* cat, const char* argName, std::int64_t arg) noexcept;
+  ~Span();
+
+  Span(const Span&) = delete;
+  Span(Span&&) = delete;
+  Span& operator=(const Span&) = delete;
+  Span& operator=(Span&&) = delete;
+
+  /// Wall time elapsed since the start of this Span. 0 if disabled.
+  std::chrono::nanoseconds elapsed() const noexcept;
+
+private:
+  const char* name;
+  const char* cat;
+  const char* argName;
+  std::int64_t arg;
+  bool active;
+  std::chrono::steady_clock::time_point start;
+  std::chrono::nanoseconds cpuStart;
+};
+
+/// Scope-class for frequent, short operations. Only accumulates wall time into
+/// the per-phase totals, and does not appear on the timeline.
+class Timer final {
+public:
+  Timer(const char* name) noexcept
+    : name(name), active(enabled()),
+      start(active ? std::chrono::steady_clock::now()
+                   : std::chrono::steady_clock::time_point()) {};
+  ~Timer();
+
+  Timer(const Timer&) = delete;
+  Timer(Timer&&) = delete;
+  Timer& operator=(const Timer&) = delete;
+  Timer& operator=(Timer&&) = delete;
+
+private:
+  const char* name;
+  bool active;
+  std::chrono::steady_clock::time_point start;
+};
+
+/// Kinds of locks that account for their contended wait time.
+enum class Lock : unsigned int {
+  map,  ///< util::locked_unordered_map
+  set,  ///< util::locked_unordered_set
+  once,  ///< util::Once
+};
+
+/// Scope-class for waiting on a contended lock. Should only be constructed
+/// after an uncontended attempt has failed, to keep the common path cheap.
+class LockWait final {
+public:
+  LockWait(Lock kind) noexcept
+    : kind(kind), start(std::chrono::steady_clock::now()) {};
+  ~LockWait();
+
+  LockWait(const LockWait&) = delete;
+  LockWait(LockWait&&) = delete;
+  LockWait& operator=(const LockWait&) = delete;
+  LockWait& operator=(LockWait&&) = delete;
+
+private:
+  Lock kind;
+  std::chrono::steady_clock::time_point start;
+};
+
+/// Register a new Pipeline, with the given Source and Sink types (in order).
+/// Returns the identifier to use when attributing data to this Pipeline.
+// MT: Internally Synchronized
+std::size_t pipeline(std::vector<std::string> sources, std::vector<std::string> sinks);
+
+/// Get a readable name for a (polymorphic) type, for use with pipeline().
+std::string typeName(const std::type_info&);
+
+/// Scope-class for a call to a Source's read(). Records the time taken and the
+/// bytes read for the Source: those noted with read() within this scope, plus
+/// any other reads the calling thread does itself (eg. through stdio, from
+/// /proc/thread-self/io).
+class SourceRead final {
+public:
+  SourceRead(std::size_t pipeline, std::size_t source) noexcept;
+  ~SourceRead();
+
+  SourceRead(const SourceRead&) = delete;
+  SourceRead(SourceRead&&) = delete;
+  SourceRead& operator=(const SourceRead&) = delete;
+  SourceRead& operator=(SourceRead&&) = delete;
+
+private:
+  std::size_t pipe;
+  std::size_t source;
+  bool active;
+  std::size_t prevPipe;
+  std::size_t prevSource;
+  std::uint64_t rcharStart;
+  std::uint64_t onThreadStart;
+  Span span;
+};
+
+/// Scope-class for a call into a Sink. Bytes written by the calling thread
+/// within this scope (see written()) are attributed to the Sink.
+class SinkCall final {
+public:
+  SinkCall(std::size_t pipeline, std::size_t sink) noexcept;
+  ~SinkCall();
+
+  SinkCall(const SinkCall&) = delete;
+  SinkCall(SinkCall&&) = delete;
+  SinkCall& operator=(const SinkCall&) = delete;
+  SinkCall& operator=(SinkCall&&) = delete;
+
+private:
+  bool active;
+  std::size_t prevPipe;
+  std::size_t prevSink;
+  std::chrono::steady_clock::time_point start;
+};
+
+/// Note that some bytes were written to an output file by the calling thread.
+// MT: Safe
+void written(std::size_t bytes) noexcept;
+
+/// Note that some bytes were read from a file on behalf of the calling thread.
+/// `onThread` is true if the calling thread did the read itself, false if it
+/// was done by an I/O backend (which /proc/thread-self/io does not see).
+// MT: Safe
+void read(std::size_t bytes, bool onThread) noexcept;
+
+/// Sample the current resident set size of the process, labeled for the
+/// report. Also appears as a counter on the timeline.
+// MT: Safe
+void sampleMemory(const char* label) noexcept;
+
+/// Write the collected telemetry: a JSON summary report to `report` and a
+/// Chrome trace-event timeline (for chrome://tracing or Perfetto) to `trace`.
+/// `pid` is used to identify this process in the timeline (e.g. MPI rank).
+// MT: Externally Synchronized (global)
+void write(const stdshim::filesystem::path& report,
+           const stdshim::filesystem::path& trace, unsigned int pid = 0);
+
+}  // namespace hpctoolkit::util::telemetry
+
+#endif  // HPCTOOLKIT_PROFILE_UTIL_TELEMETRY_H
@@ -123,6 +123,27 @@ RealPathMgr& RealPathMgr::singleton()
 }
 
 
+// Returns: true and the cached realpath for 'pathNm', if there is one.
+bool
+RealPathMgr::cacheFind(const string& pathNm, string& pathNm_real) const
+{
+  long real = m_cache.alias(m_cache.find(pathNm));
+
+  if (real < 0) {
+    return false;
+  }
+  pathNm_real = m_cache.index2str(real);
+  return true;
+}
+
+
+void
+RealPathMgr::cacheInsert(const string& pathNm, const string& pathNm_real) const
+{
+  m_cache.setAlias(m_cache.str2index(pathNm), m_cache.str2index(pathNm_real));
+}
+
+
 bool
 RealPathMgr::realpath(string& pathNm) const
 {
@@ -133,71 +154,71 @@ RealPathMgr::realpath(string& pathNm) const
   // INVARIANT: 'pathNm' is not empty
 
   // INVARIANT: all entries in the map are non-empty
-  MyMap::iterator it = m_cache.find(pathNm);
+  string pathNm_real;
 
   // -------------------------------------------------------
-  // 1. Check cache for 'pathNm'
+  // 1. Check cache for 'pathNm' (lock-free)
   // -------------------------------------------------------
-  if (it != m_cache.end()) {
+  if (cacheFind(pathNm, pathNm_real)) {
     // use cached value
-    const string& pathNm_real = it->second;
     if (pathNm_real[0] == '/') { // optimization: only copy if fully resolved
       pathNm = pathNm_real;
     }
+    return (pathNm[0] == '/'); // fully resolved
+  }
+
+  // the path managers are not thread-safe, so resolve new names
+  // one at a time
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  // -------------------------------------------------------
+  // 2. Consult cache with path-replaced 'pathNm'
+  // -------------------------------------------------------
+  string pathNm_orig = pathNm;
+
+  if (m_pathReplaceMgr != NULL) {
+    pathNm = m_pathReplaceMgr->replace(pathNm);
   }
   else {
-    // -------------------------------------------------------
-    // 2. Consult cache with path-replaced 'pathNm'
-    // -------------------------------------------------------
-    string pathNm_orig = pathNm;
+    pathNm = PathReplacementMgr::singleton().replace(pathNm);
+  }
 
-    if (m_pathReplaceMgr != NULL) {
-      pathNm = m_pathReplaceMgr->replace(pathNm);
-    }
-    else {
-      pathNm = PathReplacementMgr::singleton().replace(pathNm);
+  if (cacheFind(pathNm, pathNm_real)) {
+    // use cached value
+    if (pathNm_real[0] == '/') { // optimization: only copy if fully resolved
+      pathNm = pathNm_real;
     }
 
-    it = m_cache.find(pathNm);
-
-    if (it != m_cache.end()) {
-      // use cached value
-      const string& pathNm_real = it->second;
-      if (pathNm_real[0] == '/') { // optimization: only copy if fully resolved
-        pathNm = pathNm_real;
-      }
+    // since 'pathNm_orig' was not in map, ensure it is
+    cacheInsert(pathNm_orig, pathNm_real);
+  }
+  else {
+    // -------------------------------------------------------
+    // 3. Resolve 'pathNm' using PathFindMgr or realpath
+    // -------------------------------------------------------
+    pathNm_real = pathNm;
 
-      // since 'pathNm_orig' was not in map, ensure it is
-      m_cache.insert(make_pair(pathNm_orig, pathNm_real));
+    if (m_searchPaths.empty()) {
+      pathNm_real = RealPath(pathNm.c_str());
     }
     else {
-      // -------------------------------------------------------
-      // 3. Resolve 'pathNm' using PathFindMgr or realpath
-      // -------------------------------------------------------
-      string pathNm_real = pathNm;
+      const char* pathNm_pf;
 
-      if (m_searchPaths.empty()) {
-        pathNm_real = RealPath(pathNm.c_str());
+      if (m_pathFindMgr != NULL) {
+        pathNm_pf =
+          m_pathFindMgr->pathfind(m_searchPaths.c_str(), pathNm.c_str(), "r");
       }
       else {
-        const char* pathNm_pf;
-
-        if (m_pathFindMgr != NULL) {
-          pathNm_pf =
-            m_pathFindMgr->pathfind(m_searchPaths.c_str(), pathNm.c_str(), "r");
-        }
-        else {
-          pathNm_pf =
-            PathFindMgr::singleton().pathfind(m_searchPaths.c_str(), pathNm.c_str(), "r");
-        }
-        if (pathNm_pf) {
-          pathNm_real = pathNm_pf;
-        }
+        pathNm_pf =
+          PathFindMgr::singleton().pathfind(m_searchPaths.c_str(), pathNm.c_str(), "r");
+      }
+      if (pathNm_pf) {
+        pathNm_real = pathNm_pf;
       }
-
-      pathNm = pathNm_real;
-      m_cache.insert(make_pair(pathNm_orig, pathNm_real));
     }
+
+    pathNm = pathNm_real;
+    cacheInsert(pathNm_orig, pathNm_real);
   }
   return (pathNm[0] == '/'); // fully resolved
 }
@@ -245,10 +266,13 @@ RealPathMgr::dump(std::ostream& os, unsigned int GCC_ATTR_UNUSED flags,
                   const char* pfx) const
 {
   os << pfx << "[ RealPathMgr:" << std::endl;
-  for (MyMap::const_iterator it = m_cache.begin(); it != m_cache.end(); ++it) {
-    const string& x = it->first;
-    const string& y = it->second;
-    os << pfx << "  " << x << " => " << y << std::endl;
+  for (long i = 0; i < m_cache.size(); ++i) {
+    long real = m_cache.alias(i);
+    if (real >= 0) {
+      const string& x = m_cache.index2str(i);
+      const string& y = m_cache.index2str(real);
+      os << pfx << "  " << x << " => " << y << std::endl;
+    }
   }
   os << pfx << "]" << std::endl;
 
@@ -63,7 +63,7 @@
 //************************* System Include Files ****************************
 
 #include <string>
-#include <map>
+#include <mutex>
 #include <iostream>
 
 #include <cctype>
@@ -72,6 +72,7 @@
 
 #include "PathFindMgr.hpp"
 #include "PathReplacementMgr.hpp"
+#include "StringTable.hpp"
 
 //*************************** Forward Declarations **************************
 
@@ -102,6 +103,9 @@ public:
   // and return true.  Return true if 'fnm' is as fully resolved as it
   // can be (which does not necessarily mean it exists); otherwise
   // return false.
+  //
+  // This is safe to call from multiple threads.  Cached names are
+  // found without locking, new names are resolved under a lock.
   bool
   realpath(std::string& pathNm) const;
 
@@ -139,13 +143,20 @@ public:
 
 
 private:
-  typedef std::map<std::string, std::string> MyMap;
+  bool
+  cacheFind(const std::string& pathNm, std::string& pathNm_real) const;
+
+  void
+  cacheInsert(const std::string& pathNm, const std::string& pathNm_real) const;
 
   PathFindMgr * m_pathFindMgr;
   PathReplacementMgr * m_pathReplaceMgr;
 
   std::string m_searchPaths;
-  mutable MyMap m_cache;
+
+  // cache of path name -> realpath, as string table aliases
+  mutable HPC::StringTable m_cache;
+  mutable std::mutex m_mutex;
 };
 
 
@@ -57,84 +57,242 @@
 // 3. index2str() returns "invalid-string" if the index is out of
 // range.  We could possibly throw an exception instead.
 //
-// 4. This version manages the strings via new and delete.  We could
-// add a custom allocator to store the strings in a common area for
-// faster bulk deletion.
+// 4. The table is safe to share between threads.  The strings live
+// in an append-only arena of chunks that double in size, so an index
+// and its string never move and the table grows without a fixed cap.
+// Lookups of strings already in the table are lock-free (an
+// open-address hash table of indices).  Inserting a new string takes
+// a lock, but that happens once per distinct string.
+// When the hash table grows, the old table is kept until the string
+// table is deleted, so concurrent readers never see freed memory.
+//
+// 5. Each string has an optional alias (another index), set once.
+// This turns the table into a concurrent string -> string map, eg,
+// file name -> realpath, or mangled -> demangled name.
 
 //***************************************************************************
 
 #ifndef Support_String_Table_hpp
 #define Support_String_Table_hpp
 
-#include <map>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 namespace HPC {
 
-// compare the strings, not the pointers
-class StringCompare {
-public:
-  bool operator() (const std::string *s1, const std::string *s2) const
+class StringTable {
+private:
+  // chunk k holds (CHUNK_SIZE << k) entries
+  static const long CHUNK_SHIFT = 12;
+  static const long CHUNK_SIZE = (1L << CHUNK_SHIFT);
+  static const long MAX_CHUNKS = 40;
+  static const long INIT_HASH_SIZE = 1024;
+
+  class Entry {
+  public:
+    std::string  str;
+    size_t  hash;
+    std::atomic <long> alias;
+
+    Entry(const std::string & st, size_t hs) : str(st), hash(hs), alias(-1) {}
+  };
+
+  // open-address hash table of (index + 1), 0 is empty
+  class HashTable {
+  public:
+    long  mask;
+    std::atomic <long> * slots;
+
+    HashTable(long size) : mask(size - 1), slots(new std::atomic <long> [size])
+    {
+      for (long i = 0; i < size; i++) {
+        slots[i].store(0, std::memory_order_relaxed);
+      }
+    }
+
+    ~HashTable() { delete[] slots; }
+  };
+
+  Entry ** m_chunks[MAX_CHUNKS];
+  std::atomic <long> m_size;
+  std::atomic <HashTable *> m_hash;
+  std::vector <HashTable *> m_oldHash;
+  std::mutex   m_mutex;
+  std::string  m_invalid;
+
+  // chunk k starts at index CHUNK_SIZE * (2^k - 1)
+  static long chunkNum(long index)
   {
-    return *s1 < *s2;
+    unsigned long num = (index >> CHUNK_SHIFT) + 1;
+
+    return (8 * sizeof(unsigned long) - 1) - __builtin_clzl(num);
   }
-};
 
-class StringTable {
-  typedef std::map <const std::string *, long, StringCompare> StringMap;
-  typedef std::vector <const std::string *> StringVec;
+  static long chunkStart(long chunk)
+  {
+    return CHUNK_SIZE * ((1L << chunk) - 1);
+  }
 
-private:
-  StringMap    m_map;
-  StringVec    m_vec;
-  std::string  m_invalid;
+  Entry * entry(long index) const
+  {
+    long chunk = chunkNum(index);
+
+    return m_chunks[chunk][index - chunkStart(chunk)];
+  }
+
+  // returns: index of 'str' in hash table 'tab', else -1
+  long probe(HashTable * tab, const std::string & str, size_t hash) const
+  {
+    for (long i = hash & tab->mask;; i = (i + 1) & tab->mask) {
+      long val = tab->slots[i].load(std::memory_order_acquire);
+
+      if (val == 0) {
+        return -1;
+      }
+      Entry * ent = entry(val - 1);
+      if (ent->hash == hash && ent->str == str) {
+        return val - 1;
+      }
+    }
+  }
+
+  void insertHash(HashTable * tab, long index)
+  {
+    long i = entry(index)->hash & tab->mask;
+
+    while (tab->slots[i].load(std::memory_order_relaxed) != 0) {
+      i = (i + 1) & tab->mask;
+    }
+    tab->slots[i].store(index + 1, std::memory_order_release);
+  }
 
 public:
   StringTable()
   {
-    m_map.clear();
-    m_vec.clear();
+    for (long i = 0; i < MAX_CHUNKS; i++) {
+      m_chunks[i] = NULL;
+    }
+    m_size.store(0);
+    m_hash.store(new HashTable(INIT_HASH_SIZE));
     m_invalid = "invalid-string";
   }
 
+  StringTable(const StringTable &) = delete;
+  StringTable & operator = (const StringTable &) = delete;
+
   // delete each string individually
   ~StringTable()
   {
-    for (long i = 0; i < (long) m_vec.size(); i++) {
-      delete m_vec[i];
+    long size = m_size.load();
+
+    for (long i = 0; i < size; i++) {
+      delete entry(i);
+    }
+    for (long i = 0; i < MAX_CHUNKS && m_chunks[i] != NULL; i++) {
+      delete[] m_chunks[i];
     }
+    for (auto it = m_oldHash.begin(); it != m_oldHash.end(); ++it) {
+      delete *it;
+    }
+    delete m_hash.load();
+  }
+
+  // lookup the string in the table, returns -1 if not there
+  long find(const std::string & str) const
+  {
+    size_t hash = std::hash <std::string> () (str);
+
+    return probe(m_hash.load(std::memory_order_acquire), str, hash);
   }
 
   // lookup the string in the map and insert if not there
   long str2index(const std::string & str)
   {
-    StringMap::iterator it = m_map.find(&str);
+    size_t hash = std::hash <std::string> () (str);
+    long index = probe(m_hash.load(std::memory_order_acquire), str, hash);
 
-    if (it != m_map.end()) {
-      return it->second;
+    if (index >= 0) {
+      return index;
+    }
+
+    std::lock_guard <std::mutex> lock (m_mutex);
+
+    // recheck, another thread may have added it (or grown the table)
+    HashTable * tab = m_hash.load(std::memory_order_relaxed);
+    index = probe(tab, str, hash);
+    if (index >= 0) {
+      return index;
     }
 
     // add string to table
-    const std::string *copy = new std::string(str);
-    m_vec.push_back(copy);
-    long index = m_vec.size() - 1;
-    m_map[copy] = index;
+    index = m_size.load(std::memory_order_relaxed);
+    long chunk = chunkNum(index);
+
+    if (chunk >= MAX_CHUNKS) {
+      throw std::length_error("HPC::StringTable: too many strings");
+    }
+    if (m_chunks[chunk] == NULL) {
+      m_chunks[chunk] = new Entry * [CHUNK_SIZE << chunk];
+    }
+    m_chunks[chunk][index - chunkStart(chunk)] = new Entry(str, hash);
+    m_size.store(index + 1, std::memory_order_release);
+
+    // keep the hash table at most half full
+    if (2 * (index + 1) > tab->mask + 1) {
+      HashTable * newtab = new HashTable(2 * (tab->mask + 1));
+
+      for (long i = 0; i <= index; i++) {
+        insertHash(newtab, i);
+      }
+      m_oldHash.push_back(tab);
+      m_hash.store(newtab, std::memory_order_release);
+    }
+    else {
+      insertHash(tab, index);
+    }
 
     return index;
   }
 
-  const std::string & index2str(long index)
+  const std::string & index2str(long index) const
   {
-    if (index < 0 || index >= (long) m_vec.size()) {
+    if (index < 0 || index >= m_size.load(std::memory_order_acquire)) {
       return m_invalid;
     }
-    return *(m_vec[index]);
+    return entry(index)->str;
+  }
+
+  // returns: the alias index for 'index', or -1 if none
+  long alias(long index) const
+  {
+    if (index < 0 || index >= m_size.load(std::memory_order_acquire)) {
+      return -1;
+    }
+    return entry(index)->alias.load(std::memory_order_acquire);
+  }
+
+  // set the alias for 'index' if not already set.  returns the alias
+  // that won (the first one set).
+  long setAlias(long index, long target)
+  {
+    if (index < 0 || index >= m_size.load(std::memory_order_acquire)) {
+      return -1;
+    }
+    long expect = -1;
+    if (entry(index)->alias.compare_exchange_strong(expect, target,
+                                                    std::memory_order_acq_rel)) {
+      return target;
+    }
+    return expect;
   }
 
-  long size()
+  long size() const
   {
-    return m_vec.size();
+    return m_size.load(std::memory_order_acquire);
   }
 
 };  // class StringTable
@@ -155,6 +155,18 @@ main(int argc, char **argv, char **envp)
       p++;
       continue;
     }
+    if ( strcmp (*p, "-u") == 0 ) {
+      // also write an unwind recipe table for each load object into <dir>
+      if ((i+1) >= argc) {
+        fprintf (stderr, "FNB2: hpcfnbounds -u requires a directory argument\n" );
+        exit(1);
+      }
+      p++;
+      recipe_dir = *p;
+      i++;
+      p++;
+      continue;
+    }
     if ( strcmp (*p, "-h") == 0 ) {
       usage();
       exit(0);
@@ -279,6 +291,16 @@ get_funclist(char *name)
   //
   ret = process_mapped_header(e);
 
+  // the function list is sorted now; use it to delimit the recipe table.
+  // the table is optional, so failing to write one doesn't fail the
+  // load object: hpcrun analyzes its instructions instead.
+  if (ret == NULL && recipe_dir != NULL) {
+    char *rret = write_recipe_table(e, fd, name);
+    if (rret != NULL) {
+      fprintf(stderr, "\nFNB2: Warning, processing load-object %s: %s\n", name, rret);
+    }
+  }
+
   cleanup();
   (void) elf_end(e);
   close (fd);
@@ -828,6 +850,8 @@ usage()
       "\t-c\twrite output in C source code\n"
       "\t-t\twrite output in text format (default)\n"
       "\t\tIf no format is specified, then text mode is used.\n"
+      "\t-u <dir>\talso write an unwind recipe table for each object-file\n"
+      "\t\t    to <dir>/<basename>.hpcuw, for hpcrun --unwind-recipes\n"
       "\t-h\tprint this help message and exit\n"
       "\n"
   );
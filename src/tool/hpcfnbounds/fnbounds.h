@@ -89,6 +89,10 @@ uint64_t        dynsymread(Elf *e, GElf_Shdr sh);
 uint64_t        symtabread(Elf *e, GElf_Shdr sh);
 uint64_t  symsecread(Elf *e, GElf_Shdr sechdr, char *src);
 
+// Unwind recipe tables (recipe.c)
+char    *write_recipe_table(Elf *e, int fd, char *name);
+extern  char    *recipe_dir;
+
 // Flags governing which sources are processed
 extern  int     dynsymread_f;
 extern  int     symtabread_f;
@@ -0,0 +1,343 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+// This file contains the routines that write the unwind recipe table
+// (uw-recipe-table.h) for a load object, from its call frame information
+
+#include "fnbounds.h"
+#include "uw-recipe-table.h"
+#include <elfutils/libdw.h>
+#include <sys/stat.h>
+
+// DWARF register numbers on x86_64
+#define RC_X86_64_FP      (6)
+#define RC_X86_64_SP      (7)
+
+#define RC_INIT_ROWS      (65536)
+
+char *recipe_dir = NULL;
+
+static struct uw_recipe_table_func *rfuncs = NULL;
+static size_t nrfuncs = 0;
+static size_t maxrfuncs = 0;
+
+static struct uw_recipe_table_row *rrows = NULL;
+static size_t nrrows = 0;
+static size_t maxrrows = 0;
+
+static char rbuf[1024];
+
+// Decode a location "saved at CFA + offset" from dwarf_frame_register.
+// libdw describes it as DW_OP_call_frame_cfa, optionally followed by
+// DW_OP_consts <offset>, DW_OP_plus.
+static int
+cfa_relative(Dwarf_Op *ops, size_t nops, int64_t *offset)
+{
+  if (nops == 1 && ops[0].atom == DW_OP_call_frame_cfa) {
+    *offset = 0;
+    return 0;
+  }
+  if (nops == 3 && ops[0].atom == DW_OP_call_frame_cfa
+      && ops[1].atom == DW_OP_consts && ops[2].atom == DW_OP_plus) {
+    *offset = (int64_t)ops[1].number;
+    return 0;
+  }
+  return -1;
+}
+
+// Translate the frame state for one address range into a table row.
+// Returns -1 for any rule the table can't express (CFA from another
+// register or an expression, return address not on the stack, frame
+// pointer in a register, etc.); the function is then left out of the
+// table and hpcrun analyzes its instructions instead.
+static int
+frame_to_row(Dwarf_Frame *frame, int raReg, struct uw_recipe_table_row *row)
+{
+  Dwarf_Op opsMem[3];
+  Dwarf_Op *ops;
+  size_t nops;
+  uint64_t reg;
+  int64_t offset;
+
+  // CFA = reg + offset
+  if (dwarf_frame_cfa(frame, &ops, &nops) != 0 || nops != 1) {
+    return -1;
+  }
+  if (ops[0].atom == DW_OP_bregx) {
+    reg = ops[0].number;
+    offset = (int64_t)ops[0].number2;
+  } else if (ops[0].atom >= DW_OP_breg0 && ops[0].atom <= DW_OP_breg31) {
+    reg = ops[0].atom - DW_OP_breg0;
+    offset = (int64_t)ops[0].number;
+  } else {
+    return -1;
+  }
+  if (reg == RC_X86_64_SP) {
+    row->cfa_reg = UW_RECIPE_CFA_SP;
+  } else if (reg == RC_X86_64_FP) {
+    row->cfa_reg = UW_RECIPE_CFA_FP;
+  } else {
+    return -1;
+  }
+  if (offset < INT32_MIN || offset > INT32_MAX) {
+    return -1;
+  }
+  row->cfa_offset = (int32_t)offset;
+
+  // return address, saved at CFA + offset
+  if (dwarf_frame_register(frame, raReg, opsMem, &ops, &nops) != 0
+      || cfa_relative(ops, nops, &offset) != 0
+      || offset < INT16_MIN || offset > INT16_MAX) {
+    return -1;
+  }
+  row->ra_offset = (int16_t)offset;
+
+  // caller's frame pointer, either unchanged or saved at CFA + offset
+  if (dwarf_frame_register(frame, RC_X86_64_FP, opsMem, &ops, &nops) != 0) {
+    return -1;
+  }
+  if (nops == 0 && ops != NULL) {
+    row->fp_rule = UW_RECIPE_FP_SAME;
+    row->fp_offset = 0;
+  } else if (cfa_relative(ops, nops, &offset) == 0
+             && offset >= INT32_MIN && offset <= INT32_MAX) {
+    row->fp_rule = UW_RECIPE_FP_SAVED;
+    row->fp_offset = (int32_t)offset;
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+static int
+row_same(struct uw_recipe_table_row *a, struct uw_recipe_table_row *b)
+{
+  return (a->cfa_reg == b->cfa_reg) && (a->fp_rule == b->fp_rule)
+    && (a->ra_offset == b->ra_offset) && (a->cfa_offset == b->cfa_offset)
+    && (a->fp_offset == b->fp_offset);
+}
+
+static void
+add_row(struct uw_recipe_table_row *row)
+{
+  if (nrrows >= maxrrows) {
+    maxrrows = (maxrrows == 0 ? RC_INIT_ROWS : 2*maxrrows);
+    rrows = (struct uw_recipe_table_row *)realloc(rrows, maxrrows * sizeof(*rrows));
+    if (rrows == NULL) {
+      fprintf(stderr, "FNB2: Fatal error: unable to increase recipe row table to %ld rows; exiting", maxrrows);
+      exit(1);
+    }
+  }
+  rrows[nrrows++] = *row;
+}
+
+static void
+add_rfunc(uint64_t start, uint64_t end, size_t firstRow)
+{
+  if (nrfuncs >= maxrfuncs) {
+    maxrfuncs = (maxrfuncs == 0 ? MAX_FUNC : 2*maxrfuncs);
+    rfuncs = (struct uw_recipe_table_func *)realloc(rfuncs, maxrfuncs * sizeof(*rfuncs));
+    if (rfuncs == NULL) {
+      fprintf(stderr, "FNB2: Fatal error: unable to increase recipe function table to %ld functions; exiting", maxrfuncs);
+      exit(1);
+    }
+  }
+  rfuncs[nrfuncs].start = start;
+  rfuncs[nrfuncs].end = end;
+  rfuncs[nrfuncs].first_row = (uint32_t)firstRow;
+  rfuncs[nrfuncs].num_rows = (uint32_t)(nrrows - firstRow);
+  nrfuncs++;
+}
+
+// Walk the CFI rows from start up to limit (the next function in the
+// sorted farray).  Returns the end of the covered range, or start if the
+// function has no usable CFI.
+static uint64_t
+scan_function(Dwarf_CFI *cfi, uint64_t start, uint64_t limit)
+{
+  struct uw_recipe_table_row row, *last = NULL;
+  Dwarf_Frame *frame;
+  Dwarf_Addr rowStart, rowEnd;
+  bool signalp;
+  size_t firstRow = nrrows;
+  uint64_t addr = start;
+
+  while (addr < limit) {
+    if (dwarf_cfi_addrframe(cfi, addr, &frame) != 0) {
+      break;
+    }
+    int raReg = dwarf_frame_info(frame, &rowStart, &rowEnd, &signalp);
+    int ok = (raReg >= 0) && !signalp && (rowEnd > addr)
+      && (frame_to_row(frame, raReg, &row) == 0);
+    free(frame);
+    if (!ok) {
+      // rules we can't express: leave the whole function to hpcrun
+      nrrows = firstRow;
+      return start;
+    }
+    if (last == NULL || !row_same(last, &row)) {
+      row.offset = (uint32_t)(addr - start);
+      add_row(&row);
+      last = &rrows[nrrows - 1];
+    }
+    addr = rowEnd;
+  }
+  if (addr > limit) {
+    addr = limit;
+  }
+  if (addr == start || addr - start > UINT32_MAX) {
+    nrrows = firstRow;
+    return start;
+  }
+  add_rfunc(start, addr, firstRow);
+  return addr;
+}
+
+// Write <recipe_dir>/<basename of name>.hpcuw for the functions in the
+// (sorted) farray.  Returns NULL on success or if the load object has
+// no recipes to write, or an error message.
+char *
+write_recipe_table(Elf *e, int fd, char *name)
+{
+  struct uw_recipe_table_header hdr;
+  struct stat sb;
+  GElf_Ehdr ehdr;
+  Dwarf_CFI *cfi;
+  uint64_t i, j, limit, covered;
+  uint64_t nocfi = 0;
+  char *base, *path;
+  FILE *fp;
+
+  nrfuncs = 0;
+  nrrows = 0;
+
+  if (gelf_getehdr(e, &ehdr) == NULL || fstat(fd, &sb) != 0) {
+    sprintf(rbuf, "unwind recipe table: cannot read %s", name);
+    return rbuf;
+  }
+  // without recipes to write there is no table, and hpcrun analyzes the
+  // instructions of this load object as usual
+  if (ehdr.e_machine != EM_X86_64) {
+    if (verbose) {
+      fprintf(stderr, "FNB2: No unwind recipe table for %s: unsupported machine type %d\n",
+              name, ehdr.e_machine);
+    }
+    return NULL;
+  }
+
+  // libdw reads .eh_frame here, which is what is loaded at run time
+  cfi = dwarf_getcfi_elf(e);
+  if (cfi == NULL) {
+    if (verbose) {
+      fprintf(stderr, "FNB2: No unwind recipe table for %s: no call frame information\n", name);
+    }
+    return NULL;
+  }
+
+  covered = 0;
+  for (i = 0; i < nfunc; i = j) {
+    uint64_t start = farray[i].fadd;
+
+    // skip the aliases, and find the next function
+    for (j = i + 1; j < nfunc && farray[j].fadd == start; j++) {
+    }
+    limit = (j < nfunc ? farray[j].fadd : UINT64_MAX);
+
+    if (start < covered) {
+      continue;
+    }
+    if (scan_function(cfi, start, limit) == start) {
+      nocfi++;
+      continue;
+    }
+    covered = rfuncs[nrfuncs - 1].end;
+  }
+  dwarf_cfi_end(cfi);
+
+  if (nrrows > UINT32_MAX) {
+    sprintf(rbuf, "unwind recipe table: too many rows (%ld)", nrrows);
+    return rbuf;
+  }
+
+  base = strrchr(name, '/');
+  base = (base == NULL ? name : base + 1);
+  path = (char *)malloc(strlen(recipe_dir) + strlen(base) + strlen(UW_RECIPE_TABLE_SUFFIX) + 2);
+  sprintf(path, "%s/%s%s", recipe_dir, base, UW_RECIPE_TABLE_SUFFIX);
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, UW_RECIPE_TABLE_MAGIC, sizeof(UW_RECIPE_TABLE_MAGIC));
+  hdr.version = UW_RECIPE_TABLE_VERSION;
+  hdr.machine = ehdr.e_machine;
+  hdr.file_size = sb.st_size;
+  hdr.file_mtime = sb.st_mtime;
+  hdr.num_funcs = nrfuncs;
+  hdr.num_rows = nrrows;
+
+  fp = fopen(path, "w");
+  if (fp == NULL) {
+    sprintf(rbuf, "unwind recipe table: cannot open %s -- %s", path, strerror(errno));
+    free(path);
+    return rbuf;
+  }
+  int ok = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1)
+    && (fwrite(rfuncs, sizeof(*rfuncs), nrfuncs, fp) == nrfuncs)
+    && (fwrite(rrows, sizeof(*rrows), nrrows, fp) == nrrows);
+  if (fclose(fp) != 0) {
+    ok = 0;
+  }
+  if (!ok) {
+    sprintf(rbuf, "unwind recipe table: write to %s failed -- %s", path, strerror(errno));
+    unlink(path);
+    free(path);
+    return rbuf;
+  }
+
+  if (verbose) {
+    fprintf(stderr, "FNB2: Wrote unwind recipe table %s: %ld functions, %ld rows, %ld functions without usable CFI\n",
+        path, nrfuncs, nrrows, nocfi);
+  }
+  free(path);
+  return NULL;
+}
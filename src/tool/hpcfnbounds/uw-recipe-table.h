@@ -0,0 +1,117 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+// This file defines the layout of the unwind recipe tables written by
+// hpcfnbounds -u (recipe.c) and loaded by hpcrun
+// (hpcrun/unwind/common/uw_recipe_table.c).
+//
+// A table holds the call frame information from .eh_frame for one load
+// module, already interpreted into one row per address range, so that
+// hpcrun can mmap it and build unwind intervals without decoding any
+// instructions.  The file is a header, followed by the function array
+// (sorted by start address), followed by the row array.  Addresses are
+// link-time vmas, as in the fnbounds output.
+//
+// Like syserv-mesg.h, the layout is in native byte order and is only
+// meant to be read on the node type that wrote it.  The header records
+// the size and mtime of the load module, and hpcrun ignores a table that
+// does not match the file it is mapping.
+
+//***************************************************************************
+
+#ifndef _UW_RECIPE_TABLE_H_
+#define _UW_RECIPE_TABLE_H_
+
+#include <stdint.h>
+
+#define UW_RECIPE_TABLE_MAGIC    "HPCUWRT"
+#define UW_RECIPE_TABLE_VERSION  1
+#define UW_RECIPE_TABLE_SUFFIX   ".hpcuw"
+
+// register holding the canonical frame address (CFA)
+enum {
+  UW_RECIPE_CFA_SP = 0,
+  UW_RECIPE_CFA_FP = 1,
+};
+
+// where to find the caller's frame pointer
+enum {
+  UW_RECIPE_FP_SAME  = 0,  // unchanged
+  UW_RECIPE_FP_SAVED = 1,  // saved at CFA + fp_offset
+};
+
+struct uw_recipe_table_header {
+  char      magic[8];
+  uint32_t  version;
+  uint16_t  machine;      // ELF e_machine
+  uint16_t  reserved;
+  uint64_t  file_size;    // st_size of the load module
+  int64_t   file_mtime;   // st_mtime of the load module
+  uint64_t  num_funcs;
+  uint64_t  num_rows;
+};
+
+// one contiguous address range [start, end) that is fully covered by
+// call frame information
+struct uw_recipe_table_func {
+  uint64_t  start;
+  uint64_t  end;
+  uint32_t  first_row;
+  uint32_t  num_rows;
+};
+
+// the frame state from (func start + offset) to the next row of the
+// same function, or the end of the function
+struct uw_recipe_table_row {
+  uint32_t  offset;
+  uint8_t   cfa_reg;      // UW_RECIPE_CFA_*
+  uint8_t   fp_rule;      // UW_RECIPE_FP_*
+  int16_t   ra_offset;    // return address saved at CFA + ra_offset
+  int32_t   cfa_offset;   // CFA = cfa_reg + cfa_offset
+  int32_t   fp_offset;
+};
+
+#endif  // _UW_RECIPE_TABLE_H_
@@ -64,6 +64,7 @@
 #include "../../lib/profile/finalizers/struct.hpp"
 #include "../../lib/profile/finalizers/kernelsyms.hpp"
 #include "../../lib/profile/util/log.hpp"
+#include "../../lib/profile/util/telemetry.hpp"
 #include "../../lib/profile/mpi/all.hpp"
 
 #include <mpi.h>
@@ -283,13 +284,21 @@ int main(int argc, char* const argv[]) {
     case ProfArgs::Format::metadb:
       pipelineB2 << std::make_unique<sinks::SparseDB>(args.output);
       if(args.include_traces)
-        pipelineB2 << std::make_unique<sinks::HPCTraceDB2>(args.output);
+        pipelineB2 << std::make_unique<sinks::HPCTraceDB2>(args.output,
+          args.trace_summary_levels, args.trace_summary_depth);
       break;
     }
 
     ProfilePipeline pipeline(std::move(pipelineB2), args.threads);
     pipeline.run();
 
+    if(!args.telemetry.empty()) {
+      const auto rank = std::to_string(mpi::World::rank());
+      util::telemetry::write(args.telemetry.string() + "." + rank + ".json",
+                             args.telemetry.string() + "." + rank + ".trace.json",
+                             mpi::World::rank());
+    }
+
     if(args.valgrindUnclean) {
       mpi::World::finalize();
       std::exit(0);
@@ -48,20 +48,27 @@
 
 #include "args.hpp"
 
+#include "../../lib/profile/accumulators.hpp"
 #include "../../lib/profile/source.hpp"
 #include "../../lib/profile/sources/hpcrun4.hpp"
+#include "../../lib/profile/sources/hpcsnap.hpp"
 #include "../../lib/profile/finalizers/kernelsyms.hpp"
 #include "../../lib/profile/finalizers/struct.hpp"
 #include "../../include/hpctoolkit-version.h"
 #include "../../lib/profile/mpi/all.hpp"
+#include "../../lib/profile/util/file.hpp"
+#include "../../lib/profile/util/telemetry.hpp"
 
 #include "../../lib/prof-lean/cpuset_hwthreads.h"
 #include "../../lib/prof-lean/hpcrun-fmt.h"
 
 #include <cassert>
+#include <cerrno>
+#include <cstdlib>
 #include <getopt.h>
 #include <iostream>
 #include <iomanip>
+#include <limits>
 #include <omp.h>
 #include <random>
 #include <sstream>
@@ -107,6 +114,14 @@ Input Options:
                               Only include measurements for executables with
                               the given basename (EXE). Can be repeated to
                               include multiple executables.
+      --snapshot-series       Instead of the final profiles, process the
+                              periodic snapshots taken by `hpcrun --snapshot',
+                              with every interval between two snapshots as a
+                              separate profile. Processes without snapshots
+                              contribute their final profiles. Without this
+                              option snapshots are only used for threads that
+                              never wrote a profile of their own (e.g. killed
+                              jobs).
 
 Output Options:
   -n, --title=NAME            Specify a title for the output database.
@@ -124,6 +139,15 @@ Output Options:
                               `none' disables all global statistics.
       --no-thread-local       Disable generation of thread-local statistics.
       --no-traces             Disable generation of traces.
+      --trace-summaries[=LEVELS]
+                              Also generate multi-resolution summaries of
+                              each trace, for fast zoomed-out rendering.
+                              LEVELS is the number of power-of-two levels of
+                              detail, the finest with 2^(LEVELS-1) time
+                              buckets. Default is 11, maximum is 16.
+      --trace-summary-depth=DEPTH
+                              Summarize traces by the calling contexts at
+                              DEPTH below the root. Default is 3.
       --no-source             Disable embedded source output.
 
 Processing options:
@@ -132,6 +156,25 @@ Processing options:
                               data from. Units are K,M,G,T (powers of 1024)
                               If limit is "unlimited," always parses DWARF.
                               Default limit is 100M.
+      --io-backend=(sync|threads|io_uring)
+                              Select how database files are written.
+                              `sync' writes directly from the worker threads,
+                              `threads' hands writes to dedicated I/O threads
+                              and `io_uring' submits them in batches through
+                              Linux io_uring (using I/O threads if io_uring
+                              is unavailable). Default is `sync'.
+      --telemetry=PREFIX      Record where time and memory are spent while
+                              processing. Writes a JSON summary report to
+                              PREFIX.json and a Chrome trace-event timeline
+                              (for chrome://tracing or Perfetto) to
+                              PREFIX.trace.json. hpcprof-mpi appends the rank
+                              to PREFIX.
+      --statistics-buffer=<size>[<unit>]
+                              Limit the statistics buffered by each thread
+                              before they are applied to the shared calling
+                              contexts. Units are K,M,G (powers of 1024).
+                              0 applies every profile's statistics directly.
+                              Default is 64M.
       --ignore-structs
                               Ignore hpcstruct files in measurement directories
                               (the structs/ subdirectory). Used for testing.
@@ -164,12 +207,14 @@ const bool string_starts_with(const std::string& a, const std::string& n) {
 
 ProfArgs::ProfArgs(int argc, char* const argv[])
   : title(), threads(0), output(),
-    include_sources(true), include_traces(true), include_thread_local(true),
+    include_sources(true), include_traces(true),
+    trace_summary_levels(0), trace_summary_depth(3), include_thread_local(true),
     format(Format::metadb), dwarfMaxSize(100*1024*1024), valgrindUnclean(false) {
   int arg_includeSources = include_sources;
   int arg_includeTraces = include_traces;
   int arg_overwriteOutput = 0;
   int arg_valgrindUnclean = valgrindUnclean;
+  int arg_snapshotSeries = 0;
   int arg_foreign = 0;
   int arg_ignore_structs = 0;
   struct option longopts[] = {
@@ -178,6 +223,11 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
     {"no-thread-local", no_argument, NULL, 0},
     {"dwarf-max-size", required_argument, NULL, 0},
     {"only-exe", required_argument, NULL, 0},
+    {"trace-summaries", optional_argument, NULL, 0},
+    {"trace-summary-depth", required_argument, NULL, 0},
+    {"io-backend", required_argument, NULL, 0},
+    {"telemetry", required_argument, NULL, 0},
+    {"statistics-buffer", required_argument, NULL, 0},
     // The rest can be in any order
     {"version", no_argument, NULL, 'V'},
     {"help", no_argument, NULL, 'h'},
@@ -194,6 +244,7 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
     {"valgrind-unclean", no_argument, &arg_valgrindUnclean, 1},
     {"foreign", no_argument, &arg_foreign, 1},
     {"ignore-structs", no_argument, &arg_ignore_structs, 1},
+    {"snapshot-series", no_argument, &arg_snapshotSeries, 1},
     {0, 0, 0, 0}
   };
 
@@ -411,6 +462,72 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
         only_exes.emplace(exe.filename().generic_string());
         break;
       }
+      case 4: {  // --trace-summaries
+        trace_summary_levels = 11;
+        if(optarg != nullptr) {
+          char* end;
+          errno = 0;
+          long levels = std::strtol(optarg, &end, 10);
+          if(end == optarg || *end != '\0' || errno != 0 || levels < 1 || levels > 16) {
+            std::cerr << "Error: invalid number of levels for --trace-summaries: `"
+                      << optarg << "'\n";
+            std::exit(2);
+          }
+          trace_summary_levels = levels;
+        }
+        break;
+      }
+      case 5: {  // --trace-summary-depth
+        char* end;
+        errno = 0;
+        long depth = std::strtol(optarg, &end, 10);
+        if(end == optarg || *end != '\0' || errno != 0 || depth < 0 || depth > 255) {
+          std::cerr << "Error: invalid depth for --trace-summary-depth: `"
+                    << optarg << "'\n";
+          std::exit(2);
+        }
+        trace_summary_depth = depth;
+        break;
+      }
+      case 6: {  // --io-backend
+        std::string backend(optarg);
+        if(backend == "sync") util::File::setBackend(util::File::Backend::sync);
+        else if(backend == "threads") util::File::setBackend(util::File::Backend::threads);
+        else if(backend == "io_uring") util::File::setBackend(util::File::Backend::io_uring);
+        else {
+          std::cerr << "Error: unrecognized argument to --io-backend: `" << backend << "'\n";
+          std::exit(2);
+        }
+        break;
+      }
+      case 7:  // --telemetry
+        if(optarg[0] == '\0') {
+          std::cerr << "Error: empty prefix given to --telemetry\n";
+          std::exit(2);
+        }
+        telemetry = optarg;
+        util::telemetry::enable();
+        break;
+      case 8: {  // --statistics-buffer
+        char* end;
+        errno = 0;
+        unsigned long long limit = std::strtoull(optarg, &end, 10);
+        unsigned long long factor = 1;
+        bool bad = end == optarg || optarg[0] == '-' || errno != 0;
+        switch(end[0]) {
+        case 'k': case 'K': factor = 1024; end++; break;
+        case 'm': case 'M': factor = 1024 * 1024; end++; break;
+        case 'g': case 'G': factor = 1024 * 1024 * 1024; end++; break;
+        }
+        if(bad || *end != '\0'
+           || limit > std::numeric_limits<std::size_t>::max() / factor) {
+          std::cerr << "Error: invalid size for --statistics-buffer: `"
+                    << optarg << "'\n";
+          std::exit(2);
+        }
+        StatisticReduction::setLimit(limit * factor);
+        break;
+      }
       }
       break;
     default:
@@ -617,6 +734,7 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
 
     std::mutex sources_lock;
     const fs::path profileext = std::string(".")+HPCRUN_ProfileFnmSfx;
+    const fs::path snapshotext = std::string(".")+HPCRUN_SnapshotFnmSfx;
 
     ANNOTATE_HAPPENS_BEFORE(&start_arc);
     #pragma omp parallel num_threads(threads)
@@ -630,20 +748,29 @@ ProfArgs::ProfArgs(int argc, char* const argv[])
         auto arg = optind + pg.second;
         fs::path meas = argv[arg];
         if(!fs::is_directory(meas)) meas = "";
-        auto s = ProfileSource::create_for(pg.first, meas);
-        if(!only_exes.empty()) {
-          if(auto* r4 = dynamic_cast<hpctoolkit::sources::Hpcrun4*>(s.get()); r4 != nullptr) {
-            if(only_exes.count(r4->exe_basename()) == 0)
-              continue;
-          }
+        // A series of snapshots stands in for the final profiles of the
+        // process that took it, other processes keep their final profiles
+        if(arg_snapshotSeries && pg.first.extension() != snapshotext) {
+          auto snap = hpctoolkit::sources::hpcsnap::snapshotOf(pg.first);
+          if(!snap.empty() && fs::exists(snap)) continue;
         }
-        if(s) {
-          my_sources.emplace_back(std::move(s), std::move(pg.first));
-          my_source_args.emplace_back(std::move(arg));
-          cnts_a[pg.second].fetch_add(1, std::memory_order_relaxed);
-        } else if(pg.first.extension() == profileext) {
-          util::log::warning{} << pg.first.string() <<
-            " does not contain a valid measurement profile";
+        // Containers hold the profiles of many threads, each is its own Source
+        for(auto& p: ProfileSource::expand(pg.first, arg_snapshotSeries)) {
+          auto s = ProfileSource::create_for(p, meas);
+          if(!only_exes.empty()) {
+            if(auto* r4 = dynamic_cast<hpctoolkit::sources::Hpcrun4*>(s.get()); r4 != nullptr) {
+              if(only_exes.count(r4->exe_basename()) == 0)
+                continue;
+            }
+          }
+          if(s) {
+            my_sources.emplace_back(std::move(s), std::move(p));
+            my_source_args.emplace_back(arg);
+            cnts_a[pg.second].fetch_add(1, std::memory_order_relaxed);
+          } else if(p.extension() == profileext) {
+            util::log::warning{} << p.string() <<
+              " does not contain a valid measurement profile";
+          }
         }
       }
       {
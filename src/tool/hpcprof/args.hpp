@@ -154,6 +154,12 @@ public:
   /// Whether to include trace data in the output database
   bool include_traces;
 
+  /// Number of levels of detail in the trace summaries, 0 to disable
+  unsigned int trace_summary_levels;
+
+  /// Depth in the calling context tree to summarize traces at
+  unsigned int trace_summary_depth;
+
   /// Whether to include thread-local data in the output database
   bool include_thread_local;
 
@@ -171,6 +177,9 @@ public:
   /// Whether to enable "Valgrind-unclean" mode, which disables some deallocations.
   bool valgrindUnclean;
 
+  /// Path prefix for the telemetry report and timeline, empty if disabled.
+  stdshim::filesystem::path telemetry;
+
 private:
   bool foreign;
   std::once_flag onceMissingGPUCFGs;
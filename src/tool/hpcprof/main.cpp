@@ -57,6 +57,7 @@
 #include "../../lib/profile/finalizers/denseids.hpp"
 #include "../../lib/profile/finalizers/directclassification.hpp"
 #include "../../lib/profile/finalizers/logical.hpp"
+#include "../../lib/profile/util/telemetry.hpp"
 
 #include <memory>
 #include <iostream>
@@ -102,7 +103,8 @@ int main(int argc, char* const argv[]) {
               << std::make_unique<sinks::SparseDB>(args.output)
               << std::make_unique<sinks::MetricsYAML>(args.output);
     if(args.include_traces)
-      pipelineB << std::make_unique<sinks::HPCTraceDB2>(args.output);
+      pipelineB << std::make_unique<sinks::HPCTraceDB2>(args.output,
+          args.trace_summary_levels, args.trace_summary_depth);
     break;
   }
   }
@@ -113,6 +115,11 @@ int main(int argc, char* const argv[]) {
   // Drain the Pipeline, and make everything happen.
   pipeline.run();
 
+  if(!args.telemetry.empty()) {
+    util::telemetry::write(args.telemetry.string() + ".json",
+                           args.telemetry.string() + ".trace.json");
+  }
+
   if(args.valgrindUnclean) std::exit(0);  // Skips local cleanup of pipeline
 
   return 0;
@@ -66,6 +66,8 @@ using std::endl;
 #include <string>
 using std::string;
 
+#include <cctype>
+
 //*************************** User Include Files ****************************
 
 #include "../../include/gcc-attr.h"
@@ -104,7 +106,21 @@ static const char* usage_details =
                  "  -V, --version        Print version information.\n"
                  "  -h, --help           Print this help.\n"
                  "  -l, --lm             Print the load modules only.\n"
-     "  -g, --grep           Show the sparse metrics in a format that is easy to grep.\n";
+     "  -g, --grep           Show the sparse metrics in a format that is easy to grep.\n"
+     "  -j <n>, --jobs <n>   Decode up to <n> profiles concurrently.  Output is\n"
+     "                       still written in the order the profiles are given.\n"
+     "  -M <metric>, --metric <metric>\n"
+     "                       Show only sparse metric values of <metric>, given as\n"
+     "                       a metric name or id.  May be repeated.\n"
+     "  --min-value <v>      Show only sparse metric values whose magnitude is\n"
+     "                       at least <v>.\n"
+     "  --id-tuple <kind>[:<id>][,<kind>[:<id>]]*\n"
+     "                       Dump only profiles whose id tuple contains every\n"
+     "                       listed kind (e.g. RANK, THREAD, GPUSTREAM) with the\n"
+     "                       given logical id.  Other profiles are skipped\n"
+     "                       without being decoded.\n"
+     "\n"
+     "The --metric, --min-value and --id-tuple filters apply to hpcrun profiles.\n";
 
 #define CLP CmdLineParser
 #define CLP_SEPARATOR "!!!"
@@ -120,6 +136,14 @@ CmdLineParser::OptArgDesc Args::optArgs[] = {
      NULL },
   { 'l', "lm",              CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
+  { 'j', "jobs",            CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  { 'M', "metric",          CLP::ARG_REQ,  CLP::DUPOPT_CAT,  CLP_SEPARATOR,
+     NULL },
+  {  0 , "min-value",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "id-tuple",        CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   CmdLineParser_OptArgDesc_NULL_MACRO // SGI's compiler requires this version
 };
 
@@ -233,6 +257,28 @@ Args::parse(int argc, const char* const argv[])
       Analysis::Util::option = Analysis::Util::OutputOption_t::Print_LoadModule_Only;
     }
 
+    if (parser.isOpt("jobs")) {
+      const string& arg = parser.getOptArg("jobs");
+      long n = CmdLineParser::toLong(arg);
+      if (n < 1) {
+        ARG_ERROR("--jobs must be at least 1");
+      }
+      jobs = (unsigned int)n;
+    }
+    if (parser.isOpt("metric")) {
+      const string& arg = parser.getOptArg("metric");
+      StrUtil::tokenize_str(arg, CLP_SEPARATOR, filter.metrics);
+    }
+    if (parser.isOpt("min-value")) {
+      const string& arg = parser.getOptArg("min-value");
+      filter.hasMinValue = true;
+      filter.minValue = CmdLineParser::toDbl(arg);
+    }
+    if (parser.isOpt("id-tuple")) {
+      const string& arg = parser.getOptArg("id-tuple");
+      parseArg_idTuple(arg, filter.idTuple);
+    }
+
     // FIXME: sanity check that options correspond to mode
 
     // Check for required arguments
@@ -259,6 +305,49 @@ Args::parse(int argc, const char* const argv[])
 }
 
 
+// parseArg_idTuple: parses "<kind>[:<id>][,<kind>[:<id>]]*", where
+// <kind> is an id tuple kind name (e.g. RANK) or number.  A missing
+// <id> matches any logical id.
+void
+Args::parseArg_idTuple(const std::string& opts,
+                       std::vector<std::pair<uint16_t, uint64_t>>& idTuple)
+{
+  static const char* kindNames[IDTUPLE_MAXTYPES] = {
+    "SUMMARY", "NODE", "RANK", "THREAD", "GPUDEVICE", "GPUCONTEXT",
+    "GPUSTREAM", "CORE", "SNAPSHOT"
+  };
+
+  std::vector<string> elems;
+  StrUtil::tokenize_char(opts, ",", elems);
+  for (const string& elem : elems) {
+    size_t colon = elem.find(':');
+    string kindNm = elem.substr(0, colon);
+    for (char& c : kindNm) {
+      c = toupper(c);
+    }
+
+    uint16_t kind = IDTUPLE_MAXTYPES;
+    for (uint16_t k = 0; k < IDTUPLE_MAXTYPES; ++k) {
+      if (kindNm == kindNames[k]) {
+        kind = k;
+      }
+    }
+    if (kind == IDTUPLE_MAXTYPES) {
+      if (kindNm.empty() || !isdigit(kindNm[0])) {
+        ARG_Throw("--id-tuple: unknown kind '" << kindNm << "'");
+      }
+      kind = (uint16_t)CmdLineParser::toLong(kindNm);
+    }
+
+    uint64_t id = UINT64_MAX;
+    if (colon != string::npos) {
+      id = CmdLineParser::toUInt64(elem.substr(colon + 1));
+    }
+    idTuple.push_back(std::make_pair(kind, id));
+  }
+}
+
+
 // Cf. lib/analysis/ArgsHPCProf::parseArg_metric()
 void
 Args::parseArg_metric(Args* args, const string& value, const char* errTag)
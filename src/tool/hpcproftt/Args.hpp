@@ -70,6 +70,7 @@
 
 
 #include "../../lib/analysis/Args.hpp"
+#include "../../lib/prof/CallPath-Profile.hpp"
 
 #include "../../lib/support/diagnostics.h"
 #include "../../lib/support/CmdLineParser.hpp"
@@ -128,6 +129,10 @@ public:
   static void
   parseArg_metric(Args* args, const std::string& opts, const char* errTag);
 
+  static void
+  parseArg_idTuple(const std::string& opts,
+                   std::vector<std::pair<uint16_t, uint64_t>>& idTuple);
+
 public:
 
   // Object Correlation args
@@ -142,6 +147,12 @@ public:
   // Sparse metrics data format version - YUMENG
   bool sm_easyToGrep = false; //default
 
+  // Number of profiles decoded concurrently (output order is kept)
+  unsigned int jobs = 1;
+
+  // Restricts the sparse metric rows that are printed
+  Prof::CallPath::Profile::TextFilter filter;
+
 private:
   void Ctor();
   void setHPCHome();
@@ -49,11 +49,19 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
 
 #include <string>
 using std::string;
 
 #include <exception>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <cstdio>
+#include <cstdlib>
 
 //*********************** Xerces Include Files *******************************
 
@@ -76,6 +84,9 @@ realmain(int argc, char* const* argv);
 static int
 main_rawData(const std::vector<string>& profileFiles, bool sm_easyToGrep);
 
+static int
+main_rawData_parallel(const Args& args);
+
 
 //****************************************************************************
 
@@ -112,7 +123,10 @@ static int
 realmain(int argc, char* const* argv)
 {
   Args args(argc, argv);  // exits if error on command line
-  return main_rawData(args.profileFiles, args.sm_easyToGrep);
+  if (args.jobs <= 1 && args.filter.empty()) {
+    return main_rawData(args.profileFiles, args.sm_easyToGrep);
+  }
+  return main_rawData_parallel(args);
 }
 
 
@@ -140,4 +154,198 @@ main_rawData(const std::vector<string>& profileFiles, bool sm_easyToGrep)
   return 0;
 }
 
+
+//****************************************************************************
+// Parallel dump
+//
+// hpcrun profiles are decoded by a pool of 'args.jobs' threads, each
+// rendering one profile into its own memory buffer; the main thread
+// writes the buffers out in command-line order.  At most 'window'
+// profiles may be rendered ahead of the one being written, which
+// bounds the memory held in buffers.  Other file types print directly
+// to std::cout and are dumped by the main thread when their turn comes.
+//****************************************************************************
+
+namespace {
+
+struct DumpSlot {
+  bool ready = false;
+  bool direct = false;        // dumped by the main thread
+  string text;
+  std::exception_ptr error;
+};
+
+class ParallelDump {
+public:
+  ParallelDump(const Args& args)
+    : m_args(args), m_slots(args.profileFiles.size()),
+      m_window(4 * args.jobs), m_next(0), m_written(0)
+  { }
+
+  int
+  run();
+
+private:
+  void
+  worker();
+
+  void
+  render(size_t i, DumpSlot& slot);
+
+  const Args& m_args;
+  std::vector<DumpSlot> m_slots;
+  const size_t m_window;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  size_t m_next;     // next profile to claim
+  size_t m_written;  // profiles written so far
+};
+
+
+static void
+writeHeader(std::ostream& os, const char* fnm)
+{
+  if (Analysis::Util::option == Analysis::Util::Print_All)  {
+    os << std::setfill('=') << std::setw(77) << "=" << std::endl;
+    os << fnm << std::endl;
+    os << std::setfill('=') << std::setw(77) << "=" << std::endl;
+  }
+}
+
+
+void
+ParallelDump::render(size_t i, DumpSlot& slot)
+{
+  const char* fnm = m_args.profileFiles[i].c_str();
+
+  if (Analysis::Util::getProfileType(fnm) != Analysis::Util::ProfType_Callpath) {
+    slot.direct = true;
+    return;
+  }
+
+  char* buf = NULL;
+  size_t bufSz = 0;
+  FILE* outfs = open_memstream(&buf, &bufSz);
+  if (!outfs) {
+    DIAG_Throw("failed to allocate output buffer for '" << fnm << "'");
+  }
+
+  bool shown = false;
+  try {
+    shown = Analysis::Raw::writeAsText_callpath(fnm, outfs, m_args.sm_easyToGrep,
+                                                &m_args.filter);
+  }
+  catch (...) {
+    fclose(outfs);
+    free(buf);
+    throw;
+  }
+  fclose(outfs);
+
+  if (shown) {
+    std::ostringstream hdr;
+    writeHeader(hdr, fnm);
+    slot.text = hdr.str();
+    slot.text.append(buf, bufSz);
+  }
+  free(buf);
+}
+
+
+void
+ParallelDump::worker()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while (true) {
+    m_cv.wait(lock, [&]{
+      return m_next >= m_slots.size() || m_next < m_written + m_window;
+    });
+    if (m_next >= m_slots.size()) {
+      return;
+    }
+    size_t i = m_next++;
+    lock.unlock();
+
+    DumpSlot slot;
+    try {
+      render(i, slot);
+    }
+    catch (...) {
+      slot.error = std::current_exception();
+    }
+
+    lock.lock();
+    slot.ready = true;
+    m_slots[i] = std::move(slot);
+    m_cv.notify_all();
+  }
+}
+
+
+int
+ParallelDump::run()
+{
+  std::vector<std::thread> pool;
+  for (unsigned int t = 0; t < m_args.jobs; ++t) {
+    pool.emplace_back(&ParallelDump::worker, this);
+  }
+
+  // if an exception escapes below, no worker may be left blocked
+  struct Joiner {
+    ParallelDump& d;
+    std::vector<std::thread>& pool;
+    ~Joiner() {
+      {
+        std::lock_guard<std::mutex> lock(d.m_mutex);
+        d.m_next = d.m_slots.size();
+      }
+      d.m_cv.notify_all();
+      for (auto& t : pool) t.join();
+    }
+  } joiner{*this, pool};
+
+  for (size_t i = 0; i < m_slots.size(); ++i) {
+    DumpSlot slot;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [&]{ return m_slots[i].ready; });
+      slot = std::move(m_slots[i]);
+    }
+
+    if (slot.error) {
+      std::rethrow_exception(slot.error);
+    }
+
+    const char* fnm = m_args.profileFiles[i].c_str();
+    if (slot.direct) {
+      writeHeader(std::cout, fnm);
+      Analysis::Raw::writeAsText(fnm, m_args.sm_easyToGrep);
+      std::cout.flush();
+    }
+    else {
+      fwrite(slot.text.data(), 1, slot.text.size(), stdout);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_written = i + 1;
+    }
+    m_cv.notify_all();
+  }
+  fflush(stdout);
+
+  return 0;
+}
+
+} // namespace
+
+
+static int
+main_rawData_parallel(const Args& args)
+{
+  ParallelDump dump(args);
+  return dump.run();
+}
+
 //****************************************************************************
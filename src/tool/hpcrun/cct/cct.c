@@ -70,6 +70,7 @@
 #define _GNU_SOURCE
 
 #include <assert.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -121,6 +122,17 @@ struct cct_node_t {
   // If false, we don't write it out in hpcrun file
   bool display;
 
+  // ---------------------------------------------------------
+  // periodic snapshots (see snapshot.c)
+  // ---------------------------------------------------------
+
+  // last snapshot generation in which the owning thread touched this
+  // node, 0 if never
+  uint32_t snapshot_gen;
+
+  // only accessed by the snapshot thread
+  bool snapshot_written;
+
   // ---------------------------------------------------------
   // tree structure
   // ---------------------------------------------------------
@@ -156,6 +168,20 @@ new_persistent_id()
   return atomic_fetch_add_explicit(&global_persistent_id, 2, memory_order_relaxed);
 }
 
+// bumped whenever a node may be unlinked, moved or recycled, or a new
+// tree is created (whose root may reuse the memory of an old one).
+// a thread's trees are only changed by that thread (and the nodes it
+// frees are only recycled into its own trees), so a per-thread count
+// is enough and changes in other threads' trees don't invalidate the
+// paths cached for this one.
+static __thread unsigned long cct_generation = 0;
+
+static void
+cct_unlinked(void)
+{
+  cct_generation++;
+}
+
 static cct_node_t*
 cct_node_create(cct_addr_t* addr, bool unwound, cct_node_t* parent)
 {
@@ -180,6 +206,8 @@ cct_node_create(cct_addr_t* addr, bool unwound, cct_node_t* parent)
 
   node->persistent_id = new_persistent_id();
 
+  if (parent == NULL) cct_unlinked();
+
   node->parent = parent;
   node->children = NULL;
   node->left = NULL;
@@ -494,6 +522,12 @@ hpcrun_cct_top_new(uint16_t lmid, uintptr_t lmip)
 //
 // ********** Accessor functions
 //
+unsigned long
+hpcrun_cct_generation(void)
+{
+  return cct_generation;
+}
+
 cct_node_t*
 hpcrun_cct_parent(cct_node_t* x)
 {
@@ -687,6 +721,8 @@ hpcrun_cct_delete_addr(cct_node_t* node, cct_addr_t* frm)
 {
   if(!node) return NULL;
 
+  cct_unlinked();
+
   cct_node_t* found = splay(node->children, frm);
 
   node->children = found;
@@ -753,6 +789,7 @@ hpcrun_cct_terminate_path(cct_node_t* node)
 cct_node_t*
 hpcrun_cct_insert_node(cct_node_t* target, cct_node_t* src)
 {
+  cct_unlinked();
   src->parent = target;
 
   cct_node_t* found = splay(target->children, &(src->addr));
@@ -795,6 +832,24 @@ hpcrun_cct_retained(cct_node_t* x)
   return (x->persistent_id & HPCRUN_FMT_RetainIdFlag);
 }
 
+
+bool
+hpcrun_cct_snapshot_touch(cct_node_t* x, uint32_t gen)
+{
+  if (x->snapshot_gen == gen) return false;
+  x->snapshot_gen = gen;
+  return true;
+}
+
+
+bool
+hpcrun_cct_snapshot_mark_written(cct_node_t* x)
+{
+  if (x->snapshot_written) return false;
+  x->snapshot_written = true;
+  return true;
+}
+
 //
 // Walking functions section:
 //
@@ -1145,6 +1200,7 @@ void
 hpcrun_cct_merge(cct_node_t* cct_a, cct_node_t* cct_b,
                  merge_op_t merge, merge_op_arg_t arg)
 {
+  cct_unlinked();
   if (hpcrun_cct_is_leaf (cct_a) && hpcrun_cct_is_leaf(cct_b)) {
     // nothing to clean, because cct_b is leaf
     merge(cct_a, cct_b, arg);
@@ -1254,6 +1310,7 @@ cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src)
 // FIXME: only temporary function, until hpcrun_merge is repaired
 void
 cct_remove_my_subtree(cct_node_t* cct){
+  cct_unlinked();
   cct->children = NULL;
 //  printf("CHILDREN: %p\tLEFT: %p\tRIGHT: %p\n", cct->children, cct->left, cct->right);
 }
@@ -1308,6 +1365,7 @@ hpcrun_cct_node_alloc(){
 
 void
 hpcrun_cct_node_free(cct_node_t *cct){
+  cct_unlinked();
   add_node_to_freelist(cct);
 }
 
@@ -1327,6 +1385,7 @@ hpcrun_cct_set_children(cct_node_t* cct, cct_node_t* children)
 {
   if(!cct)
     return;
+  cct_unlinked();
   cct->children = children;
 }
 
@@ -1335,5 +1394,6 @@ hpcrun_cct_set_parent(cct_node_t* cct, cct_node_t* parent)
 {
   if(!cct)
     return;
+  cct_unlinked();
   cct->parent = parent;
 }
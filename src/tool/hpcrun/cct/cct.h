@@ -131,6 +131,14 @@ extern cct_node_t* hpcrun_cct_new(void);
 extern cct_node_t* hpcrun_cct_new_partial(void);
 extern cct_node_t* hpcrun_cct_new_special(void* addr);
 extern cct_node_t* hpcrun_cct_top_new(uint16_t lmid, uintptr_t lmip);
+
+//
+// Changes whenever a node of this thread's trees may have been
+// unlinked, moved or recycled, so a path of nodes cached from an
+// earlier insertion is stale.
+//
+extern unsigned long hpcrun_cct_generation(void);
+
 //
 // Accessor functions
 //
@@ -200,6 +208,14 @@ extern void hpcrun_cct_retain(cct_node_t* x);
 // call path.
 extern int hpcrun_cct_retained(cct_node_t* x);
 
+// periodic snapshots: record that the owning thread touched a node in
+// snapshot generation gen. returns true the first time per generation.
+extern bool hpcrun_cct_snapshot_touch(cct_node_t* x, uint32_t gen);
+
+// periodic snapshots: mark a node as written by the snapshot thread.
+// returns true if it had not been written before.
+extern bool hpcrun_cct_snapshot_mark_written(cct_node_t* x);
+
 
 // Walking functions section:
 //
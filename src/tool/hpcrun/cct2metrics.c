@@ -12,6 +12,7 @@
 #include "metrics.h"
 #include "cct/cct.h"
 #include "cct2metrics.h"
+#include "snapshot.h"
 #include "thread_data.h"
 #include "../../lib/prof-lean/splay-macros.h"
 
@@ -117,16 +118,18 @@ metric_data_list_t*
 hpcrun_reify_metric_set(cct_node_id_t cct_id, int metric_id)
 {
   TMSG(CCT2METRICS, "REIFY: %p", cct_id);
-  metric_data_list_t* rv = hpcrun_get_metric_data_list(cct_id);
-  if (rv == NULL) {
+  metric_data_list_t* head = hpcrun_get_metric_data_list(cct_id);
+  metric_data_list_t* rv;
+  if (head == NULL) {
     // First time initialize
     TMSG(CCT2METRICS, " -- Metric kind was null, allocating new metric kind");
-    rv = hpcrun_new_metric_data_list(metric_id);
+    rv = head = hpcrun_new_metric_data_list(metric_id);
     cct2metrics_assoc(cct_id, rv);
   } else {
-    rv = hpcrun_reify_metric_data_list_kind(rv, metric_id);
+    rv = hpcrun_reify_metric_data_list_kind(head, metric_id);
     TMSG(CCT2METRICS, " -- Metric kind found = %p", rv);
   }
+  hpcrun_snapshot_touch(cct_id, head);
   return rv;
 }
 
@@ -66,3 +66,12 @@ cct_cursor_finalize(
   if (cursor_finalize) return cursor_finalize(cct, bt, cursor);
   else return cursor;
 }
+
+
+bool
+cct_cursor_finalize_active(
+  void
+)
+{
+  return cursor_finalize != NULL;
+}
@@ -59,4 +59,10 @@ extern cct_node_t *cct_cursor_finalize(
   cct_node_t *cursor
 );
 
+
+// true if a cursor finalizer is registered
+extern bool cct_cursor_finalize_active(
+  void
+);
+
 #endif
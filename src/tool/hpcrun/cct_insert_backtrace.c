@@ -58,6 +58,7 @@
 
 #include "../../lib/prof-lean/lush/lush-support.h"
 #include "../../lib/prof-lean/placeholders.h"
+#include "memory/hpcrun-malloc.h"
 #include "lush/lush-backtrace.h"
 #include "thread_data.h"
 #include "hpcrun_stats.h"
@@ -72,6 +73,7 @@
 
 #include "cct_insert_backtrace.h"
 #include "cct_backtrace_finalize.h"
+#include "sample_ring.h"
 #include "lush/lush-backtrace.h"
 #include "unwind/common/backtrace.h"
 #include "thread_data.h"
@@ -89,10 +91,135 @@ extern bool hpcrun_inbounds_main(void* addr);
 //
 static bool retain_recursion = false;
 
+//
+// local variable records the on/off state of reusing the
+// previous sample's path of cct nodes:
+//
+static bool reuse_paths = true;
+
+//
+// local variable records whether every reused path is checked against
+// the path looked up from the root:
+//
+static bool verify_paths = false;
+
 
 static hpcrun_kernel_callpath_t hpcrun_kernel_callpath;
 
 
+//
+// The path of cct nodes inserted for the previous backtrace of this
+// thread, outermost frame first.  Consecutive samples usually share
+// all but their innermost frames, so the nodes of the frames they
+// share are taken from here rather than looked up again from the
+// root.  A frame is shared if it has the same ip and enclosing
+// function and, as a check that it is the same activation, the same
+// return address location.  The recursion compression of a frame
+// also depends on the next inner frame, so the node of the innermost
+// shared frame is reused only when the two backtraces are identical.
+//
+
+#define PATH_CACHE_DEPTH 256
+
+typedef struct path_cache_frame_t {
+  ip_normalized_t ip_norm;
+  ip_normalized_t the_function;
+  void* ra_loc;
+  cct_node_t* node;   // node after inserting this frame
+} path_cache_frame_t;
+
+typedef struct path_cache_t {
+  cct_node_t* root;
+  unsigned long generation;
+  bool retain_recursion;
+  long len;           // frames in the path, of which at most
+                      // PATH_CACHE_DEPTH are cached
+  path_cache_frame_t frames[PATH_CACHE_DEPTH];
+} path_cache_t;
+
+static __thread path_cache_t* path_cache = NULL;
+
+
+static path_cache_t*
+path_cache_begin(cct_node_t* root)
+{
+  if (!reuse_paths || hpcrun_isLogicalUnwind()) return NULL;
+
+  if (path_cache == NULL) {
+    path_cache = hpcrun_malloc(sizeof(path_cache_t));
+    if (path_cache == NULL) return NULL;
+    path_cache->root = NULL;
+  }
+
+  unsigned long generation = hpcrun_cct_generation();
+  if (path_cache->root != root || path_cache->generation != generation
+      || path_cache->retain_recursion != retain_recursion) {
+    path_cache->root = root;
+    path_cache->generation = generation;
+    path_cache->retain_recursion = retain_recursion;
+    path_cache->len = 0;
+  }
+  return path_cache;
+}
+
+
+static inline bool
+path_cache_match(path_cache_t* cache, long i, ip_normalized_t* ip_norm,
+                 ip_normalized_t* the_function, void* ra_loc)
+{
+  path_cache_frame_t* f = &cache->frames[i];
+  return i < cache->len
+    && f->ra_loc == ra_loc
+    && ip_normalized_eq(&f->ip_norm, ip_norm)
+    && ip_normalized_eq(&f->the_function, the_function);
+}
+
+
+// number of outermost frames whose nodes may be reused, given the
+// number that match the cache and the length of the new path
+static long
+path_cache_reusable(path_cache_t* cache, long matched, long len)
+{
+  if (matched == len && matched == cache->len) return len;
+  return matched > 0 ? matched - 1 : 0;
+}
+
+
+static inline void
+path_cache_store(path_cache_t* cache, long i, ip_normalized_t* ip_norm,
+                 ip_normalized_t* the_function, void* ra_loc, cct_node_t* node)
+{
+  if (i >= PATH_CACHE_DEPTH) return;
+  path_cache_frame_t* f = &cache->frames[i];
+  f->ip_norm = *ip_norm;
+  f->the_function = *the_function;
+  f->ra_loc = ra_loc;
+  f->node = node;
+}
+
+
+static void
+path_cache_end(path_cache_t* cache, long len)
+{
+  // the full length, so a longer path is never taken as identical
+  cache->len = len;
+}
+
+
+// check the node a path was inserted into, reusing the cached nodes,
+// against the node found by inserting the path from the root
+static void
+path_cache_verify(cct_node_t* reused, cct_node_t* looked_up)
+{
+  hpcrun_stats_cct_path_verified_inc(1);
+  if (reused != looked_up) {
+    hpcrun_stats_cct_path_mismatch_inc(1);
+    EMSG("CCT path reuse inserted into node %p, the root has the path at %p",
+         reused, looked_up);
+  }
+}
+
+
 void
 hpcrun_kernel_callpath_register(hpcrun_kernel_callpath_t kcp)
 {
@@ -101,7 +228,7 @@ hpcrun_kernel_callpath_register(hpcrun_kernel_callpath_t kcp)
 
 static cct_node_t*
 cct_insert_raw_backtrace(cct_node_t* cct,
-                            frame_t* path_beg, frame_t* path_end)
+                            frame_t* path_beg, frame_t* path_end, bool reuse)
 {
   TMSG(BT_INSERT, "%s : start", __func__);
   if (!cct) return NULL; // nowhere to insert
@@ -109,7 +236,30 @@ cct_insert_raw_backtrace(cct_node_t* cct,
   // FIXME: POGLEDAJ KOLIKO ON PUTA KROZ OVO PRODJE
 
   ip_normalized_t parent_routine = {0, 0};
-  for(; path_beg >= path_end; path_beg--){
+  long len = path_beg - path_end + 1;
+  long depth = 0;
+  cct_node_t* root = cct;
+  frame_t* full_beg = path_beg;
+
+  path_cache_t* cache = reuse ? path_cache_begin(cct) : NULL;
+  if (cache) {
+    long matched = 0;
+    while (matched < len && matched < PATH_CACHE_DEPTH &&
+           path_cache_match(cache, matched, &(path_beg - matched)->ip_norm,
+                            &(path_beg - matched)->the_function,
+                            (path_beg - matched)->ra_loc)) {
+      matched++;
+    }
+    depth = path_cache_reusable(cache, matched, len);
+    if (depth > 0) {
+      cct = cache->frames[depth - 1].node;
+      parent_routine = (path_beg - (depth - 1))->the_function;
+      path_beg -= depth;
+      TMSG(BT_INSERT, "reusing %ld of %ld frames", depth, len);
+    }
+  }
+
+  for(long i = depth; path_beg >= path_end; path_beg--, i++){
     if ( (! retain_recursion) &&
          (path_beg >= path_end + 1) &&
          ip_normalized_eq(&(path_beg->the_function), &(parent_routine)) &&
@@ -125,13 +275,118 @@ cct_insert_raw_backtrace(cct_node_t* cct,
       cct = hpcrun_cct_insert_addr(cct, &tmp, true);
     }
     parent_routine = path_beg->the_function;
+    if (cache) {
+      path_cache_store(cache, i, &path_beg->ip_norm, &path_beg->the_function,
+                       path_beg->ra_loc, cct);
+    }
   }
+  if (!reuse) return cct;
+
+  if (cache) path_cache_end(cache, len);
+  hpcrun_stats_cct_path_frames_add(len, depth);
   hpcrun_cct_terminate_path(cct);
+  if (verify_paths && depth > 0) {
+    path_cache_verify(cct, cct_insert_raw_backtrace(root, full_beg, path_end, false));
+  }
   // FIXME: vi3 consider this function
   return cct;
 }
 
 
+// as cct_insert_raw_backtrace, for the frames of a staged sample,
+// which are stored outermost first
+static cct_node_t*
+cct_insert_staged_path(cct_node_t* cct,
+                       sample_ring_frame_t* path, size_t len, bool reuse)
+{
+  if (!cct) return NULL; // nowhere to insert
+
+  ip_normalized_t parent_routine = {0, 0};
+  size_t depth = 0;
+  cct_node_t* root = cct;
+
+  path_cache_t* cache = reuse ? path_cache_begin(cct) : NULL;
+  if (cache) {
+    long matched = 0;
+    while (matched < (long) len && matched < PATH_CACHE_DEPTH &&
+           path_cache_match(cache, matched, &path[matched].ip_norm,
+                            &path[matched].the_function, path[matched].ra_loc)) {
+      matched++;
+    }
+    depth = path_cache_reusable(cache, matched, len);
+    if (depth > 0) {
+      cct = cache->frames[depth - 1].node;
+      parent_routine = path[depth - 1].the_function;
+    }
+  }
+
+  for (size_t i = depth; i < len; i++) {
+    if ( (! retain_recursion) &&
+         (i + 1 < len) &&
+         ip_normalized_eq(&(path[i].the_function), &(parent_routine)) &&
+         ip_normalized_eq(&(path[i].the_function), &(path[i + 1].the_function))) {
+      TMSG(REC_COMPRESS, "recursive routine compression!");
+    }
+    else {
+      cct_addr_t tmp =
+        (cct_addr_t) {.as_info = path[i].as_info,
+                      .ip_norm = path[i].ip_norm,
+                      .lip = path[i].lip};
+      cct = hpcrun_cct_insert_addr(cct, &tmp, true);
+    }
+    parent_routine = path[i].the_function;
+    if (cache) {
+      path_cache_store(cache, i, &path[i].ip_norm, &path[i].the_function,
+                       path[i].ra_loc, cct);
+    }
+  }
+  if (!reuse) return cct;
+
+  if (cache) path_cache_end(cache, len);
+  hpcrun_stats_cct_path_frames_add(len, depth);
+  hpcrun_cct_terminate_path(cct);
+  if (verify_paths && depth > 0) {
+    path_cache_verify(cct, cct_insert_staged_path(root, path, len, false));
+  }
+  return cct;
+}
+
+
+// N.B. If 'frm' is a 1-to-1 bichord and 'path' is not (i.e., 'path'
+// is M-to-1 or 1-to-M), then update the association of 'path' to
+// reflect that 'path' is now a proxy for two bichord types (1-to-1
+// and M-to-1 or 1-to-M)
+static void
+cct_correct_assoc(cct_node_t* path, lush_assoc_info_t as_info)
+{
+  cct_addr_t* addr = hpcrun_cct_addr(path);
+
+  lush_assoc_t as_frm = lush_assoc_info__get_assoc(as_info);
+  lush_assoc_t as_path = lush_assoc_info__get_assoc(addr->as_info);
+
+  if (as_frm == LUSH_ASSOC_1_to_1 && as_path != LUSH_ASSOC_1_to_1) {
+    // INVARIANT: path->as_info should be either M-to-1 or 1-to-M
+    lush_assoc_info__set_assoc(hpcrun_cct_addr(path)->as_info, LUSH_ASSOC_1_to_1);
+  }
+}
+
+
+static cct_node_t*
+cct_apply_metric(cct_node_t* path, int metric_id, cct_metric_data_t datum)
+{
+  metric_data_list_t* mset = hpcrun_reify_metric_set(path, metric_id);
+
+  metric_upd_proc_t* upd_proc = hpcrun_get_metric_proc(metric_id);
+  if (upd_proc) {
+    upd_proc(metric_id, mset, datum);
+  }
+
+  // POST-INVARIANT: metric set has been allocated for 'path'
+
+  return path;
+}
+
+
 static cct_node_t*
 help_hpcrun_backtrace2cct(cct_bundle_t* cct, ucontext_t* context,
         int metricId, hpcrun_metricVal_t metricIncr,
@@ -152,6 +407,20 @@ hpcrun_get_retain_recursion_mode()
   return retain_recursion;
 }
 
+void
+hpcrun_set_path_reuse_mode(bool mode)
+{
+  TMSG(BT_INSERT, "reuse of cct paths set to %s", mode ? "true" : "false");
+  reuse_paths = mode;
+}
+
+void
+hpcrun_set_path_reuse_verify(bool mode)
+{
+  TMSG(BT_INSERT, "verification of reused cct paths set to %s", mode ? "true" : "false");
+  verify_paths = mode;
+}
+
 // See usage in header.
 cct_node_t*
 hpcrun_cct_insert_backtrace(cct_node_t* treenode, frame_t* path_beg, frame_t* path_end)
@@ -163,25 +432,12 @@ hpcrun_cct_insert_backtrace(cct_node_t* treenode, frame_t* path_beg, frame_t* pa
     ENABLE(BT_INSERT);
   }
 
-  cct_node_t* path = cct_insert_raw_backtrace(treenode, path_beg, path_end);
+  cct_node_t* path = cct_insert_raw_backtrace(treenode, path_beg, path_end, true);
   if (! bt_ins) DISABLE(BT_INSERT);
 
   // Put lush as_info class correction here
+  cct_correct_assoc(path, path_beg->as_info);
 
-  // N.B. If 'frm' is a 1-to-1 bichord and 'path' is not (i.e., 'path'
-  // is M-to-1 or 1-to-M), then update the association of 'path' to
-  // reflect that 'path' is now a proxy for two bichord types (1-to-1
-  // and M-to-1 or 1-to-M)
-
-  cct_addr_t* addr = hpcrun_cct_addr(path);
-
-  lush_assoc_t as_frm = lush_assoc_info__get_assoc(path_beg->as_info);
-  lush_assoc_t as_path = lush_assoc_info__get_assoc(addr->as_info);
-
-  if (as_frm == LUSH_ASSOC_1_to_1 && as_path != LUSH_ASSOC_1_to_1) {
-    // INVARIANT: path->as_info should be either M-to-1 or 1-to-M
-    lush_assoc_info__set_assoc(hpcrun_cct_addr(path)->as_info, LUSH_ASSOC_1_to_1);
-  }
   return path;
 }
 
@@ -198,16 +454,22 @@ hpcrun_cct_insert_backtrace_w_metric(cct_node_t* treenode,
     path = hpcrun_kernel_callpath(path, data_aux);
   }
 
-  metric_data_list_t* mset = hpcrun_reify_metric_set(path, metric_id);
+  return cct_apply_metric(path, metric_id, datum);
+}
 
-  metric_upd_proc_t* upd_proc = hpcrun_get_metric_proc(metric_id);
-  if (upd_proc) {
-    upd_proc(metric_id, mset, datum);
-  }
+// See usage in header.
+cct_node_t*
+hpcrun_cct_insert_staged_w_metric(cct_node_t* treenode,
+                                  int metric_id,
+                                  sample_ring_frame_t* path, size_t len,
+                                  cct_metric_data_t datum)
+{
+  cct_node_t* leaf = cct_insert_staged_path(treenode, path, len, true);
+  if (!leaf) return NULL;
 
-  // POST-INVARIANT: metric set has been allocated for 'path'
+  if (len > 0) cct_correct_assoc(leaf, path[0].as_info);
 
-  return path;
+  return cct_apply_metric(leaf, metric_id, datum);
 }
 
 //
@@ -265,15 +527,13 @@ hpcrun_backtrace2cct(cct_bundle_t* cct, ucontext_t* context,
 }
 
 
-cct_node_t*
-hpcrun_cct_record_backtrace(
-  cct_bundle_t* cct,
-  bool partial,
-  backtrace_info_t *bt,
-  bool tramp_found
-)
+//
+// pick the node below which a backtrace is inserted
+//
+static cct_node_t*
+cct_backtrace_cursor(cct_bundle_t* cct, bool partial,
+                     backtrace_info_t *bt, bool tramp_found)
 {
-  TMSG(FENCE, "Recording backtrace");
   thread_data_t* td = hpcrun_get_thread_data();
   cct_node_t* cct_cursor = cct->tree_root;
   TMSG(FENCE, "Initially picking tree root = %p", cct_cursor);
@@ -290,6 +550,20 @@ hpcrun_cct_record_backtrace(
     cct_cursor = cct->thread_root;
     TMSG(FENCE, "Thread stop ==> cursor = %p", cct_cursor);
   }
+  return cct_cursor;
+}
+
+
+cct_node_t*
+hpcrun_cct_record_backtrace(
+  cct_bundle_t* cct,
+  bool partial,
+  backtrace_info_t *bt,
+  bool tramp_found
+)
+{
+  TMSG(FENCE, "Recording backtrace");
+  cct_node_t* cct_cursor = cct_backtrace_cursor(cct, partial, bt, tramp_found);
 
   TMSG(FENCE, "sanity check cursor = %p", cct_cursor);
   TMSG(FENCE, "further sanity check: bt->last frame = (%d, %p)",
@@ -309,22 +583,7 @@ hpcrun_cct_record_backtrace_w_metric(cct_bundle_t* cct, bool partial,
   TMSG(BT_INSERT, "Record backtrace w metric to id %d, incr = %d",
        metricId, metricIncr.i);
 
-  thread_data_t* td = hpcrun_get_thread_data();
-  cct_node_t* cct_cursor = cct->tree_root;
-  TMSG(FENCE, "Initially picking tree root = %p", cct_cursor);
-  if (tramp_found) {
-    // start insertion below caller's frame, which is marked with the trampoline
-    cct_cursor = hpcrun_cct_parent(td->tramp_cct_node);
-    TMSG(FENCE, "Tramp found ==> cursor = %p", cct_cursor);
-  }
-  if (partial) {
-    cct_cursor = cct->partial_unw_root;
-    TMSG(FENCE, "Partial unwind ==> cursor = %p", cct_cursor);
-  }
-  if (bt->fence == FENCE_THREAD) {
-    cct_cursor = cct->thread_root;
-    TMSG(FENCE, "Thread stop ==> cursor = %p", cct_cursor);
-  }
+  cct_node_t* cct_cursor = cct_backtrace_cursor(cct, partial, bt, tramp_found);
 
   cct_cursor = cct_cursor_finalize(cct, bt, cct_cursor);
 
@@ -339,55 +598,80 @@ hpcrun_cct_record_backtrace_w_metric(cct_bundle_t* cct, bool partial,
 }
 
 
-static cct_node_t*
-help_hpcrun_backtrace2cct(cct_bundle_t* bundle, ucontext_t* context,
-                          int metricId,
-                          hpcrun_metricVal_t metricIncr,
-                          int skipInner, int isSync, void *data)
+//
+// unwind and finalize the backtrace of a sample; returns false if
+// a partial unwind is not to be recorded
+//
+static bool
+cct_sample_backtrace(backtrace_info_t* bt, ucontext_t* context,
+                     int skipInner, int isSync)
 {
-  bool tramp_found;
-
-  thread_data_t* td = hpcrun_get_thread_data();
-  backtrace_info_t bt;
-
   // initialize bt
-  memset(&bt, 0, sizeof(bt));
+  memset(bt, 0, sizeof(*bt));
 
-  bool success = hpcrun_generate_backtrace(&bt, context, skipInner);
+  bool success = hpcrun_generate_backtrace(bt, context, skipInner);
 
-  if (!success != bt.partial_unwind)
+  if (!success != bt->partial_unwind)
     hpcrun_terminate();
 
-  tramp_found = bt.has_tramp;
+  bool tramp_found = bt->has_tramp;
 
   //
   // Check to make sure node below monitor_main is "main" node
   //
   // TMSG(GENERIC1, "tmain chk");
   if (ENABLED(CHECK_MAIN)) {
-    if ( bt.fence == FENCE_MAIN &&
-         ! bt.partial_unwind &&
+    if ( bt->fence == FENCE_MAIN &&
+         ! bt->partial_unwind &&
          ! tramp_found &&
-         (bt.last == bt.begin ||
-          ! hpcrun_inbounds_main(hpcrun_frame_get_unnorm(bt.last - 1)))) {
+         (bt->last == bt->begin ||
+          ! hpcrun_inbounds_main(hpcrun_frame_get_unnorm(bt->last - 1)))) {
       hpcrun_bt_dump(TD_GET(btbuf_cur), "WRONG MAIN");
       hpcrun_stats_num_samples_dropped_inc();
-      bt.partial_unwind = true;
+      bt->partial_unwind = true;
     }
   }
 
-  cct_backtrace_finalize(&bt, isSync);
+  cct_backtrace_finalize(bt, isSync);
 
-  if (bt.partial_unwind) {
+  if (bt->partial_unwind) {
     if (ENABLED(NO_PARTIAL_UNW)){
-      return NULL;
+      return false;
     }
 
     TMSG(PARTIAL_UNW, "recording partial unwind from graceful failure, "
-         "len partial unw = %d", (bt.last - bt.begin)+1);
+         "len partial unw = %d", (bt->last - bt->begin)+1);
     hpcrun_stats_num_samples_partial_inc();
   }
 
+  return true;
+}
+
+
+static void
+cct_backtrace_stats(backtrace_info_t* bt)
+{
+  if (bt->n_trolls != 0) hpcrun_stats_trolled_inc();
+  hpcrun_stats_frames_total_inc((long)(bt->last - bt->begin + 1));
+  hpcrun_stats_trolled_frames_inc((long) bt->n_trolls);
+}
+
+
+static cct_node_t*
+help_hpcrun_backtrace2cct(cct_bundle_t* bundle, ucontext_t* context,
+                          int metricId,
+                          hpcrun_metricVal_t metricIncr,
+                          int skipInner, int isSync, void *data)
+{
+  thread_data_t* td = hpcrun_get_thread_data();
+  backtrace_info_t bt;
+
+  if (!cct_sample_backtrace(&bt, context, skipInner, isSync)) {
+    return NULL;
+  }
+
+  bool tramp_found = bt.has_tramp;
+
   cct_node_t* n =
     hpcrun_cct_record_backtrace_w_metric(bundle, bt.partial_unwind, &bt,
                                          tramp_found,
@@ -402,9 +686,7 @@ help_hpcrun_backtrace2cct(cct_bundle_t* bundle, ucontext_t* context,
     }
   }
 
-  if (bt.n_trolls != 0) hpcrun_stats_trolled_inc();
-  hpcrun_stats_frames_total_inc((long)(bt.last - bt.begin + 1));
-  hpcrun_stats_trolled_frames_inc((long) bt.n_trolls);
+  cct_backtrace_stats(&bt);
 
   if (ENABLED(USE_TRAMP)){
     TMSG(TRAMP, "--NEW SAMPLE--: Remove old trampoline");
@@ -421,3 +703,41 @@ help_hpcrun_backtrace2cct(cct_bundle_t* bundle, ucontext_t* context,
 
   return n;
 }
+
+
+//-----------------------------------------------------------------------------
+// function: hpcrun_backtrace2ring
+// purpose:
+//     unwind an asynchronous sample and stage it in the thread's sample
+//     ring; returns false if the sample was not recorded.
+//-----------------------------------------------------------------------------
+
+bool
+hpcrun_backtrace_may_stage(void)
+{
+  return hpcrun_sample_ring_enabled()
+    && ! hpcrun_isLogicalUnwind()
+    && ! ENABLED(USE_TRAMP)
+    && ! cct_cursor_finalize_active()
+    && hpcrun_kernel_callpath == NULL;
+}
+
+
+bool
+hpcrun_backtrace2ring(cct_bundle_t* bundle, ucontext_t* context,
+                      int metricId, hpcrun_metricVal_t metricIncr,
+                      int skipInner, sampling_info_t *data)
+{
+  backtrace_info_t bt;
+
+  if (!cct_sample_backtrace(&bt, context, skipInner, 0/*isSync*/)) {
+    return false;
+  }
+
+  cct_node_t* cct_cursor =
+    cct_backtrace_cursor(bundle, bt.partial_unwind, &bt, bt.has_tramp);
+
+  cct_backtrace_stats(&bt);
+
+  return hpcrun_sample_ring_stage(cct_cursor, &bt, metricId, metricIncr, data);
+}
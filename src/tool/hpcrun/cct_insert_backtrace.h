@@ -51,6 +51,7 @@
 #include "cct/cct.h"
 #include "unwind/common/backtrace.h"
 #include "metrics.h"
+#include "sample_ring.h"
 
 typedef  cct_node_t *(*hpcrun_kernel_callpath_t)(cct_node_t *path, void *data_aux);
 
@@ -78,6 +79,12 @@ extern cct_node_t* hpcrun_cct_insert_backtrace_w_metric(cct_node_t* cct,
                                                         frame_t* path_beg, frame_t* path_end,
                                                         cct_metric_data_t datum, void *data);
 
+// insert the frames of a staged sample, outermost first, below 'cct'
+extern cct_node_t* hpcrun_cct_insert_staged_w_metric(cct_node_t* cct,
+                                                     int metric_id,
+                                                     sample_ring_frame_t* path, size_t len,
+                                                     cct_metric_data_t datum);
+
 extern cct_node_t* hpcrun_cct_record_backtrace(cct_bundle_t* bndl, bool partial,
 backtrace_info_t *bt,
                                                bool tramp_found);
@@ -92,6 +99,14 @@ extern cct_node_t* hpcrun_backtrace2cct(cct_bundle_t* cct, ucontext_t* context,
         int metricId, hpcrun_metricVal_t metricIncr,
         int skipInner, int isSync, void *data);
 
+// true if an asynchronous sample may be staged in the sample ring
+// rather than inserted into the cct as it is taken
+extern bool hpcrun_backtrace_may_stage(void);
+
+extern bool hpcrun_backtrace2ring(cct_bundle_t* cct, ucontext_t* context,
+        int metricId, hpcrun_metricVal_t metricIncr,
+        int skipInner, sampling_info_t *data);
+
 
 extern void hpcrun_kernel_callpath_register(hpcrun_kernel_callpath_t kcp);
 
@@ -0,0 +1,532 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "container.h"
+#include "control-knob.h"
+#include "env.h"
+#include "files.h"
+#include "node-container.h"
+#include "rank.h"
+#include "sample_prob.h"
+#include "thread_data.h"
+#include "memory/hpcrun-malloc.h"
+#include "messages/messages.h"
+
+#include "../../lib/prof-lean/hpcfmt.h"
+#include "../../lib/prof-lean/hpcio-buffer.h"
+#include "../../lib/prof-lean/hpcrun-fmt.h"
+
+
+
+//*****************************************************************************
+// macros
+//*****************************************************************************
+
+// the container's blocks are allocated in steps of this size ahead of the
+// tail, so regions stay contiguous on disk and a full file system fails
+// the step rather than a write in the middle of a region
+#define CONTAINER_PREALLOC_BYTES (16 << 20)
+
+// the index is checkpointed once CONTAINER_CHECKPOINT_BYTES (a control
+// knob) were appended since the last checkpoint, and at least
+// CONTAINER_CHECKPOINT_RATIO times the size of the last checkpoint,
+// bounding the cost of the checkpoints to a small fraction of the data
+// however many regions there are.  With the knob at 0, every region is
+// followed by a checkpoint
+#define CONTAINER_CHECKPOINT_RATIO 16
+
+// checkpoints are serialized through a buffer of this size on the stack
+#define CONTAINER_CHECKPOINT_BUFFER 4096
+
+
+
+//*****************************************************************************
+// types
+//*****************************************************************************
+
+typedef struct container_region_t {
+  struct container_region_t *next;
+  hpccontainer_fmt_entry_t entry;
+} container_region_t;
+
+
+typedef struct container_trace_sink_t {
+  int thread;
+  uint32_t seq;
+} container_trace_sink_t;
+
+
+
+//*****************************************************************************
+// local data
+//*****************************************************************************
+
+static int container_fd = -1;
+static pid_t container_pid = 0;
+
+// staged for the node writer rather than in the output directory
+static bool container_node = false;
+
+// next free byte of the container
+static _Atomic(uint64_t) container_tail = HPCCONTAINER_FMT_DataOffset;
+
+// end of the space preallocated for the container
+static _Atomic(uint64_t) container_allocated = 0;
+
+// tail past which the next checkpoint of the index is due
+static _Atomic(uint64_t) container_checkpoint_due = 0;
+static uint64_t container_checkpoint_bytes = 0;
+
+// set while a thread writes a checkpoint, and for good once the final
+// index is written
+static atomic_bool container_checkpointing = false;
+
+// index entries, pushed lock-free since trace buffers are flushed from
+// inside signal handlers
+static _Atomic(container_region_t *) container_regions = NULL;
+
+
+
+//*****************************************************************************
+// private operations
+//*****************************************************************************
+
+static void
+container_region_push
+(
+  container_region_t *region
+)
+{
+  container_region_t *head = atomic_load_explicit(&container_regions,
+                                                  memory_order_relaxed);
+  do {
+    region->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&container_regions, &head,
+             region, memory_order_release, memory_order_relaxed));
+}
+
+
+static bool
+container_pwrite
+(
+  const void *data,
+  size_t size,
+  uint64_t offset
+)
+{
+  size_t done = 0;
+  while (done < size) {
+    ssize_t ret = pwrite(container_fd, (const char *) data + done,
+                         size - done, offset + done);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    done += ret;
+  }
+  return true;
+}
+
+
+// Reserve size bytes at the tail of the container, preallocating the
+// next step of the file if the reservation reaches past the last one.
+// Async signal safe.
+//
+// Returns: the offset of the reserved space.
+static uint64_t
+container_reserve
+(
+  size_t size
+)
+{
+  uint64_t offset = atomic_fetch_add_explicit(&container_tail, size,
+                                              memory_order_relaxed);
+  uint64_t end = offset + size;
+
+  uint64_t allocated = atomic_load_explicit(&container_allocated,
+                                            memory_order_relaxed);
+  while (end > allocated) {
+    uint64_t step = (end / CONTAINER_PREALLOC_BYTES + 1) * CONTAINER_PREALLOC_BYTES;
+    if (atomic_compare_exchange_weak_explicit(&container_allocated, &allocated,
+          step, memory_order_relaxed, memory_order_relaxed)) {
+      // a failure is not fatal, pwrite() allocates whatever is missing
+      fallocate(container_fd, FALLOC_FL_KEEP_SIZE, allocated, step - allocated);
+      break;
+    }
+  }
+
+  return offset;
+}
+
+
+// Write an index of the regions appended so far, with its trailer, into
+// reserved space and point checkpoint-end in the header at it, so that a
+// process that never reaches hpcrun_container_fini still leaves a
+// readable container.  Async signal safe; returns at once if another
+// checkpoint is in progress.
+static void
+container_checkpoint
+(
+  void
+)
+{
+  if (atomic_exchange_explicit(&container_checkpointing, true,
+                               memory_order_acquire)) {
+    return;
+  }
+
+  // regions are only ever pushed in front, so the list from this head
+  // stays intact while we walk it
+  container_region_t *regions = atomic_load_explicit(&container_regions,
+                                                     memory_order_acquire);
+  uint32_t num_entries = 0;
+  size_t index_len = 4 + HPCCONTAINER_FMT_TrailerLen;
+  for (container_region_t *r = regions; r; r = r->next) {
+    num_entries++;
+    index_len += hpccontainer_fmt_entry_len(&r->entry);
+  }
+
+  uint64_t index_offset = container_reserve(index_len);
+  uint64_t offset = index_offset;
+
+  char buf[CONTAINER_CHECKPOINT_BUFFER];
+  char *end = hpcfmt_int4_swrite(num_entries, buf);
+  bool ok = true;
+  for (container_region_t *r = regions; r && ok; r = r->next) {
+    size_t len = hpccontainer_fmt_entry_len(&r->entry);
+    if (end + len > buf + sizeof(buf)) {
+      ok = container_pwrite(buf, end - buf, offset) && len <= sizeof(buf);
+      offset += end - buf;
+      end = buf;
+    }
+    if (ok) {
+      end = hpccontainer_fmt_entry_swrite(&r->entry, end);
+    }
+  }
+  if (ok && end + HPCCONTAINER_FMT_TrailerLen > buf + sizeof(buf)) {
+    ok = container_pwrite(buf, end - buf, offset);
+    offset += end - buf;
+    end = buf;
+  }
+  if (ok) {
+    end = hpccontainer_fmt_trailer_swrite(index_offset, end);
+    ok = container_pwrite(buf, end - buf, offset);
+    offset += end - buf;
+  }
+
+  // the checkpoint only counts once it is complete
+  if (ok) {
+    char checkpoint_end[8];
+    hpcfmt_int8_swrite(offset, checkpoint_end);
+    ok = container_pwrite(checkpoint_end, sizeof(checkpoint_end),
+                          HPCCONTAINER_FMT_CheckpointOffset);
+  }
+
+  uint64_t interval = container_checkpoint_bytes;
+  if (interval > 0 && interval < CONTAINER_CHECKPOINT_RATIO * index_len) {
+    interval = CONTAINER_CHECKPOINT_RATIO * index_len;
+  }
+  atomic_store_explicit(&container_checkpoint_due, offset + interval,
+                        memory_order_relaxed);
+
+  TMSG(DATA_WRITE, "container index checkpoint: %u regions%s",
+       num_entries, ok ? "" : ", failed");
+
+  atomic_store_explicit(&container_checkpointing, false, memory_order_release);
+}
+
+
+// Reserve size bytes at the tail of the container, copy the data there
+// and record the region in the index.  Async signal safe.
+//
+// Returns: size on success, else -1.
+static ssize_t
+container_append
+(
+  hpccontainer_region_kind_t kind,
+  int thread,
+  uint32_t seq,
+  id_tuple_t *id_tuple,
+  const void *data,
+  size_t size
+)
+{
+  if (container_fd < 0) {
+    return -1;
+  }
+
+  container_region_t *region = hpcrun_malloc_safe(sizeof(container_region_t));
+  if (region == NULL) {
+    return -1;
+  }
+
+  uint64_t offset = container_reserve(size);
+
+  if (!container_pwrite(data, size, offset)) {
+    // the reserved space stays a hole, the index never points at it
+    return -1;
+  }
+
+  region->entry.kind = kind;
+  region->entry.thread = thread;
+  region->entry.seq = seq;
+  region->entry.offset = offset;
+  region->entry.length = size;
+  if (id_tuple != NULL) {
+    region->entry.id_tuple = *id_tuple;
+  } else {
+    memset(&region->entry.id_tuple, 0, sizeof(id_tuple_t));
+  }
+
+  container_region_push(region);
+
+  if (offset + size >= atomic_load_explicit(&container_checkpoint_due,
+                                            memory_order_relaxed)) {
+    container_checkpoint();
+  }
+
+  return size;
+}
+
+
+static ssize_t
+container_trace_sink
+(
+  void *arg,
+  const void *data,
+  size_t size
+)
+{
+  container_trace_sink_t *sink = (container_trace_sink_t *) arg;
+
+  ssize_t ret = container_append(hpccontainer_region_trace, sink->thread,
+                                 sink->seq, NULL, data, size);
+  if (ret >= 0) {
+    sink->seq++;
+  }
+  return ret;
+}
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+bool
+hpcrun_container_enabled
+(
+  void
+)
+{
+  return container_fd >= 0 && container_pid == getpid();
+}
+
+
+void
+hpcrun_container_init
+(
+  void
+)
+{
+  // a forked child must not append to its parent's container
+  container_fd = -1;
+  container_pid = getpid();
+  atomic_store(&container_tail, HPCCONTAINER_FMT_DataOffset);
+  atomic_store(&container_allocated, 0);
+  atomic_store(&container_checkpointing, false);
+  atomic_store(&container_regions, NULL);
+  container_node = false;
+
+  int checkpoint_bytes = 16 << 20;
+  control_knob_value_get_int("CONTAINER_CHECKPOINT_BYTES", &checkpoint_bytes);
+  container_checkpoint_bytes = (checkpoint_bytes > 0) ? checkpoint_bytes : 0;
+  atomic_store(&container_checkpoint_due,
+               HPCCONTAINER_FMT_DataOffset + container_checkpoint_bytes);
+
+  bool node = hpcrun_node_container_requested();
+  if (!(node || hpcrun_get_env_bool(HPCRUN_CONTAINER))
+      || !hpcrun_sample_prob_active()) {
+    return;
+  }
+
+  if (node) {
+    container_fd = hpcrun_node_container_open();
+    container_node = (container_fd >= 0);
+  }
+  if (container_fd < 0) {
+    container_fd = hpcrun_open_container_file();
+  }
+  TMSG(DATA_WRITE, "container opened, fd = %d", container_fd);
+
+  // the header goes first, with no checkpoint yet, so that the container
+  // can be recovered from its checkpoints
+  if (container_fd >= 0) {
+    char hdr[HPCCONTAINER_FMT_MagicLenX + HPCCONTAINER_FMT_VersionLenX
+             + HPCCONTAINER_FMT_EndianLenX + 8];
+    char *end = hpccontainer_fmt_hdr_swrite(0, hdr);
+    if (!container_pwrite(hdr, end - hdr, 0)) {
+      EMSG("unable to write container header: %s", strerror(errno));
+    }
+    container_reserve(0);
+  }
+}
+
+
+int
+hpcrun_container_trace_attach
+(
+  core_profile_trace_data_t *cptd
+)
+{
+  container_trace_sink_t *sink = hpcrun_malloc(sizeof(container_trace_sink_t));
+  if (sink == NULL) {
+    return HPCFMT_ERR;
+  }
+  sink->thread = cptd->id;
+  sink->seq = 0;
+
+  return hpcio_outbuf_attach_sink(&cptd->trace_outbuf, container_trace_sink,
+                                  sink, cptd->trace_buffer, HPCRUN_TraceBufferSz,
+                                  HPCIO_OUTBUF_UNLOCKED, hpcrun_malloc);
+}
+
+
+int
+hpcrun_container_append_profile
+(
+  core_profile_trace_data_t *cptd,
+  const void *data,
+  size_t size
+)
+{
+  ssize_t ret = container_append(hpccontainer_region_profile, cptd->id, 0,
+                                 &cptd->id_tuple, data, size);
+  return (ret < 0) ? HPCFMT_ERR : HPCFMT_OK;
+}
+
+
+void
+hpcrun_container_fini
+(
+  void
+)
+{
+  if (!hpcrun_container_enabled()) {
+    return;
+  }
+
+  // wait out a checkpoint in progress and keep any more from starting
+  while (atomic_exchange(&container_checkpointing, true));
+
+  uint32_t num_entries = 0;
+  container_region_t *regions = atomic_exchange(&container_regions, NULL);
+  for (container_region_t *r = regions; r; r = r->next) {
+    num_entries++;
+  }
+
+  uint64_t index_offset = atomic_load(&container_tail);
+
+  FILE *fs = fdopen(container_fd, "w");
+  if (fs == NULL) {
+    EMSG("unable to write container index: %s", strerror(errno));
+    return;
+  }
+
+  int ret = HPCFMT_OK;
+  if (fseek(fs, 0, SEEK_SET) != 0
+      || hpccontainer_fmt_hdr_fwrite(fs) != HPCFMT_OK
+      || fseek(fs, index_offset, SEEK_SET) != 0
+      || hpcfmt_int4_fwrite(num_entries, fs) != HPCFMT_OK) {
+    ret = HPCFMT_ERR;
+  }
+  for (container_region_t *r = regions; r && ret == HPCFMT_OK; r = r->next) {
+    ret = hpccontainer_fmt_entry_fwrite(&r->entry, fs);
+  }
+  if (ret == HPCFMT_OK) {
+    ret = hpccontainer_fmt_trailer_fwrite(index_offset, fs);
+  }
+
+  // return the blocks preallocated past the index
+  long end = ftell(fs);
+  uint64_t allocated = atomic_load(&container_allocated);
+  if (ret == HPCFMT_OK && fflush(fs) == 0 && end > 0
+      && (uint64_t) end < allocated) {
+    fallocate(container_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+              end, allocated - end);
+  }
+
+  if (fclose(fs) != 0 || ret != HPCFMT_OK) {
+    EMSG("unable to write container index");
+  }
+  container_fd = -1;
+
+  TMSG(DATA_WRITE, "container closed: %u regions, %ld bytes of data",
+       num_entries, (long)(index_offset - HPCCONTAINER_FMT_DataOffset));
+
+  int rank = hpcrun_get_rank();
+  if (container_node) {
+    hpcrun_node_container_close(rank);
+  } else if (rank >= 0) {
+    hpcrun_rename_container_file(rank);
+  }
+}
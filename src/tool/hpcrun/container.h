@@ -0,0 +1,81 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+#ifndef hpcrun_container_h
+#define hpcrun_container_h
+
+//*****************************************************************************
+// Per-process container output.
+//
+// With HPCRUN_CONTAINER set, all threads of a process write their
+// profiles and traces into a single .hpccontainer file instead of one
+// .hpcrun and one .hpctrace file per thread.  Writers reserve space with
+// an atomic bump of the container tail and pwrite() into it, so threads
+// never serialize on the file.  An index of the regions is written when
+// the process finishes, and checkpointed as the container grows so that
+// a process that dies leaves a container readable up to its last
+// checkpoint.
+//*****************************************************************************
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "core_profile_trace_data.h"
+
+bool hpcrun_container_enabled(void);
+
+// open (or, after fork, reopen) the container for this process
+void hpcrun_container_init(void);
+
+// attach the thread's trace buffer to the container
+int hpcrun_container_trace_attach(core_profile_trace_data_t *cptd);
+
+// append a complete, in-memory profile for the thread
+int hpcrun_container_append_profile(core_profile_trace_data_t *cptd,
+                                    const void *data, size_t size);
+
+// write the index and give the container its final name, or hand it
+// to the node writer (see node-container.h)
+void hpcrun_container_fini(void);
+
+#endif // hpcrun_container_h
@@ -57,10 +57,28 @@ control_knob_register(char *name, char *value, control_knob_type type)
 
 static void
 control_knob_default_register(){
-  control_knob_register("STREAMS_PER_TRACING_THREAD", "256", ck_int);
+  control_knob_register("MAX_TRACING_THREADS", "8", ck_int);
+  control_knob_register("TRACING_THREAD_BACKLOG", "1000", ck_int);
   control_knob_register("MAX_COMPLETION_CALLBACK_THREADS", "1000", ck_int);
   control_knob_register("MAX_UNWIND_DEPTH", "1000", ck_int);
   control_knob_register("HPCRUN_TORCH_MONITOR_NATIVE_STACK_ENABLE", "FALSE", ck_string);
+  control_knob_register("SYNTHETIC_GPU_THREADS", "1", ck_int);
+  control_knob_register("SYNTHETIC_GPU_OPERATIONS", "100000", ck_int);
+  control_knob_register("SYNTHETIC_GPU_STREAMS", "4", ck_int);
+  control_knob_register("CCT_PATH_REUSE", "1", ck_int);
+  control_knob_register("CCT_PATH_VERIFY", "0", ck_int);
+  control_knob_register("SAMPLE_RING_SLOTS", "0", ck_int);
+  control_knob_register("SAMPLE_RING_FRAMES", "32", ck_int);
+  control_knob_register("SYNTHETIC_GPU_KERNEL_NS", "5000", ck_int);
+  control_knob_register("SYNTHETIC_GPU_MEMCPY_BYTES", "65536", ck_int);
+  control_knob_register("SYNTHETIC_GPU_MEMCPY_EVERY", "4", ck_int);
+  control_knob_register("SYNTHETIC_GPU_SYNC_EVERY", "64", ck_int);
+  control_knob_register("UNWIND_BENCH_SNAPSHOTS", "0", ck_int);
+  control_knob_register("UNWIND_BENCH_PASSES", "5", ck_int);
+  control_knob_register("UNWIND_BENCH_STACK_KB", "64", ck_int);
+  control_knob_register("UNWIND_FP_VERIFY", "0", ck_int);
+  control_knob_register("UNWIND_RECIPES_VERIFY", "0", ck_int);
+  control_knob_register("CONTAINER_CHECKPOINT_BYTES", "16777216", ck_int);
 }
 
 
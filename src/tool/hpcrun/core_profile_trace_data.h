@@ -41,8 +41,13 @@ typedef struct core_profile_trace_data_t {
   // IO support
   // ----------------------------------------
   FILE* hpcrun_file;
+  // profile bytes staged in memory when writing to a container
+  char* container_buf;
+  size_t container_size;
   void* trace_buffer;
   hpcio_outbuf_t *trace_outbuf;
+  // trace block being filled and index of written blocks (trace.c)
+  struct trace_block_state_t *trace_block;
 
 } core_profile_trace_data_t;
 
@@ -54,6 +54,11 @@ const char* HPCRUN_OPT_LUSH_AGENTS = "HPCRUN_OPT_LUSH_AGENTS";
 
 const char* HPCRUN_OUT_PATH        = "HPCRUN_OUT_PATH";
 const char* HPCRUN_TRACE           = "HPCRUN_TRACE";
+const char* HPCRUN_CONTAINER       = "HPCRUN_CONTAINER";
+const char* HPCRUN_NODE_CONTAINER  = "HPCRUN_NODE_CONTAINER";
+const char* HPCRUN_SNAPSHOT_PERIOD = "HPCRUN_SNAPSHOT_PERIOD";
+const char* HPCRUN_UNWIND_RECIPES  = "HPCRUN_UNWIND_RECIPES";
+const char* HPCRUN_UNWIND_FP       = "HPCRUN_UNWIND_FP";
 
 const char* PAPI_EVENT_LIST        = "PAPI_EVENT_LIST";
 
@@ -56,6 +56,14 @@ extern const char* HPCRUN_OUT_PATH;
 
 extern const char* HPCRUN_TRACE;
 
+extern const char* HPCRUN_CONTAINER;
+extern const char* HPCRUN_NODE_CONTAINER;
+
+extern const char* HPCRUN_SNAPSHOT_PERIOD;
+
+extern const char* HPCRUN_UNWIND_RECIPES;
+extern const char* HPCRUN_UNWIND_FP;
+
 extern const char* HPCRUN_EVENT_LIST;
 extern const char* HPCRUN_MEMSIZE;
 extern const char* HPCRUN_LOW_MEMSIZE;
@@ -148,6 +148,7 @@
 
 #define FILES_EARLY  0x1
 #define FILES_LATE   0x2
+#define FILES_TRY    0x4   // return -1 on failure instead of aborting
 
 struct fileid {
   int  done;
@@ -252,7 +253,7 @@ hpcrun_files_next_id(struct fileid *id)
 // exists.  The log and trace files are opened early, the profile file
 // (hpcrun) is opened late.  Must hold the files lock.
 
-// Returns: file descriptor, else die on failure.
+// Returns: file descriptor, else die on failure (-1 with FILES_TRY).
 //
 static int
 hpcrun_open_file(int rank, int thread, const char *suffix, int flags)
@@ -295,8 +296,12 @@ hpcrun_open_file(int rank, int thread, const char *suffix, int flags)
     lateid.done = 0;
   }
 
-  // Failure to open is a fatal error.
-  if (fd < 0) {
+  // Failure to open is a fatal error, unless the caller can recover.
+  if (fd < 0 && (flags & FILES_TRY)) {
+    EEMSG("hpctoolkit: unable to open %s file: '%s': %s",
+         suffix, name, strerror(errno));
+  }
+  else if (fd < 0) {
     hpcrun_abort("hpctoolkit: unable to open %s file: '%s': %s",
                  suffix, name, strerror(errno));
   }
@@ -510,6 +515,59 @@ hpcrun_open_profile_file(int rank, int thread)
 }
 
 
+// Returns: file descriptor for the per-process container file.  The
+// container is opened early, like the trace files, since trace data
+// can arrive before the rank is known.
+int
+hpcrun_open_container_file(void)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  ret = hpcrun_open_file(0, 0, HPCRUN_ContainerFnmSfx, FILES_EARLY);
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
+// Returns: file descriptor for the container that the last process of
+// a node writes for all of them, named after the lowest rank on the
+// node (node_rank), else -1.  Opened late, the process's own container
+// is staged elsewhere.  The log file is renamed for the process's own
+// rank, as with any other late file.
+int
+hpcrun_open_node_container_file(int rank, int node_rank)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  hpcrun_rename_log_file_early(rank);
+  ret = hpcrun_open_file(node_rank, 0, HPCRUN_ContainerFnmSfx, FILES_LATE | FILES_TRY);
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
+// Returns: file descriptor for the per-process snapshot file, opened
+// early since snapshots start before the rank is known.
+int
+hpcrun_open_snapshot_file(void)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  ret = hpcrun_open_file(0, 0, HPCRUN_SnapshotFnmSfx, FILES_EARLY);
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
 // Note: we use the log file as the lock for the file names, so we
 // need to rename the log file as the first late action.  Since this
 // is out of sequence, we save the return value and return it when the
@@ -557,6 +615,36 @@ hpcrun_rename_trace_file(int rank, int thread)
 }
 
 
+// Returns: 0 on success, else -1 on failure.
+int
+hpcrun_rename_container_file(int rank)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_rename_log_file_early(rank);
+  ret = hpcrun_rename_file(rank, 0, HPCRUN_ContainerFnmSfx);
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
+// Returns: 0 on success, else -1 on failure.
+int
+hpcrun_rename_snapshot_file(int rank)
+{
+  int ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_rename_log_file_early(rank);
+  ret = hpcrun_rename_file(rank, 0, HPCRUN_SnapshotFnmSfx);
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
 // Record the contents of a [vdso] file, if one exists. Die on failure.
 void
 hpcrun_save_vdso()
@@ -63,8 +63,13 @@ const char *hpcrun_files_output_directory();
 int hpcrun_open_log_file(void);
 int hpcrun_open_trace_file(int thread);
 int hpcrun_open_profile_file(int rank, int thread);
+int hpcrun_open_container_file(void);
+int hpcrun_open_node_container_file(int rank, int node_rank);
+int hpcrun_open_snapshot_file(void);
 int hpcrun_rename_log_file(int rank);
 int hpcrun_rename_trace_file(int rank, int thread);
+int hpcrun_rename_container_file(int rank);
+int hpcrun_rename_snapshot_file(int rank);
 
 // storing the hash of the vdso for the current process
 extern char vdso_hash_str[];
@@ -0,0 +1,427 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//******************************************************************************
+// system includes
+//******************************************************************************
+
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+//******************************************************************************
+// local includes
+//******************************************************************************
+
+#include "../../../control-knob.h"
+#include "../../../hpcrun_stats.h"
+#include "../../../safe-sampling.h"
+#include "../../../thread_data.h"
+#include "../../../libmonitor/monitor.h"
+#include "../../../messages/messages.h"
+#include "../../../utilities/hpcrun-nanotime.h"
+#include "../../activity/gpu-activity.h"
+#include "../../activity/gpu-activity-channel.h"
+#include "../../activity/gpu-op-placeholders.h"
+#include "../../operation/gpu-operation-multiplexer.h"
+#include "../../gpu-application-thread-api.h"
+
+#include "synthetic-api.h"
+
+
+
+//******************************************************************************
+// macros
+//******************************************************************************
+
+#define SYNTHETIC_MAX_STREAMS 64
+
+// simulated copy bandwidth: 10 GB/s
+#define SYNTHETIC_MEMCPY_BYTES_PER_NS 10
+
+// how often a generator attributes the activities returned to it
+#define SYNTHETIC_PROCESS_PERIOD 64
+
+#define SYNTHETIC_DEVICE_ID 0
+#define SYNTHETIC_CONTEXT_ID 0
+
+
+
+//******************************************************************************
+// type declarations
+//******************************************************************************
+
+typedef struct synthetic_config_t {
+  int threads;
+  int operations;
+  int streams;
+  int kernel_ns;
+  int memcpy_bytes;
+  int memcpy_every;
+  int sync_every;
+} synthetic_config_t;
+
+
+typedef struct synthetic_thread_state_t {
+  uint32_t stream_base;
+  // simulated completion time of the last operation on each stream
+  uint64_t stream_end[SYNTHETIC_MAX_STREAMS];
+} synthetic_thread_state_t;
+
+
+
+//******************************************************************************
+// local data
+//******************************************************************************
+
+static synthetic_config_t synthetic_config;
+
+static pthread_once_t synthetic_launch_once = PTHREAD_ONCE_INIT;
+
+static pthread_t *synthetic_threads = NULL;
+
+static atomic_bool synthetic_launched = false;
+
+static atomic_ullong synthetic_correlation_id = 0;
+
+static atomic_ullong synthetic_operations = 0;
+
+static atomic_ullong synthetic_submit_nsec = 0;
+
+static uint64_t synthetic_launch_time = 0;
+
+static __thread atomic_int synthetic_self_pending_operations = 0;
+
+
+
+//******************************************************************************
+// private operations
+//******************************************************************************
+
+static int
+synthetic_knob_get
+(
+ char *name,
+ int lower_bound
+)
+{
+  int value = lower_bound;
+  control_knob_value_get_int(name, &value);
+  return value < lower_bound ? lower_bound : value;
+}
+
+
+static void
+synthetic_submit
+(
+ synthetic_thread_state_t *state,
+ gpu_activity_kind_t kind,
+ uint32_t stream,
+ gpu_memcpy_type_t copy_kind
+)
+{
+  uint64_t correlation_id = atomic_fetch_add(&synthetic_correlation_id, 1) + 1;
+
+  gpu_placeholder_type_t placeholder_type;
+  switch (kind) {
+    case GPU_ACTIVITY_MEMCPY:
+      placeholder_type = copy_kind == GPU_MEMCPY_H2D ?
+        gpu_placeholder_type_copyin : gpu_placeholder_type_copyout;
+      break;
+    case GPU_ACTIVITY_SYNCHRONIZATION:
+      placeholder_type = gpu_placeholder_type_sync;
+      break;
+    default:
+      placeholder_type = gpu_placeholder_type_kernel;
+      break;
+  }
+
+  cct_node_t *api_node =
+    gpu_application_thread_correlation_callback(correlation_id);
+
+  gpu_op_placeholder_flags_t gpu_op_placeholder_flags = 0;
+  gpu_op_placeholder_flags_set(&gpu_op_placeholder_flags, placeholder_type);
+
+  gpu_op_ccts_t gpu_op_ccts;
+  hpcrun_safe_enter();
+  gpu_op_ccts_insert(api_node, &gpu_op_ccts, gpu_op_placeholder_flags);
+  hpcrun_safe_exit();
+
+  // the device timeline: an operation starts when it is submitted or when
+  // the previous operation on its stream completes, whichever is later
+  uint64_t submit_time = hpcrun_nanotime();
+
+  gpu_activity_t gpu_activity;
+  gpu_activity_init(&gpu_activity);
+  gpu_activity.kind = kind;
+  gpu_activity.cct_node = gpu_op_ccts_get(&gpu_op_ccts, placeholder_type);
+
+  uint32_t stream_id = state->stream_base + stream;
+  uint64_t *stream_end = &state->stream_end[stream];
+  uint64_t start = submit_time > *stream_end ? submit_time : *stream_end;
+
+  switch (kind) {
+    case GPU_ACTIVITY_MEMCPY:
+      {
+        uint64_t duration =
+          synthetic_config.memcpy_bytes / SYNTHETIC_MEMCPY_BYTES_PER_NS + 1;
+        gpu_memcpy_t *copy = &gpu_activity.details.memcpy;
+        gpu_interval_set(&gpu_activity.details.interval, start, start + duration);
+        copy->bytes = synthetic_config.memcpy_bytes;
+        copy->submit_time = submit_time;
+        copy->correlation_id = correlation_id;
+        copy->device_id = SYNTHETIC_DEVICE_ID;
+        copy->context_id = SYNTHETIC_CONTEXT_ID;
+        copy->stream_id = stream_id;
+        copy->copyKind = copy_kind;
+        *stream_end = start + duration;
+        break;
+      }
+    case GPU_ACTIVITY_SYNCHRONIZATION:
+      {
+        // a stream synchronization completes with the last operation on it
+        gpu_synchronization_t *sync = &gpu_activity.details.synchronization;
+        gpu_interval_set(&gpu_activity.details.interval, submit_time, start);
+        sync->correlation_id = correlation_id;
+        sync->context_id = SYNTHETIC_CONTEXT_ID;
+        sync->stream_id = stream_id;
+        sync->syncKind = GPU_SYNC_STREAM;
+        break;
+      }
+    default:
+      {
+        gpu_kernel_t *kernel = &gpu_activity.details.kernel;
+        gpu_interval_set(&gpu_activity.details.interval, start,
+                         start + synthetic_config.kernel_ns);
+        kernel->submit_time = submit_time;
+        kernel->correlation_id = correlation_id;
+        kernel->device_id = SYNTHETIC_DEVICE_ID;
+        kernel->context_id = SYNTHETIC_CONTEXT_ID;
+        kernel->stream_id = stream_id;
+        *stream_end = start + synthetic_config.kernel_ns;
+        break;
+      }
+  }
+
+  atomic_fetch_add(&synthetic_self_pending_operations, 1);
+  gpu_operation_multiplexer_push(gpu_activity_channel_get_local(),
+    &synthetic_self_pending_operations, &gpu_activity);
+
+  atomic_fetch_add(&synthetic_submit_nsec, hpcrun_nanotime() - submit_time);
+}
+
+
+static void
+synthetic_thread_flush
+(
+ void
+)
+{
+  atomic_bool wait;
+  atomic_store(&wait, true);
+
+  gpu_activity_t gpu_activity;
+  gpu_activity_init(&gpu_activity);
+  gpu_activity.kind = GPU_ACTIVITY_FLUSH;
+  gpu_activity.details.flush.wait = &wait;
+  gpu_operation_multiplexer_push(gpu_activity_channel_get_local(), NULL,
+    &gpu_activity);
+
+  // the operation channel is FIFO: once the flush is seen, every
+  // operation this thread submitted has been handed to the trace threads
+  while (atomic_load(&wait));
+  while (atomic_load(&synthetic_self_pending_operations) != 0);
+
+  gpu_application_thread_process_activities();
+}
+
+
+static void *
+synthetic_generator_fn
+(
+ void *arg
+)
+{
+  hpcrun_thread_init_mem_pool_once(TOOL_THREAD_ID, NULL, HPCRUN_NO_TRACE, true);
+
+  int index = (int)(intptr_t) arg;
+
+  synthetic_thread_state_t state = {
+    .stream_base = index * synthetic_config.streams
+  };
+
+  for (int i = 0; i < synthetic_config.operations; i++) {
+    uint32_t stream = i % synthetic_config.streams;
+    int n = i + 1;
+
+    if (synthetic_config.sync_every && n % synthetic_config.sync_every == 0) {
+      synthetic_submit(&state, GPU_ACTIVITY_SYNCHRONIZATION, stream,
+                       GPU_MEMCPY_UNK);
+    } else if (synthetic_config.memcpy_every &&
+               n % synthetic_config.memcpy_every == 0) {
+      gpu_memcpy_type_t copy_kind = (n / synthetic_config.memcpy_every) & 1 ?
+        GPU_MEMCPY_H2D : GPU_MEMCPY_D2H;
+      synthetic_submit(&state, GPU_ACTIVITY_MEMCPY, stream, copy_kind);
+    } else {
+      synthetic_submit(&state, GPU_ACTIVITY_KERNEL, stream, GPU_MEMCPY_UNK);
+    }
+
+    if (n % SYNTHETIC_PROCESS_PERIOD == 0) {
+      gpu_application_thread_process_activities();
+    }
+  }
+
+  synthetic_thread_flush();
+
+  atomic_fetch_add(&synthetic_operations, synthetic_config.operations);
+
+  return NULL;
+}
+
+
+static void
+synthetic_launch_once_fn
+(
+ void
+)
+{
+  synthetic_threads = malloc(synthetic_config.threads * sizeof(pthread_t));
+  if (synthetic_threads == NULL) {
+    EMSG("synthetic gpu: unable to allocate %d generator threads",
+         synthetic_config.threads);
+    return;
+  }
+
+  synthetic_launch_time = hpcrun_nanotime();
+
+  // generators are tool threads: the pipeline, not the generators, is
+  // what is being measured
+  monitor_disable_new_threads();
+  for (int i = 0; i < synthetic_config.threads; i++) {
+    pthread_create(&synthetic_threads[i], NULL, synthetic_generator_fn,
+                   (void *)(intptr_t) i);
+  }
+  monitor_enable_new_threads();
+
+  atomic_store(&synthetic_launched, true);
+}
+
+
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+void
+synthetic_api_initialize
+(
+ void
+)
+{
+  synthetic_config.threads = synthetic_knob_get("SYNTHETIC_GPU_THREADS", 1);
+  synthetic_config.operations = synthetic_knob_get("SYNTHETIC_GPU_OPERATIONS", 0);
+  synthetic_config.streams = synthetic_knob_get("SYNTHETIC_GPU_STREAMS", 1);
+  synthetic_config.kernel_ns = synthetic_knob_get("SYNTHETIC_GPU_KERNEL_NS", 1);
+  synthetic_config.memcpy_bytes = synthetic_knob_get("SYNTHETIC_GPU_MEMCPY_BYTES", 0);
+  synthetic_config.memcpy_every = synthetic_knob_get("SYNTHETIC_GPU_MEMCPY_EVERY", 0);
+  synthetic_config.sync_every = synthetic_knob_get("SYNTHETIC_GPU_SYNC_EVERY", 0);
+
+  if (synthetic_config.streams > SYNTHETIC_MAX_STREAMS) {
+    synthetic_config.streams = SYNTHETIC_MAX_STREAMS;
+  }
+
+  TMSG(GPU, "synthetic gpu: %d threads x %d operations on %d streams",
+       synthetic_config.threads, synthetic_config.operations,
+       synthetic_config.streams);
+}
+
+
+void
+synthetic_api_launch
+(
+ void
+)
+{
+  pthread_once(&synthetic_launch_once, synthetic_launch_once_fn);
+}
+
+
+void
+synthetic_api_process_finalize
+(
+ void *args,
+ int how
+)
+{
+  if (atomic_load(&synthetic_launched)) {
+    for (int i = 0; i < synthetic_config.threads; i++) {
+      pthread_join(synthetic_threads[i], NULL);
+    }
+  }
+
+  gpu_operation_multiplexer_fini();
+
+  if (!atomic_load(&synthetic_launched)) return;
+
+  uint64_t operations = atomic_load(&synthetic_operations);
+  double elapsed = (hpcrun_nanotime() - synthetic_launch_time) / 1e9;
+
+  long monitored = hpcrun_stats_gpu_operations();
+  long traced = hpcrun_stats_gpu_trace_items();
+
+  fprintf(stderr,
+          "synthetic gpu: %" PRIu64 " operations in %.3f s (%.0f operations/s)\n"
+          "synthetic gpu: submit %.1f ns/operation, monitor %.1f ns/operation,"
+          " trace %.1f ns/item\n",
+          operations, elapsed, elapsed > 0 ? operations / elapsed : 0.0,
+          operations ? (double) atomic_load(&synthetic_submit_nsec) / operations : 0.0,
+          monitored ? (double) hpcrun_stats_gpu_operations_nsec() / monitored : 0.0,
+          traced ? (double) hpcrun_stats_gpu_trace_items_nsec() / traced : 0.0);
+}
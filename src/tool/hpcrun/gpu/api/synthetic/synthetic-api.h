@@ -0,0 +1,100 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//******************************************************************************
+//
+// synthetic-api: a fake GPU device for measuring the GPU activity pipeline.
+//
+// Generator threads submit a configurable mix of kernels, memory copies and
+// synchronizations through the same path a vendor backend uses: an unwind
+// for the calling context, placeholder insertion, and a push into the
+// operation multiplexer. Completion times come from a simulated per-stream
+// device timeline, so the operation and trace threads see realistic,
+// monotonically increasing intervals without any GPU present.
+//
+// The workload is configured with control knobs (HPCRUN_CONTROL_KNOBS):
+//   SYNTHETIC_GPU_THREADS       generator threads
+//   SYNTHETIC_GPU_OPERATIONS    operations submitted by each thread
+//   SYNTHETIC_GPU_STREAMS       streams used by each thread
+//   SYNTHETIC_GPU_KERNEL_NS     simulated kernel duration
+//   SYNTHETIC_GPU_MEMCPY_BYTES  bytes moved by each simulated copy
+//   SYNTHETIC_GPU_MEMCPY_EVERY  a copy replaces every n-th kernel (0 = never)
+//   SYNTHETIC_GPU_SYNC_EVERY    a synchronization every n operations (0 = never)
+//
+//******************************************************************************
+
+#ifndef synthetic_api_h
+#define synthetic_api_h
+
+
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+void
+synthetic_api_initialize
+(
+ void
+);
+
+
+// start the generator threads; only the first call has an effect
+void
+synthetic_api_launch
+(
+ void
+);
+
+
+// join the generator threads, drain the pipeline and report throughput
+void
+synthetic_api_process_finalize
+(
+ void *args,
+ int how
+);
+
+
+
+#endif
@@ -60,8 +60,10 @@
 #include <stdatomic.h>
 
 #include "../../control-knob.h"
+#include "../../hpcrun_stats.h"
 #include "../trace/gpu-trace-api.h"
 #include "../../libmonitor/monitor.h"
+#include "../../utilities/hpcrun-nanotime.h"
 
 #include "../activity/gpu-activity.h"
 #include "../activity/gpu-activity-channel.h"
@@ -99,7 +101,9 @@ void operation_item_process_helper
  void *arg
 )
 {
+  long *count = arg;
   gpu_operation_item_process(item);
+  (*count)++;
 }
 
 
@@ -109,7 +113,24 @@ void operation_channel_consume
   void *arg
 )
 {
-  gpu_operation_channel_receive_all(channel, operation_item_process_helper, NULL);
+  gpu_operation_channel_receive_all(channel, operation_item_process_helper, arg);
+}
+
+
+// drain all operation channels once, accounting the items processed
+// and the time it took in hpcrun's statistics
+static void
+operation_channels_consume
+(
+ void
+)
+{
+  long count = 0;
+  uint64_t start = hpcrun_nanotime();
+  gpu_operation_channel_set_apply(channel_set, operation_channel_consume, &count);
+  if (count > 0) {
+    hpcrun_stats_gpu_operations_add(count, hpcrun_nanotime() - start);
+  }
 }
 
 
@@ -124,10 +145,10 @@ gpu_operation_record_thread_fn
 
   while (!atomic_load(&stop_operation_flag)) {
     gpu_operation_channel_set_await(channel_set);
-    gpu_operation_channel_set_apply(channel_set, operation_channel_consume, NULL);
+    operation_channels_consume();
   }
 
-  gpu_operation_channel_set_apply(channel_set, operation_channel_consume, NULL);
+  operation_channels_consume();
 
   // even if this is not normal exit, gpu-trace-fini will behave as if it is a normal exit
   gpu_trace_fini(NULL, MONITOR_EXIT_NORMAL);
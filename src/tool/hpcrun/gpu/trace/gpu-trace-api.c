@@ -70,11 +70,13 @@
 
 #include "../../cct/cct.h"
 #include "../../control-knob.h"
+#include "../../hpcrun_stats.h"
 #include "../../rank.h"
 #include "../../thread_data.h"
 #include "../../threadmgr.h"
 #include "../../trace.h"
 #include "../../write_data.h"
+#include "../../utilities/hpcrun-nanotime.h"
 
 #include "../common/gpu-monitoring.h"
 
@@ -95,6 +97,11 @@
 #define DEBUG 0
 #include "../common/gpu-print.h"
 
+// passes over the channels without any work, each ending with a timed
+// wait on the set, before a tracing thread offers to leave the pool and
+// park
+#define TRACE_THREAD_IDLE_PASSES 5
+
 
 
 //******************************************************************************
@@ -107,6 +114,11 @@ typedef struct gpu_tag_t {
   uint32_t stream_id;
 } gpu_tag_t;
 
+typedef struct consume_trace_arg_t {
+  cct_node_t *no_activity;
+  long count;
+} consume_trace_arg_t;
+
 
 
 //******************************************************************************
@@ -119,7 +131,10 @@ static atomic_ullong active_streams_counter;
 
 static atomic_ullong num_streams;
 
-static __thread uint64_t stream_start = 0;
+// first trace item start seen by the tracing pool; the origin of trace
+// sampling intervals. tracing threads drain any stream, so the origin is
+// shared rather than per thread.
+static atomic_ullong stream_start = 0;
 
 static mcs_lock_t lock;
 
@@ -135,7 +150,10 @@ stream_start_set
  uint64_t start_time
 )
 {
-  if (!stream_start) stream_start = start_time;
+  uint64_t unset = 0;
+  if (atomic_load_explicit(&stream_start, memory_order_relaxed) == 0) {
+    atomic_compare_exchange_strong(&stream_start, &unset, start_time);
+  }
 }
 
 
@@ -145,7 +163,7 @@ stream_start_get
  void
 )
 {
-  return stream_start;
+  return atomic_load_explicit(&stream_start, memory_order_relaxed);
 }
 
 
@@ -308,7 +326,9 @@ gpu_trace_channel_release
 
 static void
 consume_trace_item(gpu_trace_item_t *trace_item, thread_data_t *thread_data, void *arg) {
-  cct_node_t *no_activity = arg;
+  consume_trace_arg_t *consume_arg = arg;
+  cct_node_t *no_activity = consume_arg->no_activity;
+  consume_arg->count++;
   cct_node_t *call_path = trace_item->call_path_leaf;
   uint64_t start_time = trace_item->start;
   uint64_t end_time = trace_item->end;
@@ -330,7 +350,7 @@ consume_trace_item(gpu_trace_item_t *trace_item, thread_data_t *thread_data, voi
     uint64_t cur_start = start_time;
     uint64_t cur_end = end_time;
     uint64_t intervals = (cur_start - stream_start_get() - 1) / frequency + 1;
-    uint64_t pivot = intervals * frequency + stream_start;
+    uint64_t pivot = intervals * frequency + stream_start_get();
 
     if (pivot <= cur_end && pivot >= cur_start) {
       // only trace when the pivot is within the range
@@ -362,11 +382,47 @@ consume_trace_channel
   void *arg
 )
 {
+  long *count = arg;
   thread_data_t *thread_data = gpu_trace_channel_get_thread_data(channel);
   hpcrun_set_thread_data(thread_data);
-  cct_node_t *no_activity = gpu_trace_cct_no_activity(thread_data);
 
-  gpu_trace_channel_receive_all(channel, consume_trace_item, no_activity);
+  consume_trace_arg_t consume_arg = {
+    .no_activity = gpu_trace_cct_no_activity(thread_data),
+    .count = 0
+  };
+
+  gpu_trace_channel_receive_all(channel, consume_trace_item, &consume_arg);
+  *count += consume_arg.count;
+}
+
+
+// drain the trace channels with pending items once, starting with those
+// homed at this tracing thread, accounting the items processed, the time
+// it took and the backlog seen in hpcrun's statistics. returns the number
+// of items processed
+static long
+consume_trace_channel_set
+(
+ gpu_trace_channel_set_t *channel_set,
+ size_t worker
+)
+{
+  long backlog = gpu_trace_channel_set_backlog(channel_set);
+  if (backlog == 0) return 0;
+
+  hpcrun_stats_gpu_trace_depth_sample(backlog);
+
+  long count = 0;
+  uint64_t start = hpcrun_nanotime();
+  long stolen = gpu_trace_channel_set_drain(channel_set, worker,
+    gpu_trace_demultiplexer_threads(), consume_trace_channel, &count);
+  if (count > 0) {
+    hpcrun_stats_gpu_trace_items_add(count, hpcrun_nanotime() - start);
+  }
+  if (stolen > 0) {
+    hpcrun_stats_gpu_trace_steals_add(stolen);
+  }
+  return count;
 }
 
 
@@ -420,24 +476,42 @@ gpu_trace_fini
 }
 
 
-// Tracing thread
+// Tracing thread: one of the pool serving every stream's channel
 void *
 gpu_trace_record_thread_fn
 (
  void * args
 )
 {
-  gpu_trace_channel_set_t *channel_set = (gpu_trace_channel_set_t *) args;
+  size_t worker = (size_t)(uintptr_t) args;
+  gpu_trace_channel_set_t *channel_set = gpu_trace_demultiplexer_channel_set();
 
   hpcrun_thread_init_mem_pool_once(TOOL_THREAD_ID, NULL, HPCRUN_NO_TRACE, true);
 
+  int idle = 0;
   while (!atomic_load(&stop_trace_flag)) {
     gpu_trace_channel_set_await(channel_set);
-    gpu_trace_channel_set_apply(channel_set, consume_trace_channel, NULL);
+    if (consume_trace_channel_set(channel_set, worker) > 0) {
+      idle = 0;
+    } else if (++idle >= TRACE_THREAD_IDLE_PASSES
+               && gpu_trace_demultiplexer_retire(worker)) {
+      // parked until the pool grows back or tracing stops
+      while (!atomic_load(&stop_trace_flag)
+             && !gpu_trace_demultiplexer_park(worker));
+      idle = 0;
+      continue;
+    }
+    gpu_trace_demultiplexer_balance();
   }
 
-  gpu_trace_channel_set_apply(channel_set, consume_trace_channel, NULL);
-  gpu_trace_channel_set_apply(channel_set, gpu_trace_channel_release, NULL);
+  consume_trace_channel_set(channel_set, worker);
+
+  if (gpu_trace_demultiplexer_exit()) {
+    // the last tracing thread drains whatever the others left behind
+    // and closes every stream
+    consume_trace_channel_set(channel_set, worker);
+    gpu_trace_channel_set_apply(channel_set, gpu_trace_channel_release, NULL);
+  }
 
   return NULL;
 }
@@ -45,8 +45,6 @@
 // macros
 //******************************************************************************
 
-#define BASE(DERIVED) (&DERIVED->base)
-
 #define SECONDS_UNTIL_WAKEUP 1
 #define UNPROCESSED_TARGET_COUNT 100
 
@@ -58,13 +56,16 @@
 
 #define _GNU_SOURCE
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
 #include "../../../../lib/prof-lean/collections/concurrent-stack-entry-data.h"
 
 #include "../../thread_data.h"
 #include "../../memory/hpcrun-malloc.h"
 
-#include "../common/base-channel-set.h"
-
 #include "gpu-trace-channel.h"
 #include "gpu-trace-channel-set.h"
 
@@ -80,6 +81,18 @@
 typedef struct channel_stack_entry_t {
   CONCURRENT_STACK_ENTRY_DATA(struct channel_stack_entry_t);
   gpu_trace_channel_t *channel;
+  struct gpu_trace_channel_set_t *channel_set;
+
+  // position in the set; determines the tracing thread that drains the
+  // channel first
+  size_t index;
+
+  // items sent to the channel but not yet consumed
+  atomic_long pending;
+
+  // set while a tracing thread drains the channel. a channel has a single
+  // consumer at any time, which preserves the order of its trace items
+  atomic_flag busy;
 } channel_stack_entry_t;
 
 
@@ -94,8 +107,14 @@ typedef struct channel_stack_entry_t {
 //******************************************************************************
 
 typedef struct gpu_trace_channel_set_t {
-  base_channel_set_t base;
   channel_stack_t channels;
+  atomic_size_t size;
+
+  // items pending over all channels
+  atomic_long backlog;
+
+  pthread_mutex_t mtx;
+  pthread_cond_t cond_var;
 } gpu_trace_channel_set_t;
 
 
@@ -105,11 +124,52 @@ typedef struct apply_callback_helper_data_t {
 } apply_callback_helper_data_t;
 
 
+typedef struct drain_callback_helper_data_t {
+  void (*apply_fn)(gpu_trace_channel_t *, void *);
+  void *arg;
+  size_t worker;
+  size_t workers;
+  bool home;
+  long stolen;
+} drain_callback_helper_data_t;
+
+
 
 //******************************************************************************
 // private operations
 //******************************************************************************
 
+static void
+on_send_callback
+(
+ void *arg
+)
+{
+  channel_stack_entry_t *entry = arg;
+  gpu_trace_channel_set_t *channel_set = entry->channel_set;
+
+  atomic_fetch_add(&entry->pending, 1);
+  long backlog = atomic_fetch_add(&channel_set->backlog, 1) + 1;
+
+  if (backlog == UNPROCESSED_TARGET_COUNT) {
+    pthread_cond_signal(&channel_set->cond_var);
+  }
+}
+
+
+static void
+on_receive_callback
+(
+ void *arg
+)
+{
+  channel_stack_entry_t *entry = arg;
+
+  atomic_fetch_add(&entry->pending, -1);
+  atomic_fetch_add(&entry->channel_set->backlog, -1);
+}
+
+
 static void
 apply_callback_helper
 (
@@ -122,6 +182,32 @@ apply_callback_helper
 }
 
 
+static void
+drain_callback_helper
+(
+ channel_stack_entry_t *entry,
+ void *arg
+)
+{
+  drain_callback_helper_data_t *data = arg;
+
+  bool home = entry->index % data->workers == data->worker;
+  if (home != data->home || atomic_load(&entry->pending) == 0) {
+    return;
+  }
+
+  // another tracing thread is draining this channel
+  if (atomic_flag_test_and_set(&entry->busy)) {
+    return;
+  }
+
+  data->apply_fn(entry->channel, data->arg);
+  atomic_flag_clear(&entry->busy);
+
+  if (!home) data->stolen++;
+}
+
+
 
 //******************************************************************************
 // interface operations
@@ -130,45 +216,57 @@ apply_callback_helper
 gpu_trace_channel_set_t *
 gpu_trace_channel_set_new
 (
- size_t max_channels
+ void
 )
 {
   gpu_trace_channel_set_t *channel_set
     = hpcrun_malloc_safe(sizeof(gpu_trace_channel_set_t));
 
-  base_channel_set_init(BASE(channel_set), max_channels, UNPROCESSED_TARGET_COUNT);
   channel_stack_init(&channel_set->channels);
+  atomic_init(&channel_set->size, 0);
+  atomic_init(&channel_set->backlog, 0);
+  pthread_mutex_init(&channel_set->mtx, NULL);
+  pthread_cond_init(&channel_set->cond_var, NULL);
 
   return channel_set;
 }
 
 
-_Bool
+void
 gpu_trace_channel_set_add
 (
  gpu_trace_channel_set_t *channel_set,
  gpu_trace_channel_t *channel
 )
 {
-  if (!base_channel_set_add(BASE(channel_set))) {
-    return 0;
-  }
-
-  /* Register callbacks*/
-  gpu_trace_channel_init_on_send_callback(channel,
-    base_channel_set_on_send_callback, BASE(channel_set));
-  gpu_trace_channel_init_on_receive_callback(channel,
-    base_channel_set_on_receive_callback, BASE(channel_set));
-
   /* Allocate a new channel entry and add it to the stack*/
   /* TODO(Srdjan): Who should allocate memory? (this can be invoked from multiple threads)*/
   channel_stack_entry_t *channel_entry
     = hpcrun_malloc_safe(sizeof(channel_stack_entry_t));
 
   channel_entry->channel = channel;
+  channel_entry->channel_set = channel_set;
+  channel_entry->index = atomic_fetch_add(&channel_set->size, 1);
+  atomic_init(&channel_entry->pending, 0);
+  atomic_flag_clear(&channel_entry->busy);
+
+  /* Register callbacks*/
+  gpu_trace_channel_init_on_send_callback(channel,
+    on_send_callback, channel_entry);
+  gpu_trace_channel_init_on_receive_callback(channel,
+    on_receive_callback, channel_entry);
+
   channel_stack_push(&channel_set->channels, channel_entry);
+}
 
-  return 1;
+
+long
+gpu_trace_channel_set_backlog
+(
+ gpu_trace_channel_set_t *channel_set
+)
+{
+  return atomic_load(&channel_set->backlog);
 }
 
 
@@ -178,7 +276,19 @@ gpu_trace_channel_set_await
  gpu_trace_channel_set_t *channel_set
 )
 {
-  base_channel_set_await(BASE(channel_set), SECONDS_UNTIL_WAKEUP * 1000000);
+  if (atomic_load(&channel_set->backlog) >= UNPROCESSED_TARGET_COUNT) {
+    return;
+  }
+
+  /* Wait until signaled or timeout expires */
+  pthread_mutex_lock(&channel_set->mtx);
+
+  struct timespec time;
+  clock_gettime(CLOCK_REALTIME, &time);
+  time.tv_sec += SECONDS_UNTIL_WAKEUP;
+  pthread_cond_timedwait(&channel_set->cond_var, &channel_set->mtx, &time);
+
+  pthread_mutex_unlock(&channel_set->mtx);
 }
 
 
@@ -188,7 +298,46 @@ gpu_trace_channel_set_notify
  gpu_trace_channel_set_t *channel_set
 )
 {
-  base_channel_set_notify(BASE(channel_set));
+  pthread_cond_signal(&channel_set->cond_var);
+}
+
+
+void
+gpu_trace_channel_set_notify_all
+(
+ gpu_trace_channel_set_t *channel_set
+)
+{
+  pthread_cond_broadcast(&channel_set->cond_var);
+}
+
+
+long
+gpu_trace_channel_set_drain
+(
+ gpu_trace_channel_set_t *channel_set,
+ size_t worker,
+ size_t workers,
+ void (*apply_fn)(gpu_trace_channel_t *, void *),
+ void *arg
+)
+{
+  drain_callback_helper_data_t data = {
+    .apply_fn = apply_fn,
+    .arg = arg,
+    .worker = worker,
+    .workers = workers > 0 ? workers : 1,
+    .home = true,
+    .stolen = 0
+  };
+
+  // first the channels homed at this thread, then any other channel with
+  // pending items that no tracing thread is draining
+  channel_stack_for_each(&channel_set->channels, drain_callback_helper, &data);
+  data.home = false;
+  channel_stack_for_each(&channel_set->channels, drain_callback_helper, &data);
+
+  return data.stolen;
 }
 
 
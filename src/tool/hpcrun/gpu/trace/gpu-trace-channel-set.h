@@ -66,14 +66,14 @@ typedef struct gpu_trace_channel_set_t gpu_trace_channel_set_t;
 //******************************************************************************
 
 /**
- * @brief Allocates and initializes a channel set that can store up to
- * \p max_channels channels.
+ * @brief Allocates and initializes a channel set shared by all tracing
+ * threads. The set is unbounded.
  * @return the newly allocated channel_set
  */
 gpu_trace_channel_set_t *
 gpu_trace_channel_set_new
 (
- size_t max_channels
+ void
 );
 
 
@@ -91,8 +91,38 @@ gpu_trace_channel_set_apply
 
 
 /**
- * @brief Waits until new messages arrived to the channels
- * or the channel is signaled.
+ * @brief Calls \p apply_fn on each channel with pending trace items that no
+ * other tracing thread is draining. Channels homed at \p worker (of
+ * \p workers) are visited first; the rest are stolen from other threads.
+ * A channel is drained by at most one thread at a time, so the order of
+ * its trace items is preserved.
+ * @return the number of channels drained that were homed elsewhere
+ */
+long
+gpu_trace_channel_set_drain
+(
+ gpu_trace_channel_set_t *channel_set,
+ size_t worker,
+ size_t workers,
+ void (*apply_fn)(gpu_trace_channel_t *, void *),
+ void *arg
+);
+
+
+/**
+ * @brief Returns the number of trace items sent to channels in
+ * \p channel_set but not yet consumed.
+ */
+long
+gpu_trace_channel_set_backlog
+(
+ gpu_trace_channel_set_t *channel_set
+);
+
+
+/**
+ * @brief Waits until enough new messages arrived to the channels
+ * or the channel set is signaled.
  */
 void
 gpu_trace_channel_set_await
@@ -102,7 +132,7 @@ gpu_trace_channel_set_await
 
 
 /**
- * @brief Signals \p channel_set to process its channels
+ * @brief Signals one tracing thread waiting on \p channel_set
 */
 void
 gpu_trace_channel_set_notify
@@ -112,16 +142,27 @@ gpu_trace_channel_set_notify
 
 
 /**
- * @brief Adds \p channel to \p channel_set. If \p channel cannot be added,
- * the method returns false, otherwise, it returns true.
+ * @brief Signals every tracing thread waiting on \p channel_set
+*/
+void
+gpu_trace_channel_set_notify_all
+(
+ gpu_trace_channel_set_t *channel_set
+);
+
+
+/**
+ * @brief Adds \p channel to \p channel_set.
  *
  * Thread-safe
 */
-_Bool
+void
 gpu_trace_channel_set_add
 (
  gpu_trace_channel_set_t *channel_set,
  gpu_trace_channel_t *channel
 );
 
+
+
 #endif
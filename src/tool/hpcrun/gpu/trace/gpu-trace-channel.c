@@ -49,8 +49,10 @@
 
 #include "../../../../lib/prof-lean/collections/mpsc-queue-entry-data.h"
 
+#include "../../hpcrun_stats.h"
 #include "../../thread_data.h"
 #include "../../memory/hpcrun-malloc.h"
+#include "../../utilities/hpcrun-nanotime.h"
 
 #include "gpu-trace-channel.h"
 #include "gpu-trace-item.h"
@@ -64,6 +66,7 @@
 typedef struct mpscq_entry_t {
   MPSC_QUEUE_ENTRY_DATA(struct mpscq_entry_t);
   gpu_trace_item_t trace_item;
+  uint64_t send_time;
 } mpscq_entry_t;
 
 
@@ -182,6 +185,7 @@ gpu_trace_channel_send
 {
   mpscq_entry_t *entry = mpscq_allocate(get_local_allocator());
   entry->trace_item = *trace_item;
+  entry->send_time = hpcrun_nanotime();
 
   gpu_trace_item_dump(&entry->trace_item, "PRODUCE");
 
@@ -201,12 +205,19 @@ gpu_trace_channel_receive_all
  void *arg
 )
 {
+  uint64_t latency_total = 0;
+  uint64_t latency_max = 0;
+
   for (;;) {
     mpscq_entry_t *entry = mpscq_dequeue(&channel->mpsc_queue);
     if (entry == NULL) {
       break;
     }
 
+    uint64_t latency = hpcrun_nanotime() - entry->send_time;
+    latency_total += latency;
+    if (latency > latency_max) latency_max = latency;
+
     receive_fn(&entry->trace_item, channel->thread_data, arg);
     gpu_trace_item_dump(&entry->trace_item, "CONSUME");
     mpscq_deallocate(entry);
@@ -215,4 +226,8 @@ gpu_trace_channel_receive_all
       channel->on_receive_fn(channel->on_receive_arg);
     }
   }
+
+  if (latency_total > 0) {
+    hpcrun_stats_gpu_trace_latency_add(latency_total, latency_max);
+  }
 }
@@ -49,6 +49,10 @@
 
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 
 
 
@@ -56,10 +60,8 @@
 // local includes
 //******************************************************************************
 
-#include "../../../../lib/prof-lean/collections/concurrent-stack-entry-data.h"
-
 #include "../../control-knob.h"
-#include "../../memory/hpcrun-malloc.h"
+#include "../../hpcrun_stats.h"
 #include "../../messages/messages.h"
 #include "../../libmonitor/monitor.h"
 
@@ -73,30 +75,29 @@
 
 
 
-//******************************************************************************
-// generic code - macro expansions
-//******************************************************************************
-
-typedef struct channel_set_entry_t {
-  CONCURRENT_STACK_ENTRY_DATA(struct channel_set_entry_t);
-  gpu_trace_channel_set_t *channel_set;
-  pthread_t thread;
-} channel_set_entry_t;
-
-
-#define CONCURRENT_STACK_PREFIX         channel_set_stack
-#define CONCURRENT_STACK_ENTRY_TYPE     channel_set_entry_t
-#include "../../../../lib/prof-lean/collections/concurrent-stack.h"
-
-
-
 //******************************************************************************
 // type declarations
 //******************************************************************************
 
+// every stream's channel lives in one set served by a pool of tracing
+// threads. the pool starts with a single thread and grows while the
+// backlog of undrained trace items exceeds backlog_per_thread for each
+// thread, up to max_threads. threads without work sleep on the set; the
+// newest thread retires once it has been idle for a while and the
+// backlog no longer calls for it, so the pool shrinks back as it grew.
+// a retired thread is parked rather than terminated and is woken again
+// when the pool grows back over its id, so at most max_threads threads
+// are ever created. threads counts the active threads, created those
+// that exist, active or parked; both change under lock.
 typedef struct trace_demux_t {
-  channel_set_stack_t channel_sets;
-  int streams_per_thread;
+  gpu_trace_channel_set_t *channel_set;
+  atomic_size_t threads;
+  atomic_size_t running;
+  size_t created;
+  size_t max_threads;
+  long backlog_per_thread;
+  pthread_mutex_t lock;
+  pthread_cond_t parked;
 } trace_demux_t;
 
 
@@ -114,23 +115,58 @@ trace_demux_t demux;
 // private operations
 //******************************************************************************
 
-static channel_set_entry_t *
-gpu_trace_channel_set_create
+// create the tracing thread with the next id, called with demux.lock
+// held (or before any thread exists). returns false if it could not be
+// created, in which case the pool is left as it was
+static bool
+gpu_trace_thread_create
 (
- int streams_per_thread
+ void
 )
 {
-  channel_set_entry_t *entry =
-    hpcrun_malloc_safe(sizeof(channel_set_entry_t));
+  size_t id = demux.created;
+  atomic_fetch_add(&demux.running, 1);
 
-  entry->channel_set = gpu_trace_channel_set_new(streams_per_thread);
+  /* Create a tracing thread, nobody joins it */
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
 
-  /* Create a tracing thread */
   monitor_disable_new_threads();
-  pthread_create(&entry->thread, NULL, gpu_trace_record_thread_fn, entry->channel_set);
+  pthread_t thread;
+  int ret = pthread_create(&thread, &attr, gpu_trace_record_thread_fn,
+                           (void *)(uintptr_t) id);
   monitor_enable_new_threads();
+  pthread_attr_destroy(&attr);
+
+  if (ret != 0) {
+    atomic_fetch_sub(&demux.running, 1);
+    EMSG("unable to create GPU tracing thread %zu: %s", id, strerror(ret));
+    return false;
+  }
+
+  demux.created++;
+  hpcrun_stats_gpu_trace_threads_inc();
+
+  PRINT("gpu_trace_thread_create: tracing thread %zu\n", id);
+  return true;
+}
 
-  return entry;
+
+static int
+demux_knob_get
+(
+ char *name,
+ int fallback
+)
+{
+  int value = fallback;
+  control_knob_value_get_int(name, &value);
+  if (value < 1) {
+    TMSG(TRACE, "ERROR: %s is less than 1 (%d)\n", name, value);
+    value = fallback;
+  }
+  return value;
 }
 
 
@@ -140,17 +176,17 @@ demux_init
  void
 )
 {
-  int streams_per_thread;
-  control_knob_value_get_int("STREAMS_PER_TRACING_THREAD", &streams_per_thread);
-  if (streams_per_thread < 1) {
-    TMSG(TRACE, "ERROR: STREAMS_PER_TRACING_THREAD is less than 1 (%d)\n", streams_per_thread);
-    streams_per_thread = 16;
-  }
-  PRINT("streams_per_thread = %d \n", streams_per_thread);
-
-  channel_set_stack_init(&demux.channel_sets);
-  channel_set_stack_push(&demux.channel_sets, gpu_trace_channel_set_create(streams_per_thread));
-  demux.streams_per_thread = streams_per_thread;
+  demux.max_threads = demux_knob_get("MAX_TRACING_THREADS", 8);
+  demux.backlog_per_thread = demux_knob_get("TRACING_THREAD_BACKLOG", 1000);
+  PRINT("max_threads = %zu, backlog_per_thread = %ld\n",
+        demux.max_threads, demux.backlog_per_thread);
+
+  demux.channel_set = gpu_trace_channel_set_new();
+  pthread_mutex_init(&demux.lock, NULL);
+  pthread_cond_init(&demux.parked, NULL);
+  demux.created = 0;
+  atomic_init(&demux.running, 0);
+  atomic_init(&demux.threads, gpu_trace_thread_create() ? 1 : 0);
 }
 
 
@@ -165,66 +201,172 @@ gpu_trace_demultiplexer_get
 }
 
 
-static void
-notify_iter_callback
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+void
+gpu_trace_demultiplexer_push
 (
- channel_set_entry_t *channel_set,
- void *arg
+ gpu_trace_channel_t *trace_channel
 )
 {
-  gpu_trace_channel_set_notify(channel_set->channel_set);
+  trace_demux_t *demux = gpu_trace_demultiplexer_get();
+
+  gpu_trace_channel_set_add(demux->channel_set, trace_channel);
+
+  PRINT("gpu_trace_demultiplexer_push: channel = %p\n", trace_channel);
 }
 
 
+void
+gpu_trace_demultiplexer_notify
+(
+ void
+)
+{
+  trace_demux_t *demux = gpu_trace_demultiplexer_get();
+  gpu_trace_channel_set_notify_all(demux->channel_set);
+
+  pthread_mutex_lock(&demux->lock);
+  pthread_cond_broadcast(&demux->parked);
+  pthread_mutex_unlock(&demux->lock);
+}
+
+
+gpu_trace_channel_set_t *
+gpu_trace_demultiplexer_channel_set
+(
+ void
+)
+{
+  return gpu_trace_demultiplexer_get()->channel_set;
+}
+
+
+size_t
+gpu_trace_demultiplexer_threads
+(
+ void
+)
+{
+  return atomic_load(&gpu_trace_demultiplexer_get()->threads);
+}
 
-//******************************************************************************
-// interface operations
-//******************************************************************************
 
 void
-gpu_trace_demultiplexer_push
+gpu_trace_demultiplexer_balance
 (
- gpu_trace_channel_t *trace_channel
+ void
 )
 {
-  static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
   trace_demux_t *demux = gpu_trace_demultiplexer_get();
 
-  gpu_trace_channel_set_t *channel_set =
-    channel_set_stack_top(&demux->channel_sets)->channel_set;
-
-  /* If all channel sets are full, create a new channel set.
-     Use mutex to ensure that exactly one new channel set is created. */
-  if (!gpu_trace_channel_set_add(channel_set, trace_channel)) {
-    pthread_mutex_lock(&mtx);
-
-    channel_set = channel_set_stack_top(&demux->channel_sets)->channel_set;
-    if (!gpu_trace_channel_set_add(channel_set, trace_channel)) {
-      /* Create a new channel set and push the current channel to it. Since no
-         other thread can access the new channel set, the push cannot fail. */
-      channel_set_entry_t *channel_set_entry =
-              gpu_trace_channel_set_create(demux->streams_per_thread);
-      channel_set = channel_set_entry->channel_set;
-      gpu_trace_channel_set_add(channel_set, trace_channel);
-
-      /* Make the newly created channel set visible for other threads. */
-      channel_set_stack_push(&demux->channel_sets, channel_set_entry);
+  long backlog = gpu_trace_channel_set_backlog(demux->channel_set);
+  if (backlog < demux->backlog_per_thread) {
+    return;
+  }
+
+  size_t threads = atomic_load(&demux->threads);
+  if (backlog > demux->backlog_per_thread * (long) threads
+      && threads < demux->max_threads) {
+    pthread_mutex_lock(&demux->lock);
+    // only one of the threads that see the same pool size grows it
+    bool grown = false;
+    if (atomic_load(&demux->threads) == threads) {
+      if (threads < demux->created) {
+        // a parked thread has the next id, put it back to work
+        grown = true;
+        pthread_cond_broadcast(&demux->parked);
+      } else {
+        grown = gpu_trace_thread_create();
+      }
+      if (grown) {
+        atomic_store(&demux->threads, threads + 1);
+      }
     }
+    pthread_mutex_unlock(&demux->lock);
+    if (grown) {
+      return;
+    }
+  }
+
+  // wake a sleeping thread to help with the backlog
+  gpu_trace_channel_set_notify(demux->channel_set);
+}
+
+
+bool
+gpu_trace_demultiplexer_retire
+(
+ size_t worker
+)
+{
+  trace_demux_t *demux = gpu_trace_demultiplexer_get();
 
-    pthread_mutex_unlock(&mtx);
+  // only the newest thread retires, keeping the ids of the pool dense so
+  // that the remaining threads take over its home channels. the first
+  // thread never retires
+  if (worker == 0) {
+    return false;
   }
 
-  PRINT("gpu_trace_demultiplexer_push: channel_set = %p | channel = %p\n",
-        channel_set, trace_channel);
+  long backlog = gpu_trace_channel_set_backlog(demux->channel_set);
+  if (backlog >= demux->backlog_per_thread * (long) worker) {
+    return false;
+  }
+
+  pthread_mutex_lock(&demux->lock);
+  bool retired = (atomic_load(&demux->threads) == worker + 1);
+  if (retired) {
+    atomic_store(&demux->threads, worker);
+  }
+  pthread_mutex_unlock(&demux->lock);
+  if (!retired) {
+    return false;
+  }
+
+  hpcrun_stats_gpu_trace_retired_inc();
+
+  // the items still homed at this thread now belong to another one
+  if (backlog > 0) {
+    gpu_trace_channel_set_notify(demux->channel_set);
+  }
+
+  PRINT("gpu_trace_demultiplexer_retire: tracing thread %zu\n", worker);
+  return true;
 }
 
 
-void
-gpu_trace_demultiplexer_notify
+bool
+gpu_trace_demultiplexer_park
 (
- void
+ size_t worker
 )
 {
   trace_demux_t *demux = gpu_trace_demultiplexer_get();
-  channel_set_stack_for_each(&demux->channel_sets, notify_iter_callback, NULL);
+
+  pthread_mutex_lock(&demux->lock);
+  if (atomic_load(&demux->threads) <= worker) {
+    // timed, so that termination is observed even if its wakeup is missed
+    struct timespec time;
+    clock_gettime(CLOCK_REALTIME, &time);
+    time.tv_sec += 1;
+    pthread_cond_timedwait(&demux->parked, &demux->lock, &time);
+  }
+  bool active = (atomic_load(&demux->threads) > worker);
+  pthread_mutex_unlock(&demux->lock);
+
+  return active;
+}
+
+
+bool
+gpu_trace_demultiplexer_exit
+(
+ void
+)
+{
+  return atomic_fetch_sub(&gpu_trace_demultiplexer_get()->running, 1) == 1;
 }
@@ -49,6 +49,8 @@
 //******************************************************************************
 
 #include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 
 
@@ -58,6 +60,13 @@
 //******************************************************************************
 
 #include "gpu-trace-channel.h"
+#include "gpu-trace-channel-set.h"
+
+
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
 
 
 void
@@ -67,6 +76,7 @@ gpu_trace_demultiplexer_push
 );
 
 
+// wake every tracing thread, e.g. to observe termination
 void
 gpu_trace_demultiplexer_notify
 (
@@ -74,4 +84,57 @@ gpu_trace_demultiplexer_notify
 );
 
 
+// the channel set that holds every stream's trace channel
+gpu_trace_channel_set_t *
+gpu_trace_demultiplexer_channel_set
+(
+ void
+);
+
+
+// current size of the tracing thread pool
+size_t
+gpu_trace_demultiplexer_threads
+(
+ void
+);
+
+
+// called by a tracing thread after each pass over the channels: grow the
+// pool or wake an idle thread if the backlog calls for it
+void
+gpu_trace_demultiplexer_balance
+(
+ void
+);
+
+
+// called by an idle tracing thread: returns true if the thread has left
+// the pool because the backlog no longer needs it, in which case it must
+// park with gpu_trace_demultiplexer_park until the pool takes it back
+bool
+gpu_trace_demultiplexer_retire
+(
+ size_t worker
+);
+
+
+// called by a retired tracing thread: waits (at most a second) for the
+// pool to grow back over the thread's id and returns true if it has
+bool
+gpu_trace_demultiplexer_park
+(
+ size_t worker
+);
+
+
+// called by a tracing thread as it terminates; returns true for the last
+// thread of the pool, which is responsible for releasing the streams
+bool
+gpu_trace_demultiplexer_exit
+(
+ void
+);
+
+
 #endif
@@ -81,12 +81,45 @@ static atomic_long trolled = 0;
 static atomic_long frames_total = 0;
 static atomic_long trolled_frames = 0;
 static atomic_long frames_libfail_total = 0;
+static atomic_long frames_fp = 0;
+static atomic_long frames_fp_fallback = 0;
+static atomic_long frames_fp_mismatch = 0;
+static atomic_long recipe_table_checked = 0;
+static atomic_long recipe_table_mismatch = 0;
 
 static atomic_long acc_trace_records = 0;
 static atomic_long acc_trace_records_dropped = 0;
 static atomic_long acc_samples = 0;
 static atomic_long acc_samples_dropped = 0;
 
+static atomic_long gpu_operations = 0;
+static atomic_long gpu_operations_nsec = 0;
+static atomic_long gpu_trace_items = 0;
+static atomic_long gpu_trace_items_nsec = 0;
+static atomic_long gpu_trace_latency_nsec = 0;
+static atomic_long gpu_trace_latency_max = 0;
+static atomic_long gpu_trace_depth_total = 0;
+static atomic_long gpu_trace_depth_samples = 0;
+static atomic_long gpu_trace_depth_max = 0;
+static atomic_long gpu_trace_threads = 0;
+static atomic_long gpu_trace_retired = 0;
+static atomic_long gpu_trace_steals = 0;
+
+static atomic_long ompt_regions_resolved = 0;
+static atomic_long ompt_region_batches = 0;
+static atomic_long ompt_region_latency_nsec = 0;
+static atomic_long ompt_region_latency_max = 0;
+static atomic_long ompt_pending_regions_max = 0;
+
+static atomic_long sample_ring_staged = 0;
+static atomic_long sample_ring_drains = 0;
+static atomic_long sample_ring_dropped = 0;
+
+static atomic_long cct_path_frames = 0;
+static atomic_long cct_path_reused = 0;
+static atomic_long cct_path_verified = 0;
+static atomic_long cct_path_mismatch = 0;
+
 //***************************************************************************
 // interface operations
 //***************************************************************************
@@ -107,12 +140,45 @@ hpcrun_stats_reinit(void)
   atomic_store_explicit(&frames_total, 0, memory_order_relaxed);
   atomic_store_explicit(&trolled_frames, 0, memory_order_relaxed);
   atomic_store_explicit(&frames_libfail_total, 0, memory_order_relaxed);
+  atomic_store_explicit(&frames_fp, 0, memory_order_relaxed);
+  atomic_store_explicit(&frames_fp_fallback, 0, memory_order_relaxed);
+  atomic_store_explicit(&frames_fp_mismatch, 0, memory_order_relaxed);
+  atomic_store_explicit(&recipe_table_checked, 0, memory_order_relaxed);
+  atomic_store_explicit(&recipe_table_mismatch, 0, memory_order_relaxed);
 
   atomic_store_explicit(&acc_trace_records, 0, memory_order_relaxed);
   atomic_store_explicit(&acc_trace_records_dropped, 0, memory_order_relaxed);
 
   atomic_store_explicit(&acc_samples, 0, memory_order_relaxed);
   atomic_store_explicit(&acc_samples_dropped, 0, memory_order_relaxed);
+
+  atomic_store_explicit(&gpu_operations, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_operations_nsec, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_trace_items, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_trace_items_nsec, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_trace_latency_nsec, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_trace_latency_max, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_trace_depth_total, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_trace_depth_samples, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_trace_depth_max, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_trace_threads, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_trace_retired, 0, memory_order_relaxed);
+  atomic_store_explicit(&gpu_trace_steals, 0, memory_order_relaxed);
+
+  atomic_store_explicit(&ompt_regions_resolved, 0, memory_order_relaxed);
+  atomic_store_explicit(&ompt_region_batches, 0, memory_order_relaxed);
+  atomic_store_explicit(&ompt_region_latency_nsec, 0, memory_order_relaxed);
+  atomic_store_explicit(&ompt_region_latency_max, 0, memory_order_relaxed);
+  atomic_store_explicit(&ompt_pending_regions_max, 0, memory_order_relaxed);
+
+  atomic_store_explicit(&sample_ring_staged, 0, memory_order_relaxed);
+  atomic_store_explicit(&sample_ring_drains, 0, memory_order_relaxed);
+  atomic_store_explicit(&sample_ring_dropped, 0, memory_order_relaxed);
+
+  atomic_store_explicit(&cct_path_frames, 0, memory_order_relaxed);
+  atomic_store_explicit(&cct_path_reused, 0, memory_order_relaxed);
+  atomic_store_explicit(&cct_path_verified, 0, memory_order_relaxed);
+  atomic_store_explicit(&cct_path_mismatch, 0, memory_order_relaxed);
 }
 
 
@@ -404,6 +470,78 @@ hpcrun_stats_frames_libfail_total(void)
   return atomic_load_explicit(&frames_libfail_total, memory_order_relaxed);
 }
 
+//---------------------------------------------------------------------
+// (unwind) frames stepped by the frame pointer fast path, frames where
+// it fell back to the recipe unwinder, and frames where the recipe
+// unwinder disagreed with it (only checked with UNWIND_FP_VERIFY)
+//---------------------------------------------------------------------
+
+void
+hpcrun_stats_frames_fp_inc(long amt)
+{
+  atomic_fetch_add_explicit(&frames_fp, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_frames_fp(void)
+{
+  return atomic_load_explicit(&frames_fp, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_frames_fp_fallback_inc(long amt)
+{
+  atomic_fetch_add_explicit(&frames_fp_fallback, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_frames_fp_fallback(void)
+{
+  return atomic_load_explicit(&frames_fp_fallback, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_frames_fp_mismatch_inc(long amt)
+{
+  atomic_fetch_add_explicit(&frames_fp_mismatch, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_frames_fp_mismatch(void)
+{
+  return atomic_load_explicit(&frames_fp_mismatch, memory_order_relaxed);
+}
+
+//---------------------------------------------------------------------
+// functions whose intervals were built from an unwind recipe table and
+// checked against the instruction analysis, and functions where the two
+// disagree (only checked with UNWIND_RECIPES_VERIFY)
+//---------------------------------------------------------------------
+
+void
+hpcrun_stats_recipe_table_checked_inc(long amt)
+{
+  atomic_fetch_add_explicit(&recipe_table_checked, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_recipe_table_checked(void)
+{
+  return atomic_load_explicit(&recipe_table_checked, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_recipe_table_mismatch_inc(long amt)
+{
+  atomic_fetch_add_explicit(&recipe_table_mismatch, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_recipe_table_mismatch(void)
+{
+  return atomic_load_explicit(&recipe_table_mismatch, memory_order_relaxed);
+}
+
 //---------------------------------------------------------------------
 // total number of (unwind) frames in sample set that employed trolling
 //---------------------------------------------------------------------
@@ -436,6 +574,290 @@ hpcrun_stats_num_samples_yielded(void)
   return atomic_load_explicit(&num_samples_yielded, memory_order_relaxed);
 }
 
+//------------------------------------------------------
+// GPU operations processed by the monitoring thread
+//------------------------------------------------------
+
+void
+hpcrun_stats_gpu_operations_add(long count, long nsec)
+{
+  atomic_fetch_add_explicit(&gpu_operations, count, memory_order_relaxed);
+  atomic_fetch_add_explicit(&gpu_operations_nsec, nsec, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_gpu_operations(void)
+{
+  return atomic_load_explicit(&gpu_operations, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_gpu_operations_nsec(void)
+{
+  return atomic_load_explicit(&gpu_operations_nsec, memory_order_relaxed);
+}
+
+//------------------------------------------------------
+// GPU trace items processed by the tracing threads
+//------------------------------------------------------
+
+void
+hpcrun_stats_gpu_trace_items_add(long count, long nsec)
+{
+  atomic_fetch_add_explicit(&gpu_trace_items, count, memory_order_relaxed);
+  atomic_fetch_add_explicit(&gpu_trace_items_nsec, nsec, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_gpu_trace_items(void)
+{
+  return atomic_load_explicit(&gpu_trace_items, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_gpu_trace_items_nsec(void)
+{
+  return atomic_load_explicit(&gpu_trace_items_nsec, memory_order_relaxed);
+}
+
+static void
+stats_max_update(atomic_long *max, long value)
+{
+  long cur = atomic_load_explicit(max, memory_order_relaxed);
+  while (value > cur &&
+         !atomic_compare_exchange_weak_explicit(max, &cur, value,
+             memory_order_relaxed, memory_order_relaxed));
+}
+
+//------------------------------------------------------
+// GPU trace items: time from send to consumption
+//------------------------------------------------------
+
+void
+hpcrun_stats_gpu_trace_latency_add(long nsec_total, long nsec_max)
+{
+  atomic_fetch_add_explicit(&gpu_trace_latency_nsec, nsec_total, memory_order_relaxed);
+  stats_max_update(&gpu_trace_latency_max, nsec_max);
+}
+
+long
+hpcrun_stats_gpu_trace_latency_nsec(void)
+{
+  return atomic_load_explicit(&gpu_trace_latency_nsec, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_gpu_trace_latency_max(void)
+{
+  return atomic_load_explicit(&gpu_trace_latency_max, memory_order_relaxed);
+}
+
+//------------------------------------------------------
+// GPU trace backlog seen by the tracing threads
+//------------------------------------------------------
+
+void
+hpcrun_stats_gpu_trace_depth_sample(long depth)
+{
+  atomic_fetch_add_explicit(&gpu_trace_depth_total, depth, memory_order_relaxed);
+  atomic_fetch_add_explicit(&gpu_trace_depth_samples, 1L, memory_order_relaxed);
+  stats_max_update(&gpu_trace_depth_max, depth);
+}
+
+long
+hpcrun_stats_gpu_trace_depth_max(void)
+{
+  return atomic_load_explicit(&gpu_trace_depth_max, memory_order_relaxed);
+}
+
+//------------------------------------------------------
+// GPU tracing threads started and retired, and streams
+// drained by a tracing thread other than the stream's
+// home thread
+//------------------------------------------------------
+
+void
+hpcrun_stats_gpu_trace_threads_inc(void)
+{
+  atomic_fetch_add_explicit(&gpu_trace_threads, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_gpu_trace_threads(void)
+{
+  return atomic_load_explicit(&gpu_trace_threads, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_gpu_trace_retired_inc(void)
+{
+  atomic_fetch_add_explicit(&gpu_trace_retired, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_gpu_trace_retired(void)
+{
+  return atomic_load_explicit(&gpu_trace_retired, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_gpu_trace_steals_add(long count)
+{
+  atomic_fetch_add_explicit(&gpu_trace_steals, count, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_gpu_trace_steals(void)
+{
+  return atomic_load_explicit(&gpu_trace_steals, memory_order_relaxed);
+}
+
+//------------------------------------------------------
+// OMPT deferred contexts: regions resolved and their
+// latency from registration, batches of resolutions,
+// and the most regions pending for one thread
+//------------------------------------------------------
+
+void
+hpcrun_stats_ompt_region_resolved(long nsec)
+{
+  atomic_fetch_add_explicit(&ompt_regions_resolved, 1L, memory_order_relaxed);
+  atomic_fetch_add_explicit(&ompt_region_latency_nsec, nsec, memory_order_relaxed);
+  stats_max_update(&ompt_region_latency_max, nsec);
+}
+
+long
+hpcrun_stats_ompt_regions_resolved(void)
+{
+  return atomic_load_explicit(&ompt_regions_resolved, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_ompt_region_latency_max(void)
+{
+  return atomic_load_explicit(&ompt_region_latency_max, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_ompt_region_batch_inc(void)
+{
+  atomic_fetch_add_explicit(&ompt_region_batches, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_ompt_region_batches(void)
+{
+  return atomic_load_explicit(&ompt_region_batches, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_ompt_pending_regions_sample(long pending)
+{
+  stats_max_update(&ompt_pending_regions_max, pending);
+}
+
+long
+hpcrun_stats_ompt_pending_regions_max(void)
+{
+  return atomic_load_explicit(&ompt_pending_regions_max, memory_order_relaxed);
+}
+
+//------------------------------------------------------
+// sample ring: samples staged for deferred insertion,
+// drains of the ring, and samples dropped because the
+// ring was full
+//------------------------------------------------------
+
+void
+hpcrun_stats_sample_ring_staged_inc(void)
+{
+  atomic_fetch_add_explicit(&sample_ring_staged, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_sample_ring_staged(void)
+{
+  return atomic_load_explicit(&sample_ring_staged, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_sample_ring_drain_inc(void)
+{
+  atomic_fetch_add_explicit(&sample_ring_drains, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_sample_ring_drains(void)
+{
+  return atomic_load_explicit(&sample_ring_drains, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_sample_ring_dropped_inc(void)
+{
+  atomic_fetch_add_explicit(&sample_ring_dropped, 1L, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_sample_ring_dropped(void)
+{
+  return atomic_load_explicit(&sample_ring_dropped, memory_order_relaxed);
+}
+
+//------------------------------------------------------
+// cct path reuse: frames inserted into the cct and those
+// whose nodes were reused from the previous insertion
+//------------------------------------------------------
+
+void
+hpcrun_stats_cct_path_frames_add(long frames, long reused)
+{
+  atomic_fetch_add_explicit(&cct_path_frames, frames, memory_order_relaxed);
+  atomic_fetch_add_explicit(&cct_path_reused, reused, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_cct_path_frames(void)
+{
+  return atomic_load_explicit(&cct_path_frames, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_cct_path_reused(void)
+{
+  return atomic_load_explicit(&cct_path_reused, memory_order_relaxed);
+}
+
+//------------------------------------------------------
+// cct path reuse: insertions that reused nodes and were
+// checked against a lookup from the root, and those
+// that disagreed (only checked with CCT_PATH_VERIFY)
+//------------------------------------------------------
+
+void
+hpcrun_stats_cct_path_verified_inc(long amt)
+{
+  atomic_fetch_add_explicit(&cct_path_verified, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_cct_path_verified(void)
+{
+  return atomic_load_explicit(&cct_path_verified, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_cct_path_mismatch_inc(long amt)
+{
+  atomic_fetch_add_explicit(&cct_path_mismatch, amt, memory_order_relaxed);
+}
+
+long
+hpcrun_stats_cct_path_mismatch(void)
+{
+  return atomic_load_explicit(&cct_path_mismatch, memory_order_relaxed);
+}
+
 //-----------------------------
 // print summary
 //-----------------------------
@@ -462,6 +884,12 @@ hpcrun_stats_print_summary(void)
   long cpu_intervals_total = atomic_load_explicit(&num_unwind_intervals_total, memory_order_relaxed);
   long cpu_intervals_susp = atomic_load_explicit(&num_unwind_intervals_suspicious, memory_order_relaxed);
 
+  long cpu_frames_fp = atomic_load_explicit(&frames_fp, memory_order_relaxed);
+  long cpu_frames_fp_fallback = atomic_load_explicit(&frames_fp_fallback, memory_order_relaxed);
+  long cpu_frames_fp_mismatch = atomic_load_explicit(&frames_fp_mismatch, memory_order_relaxed);
+  long cpu_recipe_table_checked = atomic_load_explicit(&recipe_table_checked, memory_order_relaxed);
+  long cpu_recipe_table_mismatch = atomic_load_explicit(&recipe_table_mismatch, memory_order_relaxed);
+
   long acc_samp = atomic_load_explicit(&acc_samples, memory_order_relaxed);
   long acc_samp_dropped = atomic_load_explicit(&acc_samples_dropped, memory_order_relaxed);
 
@@ -473,6 +901,18 @@ hpcrun_stats_print_summary(void)
   AMSG("UNWIND ANOMALIES: total: %ld errant: %ld, total-frames: %ld, total-libunwind-fails: %ld",
        cpu_total, cpu_dropped, cpu_frames, cpu_frames_libfail_total );
 
+  if (cpu_frames_fp + cpu_frames_fp_fallback > 0) {
+    AMSG("FRAME POINTER UNWIND: frames: %ld, fallbacks: %ld (%.1f%%), mismatches: %ld",
+         cpu_frames_fp, cpu_frames_fp_fallback,
+         100.0 * cpu_frames_fp_fallback / (cpu_frames_fp + cpu_frames_fp_fallback),
+         cpu_frames_fp_mismatch);
+  }
+
+  if (cpu_recipe_table_checked > 0) {
+    AMSG("UNWIND RECIPE TABLE: functions checked: %ld, mismatches: %ld",
+         cpu_recipe_table_checked, cpu_recipe_table_mismatch);
+  }
+
   AMSG("ACC SUMMARY:\n"
        "         accelerator trace records: %ld (processed: %ld, dropped: %ld)\n"
        "         accelerator samples: %ld (recorded: %ld, dropped: %ld)",
@@ -480,6 +920,65 @@ hpcrun_stats_print_summary(void)
        acc_samp + acc_samp_dropped, acc_samp, acc_samp_dropped
        );
 
+  long gpu_ops = atomic_load_explicit(&gpu_operations, memory_order_relaxed);
+  long gpu_ops_nsec = atomic_load_explicit(&gpu_operations_nsec, memory_order_relaxed);
+  long gpu_trace = atomic_load_explicit(&gpu_trace_items, memory_order_relaxed);
+  long gpu_trace_nsec = atomic_load_explicit(&gpu_trace_items_nsec, memory_order_relaxed);
+
+  if (gpu_ops > 0 || gpu_trace > 0) {
+    AMSG("GPU PIPELINE: operations: %ld (%.1f ns/operation), trace items: %ld (%.1f ns/item)",
+         gpu_ops, gpu_ops > 0 ? (double) gpu_ops_nsec / gpu_ops : 0.0,
+         gpu_trace, gpu_trace > 0 ? (double) gpu_trace_nsec / gpu_trace : 0.0);
+  }
+
+  long trace_threads = atomic_load_explicit(&gpu_trace_threads, memory_order_relaxed);
+  if (trace_threads > 0) {
+    long latency = atomic_load_explicit(&gpu_trace_latency_nsec, memory_order_relaxed);
+    long depth = atomic_load_explicit(&gpu_trace_depth_total, memory_order_relaxed);
+    long depth_samples = atomic_load_explicit(&gpu_trace_depth_samples, memory_order_relaxed);
+    AMSG("GPU TRACING: threads: %ld (%ld retired), steals: %ld, "
+         "backlog: %.1f avg %ld max, latency: %.1f us avg %.1f us max",
+         trace_threads, atomic_load_explicit(&gpu_trace_retired, memory_order_relaxed),
+         atomic_load_explicit(&gpu_trace_steals, memory_order_relaxed),
+         depth_samples > 0 ? (double) depth / depth_samples : 0.0,
+         atomic_load_explicit(&gpu_trace_depth_max, memory_order_relaxed),
+         gpu_trace > 0 ? (double) latency / gpu_trace / 1000 : 0.0,
+         atomic_load_explicit(&gpu_trace_latency_max, memory_order_relaxed) / 1000.0);
+  }
+
+  long ompt_resolved = atomic_load_explicit(&ompt_regions_resolved, memory_order_relaxed);
+  if (ompt_resolved > 0) {
+    long latency = atomic_load_explicit(&ompt_region_latency_nsec, memory_order_relaxed);
+    AMSG("OMPT DEFERRED CONTEXTS: regions resolved: %ld in %ld batches, backlog: %ld max, "
+         "latency: %.1f us avg %.1f us max",
+         ompt_resolved, atomic_load_explicit(&ompt_region_batches, memory_order_relaxed),
+         atomic_load_explicit(&ompt_pending_regions_max, memory_order_relaxed),
+         (double) latency / ompt_resolved / 1000,
+         atomic_load_explicit(&ompt_region_latency_max, memory_order_relaxed) / 1000.0);
+  }
+
+  long ring_staged = atomic_load_explicit(&sample_ring_staged, memory_order_relaxed);
+  long ring_dropped = atomic_load_explicit(&sample_ring_dropped, memory_order_relaxed);
+  if (ring_staged > 0 || ring_dropped > 0) {
+    AMSG("SAMPLE RING: staged: %ld, drains: %ld, dropped (ring full): %ld",
+         ring_staged, atomic_load_explicit(&sample_ring_drains, memory_order_relaxed),
+         ring_dropped);
+  }
+
+  long path_frames = atomic_load_explicit(&cct_path_frames, memory_order_relaxed);
+  if (path_frames > 0) {
+    long path_reused = atomic_load_explicit(&cct_path_reused, memory_order_relaxed);
+    AMSG("CCT PATH REUSE: frames: %ld, reused: %ld, looked up: %ld (%.2f per sample)",
+         path_frames, path_reused, path_frames - path_reused,
+         cpu_valid > 0 ? (double) (path_frames - path_reused) / cpu_valid : 0.0);
+  }
+
+  long path_verified = atomic_load_explicit(&cct_path_verified, memory_order_relaxed);
+  if (path_verified > 0) {
+    AMSG("CCT PATH REUSE VERIFY: paths checked: %ld, mismatches: %ld", path_verified,
+         atomic_load_explicit(&cct_path_mismatch, memory_order_relaxed));
+  }
+
   AMSG("SAMPLE ANOMALIES: blocks: %ld (async: %ld, dlopen: %ld), "
        "errors: %ld (segv: %ld, soft: %ld)",
        cpu_blocked, cpu_blocked_async, cpu_blocked_dlopen,
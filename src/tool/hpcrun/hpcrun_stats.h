@@ -188,6 +188,31 @@ long hpcrun_stats_frames_total(void);
 void hpcrun_stats_frames_libfail_total_inc(long amt);
 long hpcrun_stats_frames_libfail_total(void);
 
+//---------------------------------------------------------------------
+// (unwind) frames stepped by the frame pointer fast path, frames where
+// it fell back to the recipe unwinder, and frames where the two disagree
+//---------------------------------------------------------------------
+
+void hpcrun_stats_frames_fp_inc(long amt);
+long hpcrun_stats_frames_fp(void);
+
+void hpcrun_stats_frames_fp_fallback_inc(long amt);
+long hpcrun_stats_frames_fp_fallback(void);
+
+void hpcrun_stats_frames_fp_mismatch_inc(long amt);
+long hpcrun_stats_frames_fp_mismatch(void);
+
+//---------------------------------------------------------------------
+// functions with intervals from an unwind recipe table that were checked
+// against the instruction analysis, and functions where the two disagree
+//---------------------------------------------------------------------
+
+void hpcrun_stats_recipe_table_checked_inc(long amt);
+long hpcrun_stats_recipe_table_checked(void);
+
+void hpcrun_stats_recipe_table_mismatch_inc(long amt);
+long hpcrun_stats_recipe_table_mismatch(void);
+
 //---------------------------------------------------------------------
 // total number of (unwind) frames in sample set that employed trolling
 //---------------------------------------------------------------------
@@ -195,6 +220,95 @@ long hpcrun_stats_frames_libfail_total(void);
 void hpcrun_stats_trolled_frames_inc(long amt);
 long hpcrun_stats_trolled_frames(void);
 
+//------------------------------------------------------
+// GPU operations processed by the monitoring thread,
+// and the time spent processing them
+//------------------------------------------------------
+
+void hpcrun_stats_gpu_operations_add(long count, long nsec);
+long hpcrun_stats_gpu_operations(void);
+long hpcrun_stats_gpu_operations_nsec(void);
+
+//------------------------------------------------------
+// GPU trace items processed by the tracing threads,
+// and the time spent processing them
+//------------------------------------------------------
+
+void hpcrun_stats_gpu_trace_items_add(long count, long nsec);
+long hpcrun_stats_gpu_trace_items(void);
+long hpcrun_stats_gpu_trace_items_nsec(void);
+
+//------------------------------------------------------
+// GPU tracing thread pool: send-to-consume latency of
+// trace items, backlog seen when draining, threads
+// started and retired, and streams drained away from
+// their home
+//------------------------------------------------------
+
+void hpcrun_stats_gpu_trace_latency_add(long nsec_total, long nsec_max);
+long hpcrun_stats_gpu_trace_latency_nsec(void);
+long hpcrun_stats_gpu_trace_latency_max(void);
+
+void hpcrun_stats_gpu_trace_depth_sample(long depth);
+long hpcrun_stats_gpu_trace_depth_max(void);
+
+void hpcrun_stats_gpu_trace_threads_inc(void);
+long hpcrun_stats_gpu_trace_threads(void);
+
+void hpcrun_stats_gpu_trace_retired_inc(void);
+long hpcrun_stats_gpu_trace_retired(void);
+
+void hpcrun_stats_gpu_trace_steals_add(long count);
+long hpcrun_stats_gpu_trace_steals(void);
+
+//------------------------------------------------------
+// OMPT deferred contexts: regions resolved and their
+// latency from registration, batches of resolutions,
+// and the most regions pending for one thread
+//------------------------------------------------------
+
+void hpcrun_stats_ompt_region_resolved(long nsec);
+long hpcrun_stats_ompt_regions_resolved(void);
+long hpcrun_stats_ompt_region_latency_max(void);
+void hpcrun_stats_ompt_region_batch_inc(void);
+long hpcrun_stats_ompt_region_batches(void);
+void hpcrun_stats_ompt_pending_regions_sample(long pending);
+long hpcrun_stats_ompt_pending_regions_max(void);
+
+//------------------------------------------------------
+// sample ring: samples staged for deferred insertion,
+// drains of the ring, and samples dropped because the
+// ring was full
+//------------------------------------------------------
+
+void hpcrun_stats_sample_ring_staged_inc(void);
+long hpcrun_stats_sample_ring_staged(void);
+void hpcrun_stats_sample_ring_drain_inc(void);
+long hpcrun_stats_sample_ring_drains(void);
+void hpcrun_stats_sample_ring_dropped_inc(void);
+long hpcrun_stats_sample_ring_dropped(void);
+
+//------------------------------------------------------
+// cct path reuse: frames inserted into the cct and those
+// whose nodes were reused from the previous insertion
+//------------------------------------------------------
+
+void hpcrun_stats_cct_path_frames_add(long frames, long reused);
+long hpcrun_stats_cct_path_frames(void);
+long hpcrun_stats_cct_path_reused(void);
+
+//------------------------------------------------------
+// cct path reuse: insertions that reused nodes and were
+// checked against a lookup from the root, and those
+// that disagreed
+//------------------------------------------------------
+
+void hpcrun_stats_cct_path_verified_inc(long amt);
+long hpcrun_stats_cct_path_verified(void);
+
+void hpcrun_stats_cct_path_mismatch_inc(long amt);
+long hpcrun_stats_cct_path_mismatch(void);
+
 //-----------------------------
 // print summary
 //-----------------------------
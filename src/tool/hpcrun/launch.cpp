@@ -135,6 +135,13 @@ R"==(
                                 NOTE: May cause crashes or not function if used with a
                                 different Python than HPCToolkit was built with.
                                 Highly experimental. Use at your own risk.
+
+                           -a python-sample
+                                Like "-a python", but only walk the Python frames
+                                when a sample is taken instead of hooking every
+                                Python call, for lower overhead. Falls back to
+                                "-a python" if not supported by the Python in use
+                                (requires Python < 3.11).
 )=="
 #endif
 R"==(
@@ -174,6 +181,26 @@ R"==(
                        0 : do not merge non-overlapped threads
                        1 : merge non-overlapped threads (default)
 
+  --container          Write the profiles and traces of all threads of a
+                       process into a single .hpccontainer file, instead of
+                       one .hpcrun and one .hpctrace file per thread. This
+                       reduces the number of files created in the output
+                       directory for heavily threaded or GPU-heavy runs.
+
+  --node-container     Like --container, but the processes on each node
+                       hand their containers to the last of them to finish
+                       through node-local shared memory (/dev/shm), which
+                       writes one .hpccontainer for the whole node. This
+                       reduces the file count of MPI jobs with many ranks
+                       per node.
+
+  --snapshot <sec>     Every <sec> seconds, append the changes to each
+                       thread's profile since the last snapshot to a
+                       per-process .hpcsnap file. hpcprof uses the snapshots
+                       to recover the profiles of jobs that were killed
+                       before they finished, or, with --snapshot-series,
+                       to show how the profile evolved over time.
+
   -o <outpath>, --output <outpath>
                        Directory for output data.
                        {hpctoolkit-<command>-measurements[-<jobid>]}
@@ -200,6 +227,18 @@ R"==(
                        procedures only instead of full calling contexts.
                        Equivalent to -a flat.
 
+  --unwind-recipes <dir>
+                       Build unwind recipes from the tables that
+                       'hpcfnbounds -u <dir>' wrote ahead of time from the
+                       .eh_frame call frame information of each load module.
+                       Only functions without such information have their
+                       instructions analyzed at run time.
+
+  --unwind-fp          Unwind callers by following saved frame pointers,
+                       for applications built with -fno-omit-frame-pointer.
+                       Frames that fail validation are unwound with the
+                       usual recipes. (x86-64 only)
+
   --rocprofiler-path   Path to the ROCProfiler installation. Usually, this is /opt/rocm
                        or a versioned variant e.g. /opt/rocm-5.4.3. This should match the
                        ROCm installation your application is running with.
@@ -431,6 +470,14 @@ int main(int argc, char* argv[]) {
 #else
         std::cerr << "hpcrun: HPCToolkit was not compiled with Python support enabled" << diemsg;
         return 1;
+#endif
+      } else if (strmatch(val, {"python-sample"})) {
+#ifdef ENABLE_LOGICAL_PYTHON
+        env["HPCRUN_LOGICAL_PYTHON"] = "1";
+        env["HPCRUN_LOGICAL_PYTHON_SAMPLE"] = "1";
+#else
+        std::cerr << "hpcrun: HPCToolkit was not compiled with Python support enabled" << diemsg;
+        return 1;
 #endif
       } else {
         std::cerr << "hpcrun: Invalid argument for " << arg << ": " << val << diemsg;
@@ -551,6 +598,17 @@ int main(int argc, char* argv[]) {
       env["HPCRUN_RETAIN_RECURSION"] = "1";
     } else if (strmatch(arg, {"-m", "--merge-threads"})) {
       env["HPCRUN_MERGE_THREADS"] = popvalue();
+    } else if (strmatch(arg, {"--container"})) {
+      env["HPCRUN_CONTAINER"] = "1";
+    } else if (strmatch(arg, {"--node-container"})) {
+      env["HPCRUN_CONTAINER"] = "1";
+      env["HPCRUN_NODE_CONTAINER"] = "1";
+    } else if (strmatch(arg, {"--snapshot"})) {
+      env["HPCRUN_SNAPSHOT_PERIOD"] = popvalue();
+    } else if (strmatch(arg, {"--unwind-recipes"})) {
+      env["HPCRUN_UNWIND_RECIPES"] = popvalue();
+    } else if (strmatch(arg, {"--unwind-fp"})) {
+      env["HPCRUN_UNWIND_FP"] = "1";
     } else if (strmatch(arg, {"-lm", "--low-memsize"})) {
       env["HPCRUN_LOW_MEMSIZE"] = popvalue();
     } else if (strmatch(arg, {"-ms", "--memsize"})) {
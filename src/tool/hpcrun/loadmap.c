@@ -47,6 +47,7 @@
 #define _GNU_SOURCE
 
 #include <libgen.h>
+#include <stdlib.h>
 #include <sys/time.h>
 
 #include "cct/cct.h"
@@ -57,6 +58,7 @@
 #include "sample_event.h"
 #include "epoch.h"
 
+#include "memory/hpcrun-malloc.h"
 #include "messages/messages.h"
 
 #include "../../lib/prof-lean/hpcfmt.h"
@@ -79,6 +81,263 @@ static loadmap_notify_t *notification_recipients = NULL;
 
 static void hpcrun_loadModule_flags_init(load_module_t *lm);
 
+
+//***************************************************************************
+// lock-free lookup indices
+//***************************************************************************
+
+// Address lookups happen during unwinding, so they must not take a
+// lock.  The address index is an array of the currently mapped module
+// ranges sorted by start address, rewritten in place under a sequence
+// count: the count is odd while a writer is rewriting the ranges, and
+// a reader whose count changed (or was odd) falls back to walking the
+// list.  The reader may be a signal handler that interrupted the
+// writer, so it must never wait for the count to become even.  Only
+// when the array is full is a new one of twice the capacity published;
+// the old array can't be reclaimed since a reader may still be
+// searching it, but the abandoned arrays together are no larger than
+// the live one.
+//
+// The name index is an open-addressed hash table of load modules.
+// Load modules are never removed from the loadmap, so the table only
+// grows: slots are filled in place and the table is republished at
+// twice the size when it becomes half full.
+//
+// Writers are serialized by loadmap_index_lock, which is separate from
+// loadmap_lock since some callers add load modules while holding that.
+
+typedef struct loadmap_range_t {
+  uintptr_t start;
+  uintptr_t end;
+  load_module_t* lm;
+} loadmap_range_t;
+
+typedef struct loadmap_addr_index_t {
+  size_t capacity;
+  _Atomic(size_t) seq;  // odd while the ranges are being rewritten
+  size_t size;
+  bool has_overlap;
+  loadmap_range_t ranges[];
+} loadmap_addr_index_t;
+
+#define LOADMAP_ADDR_INDEX_MIN_CAPACITY 64
+
+typedef struct loadmap_name_index_t {
+  size_t capacity;  // power of 2
+  size_t count;
+  _Atomic(load_module_t*) slots[];
+} loadmap_name_index_t;
+
+#define LOADMAP_NAME_INDEX_MIN_CAPACITY 64
+
+static _Atomic(loadmap_addr_index_t*) s_addr_index = NULL;
+static _Atomic(loadmap_name_index_t*) s_name_index = NULL;
+static spinlock_t loadmap_index_lock = SPINLOCK_UNLOCKED;
+
+
+static int
+loadmap_range_cmp(const void* a, const void* b)
+{
+  const loadmap_range_t* x = a;
+  const loadmap_range_t* y = b;
+  return (x->start > y->start) - (x->start < y->start);
+}
+
+
+// Fill 'index' with the ranges of the current loadmap, of which there
+// are at most index->capacity.
+static void
+loadmap_addr_index_fill(loadmap_addr_index_t* index)
+{
+  size_t i = 0;
+  for (load_module_t* x = s_loadmap_ptr->lm_head; (x) && i < index->capacity; x = x->next) {
+    if (x->dso_info) {
+      index->ranges[i].start = (uintptr_t) x->dso_info->start_addr;
+      index->ranges[i].end = (uintptr_t) x->dso_info->end_addr;
+      index->ranges[i].lm = x;
+      i++;
+    }
+  }
+  index->size = i;
+  qsort(index->ranges, index->size, sizeof(loadmap_range_t), loadmap_range_cmp);
+
+  // The list walk prefers the most recently mapped module when ranges
+  // overlap; rather than reproduce that ordering, such an index defers
+  // to the list walk.
+  index->has_overlap = false;
+  for (i = 1; i < index->size; i++) {
+    if (index->ranges[i].start < index->ranges[i - 1].end) {
+      index->has_overlap = true;
+      break;
+    }
+  }
+}
+
+
+// Bring the address index up to date with the current loadmap.
+// Call with loadmap_index_lock held.
+static void
+loadmap_addr_index_publish(void)
+{
+  size_t n = 0;
+  for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
+    if (x->dso_info) n++;
+  }
+
+  loadmap_addr_index_t* index = atomic_load_explicit(&s_addr_index, memory_order_relaxed);
+  if (index != NULL && n <= index->capacity) {
+    size_t seq = atomic_load_explicit(&index->seq, memory_order_relaxed);
+    atomic_store_explicit(&index->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    loadmap_addr_index_fill(index);
+    atomic_store_explicit(&index->seq, seq + 2, memory_order_release);
+    return;
+  }
+
+  size_t capacity = index ? index->capacity : LOADMAP_ADDR_INDEX_MIN_CAPACITY;
+  while (capacity < n) capacity *= 2;
+  loadmap_addr_index_t* grown =
+    hpcrun_malloc(sizeof(loadmap_addr_index_t) + capacity * sizeof(loadmap_range_t));
+  if (grown == NULL) {
+    // without an index, lookups fall back to walking the list
+    atomic_store_explicit(&s_addr_index, NULL, memory_order_release);
+    return;
+  }
+  grown->capacity = capacity;
+  atomic_init(&grown->seq, 0);
+  loadmap_addr_index_fill(grown);
+  atomic_store_explicit(&s_addr_index, grown, memory_order_release);
+}
+
+
+// Returns: false if the index can't answer the query, otherwise true
+// and the module whose range contains [begin, end] (or NULL) in *lm.
+static bool
+loadmap_addr_index_find(void* begin, void* end, load_module_t** lm)
+{
+  loadmap_addr_index_t* index = atomic_load_explicit(&s_addr_index, memory_order_acquire);
+  if (index == NULL) return false;
+
+  size_t seq = atomic_load_explicit(&index->seq, memory_order_acquire);
+  if (seq & 1) return false;
+  size_t size = index->size;
+  if (index->has_overlap || size > index->capacity) return false;
+
+  // find the last range with start <= begin
+  size_t lo = 0, hi = size;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (index->ranges[mid].start <= (uintptr_t) begin) lo = mid + 1;
+    else hi = mid;
+  }
+  load_module_t* found = NULL;
+  if (lo > 0 && (uintptr_t) end <= index->ranges[lo - 1].end) {
+    found = index->ranges[lo - 1].lm;
+  }
+
+  // a writer rewrote the ranges while we searched them
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(&index->seq, memory_order_relaxed) != seq) return false;
+
+  *lm = found;
+  return true;
+}
+
+
+static size_t
+loadmap_name_hash(const char* name)
+{
+  // FNV-1a
+  size_t h = (size_t) 0xcbf29ce484222325ULL;
+  for (const unsigned char* c = (const unsigned char*) name; *c; c++) {
+    h ^= *c;
+    h *= (size_t) 0x100000001b3ULL;
+  }
+  return h;
+}
+
+
+// Insert 'lm' into the table.  If a module with the same name is
+// already present, 'replace' decides which one the table keeps.
+static void
+loadmap_name_index_place(loadmap_name_index_t* index, load_module_t* lm, bool replace)
+{
+  size_t mask = index->capacity - 1;
+  size_t i = loadmap_name_hash(lm->name) & mask;
+  load_module_t* x;
+  while ((x = atomic_load_explicit(&index->slots[i], memory_order_relaxed)) != NULL) {
+    if (strcmp(x->name, lm->name) == 0) {
+      if (replace) atomic_store_explicit(&index->slots[i], lm, memory_order_release);
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  atomic_store_explicit(&index->slots[i], lm, memory_order_release);
+  index->count++;
+}
+
+
+static loadmap_name_index_t*
+loadmap_name_index_new(size_t capacity)
+{
+  loadmap_name_index_t* index =
+    hpcrun_malloc(sizeof(loadmap_name_index_t) + capacity * sizeof(index->slots[0]));
+  if (index == NULL) return NULL;
+
+  index->capacity = capacity;
+  index->count = 0;
+  for (size_t i = 0; i < capacity; i++) {
+    atomic_init(&index->slots[i], NULL);
+  }
+  return index;
+}
+
+
+// Add a new load module to the name index.  Like the list walk, a
+// lookup finds the most recently added module of a given name.
+// Call with loadmap_index_lock held.
+static void
+loadmap_name_index_add(load_module_t* lm)
+{
+  loadmap_name_index_t* index = atomic_load_explicit(&s_name_index, memory_order_relaxed);
+
+  if (index == NULL || 2 * (index->count + 1) > index->capacity) {
+    size_t capacity = index ? 2 * index->capacity : LOADMAP_NAME_INDEX_MIN_CAPACITY;
+    loadmap_name_index_t* grown = loadmap_name_index_new(capacity);
+    if (grown == NULL) {
+      // without an index, lookups fall back to walking the list
+      atomic_store_explicit(&s_name_index, NULL, memory_order_release);
+      return;
+    }
+    for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
+      if (x != lm) loadmap_name_index_place(grown, x, false);
+    }
+    atomic_store_explicit(&s_name_index, grown, memory_order_release);
+    index = grown;
+  }
+
+  loadmap_name_index_place(index, lm, true);
+}
+
+
+// Returns: false if there is no index, otherwise true and the load
+// module named 'name' (or NULL) in *lm.
+static bool
+loadmap_name_index_find(const char* name, load_module_t** lm)
+{
+  loadmap_name_index_t* index = atomic_load_explicit(&s_name_index, memory_order_acquire);
+  if (index == NULL) return false;
+
+  size_t mask = index->capacity - 1;
+  for (size_t i = loadmap_name_hash(name) & mask; ; i = (i + 1) & mask) {
+    load_module_t* x = atomic_load_explicit(&index->slots[i], memory_order_acquire);
+    if (x == NULL || strcmp(x->name, name) == 0) {
+      *lm = x;
+      return true;
+    }
+  }
+}
+
 void
 hpcrun_loadmap_notify_register(loadmap_notify_t *n)
 {
@@ -305,6 +564,17 @@ hpcrun_loadmap_findByAddr(void* begin, void* end)
 
   TMSG(LOADMAP, "find by address %p -- %p", begin, end);
 
+  load_module_t* lm;
+  if (loadmap_addr_index_find(begin, end, &lm)) {
+    if (lm) {
+      TMSG(LOADMAP, "       --->%s", lm->name);
+      hpcrun_loadModule_flags_set(lm, LOADMAP_ENTRY_ANALYZE);
+    } else {
+      TMSG(LOADMAP, "       --->(NOT FOUND)");
+    }
+    return lm;
+  }
+
   for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
     TMSG(LOADMAP, "\tload module %s", x->name);
     if (x->dso_info) {
@@ -332,6 +602,13 @@ load_module_t*
 hpcrun_loadmap_findByName(const char* name)
 {
   TMSG(LOADMAP, "find by name: %s", name);
+
+  load_module_t* lm;
+  if (loadmap_name_index_find(name, &lm)) {
+    TMSG(LOADMAP, lm ? "       --->FOUND" : "       --->(NOT FOUND)");
+    return lm;
+  }
+
   for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
     if (strcmp(x->name, name) == 0) {
       TMSG(LOADMAP, "       --->FOUND", x->name);
@@ -444,6 +721,7 @@ load_module_t*
 hpcrun_loadmap_map(dso_info_t* dso)
 {
   const char* msg = "";
+  bool is_new = false;
 
   TMSG(LOADMAP, "map in dso %s", dso->name);
   // -------------------------------------------------------
@@ -467,6 +745,7 @@ hpcrun_loadmap_map(dso_info_t* dso)
         lm = hpcrun_loadModule_new(dso->name);
         lm->dso_info = dso;
         hpcrun_loadmap_pushFront(lm);
+        is_new = true;
 
 #if UW_RECIPE_MAP_DEBUG
         fprintf(stderr, "hpcrun_loadmap_map: '%s' start=%p end=%p\n",
@@ -475,6 +754,13 @@ hpcrun_loadmap_map(dso_info_t* dso)
 
   }
 
+  spinlock_lock(&loadmap_index_lock);
+  if (is_new) {
+    loadmap_name_index_add(lm);
+  }
+  loadmap_addr_index_publish();
+  spinlock_unlock(&loadmap_index_lock);
+
   hpcrun_loadmap_notify_map(lm);
 
   TMSG(LOADMAP, "hpcrun_loadmap_map: '%s' size=%d %s",
@@ -498,6 +784,10 @@ hpcrun_loadmap_unmap(load_module_t* lm)
 
   lm->dso_info = NULL;
 
+  spinlock_lock(&loadmap_index_lock);
+  loadmap_addr_index_publish();
+  spinlock_unlock(&loadmap_index_lock);
+
   // Set dl_phdr_info structure to uninitialized state
   lm->phdr_info.dlpi_phdr = NULL;
 
@@ -534,6 +824,11 @@ hpcrun_loadModule_add(const char* name)
 {
   load_module_t *lm = hpcrun_loadModule_new(name);
   hpcrun_loadmap_pushFront(lm);
+
+  spinlock_lock(&loadmap_index_lock);
+  loadmap_name_index_add(lm);
+  spinlock_unlock(&loadmap_index_lock);
+
   return lm->id;
 }
 
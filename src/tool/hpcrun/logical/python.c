@@ -48,6 +48,8 @@
 
 #include "common.h"
 
+#include "../cct_backtrace_finalize.h"
+#include "../env.h"
 #include "../loadmap.h"
 #include "../messages/messages.h"
 #include "../thread_data.h"
@@ -61,6 +63,7 @@
 
 #include <assert.h>
 #include <dlfcn.h>
+#include <link.h>
 #include <Python.h>
 #include <frameobject.h>
 #include <stddef.h>
@@ -72,6 +75,14 @@
 #define IS_PYTHON_38
 #endif
 
+// Sample-time unwinding reads the thread state's frame chain directly, which is
+// only possible while PyFrameObject is a public structure (python < 3.11).
+// Later versions keep the live frames in internal _PyInterpreterFrame records,
+// and the public accessors may allocate, which is not safe in a signal handler.
+#if PY_VERSION_HEX < 0x030B0000
+#define HAVE_PYTHON_SAMPLE
+#endif
+
 // -----------------------------
 // Local variables
 // -----------------------------
@@ -83,6 +94,7 @@
     F(PyEval_GetFuncName) \
     F(PyEval_SetProfile) \
     F(PyFrame_GetLineNumber) \
+    F(PyGILState_GetThisThreadState) \
     F(PySys_AddAuditHook) \
     F(PyUnicode_AsUTF8) \
     // END PYFUNCS
@@ -93,6 +105,7 @@
     F(PyFrame_GetBack) \
     F(PyFrame_GetCode) \
     F(PyFrame_GetLineNumber) \
+    F(PyGILState_GetThisThreadState) \
     F(PySys_AddAuditHook) \
     F(PyUnicode_AsUTF8) \
     // END PYFUNCS
@@ -104,6 +117,22 @@ PYFUNCS(DL_DEF)
 
 static logical_metadata_store_t python_metastore;
 
+// If true, Python frames are recovered when a sample is taken rather than
+// tracked through a profile hook (HPCRUN_LOGICAL_PYTHON_SAMPLE).
+static bool python_sample = false;
+
+// -----------------------------
+// Python metadata helpers
+// -----------------------------
+
+static uint32_t python_code_fid(PyCodeObject* code) {
+  const char* name = DL(PyUnicode_AsUTF8)(code->co_name);
+  if(strcmp(name, "<module>") == 0)
+    name = NULL;  // Special case, the main module should just have its filename
+  return hpcrun_logical_metadata_fid(&python_metastore,
+    name, LOGICAL_MANGLING_NONE, DL(PyUnicode_AsUTF8)(code->co_filename), code->co_firstlineno);
+}
+
 // -----------------------------
 // Python unwinder
 // -----------------------------
@@ -152,11 +181,7 @@ static bool python_unwind(logical_region_t* region, void** store,
        DL(PyFrame_GetLineNumber)(pyframe), DL(PyUnicode_AsUTF8)(code->co_name),
        code->co_firstlineno);
   if(lframe->fid == 0 || lframe->code != code) {
-    const char* name = DL(PyUnicode_AsUTF8)(code->co_name);
-    if(strcmp(name, "<module>") == 0)
-      name = NULL;  // Special case, the main module should just have its filename
-    lframe->fid = hpcrun_logical_metadata_fid(&python_metastore,
-      name, LOGICAL_MANGLING_NONE, DL(PyUnicode_AsUTF8)(code->co_filename), code->co_firstlineno);
+    lframe->fid = python_code_fid(code);
     lframe->code = code;
     TMSG(LOGICAL_CTX_PYTHON, "Registered the above as Python fid #%x", lframe->fid);
   }
@@ -192,6 +217,113 @@ static const frame_t* python_afterexit(logical_region_t* reg,
   return precur;
 }
 
+// -----------------------------
+// Sample-time Python unwinder
+// -----------------------------
+
+#ifdef HAVE_PYTHON_SAMPLE
+// Load module id of libpython.so, and the code range of the evaluation loop.
+// Every PyFrameObject is executed by its own call to the evaluation loop, so
+// each physical frame within this range matches one entry in the frame chain.
+static uint16_t python_lm_id = 0;
+static uintptr_t python_eval_start = 0;
+static uintptr_t python_eval_end = 0;
+
+static bool is_eval_frame(const frame_t* frame) {
+  uintptr_t pc = (uintptr_t)frame->cursor.pc_unnorm;
+  return python_eval_start <= pc && pc <= python_eval_end;
+}
+
+// UTF-8 contents of a str object, or NULL if that would need an allocation.
+// Compact ASCII strings (nearly all names and file names) hold their UTF-8 form
+// inline, others only once PyUnicode_AsUTF8 has cached it.
+static const char* python_str_noalloc(PyObject* str) {
+  if(!PyUnicode_IS_READY(str)) return NULL;
+  if(PyUnicode_IS_COMPACT_ASCII(str)) return (const char*)PyUnicode_DATA(str);
+  return ((PyCompactUnicodeObject*)str)->utf8;
+}
+
+// Like python_code_fid, but does not call into Python's allocator.
+static uint32_t python_sample_fid(PyCodeObject* code) {
+  const char* name = python_str_noalloc(code->co_name);
+  if(name == NULL)
+    name = "<unknown>";
+  else if(strcmp(name, "<module>") == 0)
+    name = NULL;  // Special case, the main module should just have its filename
+  return hpcrun_logical_metadata_fid(&python_metastore,
+    name, LOGICAL_MANGLING_NONE, python_str_noalloc(code->co_filename), code->co_firstlineno);
+}
+
+// Backtrace finalizer for sample mode. Walks the current thread's frame chain
+// and replaces each run of libpython.so frames, starting at its first call to
+// the evaluation loop, with the Python frames that run was executing. Frames
+// above the first evaluation loop are kept, they are the C function (builtin
+// or otherwise) that Python called out to.
+//
+// Nothing here takes a Python reference or calls Python's allocator: the frame
+// chain belongs to the interrupted thread and cannot change under us. The
+// metadata store takes its own lock and uses hpcrun_malloc, as it does for the
+// logical unwinders.
+static void python_sample_bt(backtrace_info_t* bt, int isSync) {
+  PyThreadState* tstate = DL(PyGILState_GetThisThreadState)();
+  if(tstate == NULL) return;  // Not a Python thread (yet)
+  PyFrameObject* pyframe = tstate->frame;
+  if(pyframe == NULL) return;  // Not within Python right now
+
+  TMSG(LOGICAL_UNWIND, "========= Splicing sampled Python frames =========");
+  frame_t* in = bt->begin;
+  frame_t* out = bt->begin;
+  while(in <= bt->last) {
+    if(pyframe == NULL || !is_eval_frame(in)) {
+      *out++ = *in++;
+      continue;
+    }
+
+    // This run of libpython.so frames only ever shrinks: it contains at least
+    // one physical frame for every Python frame it produces.
+    for(; in <= bt->last && in->ip_norm.lm_id == python_lm_id; in++) {
+      if(pyframe == NULL || !is_eval_frame(in)) continue;
+      PyCodeObject* code = pyframe->f_code;
+      TMSG(LOGICAL_UNWIND, " sp = %p replaced by Python frame %p: %s:%d", in->cursor.sp,
+           pyframe, python_str_noalloc(code->co_filename), DL(PyFrame_GetLineNumber)(pyframe));
+      *out = *in;
+      out->ip_norm = hpcrun_logical_metadata_ipnorm(&python_metastore,
+          python_sample_fid(code), DL(PyFrame_GetLineNumber)(pyframe));
+      out++;
+      pyframe = pyframe->f_back;
+    }
+  }
+  bt->last = out - 1;
+
+  IF_ENABLED(LOGICAL_UNWIND)
+    if(pyframe != NULL)
+      TMSG(LOGICAL_UNWIND, "== WARNING Python frames remain after the last evaluation loop ==");
+  TMSG(LOGICAL_UNWIND, "========= END Splicing sampled Python frames =========");
+}
+
+static cct_backtrace_finalize_entry_t python_sample_bt_entry = {
+  .fn = python_sample_bt, .next = NULL,
+};
+
+// Locate the evaluation loop in the freshly opened libpython.so. Returns false
+// if it can't be found, in which case the profile hook is used instead.
+static bool python_sample_init(void* libpy, load_module_t* lm) {
+  void* eval = dlsym(libpy, "_PyEval_EvalFrameDefault");
+  Dl_info info;
+  const ElfW(Sym)* sym = NULL;
+  if(eval == NULL || dladdr1(eval, &info, (void**)&sym, RTLD_DL_SYMENT) == 0
+     || sym == NULL || sym->st_size == 0)
+    return false;
+  python_lm_id = lm->id;
+  python_eval_start = (uintptr_t)eval;
+  python_eval_end = python_eval_start + sym->st_size;
+  AMSG("PYTHON: sampling Python frames, evaluation loop at %p-%p",
+       (void*)python_eval_start, (void*)python_eval_end);
+  cct_backtrace_finalize_register(&python_sample_bt_entry);
+  return true;
+}
+#endif  // HAVE_PYTHON_SAMPLE
+
 // -----------------------------
 // Python integration hooks
 // -----------------------------
@@ -456,6 +588,17 @@ static void python_notify_mapped(load_module_t* lm) {
   PYFUNCS(SAVE)
   #undef SAVE
 
+  // In sample mode the interpreter is left untouched, no hooks are installed
+  if(python_sample) {
+#ifdef HAVE_PYTHON_SAMPLE
+    if(python_sample_init(libpy, lm))
+      return;
+    EEMSG("WARNING: Python evaluation loop not found, falling back to the Python profile hook");
+#else
+    EEMSG("WARNING: Sampling Python frames requires Python < 3.11, falling back to the Python profile hook");
+#endif
+  }
+
   // If all went well, we can now register our Python audit hook
   if(DL(PySys_AddAuditHook)(python_audit, NULL) != 0)
     EEMSG("Python error while adding audit hook, Python unwinding may not be enabled");
@@ -466,5 +609,6 @@ static loadmap_notify_t python_loadmap_notify = {
 };
 void hpcrun_logical_python_init() {
   hpcrun_logical_metadata_register(&python_metastore, "python");
+  python_sample = hpcrun_get_env_bool("HPCRUN_LOGICAL_PYTHON_SAMPLE");
   hpcrun_loadmap_notify_register(&python_loadmap_notify);
 }
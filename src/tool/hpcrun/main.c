@@ -87,6 +87,8 @@
 
 #include "disabled.h"
 #include "env.h"
+#include "container.h"
+#include "snapshot.h"
 #include "control-knob.h"
 #include "loadmap.h"
 #include "files.h"
@@ -123,6 +125,7 @@
 #include "epoch.h"
 #include "thread_data.h"
 #include "threadmgr.h"
+#include "sample_ring.h"
 #include "thread_finalize.h"
 #include "thread_use.h"
 #include "trace.h"
@@ -136,6 +139,7 @@
 #include "cct/cct.h"
 
 #include "unwind/common/backtrace.h"
+#include "unwind/common/unw-bench.h"
 #include "unwind/common/unwind.h"
 
 #include "utilities/arch/context-pc.h"
@@ -155,6 +159,8 @@
 
 #include "audit/audit-api.h"
 extern void hpcrun_set_retain_recursion_mode(bool mode);
+extern void hpcrun_set_path_reuse_mode(bool mode);
+extern void hpcrun_set_path_reuse_verify(bool mode);
 
 #if defined(HOST_CPU_x86) || defined(HOST_CPU_x86_64) || defined(HOST_CPU_PPC)
 extern void hpcrun_dump_intervals(void* addr);
@@ -525,12 +531,25 @@ hpcrun_init_internal(bool is_child)
 
   hpcrun_trace_init(); // this must go after thread initialization
 
+  hpcrun_container_init(); // before any trace or profile is opened
+  hpcrun_snapshot_init();
+  hpcrun_unw_bench_init();
+  hpcrun_sample_ring_init();
+
   hpcrun_trace_open(&(TD_GET(core_profile_trace_data)), HPCRUN_SAMPLE_TRACE);
 
   // Decide whether to retain full single recursion, or collapse recursive calls to
   // first instance of recursive call
   hpcrun_set_retain_recursion_mode(hpcrun_get_env_bool("HPCRUN_RETAIN_RECURSION"));
 
+  // Reuse the cct nodes of the frames a sample shares with the previous one
+  int reuse_paths = 1;
+  control_knob_value_get_int("CCT_PATH_REUSE", &reuse_paths);
+  hpcrun_set_path_reuse_mode(reuse_paths != 0);
+  int verify_paths = 0;
+  control_knob_value_get_int("CCT_PATH_VERIFY", &verify_paths);
+  hpcrun_set_path_reuse_verify(verify_paths != 0);
+
   // Initialize logical unwinding agents (LUSH)
   if (opts.lush_agent_paths[0] != '\0') {
     epoch_t* epoch = TD_GET(core_profile_trace_data.epoch);
@@ -787,6 +806,11 @@ hpcrun_fini_internal()
 
     hpcrun_process_aux_cleanup_action();
 
+    // replay recorded stacks while the load modules are still mapped
+    if (is_monitored_thread) {
+      hpcrun_unw_bench_fini();
+    }
+
     int is_process = 1;
     thread_finalize(is_process);
 
@@ -801,6 +825,8 @@ hpcrun_fini_internal()
 
     // write all threads' profile data and close trace file
     hpcrun_threadMgr_data_fini(td);
+    hpcrun_container_fini();
+    hpcrun_snapshot_fini();
 
     auditor_exports->mainlib_disconnect();
     fnbounds_fini();
@@ -117,6 +117,7 @@
  E(SAMPLE), \
  E(SAMPLE_CALLPATH), \
  E(SAMPLE_METRIC_DATA), \
+ E(SAMPLE_RING), \
  E(USE_TRAMP), \
  E(TRAMP), \
  E(RETCNT_CTL), \
@@ -671,6 +671,31 @@ hpcrun_metric_set_sparse_copy(cct_metric_data_t *val, uint16_t *metric_ids,
   return num_nzval;
 }
 
+//
+// apply fn to each non-zero value of a metric set, with the same global
+// metric ids as hpcrun_metric_set_sparse_copy
+//
+void
+hpcrun_metric_set_sparse_apply(metric_data_list_t *list,
+                               hpcrun_metric_value_fn fn, void *arg)
+{
+  int curr_id = 0;
+
+  for (kind_info_t *curr_k = first_kind; curr_k != NULL; curr_k = curr_k->link) {
+    metric_data_list_t *curr;
+    for (curr = list; curr != NULL && curr->kind != curr_k; curr = curr->next);
+    if (curr) {
+      metric_set_t *actual = curr->metrics;
+      for (int i = 0; i < curr_k->idx; i++) {
+        if (actual[i].v1.i != 0) {
+          fn((uint16_t)(curr_id + i), actual[i].v1, arg);
+        }
+      }
+    }
+    curr_id += curr_k->idx;
+  }
+}
+
 //
 // merge two metrics list
 // pre-condition: dest_list is not NULL
@@ -187,6 +187,15 @@ extern uint64_t hpcrun_metric_set_sparse_copy(cct_metric_data_t* val, uint16_t*
 
 extern uint64_t hpcrun_metric_sparse_count(metric_data_list_t* list);
 
+//
+// visit the non-zero values of a metric set
+//
+typedef void (*hpcrun_metric_value_fn)(uint16_t metric_id,
+                                       cct_metric_data_t value, void* arg);
+
+extern void hpcrun_metric_set_sparse_apply(metric_data_list_t* list,
+                                           hpcrun_metric_value_fn fn, void* arg);
+
 extern metric_data_list_t *hpcrun_merge_cct_metrics(metric_data_list_t *dest, metric_data_list_t *source);
 
 extern cct_metric_data_t* fetch_metric(metric_data_list_t*, int);
@@ -0,0 +1,743 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "env.h"
+#include "files.h"
+#include "node-container.h"
+#include "messages/messages.h"
+
+#include "../../lib/prof-lean/hpcfmt.h"
+#include "../../lib/prof-lean/hpcrun-fmt.h"
+#include "../../lib/prof-lean/id-tuple.h"
+
+
+
+//*****************************************************************************
+// macros
+//*****************************************************************************
+
+// node-local shared memory, for the table and the staged containers
+#define NODE_DIR  "/dev/shm"
+
+#define NODE_SLOTS  1024
+
+#define NODE_MAGIC  0x48504372756e6e64  // "HPCrunnd"
+
+// bound on the wait for another process to set up the table
+#define NODE_INIT_SPINS  1000000
+
+#define NODE_COPY_BUFSZ  (1 << 20)
+
+
+
+//*****************************************************************************
+// types
+//*****************************************************************************
+
+typedef enum node_slot_state_t {
+  node_slot_free = 0,
+  node_slot_running,   // measuring, staged container open
+  node_slot_done,      // staged container complete
+  node_slot_merging,   // being copied by the node writer (pid)
+} node_slot_state_t;
+
+
+typedef struct node_slot_t {
+  int32_t state;
+  pid_t pid;
+  int32_t rank;
+} node_slot_t;
+
+
+typedef struct node_table_t {
+  _Atomic(uint64_t) magic;
+  pthread_mutex_t lock;
+  int32_t unlinked;    // name was removed, join a fresh table instead
+  node_slot_t slots[NODE_SLOTS];
+} node_table_t;
+
+
+
+//*****************************************************************************
+// local data
+//*****************************************************************************
+
+static node_table_t *node_table = NULL;
+static uint64_t node_key = 0;
+static int node_slot = -1;
+static pid_t node_pid = 0;
+
+static int node_merge_slots[NODE_SLOTS];
+
+
+
+//*****************************************************************************
+// private operations
+//*****************************************************************************
+
+// The processes of a job share the table if they run as the same user
+// and write to the same output directory.
+static uint64_t
+node_key_compute
+(
+  void
+)
+{
+  uint64_t hash = 0xcbf29ce484222325;  // FNV-1a
+  const char *dir = hpcrun_files_output_directory();
+  for (const char *p = dir; *p; p++) {
+    hash = (hash ^ (unsigned char) *p) * 0x100000001b3;
+  }
+  hash = (hash ^ (uint64_t) getuid()) * 0x100000001b3;
+  return hash;
+}
+
+
+static void
+node_table_name
+(
+  char *name
+)
+{
+  snprintf(name, PATH_MAX, NODE_DIR "/hpcrun-node-%016lx", (unsigned long) node_key);
+}
+
+
+static void
+node_staged_name
+(
+  char *name,
+  int slot
+)
+{
+  snprintf(name, PATH_MAX, NODE_DIR "/hpcrun-node-%016lx-%d.%s",
+           (unsigned long) node_key, slot, HPCRUN_ContainerFnmSfx);
+}
+
+
+static bool
+node_pid_alive
+(
+  pid_t pid
+)
+{
+  return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+
+static void
+node_table_lock
+(
+  void
+)
+{
+  // the lock is robust: a process that died holding it must not
+  // stall the rest of the node
+  if (pthread_mutex_lock(&node_table->lock) == EOWNERDEAD) {
+    pthread_mutex_consistent(&node_table->lock);
+  }
+}
+
+
+static void
+node_table_unlock
+(
+  void
+)
+{
+  pthread_mutex_unlock(&node_table->lock);
+}
+
+
+static node_table_t *
+node_table_create
+(
+  int fd
+)
+{
+  if (ftruncate(fd, sizeof(node_table_t)) != 0) {
+    return NULL;
+  }
+  node_table_t *table = mmap(NULL, sizeof(node_table_t), PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+  if (table == MAP_FAILED) {
+    return NULL;
+  }
+
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  pthread_mutex_init(&table->lock, &attr);
+  pthread_mutexattr_destroy(&attr);
+
+  atomic_store_explicit(&table->magic, NODE_MAGIC, memory_order_release);
+  return table;
+}
+
+
+static node_table_t *
+node_table_attach
+(
+  int fd
+)
+{
+  struct stat st;
+  int spins = 0;
+
+  // the creator may not have sized the file yet
+  while (fstat(fd, &st) == 0 && st.st_size < (off_t) sizeof(node_table_t)) {
+    if (++spins > NODE_INIT_SPINS) {
+      return NULL;
+    }
+    sched_yield();
+  }
+  node_table_t *table = mmap(NULL, sizeof(node_table_t), PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0);
+  if (table == MAP_FAILED) {
+    return NULL;
+  }
+
+  while (atomic_load_explicit(&table->magic, memory_order_acquire) != NODE_MAGIC) {
+    if (++spins > NODE_INIT_SPINS) {
+      munmap(table, sizeof(node_table_t));
+      return NULL;
+    }
+    sched_yield();
+  }
+  return table;
+}
+
+
+// Map the node's table, creating it if this is the first process, and
+// take a free slot.
+//
+// Returns: slot index with node_table mapped, else -1.
+static int
+node_table_join
+(
+  void
+)
+{
+  char name[PATH_MAX];
+  node_table_name(name);
+
+  for (int attempt = 0; attempt < 16; attempt++) {
+    node_table_t *table = NULL;
+    int fd = open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+      table = node_table_create(fd);
+    } else if (errno == EEXIST) {
+      fd = open(name, O_RDWR);
+      if (fd < 0) {
+        // removed by the last writer in between, try again
+        continue;
+      }
+      table = node_table_attach(fd);
+    } else {
+      return -1;
+    }
+    close(fd);
+    if (table == NULL) {
+      return -1;
+    }
+
+    node_table = table;
+    node_table_lock();
+    if (table->unlinked) {
+      node_table_unlock();
+      munmap(table, sizeof(node_table_t));
+      node_table = NULL;
+      continue;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < NODE_SLOTS; i++) {
+      if (table->slots[i].state == node_slot_free) {
+        table->slots[i].state = node_slot_running;
+        table->slots[i].pid = getpid();
+        table->slots[i].rank = -1;
+        slot = i;
+        break;
+      }
+    }
+    node_table_unlock();
+
+    if (slot < 0) {
+      munmap(table, sizeof(node_table_t));
+      node_table = NULL;
+    }
+    return slot;
+  }
+
+  return -1;
+}
+
+
+static void
+node_table_leave
+(
+  void
+)
+{
+  munmap(node_table, sizeof(node_table_t));
+  node_table = NULL;
+  node_slot = -1;
+}
+
+
+static int
+node_copy
+(
+  int in_fd,
+  off_t in_off,
+  int out_fd,
+  off_t out_off,
+  size_t len
+)
+{
+  while (len > 0) {
+    ssize_t ret = copy_file_range(in_fd, &in_off, out_fd, &out_off, len, 0);
+    if (ret < 0 && errno == EINTR) continue;
+    if (ret <= 0) break;
+    len -= ret;
+  }
+  if (len == 0) {
+    return 0;
+  }
+
+  // no copy_file_range across these file systems, copy through a buffer
+  char *buf = malloc(NODE_COPY_BUFSZ);
+  if (buf == NULL) {
+    return -1;
+  }
+  while (len > 0) {
+    size_t chunk = (len < NODE_COPY_BUFSZ) ? len : NODE_COPY_BUFSZ;
+    ssize_t nread = pread(in_fd, buf, chunk, in_off);
+    if (nread < 0 && errno == EINTR) continue;
+    if (nread <= 0) break;
+    ssize_t done = 0;
+    while (done < nread) {
+      ssize_t ret = pwrite(out_fd, buf + done, nread - done, out_off + done);
+      if (ret < 0 && errno == EINTR) continue;
+      if (ret < 0) {
+        free(buf);
+        return -1;
+      }
+      done += ret;
+    }
+    in_off += nread;
+    out_off += nread;
+    len -= nread;
+  }
+  free(buf);
+
+  return (len == 0) ? 0 : -1;
+}
+
+
+// Read the index of a staged container.
+//
+// Returns: malloc'd entries and their count, else NULL.
+static hpccontainer_fmt_entry_t *
+node_staged_index
+(
+  FILE *fs,
+  uint32_t *num_entries
+)
+{
+  uint32_t cnt;
+  if (hpccontainer_fmt_index_seek(&cnt, fs) != HPCFMT_OK) {
+    return NULL;
+  }
+  hpccontainer_fmt_entry_t *entries = malloc((cnt + 1) * sizeof(hpccontainer_fmt_entry_t));
+  if (entries == NULL) {
+    return NULL;
+  }
+  for (uint32_t i = 0; i < cnt; i++) {
+    if (hpccontainer_fmt_entry_fread(&entries[i], fs) != HPCFMT_OK) {
+      for (uint32_t j = 0; j < i; j++) {
+        id_tuple_free(&entries[j].id_tuple);
+      }
+      free(entries);
+      return NULL;
+    }
+  }
+  *num_entries = cnt;
+  return entries;
+}
+
+
+// Move a staged container that could not be merged out of the way of
+// the slot, so the slot can be reused but the data is not lost.  The
+// staged container is complete, so it can be given to hpcprof as is.
+static void
+node_keep
+(
+  int slot
+)
+{
+  char name[PATH_MAX], kept[PATH_MAX];
+
+  node_staged_name(name, slot);
+  snprintf(kept, PATH_MAX, NODE_DIR "/hpcrun-kept-%016lx-%d-%d.%s",
+           (unsigned long) node_key, (int) node_pid, slot, HPCRUN_ContainerFnmSfx);
+  if (rename(name, kept) == 0) {
+    EEMSG("hpctoolkit: node container: measurement data kept in %s", kept);
+  } else {
+    EEMSG("hpctoolkit: node container: measurement data kept in %s", name);
+  }
+}
+
+
+// Copy the staged containers of the collected slots into one container
+// in the output directory.  Each staged container's data moves as one
+// block, so the regions only need their offsets rebased; the threads
+// of each process are shifted past those of the previous ones.  The
+// staged containers are only removed once the node container is
+// complete, otherwise they are kept (see node_keep).
+static void
+node_write
+(
+  int *slots,
+  int num_slots,
+  int own_rank
+)
+{
+  char name[PATH_MAX];
+  bool merged[NODE_SLOTS];
+
+  int rank = -1;
+  for (int i = 0; i < num_slots; i++) {
+    int slot_rank = node_table->slots[slots[i]].rank;
+    if (slot_rank >= 0 && (rank < 0 || slot_rank < rank)) {
+      rank = slot_rank;
+    }
+    merged[i] = false;
+  }
+
+  int out_fd = hpcrun_open_node_container_file(own_rank < 0 ? 0 : own_rank,
+                                               rank < 0 ? 0 : rank);
+  if (out_fd < 0) {
+    for (int i = 0; i < num_slots; i++) {
+      node_keep(slots[i]);
+    }
+    return;
+  }
+
+  hpccontainer_fmt_entry_t *index = NULL;
+  uint32_t index_len = 0;
+  uint64_t tail = HPCCONTAINER_FMT_DataOffset;
+  int32_t thread_base = 0;
+  int num_merged = 0;
+
+  for (int i = 0; i < num_slots; i++) {
+    node_staged_name(name, slots[i]);
+    FILE *fs = fopen(name, "r");
+    if (fs == NULL) {
+      EMSG("node container: unable to open staged container %s", name);
+      continue;
+    }
+
+    uint32_t cnt = 0;
+    hpccontainer_fmt_entry_t *entries = node_staged_index(fs, &cnt);
+    hpccontainer_fmt_entry_t *grown = NULL;
+    if (entries != NULL) {
+      grown = realloc(index, (index_len + cnt + 1) * sizeof(hpccontainer_fmt_entry_t));
+    }
+    if (grown == NULL) {
+      EMSG("node container: skipping incomplete staged container %s", name);
+      if (entries != NULL) {
+        for (uint32_t j = 0; j < cnt; j++) {
+          id_tuple_free(&entries[j].id_tuple);
+        }
+        free(entries);
+      }
+      fclose(fs);
+      node_keep(slots[i]);
+      continue;
+    }
+    index = grown;
+
+    uint64_t data_end = HPCCONTAINER_FMT_DataOffset;
+    int32_t max_thread = -1;
+    for (uint32_t j = 0; j < cnt; j++) {
+      if (entries[j].offset + entries[j].length > data_end) {
+        data_end = entries[j].offset + entries[j].length;
+      }
+      if (entries[j].thread > max_thread) {
+        max_thread = entries[j].thread;
+      }
+    }
+
+    uint64_t len = data_end - HPCCONTAINER_FMT_DataOffset;
+    if (node_copy(fileno(fs), HPCCONTAINER_FMT_DataOffset, out_fd, tail, len) != 0) {
+      EMSG("node container: unable to copy staged container %s: %s",
+           name, strerror(errno));
+      for (uint32_t j = 0; j < cnt; j++) {
+        id_tuple_free(&entries[j].id_tuple);
+      }
+      node_keep(slots[i]);
+    } else {
+      for (uint32_t j = 0; j < cnt; j++) {
+        entries[j].thread += thread_base;
+        entries[j].offset = entries[j].offset - HPCCONTAINER_FMT_DataOffset + tail;
+        index[index_len++] = entries[j];
+      }
+      tail += len;
+      thread_base += max_thread + 1;
+      merged[i] = true;
+      num_merged++;
+    }
+
+    free(entries);
+    fclose(fs);
+  }
+
+  bool written = false;
+
+  FILE *out = fdopen(out_fd, "w");
+  if (out == NULL) {
+    EMSG("node container: unable to write index: %s", strerror(errno));
+    close(out_fd);
+  } else {
+    int ret = HPCFMT_OK;
+    if (fseek(out, 0, SEEK_SET) != 0
+        || hpccontainer_fmt_hdr_fwrite(out) != HPCFMT_OK
+        || fseek(out, tail, SEEK_SET) != 0
+        || hpcfmt_int4_fwrite(index_len, out) != HPCFMT_OK) {
+      ret = HPCFMT_ERR;
+    }
+    for (uint32_t j = 0; j < index_len && ret == HPCFMT_OK; j++) {
+      ret = hpccontainer_fmt_entry_fwrite(&index[j], out);
+    }
+    if (ret == HPCFMT_OK) {
+      ret = hpccontainer_fmt_trailer_fwrite(tail, out);
+    }
+    if (fclose(out) != 0 || ret != HPCFMT_OK) {
+      EMSG("node container: unable to write index");
+    } else {
+      written = true;
+    }
+  }
+
+  for (int i = 0; i < num_slots; i++) {
+    if (!merged[i]) {
+      continue;
+    }
+    if (written) {
+      node_staged_name(name, slots[i]);
+      unlink(name);
+    } else {
+      node_keep(slots[i]);
+    }
+  }
+
+  for (uint32_t j = 0; j < index_len; j++) {
+    id_tuple_free(&index[j].id_tuple);
+  }
+  free(index);
+
+  TMSG(DATA_WRITE, "node container written: %d of %d processes, %u regions, "
+       "%ld bytes of data", num_merged, num_slots, index_len,
+       (long)(tail - HPCCONTAINER_FMT_DataOffset));
+}
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+bool
+hpcrun_node_container_requested
+(
+  void
+)
+{
+  return hpcrun_get_env_bool(HPCRUN_NODE_CONTAINER);
+}
+
+
+int
+hpcrun_node_container_open
+(
+  void
+)
+{
+  char name[PATH_MAX];
+
+  // after fork, the child takes a slot of its own
+  if (node_table != NULL) {
+    node_table_leave();
+  }
+  node_pid = getpid();
+
+  if (access(NODE_DIR, W_OK) != 0) {
+    TMSG(DATA_WRITE, "node container: no " NODE_DIR ", using a process container");
+    return -1;
+  }
+
+  node_key = node_key_compute();
+  node_slot = node_table_join();
+  if (node_slot < 0) {
+    TMSG(DATA_WRITE, "node container: no free slot, using a process container");
+    return -1;
+  }
+
+  node_staged_name(name, node_slot);
+  int fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    node_table_lock();
+    node_table->slots[node_slot].state = node_slot_free;
+    node_table_unlock();
+    node_table_leave();
+    return -1;
+  }
+
+  TMSG(DATA_WRITE, "node container: joined as slot %d", node_slot);
+  return fd;
+}
+
+
+void
+hpcrun_node_container_close
+(
+  int rank
+)
+{
+  char name[PATH_MAX];
+
+  if (node_table == NULL || node_slot < 0 || node_pid != getpid()) {
+    return;
+  }
+
+  node_table_t *table = node_table;
+  int num_slots = 0;
+  bool last = true;
+
+  node_table_lock();
+  table->slots[node_slot].state = node_slot_done;
+  table->slots[node_slot].rank = rank;
+
+  for (int i = 0; i < NODE_SLOTS; i++) {
+    if (table->slots[i].state == node_slot_running
+        && node_pid_alive(table->slots[i].pid)) {
+      last = false;
+      break;
+    }
+  }
+
+  if (last) {
+    for (int i = 0; i < NODE_SLOTS; i++) {
+      node_slot_t *slot = &table->slots[i];
+      if (slot->state == node_slot_running) {
+        // died without finishing its container
+        node_staged_name(name, i);
+        unlink(name);
+        slot->state = node_slot_free;
+      } else if (slot->state == node_slot_done
+                 || (slot->state == node_slot_merging && !node_pid_alive(slot->pid))) {
+        slot->state = node_slot_merging;
+        slot->pid = node_pid;
+        node_merge_slots[num_slots++] = i;
+      }
+    }
+  }
+  node_table_unlock();
+
+  if (!last) {
+    TMSG(DATA_WRITE, "node container: slot %d staged for the node writer", node_slot);
+    node_table_leave();
+    return;
+  }
+
+  node_write(node_merge_slots, num_slots, rank);
+
+  bool empty = true;
+  node_table_lock();
+  for (int i = 0; i < num_slots; i++) {
+    table->slots[node_merge_slots[i]].state = node_slot_free;
+  }
+  for (int i = 0; i < NODE_SLOTS; i++) {
+    if (table->slots[i].state != node_slot_free) {
+      empty = false;
+      break;
+    }
+  }
+  if (empty) {
+    table->unlinked = 1;
+    node_table_name(name);
+    unlink(name);
+  }
+  node_table_unlock();
+
+  node_table_leave();
+}
@@ -0,0 +1,92 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+#ifndef hpcrun_node_container_h
+#define hpcrun_node_container_h
+
+//*****************************************************************************
+// Node-level container output.
+//
+// With HPCRUN_NODE_CONTAINER set, the processes on one node stage their
+// containers in node-local shared memory (/dev/shm) and join a small
+// table in a shared memory segment keyed by the user and the output
+// directory.  The last process of the node to finish becomes the node
+// writer: it copies every staged container into one .hpccontainer in
+// the output directory, renumbering the threads so they stay unique,
+// and writes a single index for all of them.
+//
+// Profiles are written after MPI_Finalize, so the processes coordinate
+// through the shared table rather than MPI.  Without MPI, or when the
+// table or /dev/shm is unavailable, each process writes its own
+// container as before.
+//*****************************************************************************
+
+#include <stdbool.h>
+
+bool
+hpcrun_node_container_requested
+(
+  void
+);
+
+
+// join the node and open this process's staged container
+//
+// Returns: file descriptor, else -1 to fall back to a per-process
+// container in the output directory.
+int
+hpcrun_node_container_open
+(
+  void
+);
+
+
+// mark the (closed) staged container complete and, if this is the last
+// process of the node, write the node container
+void
+hpcrun_node_container_close
+(
+  int rank
+);
+
+#endif // hpcrun_node_container_h
@@ -50,13 +50,21 @@
 
 #define _GNU_SOURCE
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 //*****************************************************************************
 // local includes
 //*****************************************************************************
 
 #include "../../../lib/prof-lean/placeholders.h"
 
+#include "../hpcrun_stats.h"
 #include "../unresolved.h"
+#include "../memory/hpcrun-malloc.h"
+#include "../utilities/hpcrun-nanotime.h"
 #include "../utilities/timer.h"
 #include "../audit/audit-api.h"
 
@@ -76,12 +84,144 @@
 
 #define DEFER_DEBUGGING 0
 
+// initial number of slots in a thread's index of pending regions
+#define PENDING_REGIONS_MIN 64
+
 
 
 //*****************************************************************************
 // private operations
 //*****************************************************************************
 
+//-----------------------------------------------------------------------------
+// index of pending regions
+//
+// each region the thread registered for (see register_to_region) is indexed
+// by its region id until its notification is received and the region is
+// resolved. linear probing with backward shift deletion, so no tombstones.
+//-----------------------------------------------------------------------------
+
+static size_t
+pending_regions_slot
+(
+ uint64_t region_id
+)
+{
+  // fibonacci hashing, region ids are mostly sequential
+  return (size_t)((region_id * 0x9E3779B97F4A7C15ull) >> 32)
+    & (pending_regions.capacity - 1);
+}
+
+
+static void
+pending_regions_grow
+(
+ void
+)
+{
+  ompt_pending_region_t *old = pending_regions.slots;
+  size_t old_capacity = pending_regions.capacity;
+
+  // the old table is not freed, hpcrun_malloc memory is never released.
+  // growth is geometric, so at most as much again is left behind.
+  pending_regions.capacity =
+    old_capacity == 0 ? PENDING_REGIONS_MIN : 2 * old_capacity;
+  pending_regions.slots =
+    hpcrun_malloc(pending_regions.capacity * sizeof(ompt_pending_region_t));
+  memset(pending_regions.slots, 0,
+         pending_regions.capacity * sizeof(ompt_pending_region_t));
+
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old[i].notification == NULL) continue;
+    size_t j = pending_regions_slot(old[i].region_id);
+    while (pending_regions.slots[j].notification != NULL)
+      j = (j + 1) & (pending_regions.capacity - 1);
+    pending_regions.slots[j] = old[i];
+  }
+}
+
+
+// return the slot of the notification in the index, or -1 if not pending
+static ptrdiff_t
+pending_regions_find
+(
+ ompt_notification_t *notification
+)
+{
+  if (pending_regions.count == 0) return -1;
+
+  size_t mask = pending_regions.capacity - 1;
+  for (size_t i = pending_regions_slot(notification->region_id); ;
+       i = (i + 1) & mask) {
+    ompt_pending_region_t *slot = &pending_regions.slots[i];
+    if (slot->notification == NULL) return -1;
+    if (slot->notification == notification) return i;
+  }
+}
+
+
+// add the notification to the index. returns false if it already was.
+static bool
+pending_regions_insert
+(
+ ompt_notification_t *notification
+)
+{
+  if (pending_regions_find(notification) >= 0) return false;
+
+  // keep the load factor at most 3/4
+  if (4 * (pending_regions.count + 1) > 3 * pending_regions.capacity)
+    pending_regions_grow();
+
+  size_t mask = pending_regions.capacity - 1;
+  size_t i = pending_regions_slot(notification->region_id);
+  while (pending_regions.slots[i].notification != NULL)
+    i = (i + 1) & mask;
+
+  pending_regions.slots[i] = (ompt_pending_region_t) {
+    .region_id = notification->region_id,
+    .notification = notification,
+    .registered = hpcrun_nanotime(),
+  };
+  pending_regions.count++;
+
+  hpcrun_stats_ompt_pending_regions_sample(pending_regions.count);
+  return true;
+}
+
+
+// remove the notification from the index. returns its registration
+// time, or 0 if it was not pending.
+static uint64_t
+pending_regions_remove
+(
+ ompt_notification_t *notification
+)
+{
+  ptrdiff_t found = pending_regions_find(notification);
+  if (found < 0) return 0;
+
+  uint64_t registered = pending_regions.slots[found].registered;
+  pending_regions.count--;
+
+  // shift later members of the probe sequence back into the hole
+  size_t mask = pending_regions.capacity - 1;
+  size_t hole = found;
+  for (size_t i = (hole + 1) & mask; pending_regions.slots[i].notification != NULL;
+       i = (i + 1) & mask) {
+    size_t home = pending_regions_slot(pending_regions.slots[i].region_id);
+    // move the entry unless its home lies cyclically in (hole, i]
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      pending_regions.slots[hole] = pending_regions.slots[i];
+      hole = i;
+    }
+  }
+  pending_regions.slots[hole].notification = NULL;
+
+  return registered;
+}
+
+
 //
 // TODO: add trace correction info here
 // FIXME: merge metrics belongs in a different file. it is not specific to
@@ -556,6 +696,13 @@ register_to_region
 {
   ompt_region_data_t* region_data = notification->region_data;
 
+  // a notification can only be in one queue at a time. the index catches
+  // a second registration for the same region, which would corrupt it.
+  if (!pending_regions_insert(notification)) {
+    deferred_resolution_breakpoint();
+    return;
+  }
+
   ompt_region_debug_notify_needed(notification);
 
   // create notification and enqueu to region's queue
@@ -676,22 +823,21 @@ hpcrun_cct_insert_path_return_leaf_tmp
     return hpcrun_cct_insert_addr(root, hpcrun_cct_addr(path), true);
 }
 
-// return one if a notification was processed
-int
-try_resolve_one_region_context
+// resolve the region of a notification delivered to this thread, and pass
+// the notification on. now is the time of delivery, for latency statistics.
+static void
+resolve_notification
 (
- void
+ ompt_notification_t *old_head,
+ uint64_t now
 )
 {
-  ompt_notification_t *old_head = NULL;
-
-  old_head = (ompt_notification_t*)
-    wfq_dequeue_private(&threads_queue, OMPT_BASE_T_STAR_STAR(private_threads_queue));
-
-  if (!old_head) return 0;
-
   unresolved_cnt--;
 
+  uint64_t registered = pending_regions_remove(old_head);
+  if (registered != 0 && now > registered)
+    hpcrun_stats_ompt_region_resolved(now - registered);
+
   // region to resolve
   ompt_region_data_t *region_data = old_head->region_data;
 
@@ -742,11 +888,52 @@ try_resolve_one_region_context
     // notify creator of region that region_data can be put in region's freelist
     hpcrun_ompt_region_free(region_data);
   }
+}
+
 
+// return one if a notification was processed
+int
+try_resolve_one_region_context
+(
+ void
+)
+{
+  ompt_notification_t *old_head = (ompt_notification_t*)
+    wfq_dequeue_private(&threads_queue, OMPT_BASE_T_STAR_STAR(private_threads_queue));
+
+  if (!old_head) return 0;
+
+  resolve_notification(old_head, hpcrun_nanotime());
   return 1;
 }
 
 
+// resolve all notifications delivered to this thread so far as one batch.
+// return the number of regions resolved.
+static int
+resolve_region_context_batch
+(
+ void
+)
+{
+  int n = 0;
+  uint64_t now = 0;
+  for (;;) {
+    ompt_notification_t *old_head = (ompt_notification_t*)
+      wfq_dequeue_private(&threads_queue, OMPT_BASE_T_STAR_STAR(private_threads_queue));
+    if (!old_head) break;
+
+    // one clock read serves the whole batch
+    if (n == 0) now = hpcrun_nanotime();
+    resolve_notification(old_head, now);
+    n++;
+  }
+
+  if (n > 0) hpcrun_stats_ompt_region_batch_inc();
+  return n;
+}
+
+
 void
 update_unresolved_node
 (
@@ -810,8 +997,8 @@ ompt_resolve_region_contexts
     // if all regions resolved, we are done
     if (unresolved_cnt == 0) break;
 
-    // poll for a notification to resolve a region context
-    try_resolve_one_region_context();
+    // poll for notifications to resolve region contexts
+    resolve_region_context_batch();
 
     // infrequently check for a timeout
     if (i % 1000) {
@@ -847,7 +1034,7 @@ ompt_resolve_region_contexts_poll
   if (unresolved_cnt) {
     // attempt to resolve contexts by consuming any notifications that
     // are currently pending.
-    while (try_resolve_one_region_context());
+    resolve_region_context_batch();
   };
 }
 
@@ -377,6 +377,7 @@ ompt_thread_begin
 
   registered_regions = NULL;
   unresolved_cnt = 0;
+  pending_regions = (ompt_pending_regions_t) { NULL, 0, 0 };
 //  printf("Tree root begin: %p\n", td->core_profile_trace_data.epoch->csdata.tree_root);
 }
 
@@ -406,7 +407,12 @@ ompt_idle_begin
 {
   undirected_blame_idle_begin(&omp_idle_blame_info);
   if (!ompt_eager_context_p()) {
-    while(try_resolve_one_region_context());
+    // resolving changes this thread's pending regions, which samples
+    // also register with, so keep samples out while it does
+    if (hpcrun_safe_enter()) {
+      ompt_resolve_region_contexts_poll();
+      hpcrun_safe_exit();
+    }
   }
 }
 
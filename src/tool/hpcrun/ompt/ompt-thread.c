@@ -82,6 +82,9 @@ __thread int top_index = -1;
 // number of unresolved regions
 __thread int unresolved_cnt = 0;
 
+// index of the unresolved regions by region id
+__thread ompt_pending_regions_t pending_regions = { NULL, 0, 0 };
+
 // FIXME vi3: just a temp solution
 __thread ompt_region_data_t *ending_region = NULL;
 __thread ompt_frame_t *top_ancestor_frame = NULL;
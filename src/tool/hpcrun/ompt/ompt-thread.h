@@ -109,6 +109,9 @@ extern __thread ompt_frame_t *top_ancestor_frame;
 // number of unresolved regions
 extern __thread int unresolved_cnt;
 
+// index of the unresolved regions by region id
+extern __thread ompt_pending_regions_t pending_regions;
+
 
 //******************************************************************************
 // interface operations
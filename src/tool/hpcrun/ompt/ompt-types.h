@@ -153,6 +153,33 @@ typedef struct ompt_notification_s{
 } ompt_notification_t;
 
 
+// entry of the thread's index of pending regions: a region for which the
+// thread registered and is waiting for the region's call path
+typedef struct ompt_pending_region_s {
+  // region id, the key of the index
+  uint64_t region_id;
+
+  // notification enqueued to the region, NULL for an empty slot
+  ompt_notification_t *notification;
+
+  // time of registration (ns), for resolution latency
+  uint64_t registered;
+} ompt_pending_region_t;
+
+
+// open addressing hash table of the regions pending for a thread,
+// keyed by region id
+typedef struct ompt_pending_regions_s {
+  ompt_pending_region_t *slots;
+
+  // number of slots, zero or a power of two
+  size_t capacity;
+
+  // number of regions pending
+  size_t count;
+} ompt_pending_regions_t;
+
+
 // trl = Thread's Regions List
 // el  = element
 typedef struct ompt_trl_el_s {
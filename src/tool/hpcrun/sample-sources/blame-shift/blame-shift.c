@@ -26,6 +26,13 @@ blame_shift_apply(int metric_id, cct_node_t *node, int metric_incr)
 }
 
 
+int
+blame_shift_active(void)
+{
+   return bs_fns != 0;
+}
+
+
 void
 blame_shift_source_register(bs_type bst)
 {
@@ -19,6 +19,7 @@ typedef enum bs_type{
 
 void blame_shift_register(bs_fn_entry_t* entry);
 void blame_shift_apply(int metric_id, cct_node_t* node, int metric_incr);
+int blame_shift_active(void);
 void blame_shift_source_register(bs_type bst);
 int blame_shift_source_available(bs_type bst);
 
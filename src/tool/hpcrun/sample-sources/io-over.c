@@ -54,18 +54,18 @@
 // written.  This covers both stream IO (fread, fwrite, etc) and
 // unbuffered IO (read, write, etc).
 //
-// Note: for the slow or blocking overrides, we record samples before
-// and after the function.  If a process blocks in kernel, then it
-// won't receive async interrupts and this may under report the time
-// in the trace.  Using two samples assures that we see the full span
-// of the function in the trace viewer.
+// Note: for the slow or blocking overrides, we unwind once before
+// the function and attribute the bytes and time to that same CCT node
+// afterwards.  If a process blocks in kernel, then it won't receive
+// async interrupts and this may under report the time in the trace.
+// Appending trace records at both ends of the call assures that we
+// see the full span of the function in the trace viewer.
 //
-// TODO list:
+// Unwinding is the dominant cost for small-record IO, so with a byte
+// or time threshold (see io.c) calls below it are not unwound at all;
+// their bytes and time are carried over to the next unwound call.
 //
-// 2. In the second sample (after the real function), want to record
-// the sample without doing a full unwind (which is the same path as
-// the first sample).  This may require a little refactoring in the
-// sample event code.
+// TODO list:
 //
 // 3. When taking the user context, replace the syscall with the
 // assembler macros.  This may require a little refactoring of the
@@ -89,6 +89,7 @@
 
 #include <sys/types.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <ucontext.h>
 #include <unistd.h>
@@ -100,14 +101,125 @@
 
 #include "io-over.h"
 
+#include "../cct2metrics.h"
 #include "../main.h"
 #include "../safe-sampling.h"
 #include "../sample_event.h"
 #include "../thread_data.h"
+#include "../trace.h"
+#include "../utilities/hpcrun-nanotime.h"
 
 #include "../messages/messages.h"
 #include "io.h"
 
+/******************************************************************************
+ * type definitions
+ *****************************************************************************/
+
+// Per-direction state for one IO call: the CCT node from the pre-call
+// unwind (NULL if not unwound) and the epoch it belongs to.
+typedef struct io_call_s {
+  cct_node_t *node;
+  epoch_t *epoch;
+  uint64_t start;
+} io_call_t;
+
+// Bytes and time of calls not yet attributed to a CCT node.
+typedef struct io_pending_s {
+  uint64_t bytes;
+  uint64_t nsec;
+} io_pending_t;
+
+
+
+/******************************************************************************
+ * private data
+ *****************************************************************************/
+
+static __thread io_pending_t io_read_pending;
+static __thread io_pending_t io_write_pending;
+
+
+
+/******************************************************************************
+ * private operations
+ *****************************************************************************/
+
+static int
+io_should_unwind(io_pending_t *pending)
+{
+  uint64_t byte_period = hpcrun_io_byte_period();
+  uint64_t time_period = hpcrun_io_time_period();
+
+  if (byte_period == 0 && time_period == 0) {
+    return 1;
+  }
+  return (byte_period > 0 && pending->bytes >= byte_period)
+    || (time_period > 0 && pending->nsec >= time_period);
+}
+
+
+// Before the real function: unwind (if over threshold) and remember
+// the resulting node.  Call within a safe region.
+//
+static void
+io_call_begin(io_call_t *call, ucontext_t *uc, int metric_id, io_pending_t *pending)
+{
+  call->node = NULL;
+  call->epoch = NULL;
+
+  if (io_should_unwind(pending)) {
+    thread_data_t *td = hpcrun_get_thread_data();
+    sample_val_t smpl =
+      hpcrun_sample_callpath(uc, metric_id, (hpcrun_metricVal_t) {.i=0}, 0, 1, NULL);
+    call->node = smpl.sample_node;
+    call->epoch = td->core_profile_trace_data.epoch;
+  }
+
+  call->start = hpcrun_nanotime();
+  if (call->node != NULL) {
+    thread_data_t *td = hpcrun_get_thread_data();
+    hpcrun_trace_append_stream(&td->core_profile_trace_data, call->node,
+                               metric_id, td->prev_dLCA, call->start);
+  }
+}
+
+
+// After the real function: add bytes and time directly to the node
+// from io_call_begin, without a second unwind.  If the profile was
+// flushed while inside the real function, the node is gone and the
+// call is carried over like an unsampled one.  Call within a safe
+// region.
+//
+static void
+io_call_end(io_call_t *call, int bytes_metric_id, int time_metric_id,
+            io_pending_t *pending, uint64_t bytes)
+{
+  uint64_t end = hpcrun_nanotime();
+  thread_data_t *td = hpcrun_get_thread_data();
+
+  pending->bytes += bytes;
+  pending->nsec += end - call->start;
+
+  if (call->node == NULL || call->epoch != td->core_profile_trace_data.epoch) {
+    return;
+  }
+
+  cct_metric_data_increment(bytes_metric_id, call->node,
+                            (cct_metric_data_t) {.i = pending->bytes});
+  if (time_metric_id >= 0) {
+    cct_metric_data_increment(time_metric_id, call->node,
+                              (cct_metric_data_t) {.r = pending->nsec / 1.0e9});
+  }
+  hpcrun_trace_append_stream(&td->core_profile_trace_data, call->node,
+                             bytes_metric_id, td->prev_dLCA, end);
+
+  pending->bytes = 0;
+  pending->nsec = 0;
+}
+
+
+
 /******************************************************************************
  * interface operations
  *****************************************************************************/
@@ -116,6 +228,7 @@ ssize_t
 foilbase_read(read_fn_t* real_read, int fd, void *buf, size_t count)
 {
   ucontext_t uc;
+  io_call_t call;
   ssize_t ret;
   int metric_id_read = hpcrun_metric_id_read();
   int save_errno;
@@ -124,24 +237,18 @@ foilbase_read(read_fn_t* real_read, int fd, void *buf, size_t count)
     return real_read(fd, buf, count);
   }
 
-  // insert samples before and after the slow functions to make the
-  // traces look better.
   getcontext(&uc);
-  hpcrun_sample_callpath(&uc, metric_id_read,
-        (hpcrun_metricVal_t) {.i=0},
-        0, 1, NULL);
+  io_call_begin(&call, &uc, metric_id_read, &io_read_pending);
 
   hpcrun_safe_exit();
   ret = real_read(fd, buf, count);
   save_errno = errno;
   hpcrun_safe_enter();
 
-  // FIXME: the second sample should not do a full unwind.
   TMSG(IO, "read: fd: %d, buf: %p, count: %ld, actual: %ld",
        fd, buf, count, ret);
-  hpcrun_sample_callpath(&uc, metric_id_read,
-        (hpcrun_metricVal_t) {.i=(ret > 0 ? ret : 0)},
-        0, 1, NULL);
+  io_call_end(&call, metric_id_read, hpcrun_metric_id_read_time(),
+              &io_read_pending, (ret > 0 ? ret : 0));
   hpcrun_safe_exit();
 
   errno = save_errno;
@@ -153,7 +260,8 @@ ssize_t
 foilbase_write(write_fn_t* real_write, int fd, const void *buf, size_t count)
 {
   ucontext_t uc;
-  size_t ret;
+  io_call_t call;
+  ssize_t ret;
   int metric_id_write = hpcrun_metric_id_write();
   int save_errno;
 
@@ -161,24 +269,18 @@ foilbase_write(write_fn_t* real_write, int fd, const void *buf, size_t count)
     return real_write(fd, buf, count);
   }
 
-  // insert samples before and after the slow functions to make the
-  // traces look better.
   getcontext(&uc);
-  hpcrun_sample_callpath(&uc, metric_id_write,
-            (hpcrun_metricVal_t) {.i=0},
-            0, 1, NULL);
+  io_call_begin(&call, &uc, metric_id_write, &io_write_pending);
 
   hpcrun_safe_exit();
   ret = real_write(fd, buf, count);
   save_errno = errno;
   hpcrun_safe_enter();
 
-  // FIXME: the second sample should not do a full unwind.
   TMSG(IO, "write: fd: %d, buf: %p, count: %ld, actual: %ld",
        fd, buf, count, ret);
-  hpcrun_sample_callpath(&uc, metric_id_write,
-        (hpcrun_metricVal_t) {.i=(ret > 0 ? ret : 0)},
-        0, 1, NULL);
+  io_call_end(&call, metric_id_write, hpcrun_metric_id_write_time(),
+              &io_write_pending, (ret > 0 ? ret : 0));
   hpcrun_safe_exit();
 
   errno = save_errno;
@@ -190,6 +292,7 @@ size_t
 foilbase_fread(fread_fn_t* real_fread, void *ptr, size_t size, size_t count, FILE *stream)
 {
   ucontext_t uc;
+  io_call_t call;
   size_t ret;
   int metric_id_read = hpcrun_metric_id_read();
 
@@ -197,24 +300,17 @@ foilbase_fread(fread_fn_t* real_fread, void *ptr, size_t size, size_t count, FIL
     return real_fread(ptr, size, count, stream);
   }
 
-  // insert samples before and after the slow functions to make the
-  // traces look better.
-
   getcontext(&uc);
-  hpcrun_sample_callpath(&uc, metric_id_read,
-            (hpcrun_metricVal_t) {.i=0},
-            0, 1, NULL);
+  io_call_begin(&call, &uc, metric_id_read, &io_read_pending);
 
   hpcrun_safe_exit();
   ret = real_fread(ptr, size, count, stream);
   hpcrun_safe_enter();
 
-  // FIXME: the second sample should not do a full unwind.
   TMSG(IO, "fread: size: %ld, count: %ld, bytes: %ld, actual: %ld",
        size, count, count*size, ret*size);
-  hpcrun_sample_callpath(&uc, metric_id_read,
-            (hpcrun_metricVal_t) {.i=ret*size},
-            0, 1, NULL);
+  io_call_end(&call, metric_id_read, hpcrun_metric_id_read_time(),
+              &io_read_pending, ret*size);
   hpcrun_safe_exit();
 
   return ret;
@@ -225,6 +321,7 @@ size_t
 foilbase_fwrite(fwrite_fn_t* real_fwrite, const void *ptr, size_t size, size_t count, FILE *stream)
 {
   ucontext_t uc;
+  io_call_t call;
   size_t ret;
   int metric_id_write = hpcrun_metric_id_write();
 
@@ -232,23 +329,17 @@ foilbase_fwrite(fwrite_fn_t* real_fwrite, const void *ptr, size_t size, size_t c
     return real_fwrite(ptr, size, count, stream);
   }
 
-  // insert samples before and after the slow functions to make the
-  // traces look better.
   getcontext(&uc);
-  hpcrun_sample_callpath(&uc, metric_id_write,
-            (hpcrun_metricVal_t) {.i=0},
-            0, 1, NULL);
+  io_call_begin(&call, &uc, metric_id_write, &io_write_pending);
 
   hpcrun_safe_exit();
   ret = real_fwrite(ptr, size, count, stream);
   hpcrun_safe_enter();
 
-  // FIXME: the second sample should not do a full unwind.
   TMSG(IO, "fwrite: size: %ld, count: %ld, bytes: %ld, actual: %ld",
        size, count, count*size, ret*size);
-  hpcrun_sample_callpath(&uc, metric_id_write,
-            (hpcrun_metricVal_t) {.i=ret*size},
-            0, 1, NULL);
+  io_call_end(&call, metric_id_write, hpcrun_metric_id_write_time(),
+              &io_write_pending, ret*size);
   hpcrun_safe_exit();
 
   return ret;
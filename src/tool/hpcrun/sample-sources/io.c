@@ -50,8 +50,10 @@
 
 #define _GNU_SOURCE
 
+#include <inttypes.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 
@@ -76,6 +78,13 @@
 
 static int metric_id_read = -1;
 static int metric_id_write = -1;
+static int metric_id_read_time = -1;
+static int metric_id_write_time = -1;
+
+static uint64_t io_byte_period = 0;
+static uint64_t io_time_period = 0;
+
+#define HPCRUN_IO_TIME_PERIOD  "HPCRUN_IO_TIME_PERIOD"
 
 
 /******************************************************************************
@@ -89,6 +98,10 @@ METHOD_FN(init)
   self->state = INIT;
   metric_id_read = -1;
   metric_id_write = -1;
+  metric_id_read_time = -1;
+  metric_id_write_time = -1;
+  io_byte_period = 0;
+  io_time_period = 0;
 }
 
 
@@ -148,15 +161,41 @@ METHOD_FN(supports_event, const char *ev_str)
 }
 
 
-// IO metrics: bytes read and bytes written.
+// IO metrics: bytes read and bytes written, and time spent in the
+// read and write calls.
+//
+// IO@<bytes> sets a byte threshold for unwinding, and the
+// HPCRUN_IO_TIME_PERIOD environment variable sets a time threshold in
+// nanoseconds.  Calls below both thresholds are not unwound; their
+// bytes and time are carried over to the next call that is.
 
 static void
 METHOD_FN(process_event_list, int lush_metrics)
 {
+  char *evlist = METHOD_CALL(self, get_event_str);
+  char *event = start_tok(evlist);
+  char name[1024];
+  long period = 0;
+
+  hpcrun_extract_ev_thresh(event, sizeof(name), name, &period, 0);
+  io_byte_period = (period > 0) ? period : 0;
+
+  char *time_str = getenv(HPCRUN_IO_TIME_PERIOD);
+  if (time_str != NULL) {
+    io_time_period = strtoull(time_str, NULL, 10);
+  }
+  TMSG(IO, "byte period: %"PRIu64", time period: %"PRIu64" ns", io_byte_period, io_time_period);
+
   TMSG(IO, "create metrics for IO bytes read and bytes written");
   kind_info_t *io_kind = hpcrun_metrics_new_kind();
   metric_id_read = hpcrun_set_new_metric_info(io_kind, "IO Bytes Read");
   metric_id_write = hpcrun_set_new_metric_info(io_kind, "IO Bytes Written");
+  metric_id_read_time =
+    hpcrun_set_new_metric_info_and_period(io_kind, "IO Read Time (sec)",
+                                          MetricFlags_ValFmt_Real, 1, metric_property_time);
+  metric_id_write_time =
+    hpcrun_set_new_metric_info_and_period(io_kind, "IO Write Time (sec)",
+                                          MetricFlags_ValFmt_Real, 1, metric_property_time);
   hpcrun_close_kind(io_kind);
   TMSG(IO, "metric id read: %d, write: %d", metric_id_read, metric_id_write);
 }
@@ -181,7 +220,9 @@ METHOD_FN(display_events)
   printf("===========================================================================\n");
   printf("Name\t\tDescription\n");
   printf("---------------------------------------------------------------------------\n");
-  printf("IO\t\t" "The number of bytes read and written per dynamic context\n");
+  printf("IO\t\t" "The number of bytes read and written and the time spent\n"
+         "\t\t" "reading and writing per dynamic context.  IO@<bytes> only\n"
+         "\t\t" "unwinds once per <bytes> transferred.\n");
   printf("\n");
 }
 
@@ -215,3 +256,27 @@ hpcrun_metric_id_write(void)
 {
   return metric_id_write;
 }
+
+int
+hpcrun_metric_id_read_time(void)
+{
+  return metric_id_read_time;
+}
+
+int
+hpcrun_metric_id_write_time(void)
+{
+  return metric_id_write_time;
+}
+
+uint64_t
+hpcrun_io_byte_period(void)
+{
+  return io_byte_period;
+}
+
+uint64_t
+hpcrun_io_time_period(void)
+{
+  return io_time_period;
+}
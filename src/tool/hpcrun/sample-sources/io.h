@@ -47,7 +47,18 @@
 #ifndef _HPCRUN_IO_H_
 #define _HPCRUN_IO_H_
 
+#include <stdint.h>
+
 int hpcrun_metric_id_read(void);
 int hpcrun_metric_id_write(void);
+int hpcrun_metric_id_read_time(void);
+int hpcrun_metric_id_write_time(void);
+
+// Sampling thresholds for the IO overrides: an IO call is unwound only
+// once this many bytes (IO@<bytes>) or nanoseconds
+// (HPCRUN_IO_TIME_PERIOD) have accumulated since the last unwind.
+// Zero for both means every call is unwound.
+uint64_t hpcrun_io_byte_period(void);
+uint64_t hpcrun_io_time_period(void);
 
 #endif
@@ -707,7 +707,9 @@ itimer_signal_handler(int sig, siginfo_t* siginfo, void* context)
     .sample_clock = 0,
     .sample_data = NULL,
     .sampling_period = period * 1000,
-    .is_time_based_metric = 1
+    .is_time_based_metric = 1,
+    // blame shifting needs the sample node
+    .may_defer = !blame_shift_active()
   };
 
   sample_val_t sv = hpcrun_sample_callpath(context, metric_id, metric_delta,
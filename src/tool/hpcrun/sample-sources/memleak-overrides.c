@@ -66,6 +66,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <ucontext.h>
 
@@ -138,6 +139,11 @@ leakinfo_t leakinfo_NULL = { .magic = 0, .context = NULL, .bytes = 0 };
 #define HPCRUN_MEMLEAK_PROB  "HPCRUN_MEMLEAK_PROB"
 #define DEFAULT_PROB  0.1
 
+// must be a power of 2
+#define MEMLEAK_SHARD_BITS   8
+#define MEMLEAK_NUM_SHARDS   (1 << MEMLEAK_SHARD_BITS)
+#define MEMLEAK_SHARD_ALIGN  128
+
 
 /******************************************************************************
  * private data
@@ -148,8 +154,24 @@ static int leak_detection_init = 0;    // default is uninitialized
 static int use_memleak_prob = 0;
 static float memleak_prob = 0.0;
 
-static struct leakinfo_s *memleak_tree_root = NULL;
-static spinlock_t memtree_lock = SPINLOCK_UNLOCKED;
+// Out-of-band (footer) leakinfo structs are indexed by their
+// application pointer in a table of independently locked splay trees.
+// A malloc/free pair only touches the shard its address hashes to, so
+// threads allocating unrelated blocks do not serialize on one lock.
+//
+typedef struct memleak_shard_s {
+  spinlock_t lock;
+  atomic_long count;
+  struct leakinfo_s *root;
+} __attribute__((aligned(MEMLEAK_SHARD_ALIGN))) memleak_shard_t;
+
+static memleak_shard_t memleak_shards[MEMLEAK_NUM_SHARDS] = {
+  [0 ... MEMLEAK_NUM_SHARDS - 1] = { .lock = SPINLOCK_UNLOCKED, .root = NULL }
+};
+
+static unsigned int memleak_seed = 0;
+static __thread unsigned int memleak_rand_state = 0;
+static __thread int memleak_rand_init = 0;
 
 static int leakinfo_size = sizeof(struct leakinfo_s);
 static long memleak_pagesize = MEMLEAK_DEFAULT_PAGESIZE;
@@ -179,33 +201,47 @@ splay(struct leakinfo_s *root, void *key)
 }
 
 
+// Fibonacci hash of the block address.  The low bits are dropped
+// since malloc results are at least 16-byte aligned.
+//
+static inline memleak_shard_t *
+memleak_shard(void *memblock)
+{
+  uint64_t key = ((uintptr_t) memblock) >> 4;
+
+  return &memleak_shards[(key * 0x9E3779B97F4A7C15ULL) >> (64 - MEMLEAK_SHARD_BITS)];
+}
+
+
 static void
 splay_insert(struct leakinfo_s *node)
 {
   void *memblock = node->memblock;
+  memleak_shard_t *shard = memleak_shard(memblock);
 
   node->left = node->right = NULL;
 
-  spinlock_lock(&memtree_lock);
-  if (memleak_tree_root != NULL) {
-    memleak_tree_root = splay(memleak_tree_root, memblock);
-
-    if (memblock < memleak_tree_root->memblock) {
-      node->left = memleak_tree_root->left;
-      node->right = memleak_tree_root;
-      memleak_tree_root->left = NULL;
-    } else if (memblock > memleak_tree_root->memblock) {
-      node->left = memleak_tree_root;
-      node->right = memleak_tree_root->right;
-      memleak_tree_root->right = NULL;
+  spinlock_lock(&shard->lock);
+  if (shard->root != NULL) {
+    shard->root = splay(shard->root, memblock);
+
+    if (memblock < shard->root->memblock) {
+      node->left = shard->root->left;
+      node->right = shard->root;
+      shard->root->left = NULL;
+    } else if (memblock > shard->root->memblock) {
+      node->left = shard->root;
+      node->right = shard->root->right;
+      shard->root->right = NULL;
     } else {
       TMSG(MEMLEAK, "memleak splay tree: unable to insert %p (already present)",
            node->memblock);
       hpcrun_terminate();
     }
   }
-  memleak_tree_root = node;
-  spinlock_unlock(&memtree_lock);
+  shard->root = node;
+  atomic_fetch_add_explicit(&shard->count, 1, memory_order_relaxed);
+  spinlock_unlock(&shard->lock);
 }
 
 
@@ -213,34 +249,43 @@ static struct leakinfo_s *
 splay_delete(void *memblock)
 {
   struct leakinfo_s *result = NULL;
+  memleak_shard_t *shard = memleak_shard(memblock);
+
+  // Fast path: frees of blocks that were never tracked (before init,
+  // not sampled, header layout) usually land in an empty shard.  The
+  // block can't be inserted concurrently with its own free, so an
+  // empty shard means there is nothing to find and no need to lock.
+  if (atomic_load_explicit(&shard->count, memory_order_relaxed) == 0) {
+    TMSG(MEMLEAK, "memleak splay tree empty: unable to delete %p", memblock);
+    return NULL;
+  }
 
-  spinlock_lock(&memtree_lock);
-  if (memleak_tree_root == NULL) {
-    spinlock_unlock(&memtree_lock);
+  spinlock_lock(&shard->lock);
+  if (shard->root == NULL) {
+    spinlock_unlock(&shard->lock);
     TMSG(MEMLEAK, "memleak splay tree empty: unable to delete %p", memblock);
     return NULL;
   }
 
-  memleak_tree_root = splay(memleak_tree_root, memblock);
+  shard->root = splay(shard->root, memblock);
 
-  if (memblock != memleak_tree_root->memblock) {
-    spinlock_unlock(&memtree_lock);
+  if (memblock != shard->root->memblock) {
+    spinlock_unlock(&shard->lock);
     TMSG(MEMLEAK, "memleak splay tree: %p not in tree", memblock);
     return NULL;
   }
 
-  result = memleak_tree_root;
+  result = shard->root;
 
-  if (memleak_tree_root->left == NULL) {
-    memleak_tree_root = memleak_tree_root->right;
-    spinlock_unlock(&memtree_lock);
-    return result;
+  if (shard->root->left == NULL) {
+    shard->root = shard->root->right;
+  } else {
+    shard->root->left = splay(shard->root->left, memblock);
+    shard->root->left->right = shard->root->right;
+    shard->root = shard->root->left;
   }
-
-  memleak_tree_root->left = splay(memleak_tree_root->left, memblock);
-  memleak_tree_root->left->right = memleak_tree_root->right;
-  memleak_tree_root =  memleak_tree_root->left;
-  spinlock_unlock(&memtree_lock);
+  atomic_fetch_sub_explicit(&shard->count, 1, memory_order_relaxed);
+  spinlock_unlock(&shard->lock);
   return result;
 }
 
@@ -306,7 +351,7 @@ memleak_initialize(void)
     }
     gettimeofday(&tv, NULL);
     seed += (getpid() << 16) + (tv.tv_usec << 4);
-    srandom(seed);
+    memleak_seed = seed;
   }
 
   // unconditionally enable leak detection for now
@@ -317,6 +362,24 @@ memleak_initialize(void)
 }
 
 
+// Decide whether to track this malloc under HPCRUN_MEMLEAK_PROB.
+// random() takes a process-wide lock inside libc, so each thread
+// keeps its own rand_r() state, seeded from the process seed.
+//
+static int
+memleak_not_sampled(void)
+{
+  if (! use_memleak_prob) {
+    return 0;
+  }
+  if (! memleak_rand_init) {
+    memleak_rand_state = memleak_seed ^ (unsigned int) (uintptr_t) &memleak_rand_state;
+    memleak_rand_init = 1;
+  }
+  return rand_r(&memleak_rand_state)/(float)RAND_MAX > memleak_prob;
+}
+
+
 // Returns: 1 if p1 and p2 are on the same physical page.
 //
 static inline int
@@ -480,7 +543,7 @@ memleak_malloc_helper(memalign_fcn* real_memalign, malloc_fcn* real_malloc,
   } else if (TD_GET(inside_dlfcn)) {
     active = 0;
     inactive_mesg = "unable to monitor: inside dlfcn";
-  } else if (use_memleak_prob && (random()/(float)RAND_MAX > memleak_prob)) {
+  } else if (memleak_not_sampled()) {
     active = 0;
     inactive_mesg = "not sampled";
   }
@@ -794,7 +857,7 @@ foilbase_realloc(memalign_fcn* real_memalign, malloc_fcn* real_malloc, realloc_f
   } else if (TD_GET(inside_dlfcn)) {
     active = 0;
     inactive_mesg = "unable to monitor: inside dlfcn";
-  } else if (use_memleak_prob && (random()/(float)RAND_MAX > memleak_prob)) {
+  } else if (memleak_not_sampled()) {
     active = 0;
     inactive_mesg = "not sampled";
   }
@@ -117,6 +117,8 @@ SAMPLE_SOURCE_DECL_MACRO(level0)
 SAMPLE_SOURCE_DECL_MACRO(opencl)
 #endif
 
+SAMPLE_SOURCE_DECL_MACRO(synthetic_gpu)
+
 #ifdef HPCRUN_CPU_GPU_IDLE
 SAMPLE_SOURCE_DECL_MACRO(cpu_gpu_idle)
 #endif
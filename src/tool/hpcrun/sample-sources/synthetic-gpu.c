@@ -0,0 +1,198 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//******************************************************************************
+// local includes
+//******************************************************************************
+
+#define _GNU_SOURCE
+
+#include "common.h"
+
+#include "../device-finalizers.h"
+#include "../gpu/gpu-metrics.h"
+#include "../gpu/trace/gpu-trace-api.h"
+#include "../gpu/api/synthetic/synthetic-api.h"
+#include "../thread_data.h"
+#include "../trace.h"
+#include "../messages/messages.h"
+#include "../utilities/tokenize.h"
+
+
+
+//******************************************************************************
+// macros
+//******************************************************************************
+
+#define SYNTHETIC_GPU_OPTION "gpu=synthetic"
+
+
+
+//******************************************************************************
+// local variables
+//******************************************************************************
+
+static device_finalizer_fn_entry_t device_finalizer_shutdown;
+
+
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+static void
+METHOD_FN(init)
+{
+  self->state = INIT;
+}
+
+
+static void
+METHOD_FN(thread_init)
+{
+  TMSG(GPU, "synthetic thread_init");
+}
+
+
+static void
+METHOD_FN(thread_init_action)
+{
+  TMSG(GPU, "synthetic thread_init_action");
+}
+
+
+static void
+METHOD_FN(start)
+{
+  TMSG(GPU, "synthetic start");
+  TD_GET(ss_state)[self->sel_idx] = START;
+
+  synthetic_api_launch();
+}
+
+
+static void
+METHOD_FN(thread_fini_action)
+{
+  TMSG(GPU, "synthetic thread_fini_action");
+}
+
+
+static void
+METHOD_FN(stop)
+{
+  hpcrun_get_thread_data();
+  TD_GET(ss_state)[self->sel_idx] = STOP;
+}
+
+
+static void
+METHOD_FN(shutdown)
+{
+  self->state = UNINIT;
+}
+
+
+static bool
+METHOD_FN(supports_event, const char *ev_str)
+{
+  return hpcrun_ev_is(ev_str, SYNTHETIC_GPU_OPTION);
+}
+
+
+static void
+METHOD_FN(process_event_list, int lush_metrics)
+{
+  hpcrun_set_trace_metric(HPCRUN_GPU_TRACE_FLAG);
+  gpu_metrics_default_enable();
+  gpu_metrics_KINFO_enable();
+}
+
+
+static void
+METHOD_FN(finalize_event_list)
+{
+  synthetic_api_initialize();
+
+  // generator threads drain their own activities before they exit, so
+  // only process shutdown needs a finalizer
+  device_finalizer_shutdown.fn = synthetic_api_process_finalize;
+  device_finalizer_register(device_finalizer_type_shutdown, &device_finalizer_shutdown);
+}
+
+
+static void
+METHOD_FN(gen_event_set,int lush_metrics)
+{
+}
+
+
+static void
+METHOD_FN(display_events)
+{
+  printf("===========================================================================\n");
+  printf("Available events for benchmarking GPU monitoring\n");
+  printf("===========================================================================\n");
+  printf("Name\t\tDescription\n");
+  printf("---------------------------------------------------------------------------\n");
+  printf("gpu=synthetic\tDrive the GPU activity pipeline with a simulated device.\n"
+         "\t\tNo GPU is needed. The workload is configured with the\n"
+         "\t\tSYNTHETIC_GPU_* control knobs in HPCRUN_CONTROL_KNOBS;\n"
+         "\t\tthroughput and per-operation cost are reported at exit.\n"
+         "\n");
+}
+
+
+
+//**************************************************************************
+// object
+//**************************************************************************
+
+#define ss_name synthetic_gpu
+#define ss_cls SS_HARDWARE
+#define ss_sort_order  25
+
+#include "ss_obj.h"
@@ -71,8 +71,10 @@
 #include "utilities/arch/context-pc.h"
 #include "memory/hpcrun-malloc.h"
 #include "sample_event.h"
+#include "sample_ring.h"
 #include "sample_sources_all.h"
 #include "start-stop.h"
+#include "unwind/common/unw-bench.h"
 #include "unwind/common/uw_recipe_map.h"
 #include "unwind/common/validate_return_addr.h"
 #include "write_data.h"
@@ -170,7 +172,7 @@ hpcrun_drop_sample(void)
 }
 
 static cct_node_t *
-hpcrun_trace_ip(ip_normalized_t leaf_ip, cct_node_t *parent, int metricId, uint64_t sampling_period)
+hpcrun_trace_ip(ip_normalized_t leaf_ip, cct_node_t *parent, int metricId, uint64_t sampling_period, uint64_t nanotime)
 {
   cct_node_t *trace_node = NULL;
 
@@ -193,13 +195,50 @@ hpcrun_trace_ip(ip_normalized_t leaf_ip, cct_node_t *parent, int metricId, uint6
     trace_node = func_proxy;
 
     TMSG(TRACE, "Changed persistent id to indicate mutation of func_proxy node");
-    hpcrun_trace_append(&td->core_profile_trace_data, func_proxy, metricId, td->prev_dLCA, sampling_period);
+    hpcrun_trace_append_at(&td->core_profile_trace_data, func_proxy, metricId, td->prev_dLCA, sampling_period, nanotime);
     TMSG(TRACE, "Appended func_proxy node to trace");
   }
 
   return trace_node;
 }
 
+cct_node_t *
+hpcrun_trace_sample(cct_node_t *node, ip_normalized_t bt_leaf_ip,
+                    ip_normalized_t bt_leaf_function, int metricId,
+                    uint64_t sampling_period, uint64_t nanotime)
+{
+  cct_addr_t *addr = hpcrun_cct_addr(node);
+  ip_normalized_t leaf_ip = addr->ip_norm;
+
+  if (is_placeholder(leaf_ip)) {
+    // placeholders shouldn't be adjusted
+  } else if (ip_normalized_eq(&leaf_ip, &bt_leaf_ip)) {
+    // the call chain sampled has as its leaf an instruction in a user
+    // procedure. we know this because leaf_ip matches the first entry
+    // in the backtrace buffer.  samples in kernel space yield a
+    // leaf_ip that is not logged in the backtrace buffer. for user
+    // space samples, the first entry in the backtrace buffer includes
+    // not only the normalized IP of the call chain leaf but also the
+    // IP of the first instruction in the enclosing function, which we
+    // use to uniquely represent the function itself. in this case, we
+    // adjust leaf_ip to point to the first IP of its enclosing
+    // function to simplify processing of procedure-level traces for
+    // call chains that are completely in user space.
+
+    // when call chain tracing is enabled, tracing arbitrary leaf IPs
+    // for user space call chains is messy because it can cause
+    // trace-ids to be marked on multiple call chain leaves
+    // (instructions) that belong to the same source-level
+    // statement. collapsing these when call path traces are present
+    // leaves us with many trace-ids referring to the same source
+    // construct. trust me: merging here is easier :-).
+    leaf_ip = bt_leaf_function;
+  }
+
+  return hpcrun_trace_ip(leaf_ip, hpcrun_cct_parent(node), metricId,
+                         sampling_period, nanotime);
+}
+
 void
 hpcrun_trace_node(cct_node_t *node)
 {
@@ -211,7 +250,8 @@ hpcrun_trace_node(cct_node_t *node)
     // needs a proper metric for a data-centric trace
     int metricId = 0;
     uint64_t sampling_period = UINT64_MAX;
-    hpcrun_trace_ip(addr->ip_norm, parent, metricId, sampling_period);
+    hpcrun_sample_ring_drain();
+    hpcrun_trace_ip(addr->ip_norm, parent, metricId, sampling_period, 0);
 #endif
   }
 }
@@ -265,6 +305,14 @@ hpcrun_sample_callpath(void* context, int metricId,
   cct_node_t* node = NULL;
   epoch_t* epoch = td->core_profile_trace_data.epoch;
 
+  // an asynchronous sample whose node is not needed by the caller may
+  // be staged and inserted into the cct later
+  bool stage = !isSync && data != NULL && data->may_defer
+    && hpcrun_backtrace_may_stage();
+#ifdef TORCH_MONITOR_ENABLE
+  stage = stage && !torch_monitor_status_get();
+#endif
+
   // --------------------------------------
   // start of handling sample
   // --------------------------------------
@@ -281,26 +329,38 @@ hpcrun_sample_callpath(void* context, int metricId,
       /* check to see if shared library loadmap (of current epoch) has changed out from under us */
       epoch = hpcrun_check_for_new_loadmap(epoch);
 
+      if (!isSync) {
+        hpcrun_unw_bench_capture(context);
+      }
+
       void *data_aux = NULL;
       if (data != NULL)
         data_aux = data->sample_data;
 
+      if (stage) {
+        hpcrun_backtrace2ring(&(epoch->csdata), context, metricId,
+          metricIncr, skipInner, data);
+      } else {
+        // staged samples precede this one in the cct and the trace
+        hpcrun_sample_ring_drain();
+
 #ifdef TORCH_MONITOR_ENABLE
-      if (torch_monitor_status_get() && !torch_monitor_native_stack_status_get()) {
-        TMSG(TORCH_MONITOR, "torch_monitor backtrace2cct invoked");
-        node = torch_monitor_backtrace2cct(&(epoch->csdata), metricId, metricIncr);
-      }
-      
-      if (node == NULL) {
+        if (torch_monitor_status_get() && !torch_monitor_native_stack_status_get()) {
+          TMSG(TORCH_MONITOR, "torch_monitor backtrace2cct invoked");
+          node = torch_monitor_backtrace2cct(&(epoch->csdata), metricId, metricIncr);
+        }
+
+        if (node == NULL) {
 #endif
-        TMSG(SAMPLE_CALLPATH, "%s taking profile sample", __func__);
-        TMSG(SAMPLE_METRIC_DATA, "--metric data for sample (as a uint64_t) = %"PRIu64"", metricIncr);
+          TMSG(SAMPLE_CALLPATH, "%s taking profile sample", __func__);
+          TMSG(SAMPLE_METRIC_DATA, "--metric data for sample (as a uint64_t) = %"PRIu64"", metricIncr);
 
-        node  = hpcrun_backtrace2cct(&(epoch->csdata), context, metricId,
-          metricIncr, skipInner, isSync, data_aux);
+          node  = hpcrun_backtrace2cct(&(epoch->csdata), context, metricId,
+            metricIncr, skipInner, isSync, data_aux);
 #ifdef TORCH_MONITOR_ENABLE
-      }
+        }
 #endif
+      }
 
       if (ENABLED(DUMP_BACKTRACES)) {
         hpcrun_bt_dump(td->btbuf_cur, "UNWIND");
@@ -308,6 +368,11 @@ hpcrun_sample_callpath(void* context, int metricId,
     }
   }
   else {  // Partial unwind case
+    // skip a staged sample whose insertion faulted, then record the
+    // rest ahead of this one
+    hpcrun_sample_ring_recover();
+    hpcrun_sample_ring_drain();
+
     cct_bundle_t* cct = &(td->core_profile_trace_data.epoch->csdata);
 #ifdef TORCH_MONITOR_ENABLE
     if (torch_monitor_status_get() && !torch_monitor_native_stack_status_get()) {
@@ -331,45 +396,24 @@ hpcrun_sample_callpath(void* context, int metricId,
 
   ret.sample_node = node;
 
-  cct_addr_t *addr = hpcrun_cct_addr(node);
-  ip_normalized_t leaf_ip = addr->ip_norm;
-
-  if (is_placeholder(leaf_ip)) {
-    // placeholders shouldn't be adjusted
-  } else if (ip_normalized_eq(&leaf_ip, &(td->btbuf_beg->ip_norm))) {
-    // the call chain sampled has as its leaf an instruction in a user
-    // procedure. we know this because leaf_ip matches the first entry
-    // in the backtrace buffer.  samples in kernel space yield a
-    // leaf_ip that is not logged in the backtrace buffer. for user
-    // space samples, the first entry in the backtrace buffer includes
-    // not only the normalized IP of the call chain leaf but also the
-    // IP of the first instruction in the enclosing function, which we
-    // use to uniquely represent the function itself. in this case, we
-    // adjust leaf_ip to point to the first IP of its enclosing
-    // function to simplify processing of procedure-level traces for
-    // call chains that are completely in user space.
-
-    // when call chain tracing is enabled, tracing arbitrary leaf IPs
-    // for user space call chains is messy because it can cause
-    // trace-ids to be marked on multiple call chain leaves
-    // (instructions) that belong to the same source-level
-    // statement. collapsing these when call path traces are present
-    // leaves us with many trace-ids referring to the same source
-    // construct. trust me: merging here is easier :-).
-    leaf_ip = td->btbuf_beg->the_function;
-  }
+  // a staged sample is traced when it is inserted into the cct, unless
+  // it was recorded above as a partial unwind
+  bool staged = stage && ljmp == 0;
 
   // a proxy sample (data == NULL) is never a time based metric
-  if (!isSync && data != NULL) {
+  if (!staged && !isSync && data != NULL) {
     uint64_t sampling_period = data->sampling_period;
     int is_time_based_metric = data->is_time_based_metric;
     if (is_time_based_metric > 0) {
-      ret.trace_node = hpcrun_trace_ip(leaf_ip, hpcrun_cct_parent(node), metricId, sampling_period);
+      ret.trace_node = hpcrun_trace_sample(node, td->btbuf_beg->ip_norm,
+                                           td->btbuf_beg->the_function,
+                                           metricId, sampling_period, 0);
     }
   }
 
   hpcrun_clear_handling_sample(td);
   if (get_mem_low() || ENABLED(FLUSH_EVERY_SAMPLE)) {
+    hpcrun_sample_ring_drain();
     hpcrun_flush_epochs(&(TD_GET(core_profile_trace_data)));
     hpcrun_reclaim_freeable_mem();
   }
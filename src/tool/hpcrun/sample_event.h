@@ -106,6 +106,15 @@ hpcrun_sample_val_init(sample_val_t* x)
 
 extern void hpcrun_trace_node(cct_node_t *node);
 
+// append a sample recorded at 'node' to the trace; the leaf of the
+// backtrace buffer identifies the enclosing function of a user-space
+// leaf.  a zero 'nanotime' means now.
+extern cct_node_t* hpcrun_trace_sample(cct_node_t *node,
+                                       ip_normalized_t bt_leaf_ip,
+                                       ip_normalized_t bt_leaf_function,
+                                       int metricId, uint64_t sampling_period,
+                                       uint64_t nanotime);
+
 extern sample_val_t hpcrun_sample_callpath(void *context, int metricId,
                                    hpcrun_metricVal_t metricIncr,
                                    int skipInner, int isSync, sampling_info_t *data);
@@ -0,0 +1,431 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL: $
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "sample_ring.h"
+
+#include "cct_insert_backtrace.h"
+#include "control-knob.h"
+#include "hpcrun_stats.h"
+#include "sample_event.h"
+#include "thread_data.h"
+#include "thread_finalize.h"
+#include "trace.h"
+#include "memory/hpcrun-malloc.h"
+#include "messages/messages.h"
+
+
+
+//*****************************************************************************
+// type declarations
+//*****************************************************************************
+
+typedef struct sample_ring_record_s {
+  cct_node_t *cursor;
+  hpcrun_metricVal_t metric_incr;
+  int metric_id;
+
+  // trace the sample at 'nanotime'
+  bool trace;
+  uint64_t sampling_period;
+  uint64_t nanotime;
+
+  // the innermost frame of the backtrace buffer, which identifies the
+  // enclosing function of the leaf in the trace
+  ip_normalized_t leaf_ip;
+  ip_normalized_t leaf_function;
+
+  // frames [frame_beg, frame_end) of the frame ring, outermost first
+  uint64_t frame_beg;
+  uint64_t frame_end;
+} sample_ring_record_t;
+
+
+struct sample_ring_s {
+  sample_ring_record_t *records;
+  uint64_t record_mask;
+
+  sample_ring_frame_t *frames;
+  uint64_t frame_mask;
+
+  // records [tail, head) and frames [frame_tail, frame_head) are staged.
+  // the positions only grow; the sample handler advances the heads and
+  // the drain advances the tails.
+  _Atomic(uint64_t) head;
+  _Atomic(uint64_t) tail;
+  _Atomic(uint64_t) frame_head;
+  _Atomic(uint64_t) frame_tail;
+
+  volatile bool draining;
+};
+
+
+
+//*****************************************************************************
+// local data
+//*****************************************************************************
+
+static uint64_t ring_slots = 0;
+static uint64_t ring_frames = 0;
+
+static thread_finalize_entry_t sample_ring_finalizer;
+
+
+
+//*****************************************************************************
+// private operations
+//*****************************************************************************
+
+static uint64_t
+pow2_ceil(uint64_t n)
+{
+  uint64_t p = 1;
+  while (p < n) p <<= 1;
+  return p;
+}
+
+
+static sample_ring_t *
+sample_ring_get(void)
+{
+  thread_data_t *td = hpcrun_get_thread_data();
+  if (td->sample_ring != NULL) {
+    return td->sample_ring;
+  }
+
+  sample_ring_t *ring = hpcrun_malloc(sizeof(sample_ring_t));
+  sample_ring_record_t *records =
+    hpcrun_malloc(ring_slots * sizeof(sample_ring_record_t));
+  sample_ring_frame_t *frames =
+    hpcrun_malloc(ring_frames * sizeof(sample_ring_frame_t));
+  if (ring == NULL || records == NULL || frames == NULL) {
+    return NULL;
+  }
+
+  ring->records = records;
+  ring->record_mask = ring_slots - 1;
+  ring->frames = frames;
+  ring->frame_mask = ring_frames - 1;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->frame_head, 0);
+  atomic_init(&ring->frame_tail, 0);
+  ring->draining = false;
+
+  td->sample_ring = ring;
+  return ring;
+}
+
+
+// reserve a record and 'len' contiguous frames, or return NULL if
+// the ring has no room for them
+static sample_ring_record_t *
+sample_ring_reserve(sample_ring_t *ring, uint64_t len)
+{
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail > ring->record_mask) {
+    return NULL;
+  }
+
+  uint64_t frame_head =
+    atomic_load_explicit(&ring->frame_head, memory_order_relaxed);
+  uint64_t frame_tail =
+    atomic_load_explicit(&ring->frame_tail, memory_order_acquire);
+
+  // a backtrace does not wrap around the end of the frame ring
+  uint64_t pos = frame_head & ring->frame_mask;
+  uint64_t beg = frame_head;
+  if (pos + len > ring->frame_mask + 1) {
+    beg += ring->frame_mask + 1 - pos;
+  }
+  if (beg + len - frame_tail > ring->frame_mask + 1) {
+    return NULL;
+  }
+
+  sample_ring_record_t *rec = &ring->records[head & ring->record_mask];
+  rec->frame_beg = beg;
+  rec->frame_end = beg + len;
+  return rec;
+}
+
+
+static void
+sample_ring_publish(sample_ring_t *ring, sample_ring_record_t *rec)
+{
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  atomic_store_explicit(&ring->frame_head, rec->frame_end, memory_order_relaxed);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+
+static bool
+sample_ring_half_full(sample_ring_t *ring)
+{
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint64_t frame_head =
+    atomic_load_explicit(&ring->frame_head, memory_order_relaxed);
+  uint64_t frame_tail =
+    atomic_load_explicit(&ring->frame_tail, memory_order_relaxed);
+
+  return (head - tail) * 2 > ring->record_mask
+    || (frame_head - frame_tail) * 2 > ring->frame_mask;
+}
+
+
+static void
+sample_ring_consume(sample_ring_t *ring, uint64_t tail)
+{
+  sample_ring_record_t *rec = &ring->records[tail & ring->record_mask];
+  atomic_store_explicit(&ring->frame_tail, rec->frame_end, memory_order_release);
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+
+static void
+sample_ring_drain_ring(sample_ring_t *ring)
+{
+  if (ring->draining) {
+    return;
+  }
+  ring->draining = true;
+
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (tail != head) {
+    hpcrun_stats_sample_ring_drain_inc();
+  }
+
+  for (; tail != head; tail++) {
+    sample_ring_record_t *rec = &ring->records[tail & ring->record_mask];
+    sample_ring_frame_t *frames =
+      &ring->frames[rec->frame_beg & ring->frame_mask];
+
+    cct_node_t *node =
+      hpcrun_cct_insert_staged_w_metric(rec->cursor, rec->metric_id,
+                                        frames, rec->frame_end - rec->frame_beg,
+                                        (cct_metric_data_t) rec->metric_incr);
+    if (rec->trace && node != NULL) {
+      hpcrun_trace_sample(node, rec->leaf_ip, rec->leaf_function,
+                          rec->metric_id, rec->sampling_period, rec->nanotime);
+    }
+
+    sample_ring_consume(ring, tail);
+  }
+
+  ring->draining = false;
+}
+
+
+static void
+sample_ring_thread_finalize(int is_process)
+{
+  hpcrun_sample_ring_drain();
+}
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+void
+hpcrun_sample_ring_init
+(
+  void
+)
+{
+  int slots = 0;
+  control_knob_value_get_int("SAMPLE_RING_SLOTS", &slots);
+  if (slots <= 0) {
+    return;
+  }
+
+  int frames = 32;
+  control_knob_value_get_int("SAMPLE_RING_FRAMES", &frames);
+  if (frames <= 0) {
+    frames = 32;
+  }
+
+  ring_slots = pow2_ceil(slots < 2 ? 2 : slots);
+  ring_frames = pow2_ceil(ring_slots * frames);
+
+  sample_ring_finalizer.next = 0;
+  sample_ring_finalizer.fn = sample_ring_thread_finalize;
+  thread_finalize_register(&sample_ring_finalizer);
+
+  TMSG(SAMPLE_RING, "staging %"PRIu64" samples, %"PRIu64" frames per thread",
+       ring_slots, ring_frames);
+}
+
+
+bool
+hpcrun_sample_ring_enabled
+(
+  void
+)
+{
+  return ring_slots != 0;
+}
+
+
+bool
+hpcrun_sample_ring_stage
+(
+  cct_node_t *cursor,
+  backtrace_info_t *bt,
+  int metric_id,
+  hpcrun_metricVal_t metric_incr,
+  sampling_info_t *data
+)
+{
+  sample_ring_t *ring = sample_ring_get();
+  if (ring == NULL) {
+    hpcrun_stats_sample_ring_dropped_inc();
+    return false;
+  }
+
+  // drain before this sample is published: if an insertion faults,
+  // the handler records this sample as a partial unwind, and it must
+  // not also be in the ring
+  if (sample_ring_half_full(ring)) {
+    sample_ring_drain_ring(ring);
+  }
+
+  uint64_t len = bt->last - bt->begin + 1;
+  sample_ring_record_t *rec = sample_ring_reserve(ring, len);
+  if (rec == NULL) {
+    // make room, unless this sample interrupted the drain
+    sample_ring_drain_ring(ring);
+    rec = sample_ring_reserve(ring, len);
+  }
+  if (rec == NULL) {
+    hpcrun_stats_sample_ring_dropped_inc();
+    return false;
+  }
+
+  thread_data_t *td = hpcrun_get_thread_data();
+
+  rec->cursor = cursor;
+  rec->metric_id = metric_id;
+  rec->metric_incr = metric_incr;
+  rec->trace = data->is_time_based_metric > 0 && hpcrun_trace_isactive();
+  rec->sampling_period = data->sampling_period;
+  rec->nanotime = rec->trace ? hpcrun_trace_nanotime() : 0;
+  rec->leaf_ip = td->btbuf_beg->ip_norm;
+  rec->leaf_function = td->btbuf_beg->the_function;
+
+  sample_ring_frame_t *out = &ring->frames[rec->frame_beg & ring->frame_mask];
+  for (frame_t *f = bt->last; f >= bt->begin; f--, out++) {
+    out->as_info = f->as_info;
+    out->ip_norm = f->ip_norm;
+    out->the_function = f->the_function;
+    out->ra_loc = f->ra_loc;
+    out->lip = f->lip;
+  }
+
+  sample_ring_publish(ring, rec);
+  hpcrun_stats_sample_ring_staged_inc();
+
+  return true;
+}
+
+
+void
+hpcrun_sample_ring_drain
+(
+  void
+)
+{
+  if (ring_slots == 0) {
+    return;
+  }
+
+  thread_data_t *td = hpcrun_get_thread_data();
+  if (td->sample_ring != NULL) {
+    sample_ring_drain_ring(td->sample_ring);
+  }
+}
+
+
+void
+hpcrun_sample_ring_recover
+(
+  void
+)
+{
+  if (ring_slots == 0) {
+    return;
+  }
+
+  thread_data_t *td = hpcrun_get_thread_data();
+  sample_ring_t *ring = td->sample_ring;
+  if (ring != NULL && ring->draining) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    sample_ring_consume(ring, tail);
+    hpcrun_stats_sample_ring_dropped_inc();
+    ring->draining = false;
+  }
+}
@@ -0,0 +1,145 @@
+// -*-Mode: C++;-*- // technically C99
+
+#ifndef _hpctoolkit_sample_ring_h_
+#define _hpctoolkit_sample_ring_h_
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL: $
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//*****************************************************************************
+// Per-thread staging ring for asynchronous samples.
+//
+// When the SAMPLE_RING_SLOTS control knob is nonzero, a sample whose
+// caller does not need its cct node only records the normalized
+// backtrace, the cursor below which it belongs, the metric increment
+// and the time of the sample in a per-thread ring.  The samples are
+// inserted into the cct and appended to the trace later, in the order
+// they were taken: by the sample that finds the ring half full, before
+// any sample that is recorded immediately, before a flush of the
+// profile, and when the thread finishes.
+//
+// The ring has a single producer (the sample handler) and a single
+// consumer (the drain) on the same thread, and neither one waits for
+// the other: a sample that finds the ring full while it is being
+// drained is dropped and counted.
+//*****************************************************************************
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "cct/cct.h"
+#include "metrics.h"
+#include "unwind/common/backtrace_info.h"
+#include "utilities/ip-normalized.h"
+
+#include "../../lib/prof-lean/hpcrun-fmt.h"
+#include "../../lib/prof-lean/lush/lush-support.h"
+
+//*****************************************************************************
+// type declarations
+//*****************************************************************************
+
+// the part of a frame_t that the cct insertion uses
+typedef struct sample_ring_frame_t {
+  lush_assoc_info_t as_info;
+  ip_normalized_t ip_norm;
+  ip_normalized_t the_function;
+  void* ra_loc;
+  lush_lip_t* lip;
+} sample_ring_frame_t;
+
+typedef struct sample_ring_s sample_ring_t;
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+void
+hpcrun_sample_ring_init
+(
+  void
+);
+
+bool
+hpcrun_sample_ring_enabled
+(
+  void
+);
+
+// stage the backtrace of an asynchronous sample for insertion below
+// 'cursor'; returns false if the sample was dropped
+bool
+hpcrun_sample_ring_stage
+(
+  cct_node_t *cursor,
+  backtrace_info_t *bt,
+  int metric_id,
+  hpcrun_metricVal_t metric_incr,
+  sampling_info_t *data
+);
+
+// insert the staged samples of this thread into the cct and the trace
+void
+hpcrun_sample_ring_drain
+(
+  void
+);
+
+// called after a fault: skip the staged sample whose insertion was
+// interrupted, if any
+void
+hpcrun_sample_ring_recover
+(
+  void
+);
+
+#endif // _hpctoolkit_sample_ring_h_
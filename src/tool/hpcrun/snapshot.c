@@ -0,0 +1,871 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "env.h"
+#include "files.h"
+#include "loadmap.h"
+#include "rank.h"
+#include "sample_prob.h"
+#include "snapshot.h"
+#include "thread_data.h"
+#include "libmonitor/monitor.h"
+#include "memory/hpcrun-malloc.h"
+#include "messages/messages.h"
+
+#include "../../lib/prof-lean/hpcfmt.h"
+#include "../../lib/prof-lean/hpcrun-fmt.h"
+#include "../../lib/prof-lean/spinlock.h"
+#include "../../lib/support-lean/OSUtil.h"
+
+
+
+//*****************************************************************************
+// macros
+//*****************************************************************************
+
+// a chunk of the dirty log is a little under 16K on 64-bit systems
+#define SNAPSHOT_CHUNK_ENTRIES 1022
+
+#define NSEC_PER_SEC 1000000000L
+
+
+
+//*****************************************************************************
+// types
+//*****************************************************************************
+
+typedef struct snapshot_entry_t {
+  cct_node_t *node;
+  metric_data_list_t *metrics;
+} snapshot_entry_t;
+
+
+typedef struct snapshot_chunk_t {
+  _Atomic(struct snapshot_chunk_t *) next;
+  _Atomic(uint32_t) count;
+  snapshot_entry_t entries[SNAPSHOT_CHUNK_ENTRIES];
+} snapshot_chunk_t;
+
+
+// The dirty log of one thread.  The owning thread appends at tail; the
+// helper reads everything appended since its last visit, and re-reads it
+// once more on the following visit to pick up updates that were still in
+// flight the first time.  Chunks that have been read twice go back to the
+// owner through the free list.
+typedef struct snapshot_thread_t {
+  struct snapshot_thread_t *next;
+  core_profile_trace_data_t *cptd;
+  int thread;
+  uint32_t epoch;
+
+  // held by the helper while it reads the log, and by the owner to end
+  // or reset it
+  spinlock_t lock;
+  bool done;
+
+  // producer side
+  snapshot_chunk_t *tail;
+  snapshot_chunk_t *spare;
+  _Atomic(snapshot_chunk_t *) free;
+
+  // consumer side
+  snapshot_chunk_t *head;   // entries of the previous visit start here ...
+  uint32_t recheck;         // ... at this index
+  snapshot_chunk_t *cursor; // entries of the next visit start here ...
+  uint32_t consumed;        // ... at this index
+} snapshot_thread_t;
+
+
+typedef struct snapshot_delta_t {
+  FILE *nodes;
+  FILE *values;
+  uint32_t num_nodes;
+  uint32_t num_values;
+  uint32_t node_id;
+} snapshot_delta_t;
+
+
+
+//*****************************************************************************
+// local data
+//*****************************************************************************
+
+// generation 0 means snapshots are disabled
+static _Atomic(uint32_t) snapshot_generation = 0;
+
+// bumped by every init, so that threads re-register after a fork
+static _Atomic(uint32_t) snapshot_epoch = 0;
+
+static _Atomic(snapshot_thread_t *) snapshot_threads = NULL;
+
+static __thread snapshot_thread_t *snapshot_self = NULL;
+
+static FILE *snapshot_fs = NULL;
+static pid_t snapshot_pid = 0;
+static spinlock_t snapshot_fs_lock = SPINLOCK_UNLOCKED;
+
+static struct timespec snapshot_period;
+static pthread_t snapshot_helper;
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t snapshot_cond = PTHREAD_COND_INITIALIZER;
+static bool snapshot_stop = false;
+
+// serializes writing snapshots, between the helper and threads that
+// finish
+static pthread_mutex_t snapshot_write_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// what has already been written, guarded by snapshot_write_lock
+static uint16_t snapshot_last_lm_id = 0;
+static int snapshot_last_num_metrics = -1;
+static cct_node_t **snapshot_chain = NULL;
+static size_t snapshot_chain_size = 0;
+
+
+
+//*****************************************************************************
+// private operations: owning threads
+//*****************************************************************************
+
+static snapshot_chunk_t *
+snapshot_chunk_new
+(
+  snapshot_thread_t *t
+)
+{
+  if (t->spare == NULL) {
+    t->spare = atomic_exchange_explicit(&t->free, NULL, memory_order_acquire);
+  }
+
+  snapshot_chunk_t *chunk = t->spare;
+  if (chunk != NULL) {
+    t->spare = atomic_load_explicit(&chunk->next, memory_order_relaxed);
+  } else {
+    chunk = hpcrun_malloc(sizeof(snapshot_chunk_t));
+    if (chunk == NULL) return NULL;
+  }
+
+  atomic_init(&chunk->next, NULL);
+  atomic_init(&chunk->count, 0);
+  return chunk;
+}
+
+
+static snapshot_thread_t *
+snapshot_thread_register
+(
+  void
+)
+{
+  snapshot_thread_t *t = hpcrun_malloc(sizeof(snapshot_thread_t));
+  if (t == NULL) return NULL;
+  memset(t, 0, sizeof(*t));
+
+  core_profile_trace_data_t *cptd = &(TD_GET(core_profile_trace_data));
+  t->cptd = cptd;
+  t->thread = cptd->id;
+  t->epoch = atomic_load_explicit(&snapshot_epoch, memory_order_relaxed);
+  spinlock_init(&t->lock);
+  atomic_init(&t->free, NULL);
+
+  t->tail = t->head = t->cursor = snapshot_chunk_new(t);
+  if (t->tail == NULL) return NULL;
+
+  snapshot_thread_t *head = atomic_load_explicit(&snapshot_threads,
+                                                 memory_order_relaxed);
+  do {
+    t->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&snapshot_threads, &head, t,
+             memory_order_release, memory_order_relaxed));
+
+  return t;
+}
+
+
+static void
+snapshot_log_append
+(
+  snapshot_thread_t *t,
+  cct_node_t *node,
+  metric_data_list_t *metrics
+)
+{
+  snapshot_chunk_t *tail = t->tail;
+  uint32_t count = atomic_load_explicit(&tail->count, memory_order_relaxed);
+
+  if (count == SNAPSHOT_CHUNK_ENTRIES) {
+    snapshot_chunk_t *chunk = snapshot_chunk_new(t);
+    if (chunk == NULL) return;
+    atomic_store_explicit(&tail->next, chunk, memory_order_release);
+    t->tail = tail = chunk;
+    count = 0;
+  }
+
+  tail->entries[count].node = node;
+  tail->entries[count].metrics = metrics;
+  atomic_store_explicit(&tail->count, count + 1, memory_order_release);
+}
+
+
+// drop the whole log.  the owner is the only producer, so it can take
+// the chunks back directly.
+static void
+snapshot_thread_discard
+(
+  snapshot_thread_t *t
+)
+{
+  snapshot_chunk_t *chunk = t->head;
+  while (chunk != t->tail) {
+    snapshot_chunk_t *next = atomic_load_explicit(&chunk->next,
+                                                  memory_order_relaxed);
+    atomic_store_explicit(&chunk->next, t->spare, memory_order_relaxed);
+    t->spare = chunk;
+    chunk = next;
+  }
+
+  t->head = t->cursor = t->tail;
+  t->recheck = t->consumed = atomic_load_explicit(&t->tail->count,
+                                                  memory_order_relaxed);
+}
+
+
+
+//*****************************************************************************
+// private operations: helper
+//*****************************************************************************
+
+static int
+snapshot_record_write
+(
+  hpcsnap_record_kind_t kind,
+  const void *payload,
+  size_t length
+)
+{
+  spinlock_lock(&snapshot_fs_lock);
+  int ret = hpcsnap_fmt_record_fwrite(kind, payload, length, snapshot_fs);
+  // a killed process keeps every record that made it out
+  fflush(snapshot_fs);
+  spinlock_unlock(&snapshot_fs_lock);
+
+  return ret;
+}
+
+
+static void
+snapshot_write_metrics
+(
+  void
+)
+{
+  int num_metrics = 0;
+  kind_info_t *curr = NULL;
+  metric_desc_p_tbl_t *metric_tbl = hpcrun_get_metric_tbl(&curr);
+  while (curr != NULL) {
+    num_metrics += metric_tbl->len;
+    metric_tbl = hpcrun_get_metric_tbl(&curr);
+  }
+  if (num_metrics == snapshot_last_num_metrics) return;
+
+  char *buf = NULL;
+  size_t size = 0;
+  FILE *fs = open_memstream(&buf, &size);
+  if (fs == NULL) return;
+
+  int ret = hpcfmt_int4_fwrite(hpcrun_get_num_kind_metrics(), fs);
+  curr = NULL;
+  metric_tbl = hpcrun_get_metric_tbl(&curr);
+  while (curr != NULL && ret == HPCFMT_OK) {
+    ret = hpcrun_fmt_metricTbl_fwrite(metric_tbl, fs);
+    metric_tbl = hpcrun_get_metric_tbl(&curr);
+  }
+  fclose(fs);
+
+  if (ret == HPCFMT_OK
+      && snapshot_record_write(hpcsnap_record_metrics, buf, size) == HPCFMT_OK) {
+    snapshot_last_num_metrics = num_metrics;
+  }
+  free(buf);
+}
+
+
+static void
+snapshot_write_loadmap
+(
+  void
+)
+{
+  char *buf = NULL;
+  size_t size = 0;
+  FILE *fs = open_memstream(&buf, &size);
+  if (fs == NULL) return;
+
+  uint32_t num_entries = 0;
+  uint16_t last_lm_id = snapshot_last_lm_id;
+
+  hpcrun_loadmap_lock();
+  hpcrun_loadmap_t *loadmap = hpcrun_getLoadmap();
+  for (load_module_t *lm = loadmap->lm_head; lm; lm = lm->next) {
+    if (lm->id > snapshot_last_lm_id) num_entries++;
+  }
+
+  // N.B.: in reverse order, to obtain ascending ids as in write_epochs
+  hpcfmt_int4_fwrite(num_entries, fs);
+  for (load_module_t *lm = loadmap->lm_end; lm; lm = lm->prev) {
+    if (lm->id <= snapshot_last_lm_id) continue;
+
+    loadmap_entry_t lm_entry;
+    lm_entry.id = lm->id;
+    lm_entry.name = lm->name;
+    lm_entry.flags = hpcrun_loadModule_flags_get(lm);
+    hpcrun_fmt_loadmapEntry_fwrite(&lm_entry, fs);
+
+    if (lm->id > last_lm_id) last_lm_id = lm->id;
+  }
+  hpcrun_loadmap_unlock();
+  fclose(fs);
+
+  if (num_entries > 0
+      && snapshot_record_write(hpcsnap_record_loadmap, buf, size) == HPCFMT_OK) {
+    snapshot_last_lm_id = last_lm_id;
+  }
+  free(buf);
+}
+
+
+static void
+snapshot_write_node
+(
+  cct_node_t *node,
+  snapshot_delta_t *delta
+)
+{
+  cct_node_t *parent = hpcrun_cct_parent(node);
+  cct_addr_t *addr = hpcrun_cct_addr(node);
+
+  // the retain bit may still change, hpcprof does not need it here
+  hpcrun_fmt_cct_node_t tmp;
+  hpcrun_fmt_cct_node_init(&tmp);
+  tmp.id = hpcrun_cct_persistent_id(node) & ~HPCRUN_FMT_RetainIdFlag;
+  tmp.id_parent = parent ?
+    hpcrun_cct_persistent_id(parent) & ~HPCRUN_FMT_RetainIdFlag : 0;
+  tmp.unwound = hpcrun_cct_unwound(node);
+  tmp.lm_id = addr->ip_norm.lm_id;
+  tmp.lm_ip = (hpcfmt_vma_t) (uintptr_t) addr->ip_norm.lm_ip;
+
+  epoch_flags_t flags;
+  flags.bits = 0;
+  hpcrun_fmt_cct_node_fwrite(&tmp, flags, delta->nodes);
+  delta->num_nodes++;
+}
+
+
+// write the ancestors of node that are not in the file yet, parents
+// first.  node ids are process-wide, so a node written on behalf of one
+// thread never needs to be written again for another.
+static void
+snapshot_write_path
+(
+  cct_node_t *node,
+  snapshot_delta_t *delta
+)
+{
+  size_t depth = 0;
+  for (cct_node_t *n = node; n != NULL; n = hpcrun_cct_parent(n)) {
+    if (depth == snapshot_chain_size) {
+      size_t size = snapshot_chain_size ? 2 * snapshot_chain_size : 256;
+      cct_node_t **chain = realloc(snapshot_chain, size * sizeof(cct_node_t *));
+      if (chain == NULL) break;
+      snapshot_chain = chain;
+      snapshot_chain_size = size;
+    }
+    if (!hpcrun_cct_snapshot_mark_written(n)) break;
+    snapshot_chain[depth++] = n;
+  }
+
+  while (depth > 0) {
+    snapshot_write_node(snapshot_chain[--depth], delta);
+  }
+}
+
+
+static void
+snapshot_write_value
+(
+  uint16_t metric_id,
+  cct_metric_data_t value,
+  void *arg
+)
+{
+  snapshot_delta_t *delta = (snapshot_delta_t *) arg;
+
+  hpcsnap_fmt_value_t x;
+  x.id = delta->node_id;
+  x.mid = metric_id;
+  x.value.bits = value.bits;
+  hpcsnap_fmt_value_fwrite(&x, delta->values);
+  delta->num_values++;
+}
+
+
+// Read the thread's log from the start of the previous visit to its
+// current end.  Must hold the thread's lock.
+static void
+snapshot_thread_read
+(
+  snapshot_thread_t *t,
+  snapshot_delta_t *delta
+)
+{
+  snapshot_chunk_t *chunk = t->head;
+  uint32_t i = t->recheck;
+
+  for (;;) {
+    uint32_t count = atomic_load_explicit(&chunk->count, memory_order_acquire);
+    for (; i < count; i++) {
+      snapshot_entry_t *e = &chunk->entries[i];
+      snapshot_write_path(e->node, delta);
+      delta->node_id =
+        hpcrun_cct_persistent_id(e->node) & ~HPCRUN_FMT_RetainIdFlag;
+      hpcrun_metric_set_sparse_apply(e->metrics, snapshot_write_value, delta);
+    }
+    snapshot_chunk_t *next = atomic_load_explicit(&chunk->next,
+                                                  memory_order_acquire);
+    if (next == NULL || count < SNAPSHOT_CHUNK_ENTRIES) {
+      break;
+    }
+    chunk = next;
+    i = 0;
+  }
+
+  // the entries read for the first time are read again next visit; hand
+  // back the chunks before them
+  snapshot_chunk_t *recycle = t->head;
+  while (recycle != t->cursor) {
+    snapshot_chunk_t *next = atomic_load_explicit(&recycle->next,
+                                                  memory_order_relaxed);
+    snapshot_chunk_t *free_head = atomic_load_explicit(&t->free,
+                                                       memory_order_relaxed);
+    do {
+      atomic_store_explicit(&recycle->next, free_head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&t->free, &free_head,
+               recycle, memory_order_release, memory_order_relaxed));
+    recycle = next;
+  }
+
+  t->head = t->cursor;
+  t->recheck = t->consumed;
+  t->cursor = chunk;
+  t->consumed = i;
+}
+
+
+static void
+snapshot_write_thread
+(
+  snapshot_thread_t *t,
+  uint32_t generation,
+  uint64_t time
+)
+{
+  snapshot_delta_t delta;
+  char *nodes_buf = NULL, *values_buf = NULL, *buf = NULL;
+  size_t nodes_size = 0, values_size = 0, size = 0;
+
+  memset(&delta, 0, sizeof(delta));
+  delta.nodes = open_memstream(&nodes_buf, &nodes_size);
+  delta.values = open_memstream(&values_buf, &values_size);
+  if (delta.nodes == NULL || delta.values == NULL) goto cleanup;
+
+  spinlock_lock(&t->lock);
+  bool done = t->done;
+  if (!done) {
+    snapshot_thread_read(t, &delta);
+  }
+  spinlock_unlock(&t->lock);
+  if (done) goto cleanup;
+
+  fclose(delta.nodes);
+  fclose(delta.values);
+  delta.nodes = delta.values = NULL;
+  if (delta.num_values == 0) goto cleanup;
+
+  FILE *fs = open_memstream(&buf, &size);
+  if (fs == NULL) goto cleanup;
+
+  // the thread's id tuple is only complete once it writes its profile,
+  // hpcprof derives one from the thread and rank
+  hpcsnap_fmt_delta_hdr_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.generation = generation;
+  hdr.time = time;
+  hdr.thread = t->thread;
+  hdr.rank = hpcrun_get_rank();
+
+  hpcsnap_fmt_delta_hdr_fwrite(&hdr, fs);
+  hpcfmt_int4_fwrite(delta.num_nodes, fs);
+  fwrite(nodes_buf, 1, nodes_size, fs);
+  hpcfmt_int4_fwrite(delta.num_values, fs);
+  fwrite(values_buf, 1, values_size, fs);
+  fclose(fs);
+
+  snapshot_record_write(hpcsnap_record_delta, buf, size);
+
+ cleanup:
+  if (delta.nodes) fclose(delta.nodes);
+  if (delta.values) fclose(delta.values);
+  free(nodes_buf);
+  free(values_buf);
+  free(buf);
+}
+
+
+static void
+snapshot_write_done
+(
+  snapshot_thread_t *t
+)
+{
+  spinlock_lock(&t->lock);
+  t->done = true;
+  spinlock_unlock(&t->lock);
+
+  char *buf = NULL;
+  size_t size = 0;
+  FILE *fs = open_memstream(&buf, &size);
+  if (fs == NULL) return;
+  hpcfmt_int4_fwrite((uint32_t) t->thread, fs);
+  fclose(fs);
+
+  snapshot_record_write(hpcsnap_record_done, buf, size);
+  free(buf);
+}
+
+
+static uint64_t
+snapshot_time
+(
+  void
+)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (uint64_t) now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+}
+
+
+static void
+snapshot_take
+(
+  void
+)
+{
+  pthread_mutex_lock(&snapshot_write_lock);
+
+  // updates from now on are logged again
+  uint32_t generation = atomic_fetch_add(&snapshot_generation, 1);
+  uint64_t time = snapshot_time();
+
+  snapshot_write_metrics();
+  for (snapshot_thread_t *t = atomic_load(&snapshot_threads); t; t = t->next) {
+    snapshot_write_thread(t, generation, time);
+  }
+
+  // after the deltas, so that it covers every module they refer to
+  snapshot_write_loadmap();
+
+  pthread_mutex_unlock(&snapshot_write_lock);
+
+  TMSG(DATA_WRITE, "snapshot %u written", generation);
+}
+
+
+static void *
+snapshot_helper_fn
+(
+  void *arg
+)
+{
+  hpcrun_thread_init_mem_pool_once(TOOL_THREAD_ID, NULL, HPCRUN_NO_TRACE, true);
+
+  pthread_mutex_lock(&snapshot_mutex);
+  while (!snapshot_stop) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += snapshot_period.tv_sec;
+    deadline.tv_nsec += snapshot_period.tv_nsec;
+    if (deadline.tv_nsec >= NSEC_PER_SEC) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= NSEC_PER_SEC;
+    }
+
+    int ret = 0;
+    while (!snapshot_stop && ret != ETIMEDOUT) {
+      ret = pthread_cond_timedwait(&snapshot_cond, &snapshot_mutex, &deadline);
+    }
+    if (snapshot_stop) break;
+
+    pthread_mutex_unlock(&snapshot_mutex);
+    snapshot_take();
+    pthread_mutex_lock(&snapshot_mutex);
+  }
+  pthread_mutex_unlock(&snapshot_mutex);
+
+  return NULL;
+}
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+bool
+hpcrun_snapshot_enabled
+(
+  void
+)
+{
+  return snapshot_fs != NULL && snapshot_pid == getpid();
+}
+
+
+void
+hpcrun_snapshot_init
+(
+  void
+)
+{
+  // a forked child starts over: it has no helper and its own file
+  atomic_store(&snapshot_generation, 0);
+  atomic_fetch_add(&snapshot_epoch, 1);
+  atomic_store(&snapshot_threads, NULL);
+  snapshot_fs = NULL;
+  snapshot_pid = getpid();
+  snapshot_stop = false;
+  snapshot_last_lm_id = 0;
+  snapshot_last_num_metrics = -1;
+
+  const char *period_str = getenv(HPCRUN_SNAPSHOT_PERIOD);
+  if (period_str == NULL || !hpcrun_sample_prob_active()) {
+    return;
+  }
+
+  double period = strtod(period_str, NULL);
+  if (!(period > 0)) {
+    EMSG("ignoring invalid snapshot period: %s", period_str);
+    return;
+  }
+  snapshot_period.tv_sec = (time_t) period;
+  snapshot_period.tv_nsec = (long) ((period - snapshot_period.tv_sec) * NSEC_PER_SEC);
+
+  int fd = hpcrun_open_snapshot_file();
+  FILE *fs = (fd >= 0) ? fdopen(fd, "w") : NULL;
+  if (fs == NULL) {
+    EMSG("unable to open snapshot file");
+    return;
+  }
+
+  const unsigned int bufSZ = 32;
+
+  const char *jobIdStr = OSUtil_jobid();
+  if (!jobIdStr) jobIdStr = "";
+
+  char hostidStr[bufSZ];
+  snprintf(hostidStr, bufSZ, "%x", OSUtil_hostid());
+
+  char pidStr[bufSZ];
+  snprintf(pidStr, bufSZ, "%u", OSUtil_pid());
+
+  hpcsnap_fmt_hdr_fwrite(fs,
+                         HPCRUN_FMT_NV_prog, hpcrun_files_executable_name(),
+                         HPCRUN_FMT_NV_progPath, hpcrun_files_executable_pathname(),
+                         HPCRUN_FMT_NV_envPath, getenv("PATH"),
+                         HPCRUN_FMT_NV_jobId, jobIdStr,
+                         HPCRUN_FMT_NV_hostid, hostidStr,
+                         HPCRUN_FMT_NV_pid, pidStr,
+                         NULL);
+  fflush(fs);
+  snapshot_fs = fs;
+
+  atomic_store(&snapshot_generation, 1);
+
+  monitor_disable_new_threads();
+  int ret = pthread_create(&snapshot_helper, NULL, snapshot_helper_fn, NULL);
+  monitor_enable_new_threads();
+  if (ret != 0) {
+    EMSG("unable to start the snapshot thread: %s", strerror(ret));
+    atomic_store(&snapshot_generation, 0);
+    fclose(snapshot_fs);
+    snapshot_fs = NULL;
+    return;
+  }
+
+  TMSG(DATA_WRITE, "snapshots every %s seconds", period_str);
+}
+
+
+void
+hpcrun_snapshot_touch
+(
+  cct_node_t *node,
+  metric_data_list_t *metrics
+)
+{
+  uint32_t generation = atomic_load_explicit(&snapshot_generation,
+                                             memory_order_relaxed);
+  if (generation == 0) return;
+
+  if (!hpcrun_cct_snapshot_touch(node, generation)) return;
+
+  snapshot_thread_t *self = snapshot_self;
+  if (self == NULL
+      || self->epoch != atomic_load_explicit(&snapshot_epoch, memory_order_relaxed)) {
+    self = snapshot_self = snapshot_thread_register();
+    if (self == NULL) return;
+  }
+
+  snapshot_log_append(self, node, metrics);
+}
+
+
+void
+hpcrun_snapshot_thread_done
+(
+  core_profile_trace_data_t *cptd
+)
+{
+  if (!hpcrun_snapshot_enabled()) return;
+
+  // write what changed since the last snapshot, so that a series of
+  // snapshots adds up to the complete profile
+  pthread_mutex_lock(&snapshot_write_lock);
+
+  uint32_t generation = atomic_load(&snapshot_generation);
+  uint64_t time = snapshot_time();
+
+  snapshot_write_metrics();
+  for (snapshot_thread_t *t = atomic_load(&snapshot_threads); t; t = t->next) {
+    if (t->cptd == cptd && !t->done) {
+      snapshot_write_thread(t, generation, time);
+      snapshot_write_done(t);
+    }
+  }
+  snapshot_write_loadmap();
+
+  pthread_mutex_unlock(&snapshot_write_lock);
+}
+
+
+void
+hpcrun_snapshot_thread_reset
+(
+  core_profile_trace_data_t *cptd
+)
+{
+  if (!hpcrun_snapshot_enabled()) return;
+
+  for (snapshot_thread_t *t = atomic_load(&snapshot_threads); t; t = t->next) {
+    if (t->cptd == cptd) {
+      spinlock_lock(&t->lock);
+      snapshot_thread_discard(t);
+      spinlock_unlock(&t->lock);
+    }
+  }
+}
+
+
+void
+hpcrun_snapshot_fini
+(
+  void
+)
+{
+  if (!hpcrun_snapshot_enabled()) return;
+
+  pthread_mutex_lock(&snapshot_mutex);
+  snapshot_stop = true;
+  pthread_cond_signal(&snapshot_cond);
+  pthread_mutex_unlock(&snapshot_mutex);
+  pthread_join(snapshot_helper, NULL);
+
+  // threads that never wrote a profile
+  snapshot_take();
+  atomic_store(&snapshot_generation, 0);
+
+  if (fclose(snapshot_fs) != 0) {
+    EMSG("unable to write snapshot file");
+  }
+  snapshot_fs = NULL;
+
+  free(snapshot_chain);
+  snapshot_chain = NULL;
+  snapshot_chain_size = 0;
+
+  int rank = hpcrun_get_rank();
+  if (rank >= 0) {
+    hpcrun_rename_snapshot_file(rank);
+  }
+}
@@ -0,0 +1,82 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+#ifndef hpcrun_snapshot_h
+#define hpcrun_snapshot_h
+
+//*****************************************************************************
+// Periodic snapshots.
+//
+// With HPCRUN_SNAPSHOT_PERIOD set, a helper thread appends the changes to
+// every thread's profile to a per-process .hpcsnap file once per period.
+// The helper cannot walk a thread's CCT while the thread samples (sibling
+// lookups splay the tree), so instead each thread logs the nodes whose
+// metrics it updates, once per snapshot generation, to a private
+// single-producer, single-consumer log that the helper drains.
+//*****************************************************************************
+
+#include <stdbool.h>
+
+#include "core_profile_trace_data.h"
+#include "cct/cct.h"
+#include "metrics.h"
+
+bool hpcrun_snapshot_enabled(void);
+
+// open (or, after fork, reopen) the snapshot file and start the helper
+void hpcrun_snapshot_init(void);
+
+// record that the calling thread updated the metrics of node. called
+// from hpcrun_reify_metric_set, async signal safe.
+void hpcrun_snapshot_touch(cct_node_t *node, metric_data_list_t *metrics);
+
+// the thread is about to write its own profile, stop snapshotting it
+void hpcrun_snapshot_thread_done(core_profile_trace_data_t *cptd);
+
+// the thread's CCT is about to be discarded (see hpcrun_flush_epochs)
+void hpcrun_snapshot_thread_reset(core_profile_trace_data_t *cptd);
+
+// stop the helper, take a last snapshot and give the file its final name
+void hpcrun_snapshot_fini(void);
+
+#endif // hpcrun_snapshot_h
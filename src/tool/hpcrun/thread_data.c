@@ -328,8 +328,11 @@ core_profile_trace_data_init
   // IO support
   // ----------------------------------------
   cptd->hpcrun_file  = NULL;
+  cptd->container_buf = NULL;
+  cptd->container_size = 0;
   cptd->trace_buffer = NULL;
   cptd->trace_outbuf = NULL;
+  cptd->trace_block = NULL;
 
   // ----------------------------------------
   // ???
@@ -460,6 +463,7 @@ hpcrun_thread_data_init
   td->cached_bt_buf_frame_end = td->cached_bt_frame_beg;
   td->tramp_frame       = NULL;
   td->tramp_cct_node    = NULL;
+  td->sample_ring       = NULL;
 
   // ----------------------------------------
   // exception stuff
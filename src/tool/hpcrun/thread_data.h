@@ -250,6 +250,9 @@ typedef struct thread_data_t {
   uint32_t prev_dLCA; // distance to LCA in the CCT for the previous sample
   uint32_t dLCA; // distance to LCA in the CCT
 
+  // samples staged for insertion into the CCT (see sample_ring.h)
+  struct sample_ring_s* sample_ring;
+
   // ----------------------------------------
   // exception stuff
   // ----------------------------------------
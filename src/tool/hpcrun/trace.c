@@ -60,6 +60,7 @@
 // local includes
 //*********************************************************************
 
+#include "container.h"
 #include "disabled.h"
 #include "env.h"
 #include "files.h"
@@ -88,10 +89,31 @@
 // without a sample are considered as a gap.
 #define TRACE_GAP_FACTOR 5
 
+// Index entries of written blocks are kept in chunks of this many
+#define TRACE_INDEX_CHUNK 256
+
 //*********************************************************************
 // type declarations
 //*********************************************************************
 
+typedef struct trace_index_chunk_t {
+  struct trace_index_chunk_t *next;
+  uint32_t len;
+  hpctrace_fmt_index_entry_t entries[TRACE_INDEX_CHUNK];
+} trace_index_chunk_t;
+
+// Records are staged one block at a time and written out behind a
+// block header when the block fills (see hpcrun-fmt.h).
+typedef struct trace_block_state_t {
+  hpctrace_hdr_flags_t flags;
+  uint64_t offset;  // trace offset of the next block
+  hpctrace_fmt_block_hdr_t hdr;
+  hpctrace_fmt_datum_t records[HPCTRACE_FMT_BlockLen];
+
+  uint64_t num_blocks;
+  trace_index_chunk_t *index_head;
+  trace_index_chunk_t *index_tail;
+} trace_block_state_t;
 
 
 //*********************************************************************
@@ -99,6 +121,8 @@
 //*********************************************************************
 
 static void hpcrun_trace_file_validate(int valid, char *op);
+static void hpcrun_trace_block_flush(core_profile_trace_data_t *cptd);
+static void hpcrun_trace_index_write(core_profile_trace_data_t *cptd);
 static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, unsigned int metric_id, uint32_t dLCA, uint64_t nanotime);
 
 
@@ -149,12 +173,18 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd, hpcrun_trace_type_t type)
     // I think unlocked is ok here (we don't overlap any system
     // locks).  At any rate, locks only protect against threads, they
     // don't help with signal handlers (that's much harder).
-    fd = hpcrun_open_trace_file(cptd->id);
-    hpcrun_trace_file_validate(fd >= 0, "open");
     cptd->trace_buffer = hpcrun_malloc(HPCRUN_TraceBufferSz);
 
-    ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
-                              HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED, hpcrun_malloc);
+    if (hpcrun_container_enabled()) {
+      // full buffers become trace segments of the process container
+      ret = hpcrun_container_trace_attach(cptd);
+    } else {
+      fd = hpcrun_open_trace_file(cptd->id);
+      hpcrun_trace_file_validate(fd >= 0, "open");
+
+      ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
+                                HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED, hpcrun_malloc);
+    }
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "open");
 
     hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
@@ -171,6 +201,8 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd, hpcrun_trace_type_t type)
     HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_LCA_RECORDED_BIT_POS, false);
 #endif
 
+    HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_BLOCKED_BIT_POS, true);
+
     switch(type) {
     case HPCRUN_SAMPLE_TRACE:
       HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_CALL_TRACE_BIT_POS, 0);
@@ -186,6 +218,12 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd, hpcrun_trace_type_t type)
 
     ret = hpctrace_fmt_hdr_outbuf(flags, cptd->trace_outbuf);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "write header to");
+
+    trace_block_state_t *blk = hpcrun_malloc(sizeof(trace_block_state_t));
+    memset(blk, 0, sizeof(*blk));
+    blk->flags = flags;
+    blk->offset = HPCTRACE_FMT_HeaderLen;
+    cptd->trace_block = blk;
   }
   TMSG(TRACE, "Trace open done");
 }
@@ -201,16 +239,30 @@ hpcrun_trace_append_with_time(core_profile_trace_data_t *st, unsigned int call_p
 
 __thread uint64_t prev_nanotime = 0;
 
+uint64_t
+hpcrun_trace_nanotime(void)
+{
+  struct timeval tv;
+  int ret = gettimeofday(&tv, NULL);
+  if (ret != 0)
+    hpcrun_terminate();  // gettimeofday failed!
+  return ((uint64_t)tv.tv_usec + (((uint64_t)tv.tv_sec) * 1000000)) * 1000;
+}
+
+
 void
 hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, unsigned int metric_id, uint32_t dLCA, uint64_t sampling_period)
+{
+  hpcrun_trace_append_at(cptd, node, metric_id, dLCA, sampling_period, 0);
+}
+
+
+void
+hpcrun_trace_append_at(core_profile_trace_data_t *cptd, cct_node_t* node, unsigned int metric_id, uint32_t dLCA, uint64_t sampling_period, uint64_t nanotime)
 {
   if (tracing && hpcrun_sample_prob_active()) {
-    struct timeval tv;
-    int ret = gettimeofday(&tv, NULL);
-    if (ret != 0)
-      hpcrun_terminate();  // gettimeofday failed!
-    uint64_t nanotime = ((uint64_t)tv.tv_usec
-                         + (((uint64_t)tv.tv_sec) * 1000000)) * 1000;
+    if (nanotime == 0)
+      nanotime = hpcrun_trace_nanotime();
     if (sampling_period > 0 && prev_nanotime != 0 && nanotime - prev_nanotime > TRACE_GAP_FACTOR * sampling_period) {
       cct_bundle_t* cct_bundle = &(cptd->epoch->csdata);
       cct_node_t* idle_node = hpcrun_cct_bundle_get_no_activity_node(cct_bundle);
@@ -255,13 +307,17 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
   if (tracing && hpcrun_sample_prob_active()) {
 
     TMSG(TRACE, "Trace active close code");
+    if (cptd->trace_block) {
+      hpcrun_trace_block_flush(cptd);
+      hpcrun_trace_index_write(cptd);
+    }
     int ret = hpcio_outbuf_close(&cptd->trace_outbuf);
     if (ret != HPCFMT_OK) {
       EMSG("unable to flush and close trace file");
     }
 
     int rank = hpcrun_get_rank();
-    if (rank >= 0) {
+    if (rank >= 0 && !hpcrun_container_enabled()) {
       hpcrun_rename_trace_file(rank, cptd->id);
     }
   }
@@ -303,21 +359,86 @@ hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int
     trace_datum.comp = nanotime;
 #endif
 
-    hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
-#ifdef DATACENTRIC_TRACE
-    HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS, true);
-#else
-    HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_DATA_CENTRIC_BIT_POS, false);
-#endif
+    trace_block_state_t *blk = cptd->trace_block;
+    if (blk == NULL) {
+      return;  // trace not open (or already closed)
+    }
+    hpctrace_fmt_block_hdr_t *bhdr = &blk->hdr;
+    if (bhdr->count == 0) {
+      bhdr->flags = HPCTRACE_FMT_BLOCK_FLAGS_SORTED;
+      bhdr->minTime = bhdr->maxTime = nanotime;
+    } else {
+      if (nanotime < HPCTRACE_FMT_GET_TIME(blk->records[bhdr->count - 1].comp)) {
+        bhdr->flags &= ~HPCTRACE_FMT_BLOCK_FLAGS_SORTED;
+      }
+      if (nanotime < bhdr->minTime) bhdr->minTime = nanotime;
+      if (nanotime > bhdr->maxTime) bhdr->maxTime = nanotime;
+    }
+    blk->records[bhdr->count++] = trace_datum;
+
+    if (bhdr->count == HPCTRACE_FMT_BlockLen) {
+      hpcrun_trace_block_flush(cptd);
+    }
+}
 
-#if defined(LCA_TRACE) && (defined (HOST_CPU_x86_64) || defined (HOST_CPU_PPC))
-    HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_LCA_RECORDED_BIT_POS, true);
-#else
-    HPCTRACE_HDR_FLAGS_SET_BIT(flags, HPCTRACE_HDR_FLAGS_LCA_RECORDED_BIT_POS, false);
-#endif
 
-    int ret = hpctrace_fmt_datum_outbuf(&trace_datum, flags, cptd->trace_outbuf);
+// Write out the staged block (if any) and note it in the index
+static void
+hpcrun_trace_block_flush(core_profile_trace_data_t *cptd)
+{
+  trace_block_state_t *blk = cptd->trace_block;
+  if (blk->hdr.count == 0) {
+    return;
+  }
+
+  int ret = hpctrace_fmt_block_hdr_outbuf(&blk->hdr, cptd->trace_outbuf);
+  hpcrun_trace_file_validate(ret == HPCFMT_OK, "append");
+  for (uint32_t i = 0; i < blk->hdr.count; i++) {
+    ret = hpctrace_fmt_datum_outbuf(&blk->records[i], blk->flags, cptd->trace_outbuf);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "append");
+  }
+
+  trace_index_chunk_t *chunk = blk->index_tail;
+  if (chunk == NULL || chunk->len == TRACE_INDEX_CHUNK) {
+    chunk = hpcrun_malloc(sizeof(trace_index_chunk_t));
+    chunk->next = NULL;
+    chunk->len = 0;
+    if (blk->index_tail) blk->index_tail->next = chunk;
+    else blk->index_head = chunk;
+    blk->index_tail = chunk;
+  }
+  hpctrace_fmt_index_entry_t *entry = &chunk->entries[chunk->len++];
+  entry->offset = blk->offset;
+  entry->hdr = blk->hdr;
+  blk->num_blocks++;
+
+  blk->offset += HPCTRACE_FMT_BlockHdrLen
+    + (uint64_t)blk->hdr.count * hpctrace_fmt_datum_size(blk->flags);
+  blk->hdr.count = 0;
+}
+
+
+// Write the block index and trailer that end the trace
+static void
+hpcrun_trace_index_write(core_profile_trace_data_t *cptd)
+{
+  trace_block_state_t *blk = cptd->trace_block;
+  int ret;
+
+  for (trace_index_chunk_t *chunk = blk->index_head; chunk; chunk = chunk->next) {
+    for (uint32_t i = 0; i < chunk->len; i++) {
+      ret = hpctrace_fmt_index_entry_outbuf(&chunk->entries[i], cptd->trace_outbuf);
+      hpcrun_trace_file_validate(ret == HPCFMT_OK, "write index to");
+    }
+  }
+
+  hpctrace_fmt_trailer_t trailer;
+  trailer.num_blocks = blk->num_blocks;
+  trailer.index_offset = blk->offset;
+  ret = hpctrace_fmt_trailer_outbuf(&trailer, cptd->trace_outbuf);
+  hpcrun_trace_file_validate(ret == HPCFMT_OK, "write index to");
+
+  cptd->trace_block = NULL;
 }
 
 
@@ -0,0 +1,509 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL: $
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+
+//**************************************************************************
+// system includes
+//**************************************************************************
+
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <setjmp.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <ucontext.h>
+
+
+
+//**************************************************************************
+// local includes
+//**************************************************************************
+
+#include "unw-bench.h"
+
+#include "libunw_intervals.h"
+#include "libunwind-pvt.h"
+#include "unwind.h"
+#include "uw_recipe_map.h"
+
+#include "../../control-knob.h"
+#include "../../handling_sample.h"
+#include "../../thread_data.h"
+#include "../../fnbounds/fnbounds_interface.h"
+#include "../../libmonitor/monitor.h"
+#include "../../memory/hpcrun-malloc.h"
+#include "../../messages/messages.h"
+#include "../../utilities/hpcrun-nanotime.h"
+
+
+
+//**************************************************************************
+// macros
+//**************************************************************************
+
+#define UNW_BENCH_RED_ZONE      128
+#define UNW_BENCH_MAX_FRAMES    512
+#define UNW_BENCH_MAX_REPORTS   10
+
+
+
+//**************************************************************************
+// type declarations
+//**************************************************************************
+
+typedef enum {
+  UNW_BENCH_HPCRUN,
+  UNW_BENCH_LIBUNWIND,
+  UNW_BENCH_NUM_UNWINDERS
+} unw_bench_unwinder_t;
+
+typedef struct unw_bench_snapshot_s {
+  ucontext_t ctx;         // copy of the signal context
+  uintptr_t ctx_orig;     // address of the original context
+  uintptr_t stack_orig;   // lowest stack address copied
+  size_t stack_len;
+  char *stack;            // copy of [stack_orig, stack_orig + stack_len)
+} unw_bench_snapshot_t;
+
+typedef struct unw_bench_result_s {
+  uint64_t cold_ns;
+  uint64_t cold_frames;
+  uint64_t warm_ns;
+  uint64_t warm_frames;
+  uint64_t faults;
+  uw_recipe_map_stats_t stats;
+} unw_bench_result_t;
+
+
+
+//**************************************************************************
+// private data
+//**************************************************************************
+
+static const char *unwinder_name[UNW_BENCH_NUM_UNWINDERS] = {
+  "hpcrun", "libunwind"
+};
+
+static int num_snapshots = 0;
+static int num_passes = 0;
+static size_t stack_bytes = 0;
+
+static unw_bench_snapshot_t *snapshots = NULL;
+static atomic_int next_snapshot = 0;
+
+
+
+//**************************************************************************
+// private operations
+//**************************************************************************
+
+static uintptr_t
+rebase
+(
+  uintptr_t value,
+  uintptr_t from,
+  size_t len,
+  uintptr_t to
+)
+{
+  return (from <= value && value <= from + len) ? value - from + to : value;
+}
+
+
+// Move the snapshot so that it can be unwound in place.  Every word of
+// the context and of the stack copy that points into the original
+// stack is redirected into the copy, and every word of the context that
+// points into the original context (eg, the fpregs pointer) is
+// redirected into the copy of the context.  An integer that happens to
+// look like a stack address is moved too, which can only perturb an
+// unwind that would read it as a pointer anyway.
+//
+static void
+relocate
+(
+  unw_bench_snapshot_t *s
+)
+{
+  uintptr_t stack_copy = (uintptr_t) s->stack;
+  uintptr_t ctx_copy = (uintptr_t) &s->ctx;
+
+  uintptr_t *w = (uintptr_t *) s->stack;
+  for (size_t i = 0; i < s->stack_len / sizeof(uintptr_t); i++) {
+    w[i] = rebase(w[i], s->stack_orig, s->stack_len, stack_copy);
+  }
+
+  w = (uintptr_t *) &s->ctx;
+  for (size_t i = 0; i < sizeof(s->ctx) / sizeof(uintptr_t); i++) {
+    uintptr_t v = rebase(w[i], s->stack_orig, s->stack_len, stack_copy);
+    w[i] = rebase(v, s->ctx_orig, sizeof(s->ctx) - 1, ctx_copy);
+  }
+}
+
+
+// Unwind one snapshot, saving up to 'max' unnormalized pcs.  Returns the
+// number of frames, or -1 if the unwind faulted.  The unwind stops at
+// the first frame whose stack pointer leaves the stack copy.
+//
+static int
+unwind_snapshot
+(
+  unw_bench_snapshot_t *s,
+  unw_bench_unwinder_t which,
+  void **pcs,
+  int max
+)
+{
+  thread_data_t *td = hpcrun_get_thread_data();
+  sigjmp_buf_t *old = td->current_jmp_buf;
+  td->current_jmp_buf = &td->bad_unwind;
+  td->btbuf_cur = NULL;
+
+  hpcrun_set_handling_sample(td);
+
+  volatile int n = 0;
+  if (sigsetjmp(td->bad_unwind.jb, 1) == 0) {
+    hpcrun_unw_cursor_t cursor;
+    memset(&cursor, 0, sizeof(cursor));
+
+    if (which == UNW_BENCH_HPCRUN) {
+      hpcrun_unw_init_cursor(&cursor, &s->ctx);
+    } else {
+      libunw_unw_init_cursor(&cursor, &s->ctx);
+    }
+
+    char *lo = s->stack;
+    char *hi = s->stack + s->stack_len;
+
+    for (;;) {
+      void *pc;
+      hpcrun_unw_get_ip_unnorm_reg(&cursor, &pc);
+      if (n < max) {
+        pcs[n] = pc;
+      }
+      n++;
+
+      if (n >= UNW_BENCH_MAX_FRAMES) {
+        break;
+      }
+
+      step_state ret = (which == UNW_BENCH_HPCRUN)
+        ? hpcrun_unw_step(&cursor) : libunw_unw_step(&cursor);
+      if (ret <= STEP_STOP || ret == STEP_STOP_WEAK) {
+        break;
+      }
+
+      char *sp = (char *) cursor.sp;
+      if (sp < lo || sp >= hi) {
+        break;
+      }
+    }
+  } else {
+    n = -1;
+  }
+
+  hpcrun_clear_handling_sample(td);
+  td->current_jmp_buf = old;
+
+  return n;
+}
+
+
+// the sequence of enclosing functions, which is what both unwinders
+// should agree on even when they report different return addresses
+//
+static void
+pcs_to_functions
+(
+  void **pcs,
+  int n
+)
+{
+  for (int i = 0; i < n; i++) {
+    void *start = NULL;
+    void *end = NULL;
+    load_module_t *lm = NULL;
+    void *pc = (char *) pcs[i] - (i > 0 ? 1 : 0);
+    pcs[i] = fnbounds_enclosing_addr(pc, &start, &end, &lm) ? start : pc;
+  }
+}
+
+
+static void
+stats_diff
+(
+  uw_recipe_map_stats_t *diff,
+  const uw_recipe_map_stats_t *before,
+  const uw_recipe_map_stats_t *after
+)
+{
+  diff->hash_hits += after->hash_hits - before->hash_hits;
+  diff->hash_misses += after->hash_misses - before->hash_misses;
+  diff->map_hits += after->map_hits - before->map_hits;
+  diff->map_misses += after->map_misses - before->map_misses;
+  diff->map_waits += after->map_waits - before->map_waits;
+}
+
+
+static double
+percent
+(
+  uint64_t part,
+  uint64_t whole
+)
+{
+  return whole ? 100.0 * part / whole : 0.0;
+}
+
+
+static void
+report
+(
+  int n,
+  unw_bench_result_t *res,
+  int divergent
+)
+{
+  fprintf(stderr, "hpcrun unwind replay: %d snapshots, %d passes, %d divergent\n",
+          n, num_passes, divergent);
+
+  for (int u = 0; u < UNW_BENCH_NUM_UNWINDERS; u++) {
+    unw_bench_result_t *r = &res[u];
+    uw_recipe_map_stats_t *st = &r->stats;
+    fprintf(stderr, "  %-10s cold %8.1f ns/frame  warm %8.1f ns/frame  "
+            "frames %" PRIu64 "  faults %" PRIu64 "  "
+            "uw_hash hit %5.1f%%  recipe map hit %5.1f%%\n",
+            unwinder_name[u],
+            r->cold_frames ? (double) r->cold_ns / r->cold_frames : 0.0,
+            r->warm_frames ? (double) r->warm_ns / r->warm_frames : 0.0,
+            r->cold_frames, r->faults,
+            percent(st->hash_hits, st->hash_hits + st->hash_misses),
+            percent(st->map_hits, st->map_hits + st->map_misses));
+  }
+}
+
+
+
+//**************************************************************************
+// interface operations
+//**************************************************************************
+
+void
+hpcrun_unw_bench_init
+(
+  void
+)
+{
+  int value = 0;
+  control_knob_value_get_int("UNWIND_BENCH_SNAPSHOTS", &value);
+  if (value <= 0) {
+    return;
+  }
+
+  int passes = 1;
+  control_knob_value_get_int("UNWIND_BENCH_PASSES", &passes);
+  int kb = 64;
+  control_knob_value_get_int("UNWIND_BENCH_STACK_KB", &kb);
+
+  num_passes = (passes > 0) ? passes : 1;
+  stack_bytes = (size_t) ((kb > 0) ? kb : 1) * 1024;
+
+  snapshots = hpcrun_malloc(value * sizeof(unw_bench_snapshot_t));
+  if (snapshots == NULL) {
+    EMSG("unwind replay: unable to allocate %d snapshots", value);
+    return;
+  }
+  memset(snapshots, 0, value * sizeof(unw_bench_snapshot_t));
+  num_snapshots = value;
+
+  TMSG(UNW, "unwind replay: %d snapshots of up to %zu stack bytes",
+       num_snapshots, stack_bytes);
+}
+
+
+void
+hpcrun_unw_bench_capture
+(
+  void *context
+)
+{
+  if (num_snapshots == 0 || context == NULL
+      || atomic_load_explicit(&next_snapshot, memory_order_relaxed) >= num_snapshots) {
+    return;
+  }
+
+  unw_cursor_t c;
+  unw_word_t sp = 0;
+  if (libunwind_init_local2(&c, (unw_context_t *) context, UNW_INIT_SIGNAL_FRAME) != 0
+      || libunwind_get_reg(&c, UNW_REG_SP, &sp) != 0) {
+    return;
+  }
+
+  uintptr_t lo = (uintptr_t) sp - UNW_BENCH_RED_ZONE;
+  uintptr_t hi = (uintptr_t) monitor_stack_bottom();
+  if (hi <= lo) {
+    return;
+  }
+  if (hi - lo > stack_bytes) {
+    hi = lo + stack_bytes;
+  }
+
+  char *stack = hpcrun_malloc(hi - lo);
+  if (stack == NULL) {
+    return;
+  }
+
+  int slot = atomic_fetch_add_explicit(&next_snapshot, 1, memory_order_relaxed);
+  if (slot >= num_snapshots) {
+    return;
+  }
+
+  unw_bench_snapshot_t *s = &snapshots[slot];
+  memcpy(&s->ctx, context, sizeof(s->ctx));
+  memcpy(stack, (void *) lo, hi - lo);
+  s->ctx_orig = (uintptr_t) context;
+  s->stack_orig = lo;
+  s->stack_len = hi - lo;
+  s->stack = stack;
+}
+
+
+void
+hpcrun_unw_bench_fini
+(
+  void
+)
+{
+  int n = atomic_load(&next_snapshot);
+  if (n > num_snapshots) {
+    n = num_snapshots;
+  }
+  if (n == 0) {
+    return;
+  }
+
+  static void *pcs[UNW_BENCH_NUM_UNWINDERS][UNW_BENCH_MAX_FRAMES];
+  unw_bench_result_t res[UNW_BENCH_NUM_UNWINDERS];
+  memset(res, 0, sizeof(res));
+
+  int count = 0;
+  for (int i = 0; i < n; i++) {
+    if (snapshots[i].stack != NULL) {
+      relocate(&snapshots[i]);
+      count++;
+    }
+  }
+
+  // pass 0 is cold: the recipe map and uw_hash are as the run left
+  // them, but the snapshots' own intervals may not be built yet
+  for (int pass = 0; pass < num_passes; pass++) {
+    for (int u = 0; u < UNW_BENCH_NUM_UNWINDERS; u++) {
+      unw_bench_result_t *r = &res[u];
+      uw_recipe_map_stats_t before, after;
+      uw_recipe_map_stats_get(&before);
+
+      for (int i = 0; i < n; i++) {
+        unw_bench_snapshot_t *s = &snapshots[i];
+        if (s->stack == NULL) continue;
+
+        uint64_t t0 = hpcrun_nanotime();
+        int frames = unwind_snapshot(s, u, pcs[u], 0);
+        uint64_t t1 = hpcrun_nanotime();
+
+        if (frames < 0) {
+          if (pass == 0) r->faults++;
+          continue;
+        }
+        if (pass == 0) {
+          r->cold_ns += t1 - t0;
+          r->cold_frames += frames;
+        } else {
+          r->warm_ns += t1 - t0;
+          r->warm_frames += frames;
+        }
+      }
+
+      uw_recipe_map_stats_get(&after);
+      stats_diff(&r->stats, &before, &after);
+    }
+  }
+
+  // divergence check, outside of the timed loops
+  int divergent = 0;
+  for (int i = 0; i < n; i++) {
+    unw_bench_snapshot_t *s = &snapshots[i];
+    if (s->stack == NULL) continue;
+
+    int frames[UNW_BENCH_NUM_UNWINDERS];
+    for (int u = 0; u < UNW_BENCH_NUM_UNWINDERS; u++) {
+      frames[u] = unwind_snapshot(s, u, pcs[u], UNW_BENCH_MAX_FRAMES);
+      if (frames[u] > 0) {
+        pcs_to_functions(pcs[u], frames[u]);
+      }
+    }
+
+    int same = (frames[0] == frames[1]);
+    for (int f = 0; same && f < frames[0]; f++) {
+      same = (pcs[0][f] == pcs[1][f]);
+    }
+    if (same) continue;
+
+    if (divergent < UNW_BENCH_MAX_REPORTS) {
+      int f = 0;
+      while (f < frames[0] && f < frames[1] && pcs[0][f] == pcs[1][f]) f++;
+      AMSG("unwind replay: snapshot %d diverges at frame %d: "
+           "%s %d frames (%p), %s %d frames (%p)", i, f,
+           unwinder_name[0], frames[0], f < frames[0] ? pcs[0][f] : NULL,
+           unwinder_name[1], frames[1], f < frames[1] ? pcs[1][f] : NULL);
+    }
+    divergent++;
+  }
+
+  report(count, res, divergent);
+}
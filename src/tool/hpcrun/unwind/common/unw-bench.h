@@ -0,0 +1,87 @@
+// -*-Mode: C++;-*- // technically C99
+
+#ifndef _hpctoolkit_unw_bench_h_
+#define _hpctoolkit_unw_bench_h_
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL: $
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//*****************************************************************************
+// Recorded-stack replay benchmark for the unwinders.
+//
+// When the UNWIND_BENCH_SNAPSHOTS control knob is nonzero, the first
+// that many asynchronous samples save a snapshot of the signal context
+// and of the live stack above the interrupted stack pointer.  At process
+// exit, while the load modules are still mapped, each snapshot is
+// replayed against the hpcrun unwinder and against libunwind, and the
+// time per frame, the hit rates of uw_hash and of the recipe map, and
+// the snapshots where the two unwinders disagree are reported on stderr.
+//*****************************************************************************
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+void
+hpcrun_unw_bench_init
+(
+  void
+);
+
+// called from the sample handler, before the backtrace
+void
+hpcrun_unw_bench_capture
+(
+  void *context
+);
+
+// replay the snapshots and print the report
+void
+hpcrun_unw_bench_fini
+(
+  void
+);
+
+#endif // _hpctoolkit_unw_bench_h_
@@ -85,6 +85,7 @@
 #include "../../thread_data.h"
 #include "uw_hash.h"
 #include "uw_recipe_map.h"
+#include "uw_recipe_table.h"
 #include "unwind-interval.h"
 #include "../../fnbounds/fnbounds_interface.h"
 #include "../../../../lib/prof-lean/cskiplist.h"
@@ -113,6 +114,18 @@
 
 #define NUM_NODES 10
 
+// The map for each unwinder is split into shards so that threads looking
+// up recipes for unrelated code do not share a skiplist and its lock.
+// An address selects its shard by the 64K region that contains it, so
+// neighboring regions go to different shards.  Each shard is a complete
+// map by itself: it holds the poisoned (unmapped) ranges and entries for
+// the functions that addresses in its regions were looked up in.  A
+// function that straddles a region boundary may thus have an entry in
+// more than one shard; each is built independently.
+#define SHARD_BITS 6
+#define NUM_SHARDS (1 << SHARD_BITS)
+#define SHARD_REGION_SHIFT 16
+
 //******************************************************************************
 // type
 //******************************************************************************
@@ -271,13 +284,28 @@ ilmstat_btuwi_pair_free(ilmstat_btuwi_pair_t* pair, unwinder_t uw)
 // local data
 //---------------------------------------------------------------------
 
-// a map from unwinder kind to its recipe skiplist
-static cskiplist_t *unwinder_to_cskiplist[NUM_UNWINDERS];
+// a map from unwinder kind to the shards of its recipe skiplist
+static cskiplist_t *unwinder_to_cskiplist[NUM_UNWINDERS][NUM_SHARDS];
 
 // memory allocator for creating unwinder_to_cskiplist
 // and inserting entries into unwinder_to_cskiplist:
 static mem_alloc my_alloc = hpcrun_malloc;
 
+static __thread uw_recipe_map_stats_t my_stats;
+
+//******************************************************************************
+// Shards
+//******************************************************************************
+
+static inline cskiplist_t *
+uw_recipe_map_shard(uintptr_t addr, unwinder_t uw)
+{
+  uint64_t region = (uint64_t)addr >> SHARD_REGION_SHIFT;
+  // Fibonacci hashing spreads consecutive regions over the shards
+  unsigned int shard = (region * 0x9E3779B97F4A7C15ull) >> (64 - SHARD_BITS);
+  return unwinder_to_cskiplist[uw][shard];
+}
+
 //******************************************************************************
 // String output
 //******************************************************************************
@@ -436,9 +464,12 @@ uw_recipe_map_report_and_dump(const char *op, void *start, void *end)
     char buf[MAX_CSKIPLIST_STR];
     buf[0] = 0;
 
-    fprintf(stderr, "********* recipe map for unwinder %d *********\n", uw);
-    cskl_tostr(unwinder_to_cskiplist[uw], cskl_ilmstat_btuwi_node_tostr[uw], buf, MAX_CSKIPLIST_STR);
-    fprintf(stderr, "%s", buf);
+    for (int shard = 0; shard < NUM_SHARDS; shard++) {
+      fprintf(stderr, "********* recipe map for unwinder %d, shard %d *********\n", uw, shard);
+      buf[0] = 0;
+      cskl_tostr(unwinder_to_cskiplist[uw][shard], cskl_ilmstat_btuwi_node_tostr[uw], buf, MAX_CSKIPLIST_STR);
+      fprintf(stderr, "%s", buf);
+    }
   }
 }
 #else
@@ -446,13 +477,13 @@ uw_recipe_map_report_and_dump(const char *op, void *start, void *end)
 #endif
 
 static void
-uw_recipe_map_poison(uintptr_t start, uintptr_t end, unwinder_t uw)
+uw_recipe_map_poison(cskiplist_t *cskl, uintptr_t start, uintptr_t end, unwinder_t uw)
 {
   uw_recipe_map_report("uw_recipe_map_poison", (void *) start, (void *) end);
 
   ilmstat_btuwi_pair_t* itpair =
           ilmstat_btuwi_pair_build(start, end, NULL, NEVER, my_alloc);
-  csklnode_t *node = cskl_insert(unwinder_to_cskiplist[uw], itpair, my_alloc);
+  csklnode_t *node = cskl_insert(cskl, itpair, my_alloc);
   if (itpair != (ilmstat_btuwi_pair_t*)node->val)
     ilmstat_btuwi_pair_free(itpair, uw);
 }
@@ -463,9 +494,9 @@ uw_recipe_map_poison(uintptr_t start, uintptr_t end, unwinder_t uw)
  * return that node, otherwise return NULL.
  */
 static ilmstat_btuwi_pair_t*
-uw_recipe_map_inrange_find(uintptr_t addr, unwinder_t uw)
+uw_recipe_map_inrange_find(cskiplist_t *cskl, uintptr_t addr)
 {
-  return (ilmstat_btuwi_pair_t*)cskl_inrange_find(unwinder_to_cskiplist[uw], (void*)addr);
+  return (ilmstat_btuwi_pair_t*)cskl_inrange_find(cskl, (void*)addr);
 }
 
 static void
@@ -500,16 +531,17 @@ static void (*cskl_ilmstat_btuwi_free[])(void *anode) =
 
 static bool
 uw_recipe_map_cmp_del_bulk_unsynch(
+        cskiplist_t *cskl,
         ilmstat_btuwi_pair_t* key,
         unwinder_t uw)
 {
-  return cskl_cmp_del_bulk_unsynch(unwinder_to_cskiplist[uw], key, key, cskl_ilmstat_btuwi_free[uw]);
+  return cskl_cmp_del_bulk_unsynch(cskl, key, key, cskl_ilmstat_btuwi_free[uw]);
 }
 
 static void
-uw_recipe_map_unpoison(uintptr_t start, uintptr_t end, unwinder_t uw)
+uw_recipe_map_unpoison(cskiplist_t *cskl, uintptr_t start, uintptr_t end, unwinder_t uw)
 {
-  ilmstat_btuwi_pair_t* ilmstat_btuwi = uw_recipe_map_inrange_find(start, uw);
+  ilmstat_btuwi_pair_t* ilmstat_btuwi = uw_recipe_map_inrange_find(cskl, start);
   if (ilmstat_btuwi == NULL)
     return;
 
@@ -524,38 +556,38 @@ uw_recipe_map_unpoison(uintptr_t start, uintptr_t end, unwinder_t uw)
 
   uintptr_t s0 = ilmstat_btuwi->interval.start;
   uintptr_t e0 = ilmstat_btuwi->interval.end;
-  uw_recipe_map_cmp_del_bulk_unsynch(ilmstat_btuwi, uw);
-  uw_recipe_map_poison(s0, start, uw);
-  uw_recipe_map_poison(end, e0, uw);
+  uw_recipe_map_cmp_del_bulk_unsynch(cskl, ilmstat_btuwi, uw);
+  uw_recipe_map_poison(cskl, s0, start, uw);
+  uw_recipe_map_poison(cskl, end, e0, uw);
 }
 
 
 static void
-uw_recipe_map_repoison(uintptr_t start, uintptr_t end, unwinder_t uw)
+uw_recipe_map_repoison(cskiplist_t *cskl, uintptr_t start, uintptr_t end, unwinder_t uw)
 {
   if (start > 0) {
-    ilmstat_btuwi_pair_t* ileft = uw_recipe_map_inrange_find(start - 1, uw);
+    ilmstat_btuwi_pair_t* ileft = uw_recipe_map_inrange_find(cskl, start - 1);
     if (ileft) {
       if ((ileft->interval.end == start) &&
           (NEVER == atomic_load_explicit(&ileft->stat, memory_order_acquire))) {
         // poisoned interval adjacent on the left
         start = ileft->interval.start;
-        uw_recipe_map_cmp_del_bulk_unsynch(ileft, uw);
+        uw_recipe_map_cmp_del_bulk_unsynch(cskl, ileft, uw);
       }
     }
   }
   if (end < UINTPTR_MAX) {
-    ilmstat_btuwi_pair_t* iright = uw_recipe_map_inrange_find(end+1, uw);
+    ilmstat_btuwi_pair_t* iright = uw_recipe_map_inrange_find(cskl, end+1);
     if (iright) {
       if ((iright->interval.start == end) &&
           (NEVER == atomic_load_explicit(&iright->stat, memory_order_acquire))) {
         // poisoned interval adjacent on the right
         end = iright->interval.end;
-        uw_recipe_map_cmp_del_bulk_unsynch(iright, uw);
+        uw_recipe_map_cmp_del_bulk_unsynch(cskl, iright, uw);
       }
     }
   }
-  uw_recipe_map_poison(start, end, uw);
+  uw_recipe_map_poison(cskl, start, end, uw);
 }
 
 static void
@@ -566,9 +598,15 @@ uw_recipe_map_notify_map(load_module_t* lm)
   void* end = lm->dso_info->end_addr;
   uw_recipe_map_report_and_dump("*** map: before unpoisoning", start, end);
 
+  // map the ahead-of-time recipes for lm, if any, before its
+  // intervals can be built
+  uw_recipe_table_map(lm);
+
   unwinder_t uw;
   for (uw = 0; uw < NUM_UNWINDERS; uw++)
-    uw_recipe_map_unpoison((uintptr_t)start, (uintptr_t)end, uw);
+    for (int shard = 0; shard < NUM_SHARDS; shard++)
+      uw_recipe_map_unpoison(unwinder_to_cskiplist[uw][shard],
+                             (uintptr_t)start, (uintptr_t)end, uw);
 
   uw_recipe_map_report_and_dump("*** map: after unpoisoning", start, end);
 }
@@ -586,11 +624,17 @@ uw_recipe_map_notify_unmap(load_module_t* lm)
   TMSG(UW_RECIPE_MAP, "uw_recipe_map_delete_range from %p to %p", start, end);
   unwinder_t uw;
   for (uw = 0; uw < NUM_UNWINDERS; uw++)
-    cskl_inrange_del_bulk_unsynch(unwinder_to_cskiplist[uw], start, ((void*)((char *) end) - 1), cskl_ilmstat_btuwi_free[uw]);
+    for (int shard = 0; shard < NUM_SHARDS; shard++)
+      cskl_inrange_del_bulk_unsynch(unwinder_to_cskiplist[uw][shard], start,
+                                    ((void*)((char *) end) - 1), cskl_ilmstat_btuwi_free[uw]);
 
   // join poisoned intervals here.
   for (uw = 0; uw < NUM_UNWINDERS; uw++)
-    uw_recipe_map_repoison((uintptr_t)start, (uintptr_t)end, uw);
+    for (int shard = 0; shard < NUM_SHARDS; shard++)
+      uw_recipe_map_repoison(unwinder_to_cskiplist[uw][shard],
+                             (uintptr_t)start, (uintptr_t)end, uw);
+
+  uw_recipe_table_unmap(lm);
 
   if (hpcrun_td_avail()) {
     thread_data_t *td = hpcrun_get_thread_data();
@@ -648,15 +692,20 @@ uw_recipe_map_init(void)
           ilmstat_btuwi_pair_build(UINTPTR_MAX, UINTPTR_MAX, NULL, NEVER, my_alloc );
   unwinder_t uw;
   for (uw = 0; uw < NUM_UNWINDERS; uw++)
-    unwinder_to_cskiplist[uw] =
-      cskl_new(lsentinel, rsentinel, SKIPLIST_HEIGHT,
-               ilmstat_btuwi_pair_cmp, ilmstat_btuwi_pair_inrange, my_alloc);
+    for (int shard = 0; shard < NUM_SHARDS; shard++)
+      unwinder_to_cskiplist[uw][shard] =
+        cskl_new(lsentinel, rsentinel, SKIPLIST_HEIGHT,
+                 ilmstat_btuwi_pair_cmp, ilmstat_btuwi_pair_inrange, my_alloc);
 
+  if (uw_recipe_table_init()) {
+    TMSG(UW_RECIPE_MAP, "using ahead-of-time unwind recipe tables");
+  }
   uw_recipe_map_notify_init();
 
   // initialize the map with a POISONED node ({([0, UINTPTR_MAX), NULL), NEVER}, NULL)
   for (uw = 0; uw < NUM_UNWINDERS; uw++)
-    uw_recipe_map_poison(0, UINTPTR_MAX, uw);
+    for (int shard = 0; shard < NUM_SHARDS; shard++)
+      uw_recipe_map_poison(unwinder_to_cskiplist[uw][shard], 0, UINTPTR_MAX, uw);
 }
 
 
@@ -697,13 +746,17 @@ uw_recipe_map_lookup_helper
     e = uw_hash_lookup(td->uw_hash_table, uw, addr);
 
     if (e == NULL) {
+      my_stats.hash_misses++;
+
       // check if addr is already in the range of an interval key in the map
-      ilm_btui = uw_recipe_map_inrange_find((uintptr_t)addr, uw);
+      ilm_btui = uw_recipe_map_inrange_find(uw_recipe_map_shard((uintptr_t)addr, uw),
+                                            (uintptr_t)addr);
 
       // if we find ilm_btui, replace it in the hash table
       if (ilm_btui != NULL) {
         oldstat = atomic_load_explicit(&ilm_btui->stat, memory_order_acquire);
         if (oldstat == READY) {
+          my_stats.map_hits++;
           unwr_info->btuwi = bitree_uwi_inrange(ilm_btui->btuwi, (uintptr_t)addr);
           if (unwr_info->btuwi != NULL) {
             uw_hash_insert(td->uw_hash_table, uw, addr, ilm_btui,
@@ -715,6 +768,7 @@ uw_recipe_map_lookup_helper
         }
       }
     } else {
+      my_stats.hash_hits++;
       ilm_btui = e->ilm_btui;
       unwr_info->btuwi = e->btuwi;
       // if we find ilm_btui, we do not need to update btuwi
@@ -765,6 +819,8 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
   tree_stat_t oldstat = uw_recipe_map_lookup_helper(td, addr, uw, unwr_info, &ilm_btui);
 
   if (oldstat != READY) {
+    my_stats.map_misses++;
+
     // unwind recipe currently unavailable, prepare to build recipes for the enclosing
     // routine
     if (!ilm_btui) {
@@ -786,7 +842,7 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
       ilmstat_btuwi_pair_malloc((uintptr_t)fcn_start, (uintptr_t)fcn_end, lm,
         DEFERRED, my_alloc);
 
-    csklnode_t *node = cskl_insert(unwinder_to_cskiplist[uw], ilm_btui, my_alloc);
+    csklnode_t *node = cskl_insert(uw_recipe_map_shard((uintptr_t)addr, uw), ilm_btui, my_alloc);
     if (ilm_btui !=  (ilmstat_btuwi_pair_t*)node->val) {
       // interval_ldmod_pair ([fcn_start, fcn_end), lm) is already in the map,
       // so free the unused copy and use the mapped one
@@ -835,6 +891,10 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
       }
     }
     else {
+      // another thread is building this function's intervals; wait for
+      // that function alone
+      if (FORTHCOMING == oldstat)
+        my_stats.map_waits++;
       while (FORTHCOMING == oldstat)
         oldstat = atomic_load_explicit(&ilm_btui->stat, memory_order_acquire);
       if (oldstat == NEVER) {
@@ -862,3 +922,10 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
 
   return (unwr_info->btuwi != NULL);
 }
+
+
+void
+uw_recipe_map_stats_get(uw_recipe_map_stats_t *stats)
+{
+  *stats = my_stats;
+}
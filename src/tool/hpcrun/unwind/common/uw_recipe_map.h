@@ -52,10 +52,26 @@
 #ifndef _UW_RECIPE_MAP_H_
 #define _UW_RECIPE_MAP_H_
 
+#include <stdint.h>
+
 #include "unwindr_info.h"
 
 typedef struct ilmstat_btuwi_pair_s ilmstat_btuwi_pair_t;
 
+/*
+ * per-thread counts of how lookups were satisfied: by the thread's
+ * uw_hash table, by recipes already in the map, or by building the
+ * recipes of the enclosing procedure (or waiting for another thread to).
+ * map_waits counts the misses that waited for another thread.
+ */
+typedef struct uw_recipe_map_stats_s {
+  uint64_t hash_hits;
+  uint64_t hash_misses;
+  uint64_t map_hits;
+  uint64_t map_misses;
+  uint64_t map_waits;
+} uw_recipe_map_stats_t;
+
 void
 uw_recipe_map_init(void);
 
@@ -76,4 +92,11 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info);
 bool
 uw_recipe_map_lookup_noinsert(void *addr, unwinder_t uw, unwindr_info_t *unwr_info);
 
+
+/*
+ * copy the calling thread's lookup counts into *stats
+ */
+void
+uw_recipe_map_stats_get(uw_recipe_map_stats_t *stats);
+
 #endif  /* !_UW_RECIPE_MAP_H_ */
@@ -0,0 +1,376 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL: $
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//**************************************************************************
+// system includes
+//**************************************************************************
+
+#define _GNU_SOURCE
+
+#include <elf.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+
+//**************************************************************************
+// local includes
+//**************************************************************************
+
+#include "uw_recipe_table.h"
+
+#include "../../env.h"
+#include "../../memory/hpcrun-malloc.h"
+#include "../../messages/messages.h"
+#include "../../../../lib/prof-lean/spinlock.h"
+
+
+
+//**************************************************************************
+// macros
+//**************************************************************************
+
+#if defined(__x86_64__)
+#define UW_RECIPE_MACHINE EM_X86_64
+#else
+#define UW_RECIPE_MACHINE EM_NONE  // no recipe tables yet
+#endif
+
+
+
+//**************************************************************************
+// type declarations
+//**************************************************************************
+
+typedef struct uw_recipe_table_s {
+  struct uw_recipe_table_s *next;
+  load_module_t *lm;
+
+  // run-time range of the load module, and its relocation
+  uintptr_t start;
+  uintptr_t end;
+  uintptr_t start_to_ref_dist;
+
+  void *map;
+  size_t map_size;
+
+  // one reference while mapped, plus one per span found in the table
+  atomic_uint refs;
+
+  const struct uw_recipe_table_func *funcs;
+  uint64_t num_funcs;
+  const struct uw_recipe_table_row *rows;
+  uint64_t num_rows;
+} uw_recipe_table_t;
+
+
+
+//**************************************************************************
+// private data
+//**************************************************************************
+
+static const char *table_dir = NULL;
+
+static uw_recipe_table_t *tables = NULL;
+static uw_recipe_table_t *free_tables = NULL;
+static spinlock_t tables_lock = SPINLOCK_UNLOCKED;
+
+
+
+//**************************************************************************
+// private operations
+//**************************************************************************
+
+static void
+table_unref
+(
+  uw_recipe_table_t *t
+)
+{
+  if (atomic_fetch_sub_explicit(&t->refs, 1, memory_order_acq_rel) != 1) return;
+
+  munmap(t->map, t->map_size);
+
+  spinlock_lock(&tables_lock);
+  t->next = free_tables;
+  free_tables = t;
+  spinlock_unlock(&tables_lock);
+}
+
+
+static bool
+table_valid
+(
+  const struct uw_recipe_table_header *hdr,
+  size_t map_size,
+  const struct stat *lm_stat
+)
+{
+  if (memcmp(hdr->magic, UW_RECIPE_TABLE_MAGIC, sizeof(UW_RECIPE_TABLE_MAGIC)) != 0
+      || hdr->version != UW_RECIPE_TABLE_VERSION
+      || hdr->machine != UW_RECIPE_MACHINE) {
+    return false;
+  }
+
+  // the table must describe this very file
+  if (hdr->file_size != (uint64_t)lm_stat->st_size
+      || hdr->file_mtime != (int64_t)lm_stat->st_mtime) {
+    return false;
+  }
+
+  size_t avail = map_size - sizeof(*hdr);
+  if (hdr->num_funcs > avail / sizeof(struct uw_recipe_table_func)) return false;
+  avail -= hdr->num_funcs * sizeof(struct uw_recipe_table_func);
+  if (hdr->num_rows != avail / sizeof(struct uw_recipe_table_row)) return false;
+
+  const struct uw_recipe_table_func *funcs =
+    (const struct uw_recipe_table_func *)(hdr + 1);
+  uint64_t prev_end = 0;
+  for (uint64_t i = 0; i < hdr->num_funcs; i++) {
+    if (funcs[i].start < prev_end || funcs[i].end <= funcs[i].start
+        || funcs[i].num_rows == 0
+        || (uint64_t)funcs[i].first_row + funcs[i].num_rows > hdr->num_rows) {
+      return false;
+    }
+    prev_end = funcs[i].end;
+  }
+  return true;
+}
+
+
+
+//**************************************************************************
+// interface operations
+//**************************************************************************
+
+bool
+uw_recipe_table_init
+(
+  void
+)
+{
+  table_dir = getenv(HPCRUN_UNWIND_RECIPES);
+  if (table_dir != NULL && table_dir[0] == '\0') {
+    table_dir = NULL;
+  }
+  return table_dir != NULL;
+}
+
+
+void
+uw_recipe_table_map
+(
+  load_module_t *lm
+)
+{
+  if (table_dir == NULL || lm == NULL || lm->dso_info == NULL || lm->name == NULL) {
+    return;
+  }
+
+  char path[PATH_MAX];
+  const char *base = strrchr(lm->name, '/');
+  base = (base == NULL) ? lm->name : base + 1;
+  if (snprintf(path, sizeof(path), "%s/%s%s", table_dir, base,
+               UW_RECIPE_TABLE_SUFFIX) >= (int)sizeof(path)) {
+    return;
+  }
+
+  struct stat lm_stat, table_stat;
+  if (stat(lm->name, &lm_stat) != 0) {
+    return;
+  }
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    TMSG(UW_RECIPE_MAP, "no unwind recipe table for %s", lm->name);
+    return;
+  }
+  void *map = MAP_FAILED;
+  if (fstat(fd, &table_stat) == 0
+      && table_stat.st_size >= (off_t)sizeof(struct uw_recipe_table_header)) {
+    map = mmap(NULL, table_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    return;
+  }
+
+  const struct uw_recipe_table_header *hdr = map;
+  if (!table_valid(hdr, table_stat.st_size, &lm_stat)) {
+    EMSG("ignoring stale or invalid unwind recipe table %s for %s", path, lm->name);
+    munmap(map, table_stat.st_size);
+    return;
+  }
+
+  spinlock_lock(&tables_lock);
+  uw_recipe_table_t *t = free_tables;
+  if (t != NULL) {
+    free_tables = t->next;
+  }
+  spinlock_unlock(&tables_lock);
+  if (t == NULL) {
+    t = (uw_recipe_table_t *)hpcrun_malloc(sizeof(uw_recipe_table_t));
+  }
+
+  t->lm = lm;
+  t->start = (uintptr_t)lm->dso_info->start_addr;
+  t->end = (uintptr_t)lm->dso_info->end_addr;
+  t->start_to_ref_dist = lm->dso_info->start_to_ref_dist;
+  t->map = map;
+  t->map_size = table_stat.st_size;
+  t->funcs = (const struct uw_recipe_table_func *)(hdr + 1);
+  t->num_funcs = hdr->num_funcs;
+  t->rows = (const struct uw_recipe_table_row *)(t->funcs + hdr->num_funcs);
+  t->num_rows = hdr->num_rows;
+  atomic_init(&t->refs, 1);
+
+  spinlock_lock(&tables_lock);
+  t->next = tables;
+  tables = t;
+  spinlock_unlock(&tables_lock);
+
+  TMSG(UW_RECIPE_MAP, "unwind recipe table %s: %ld functions, %ld rows",
+       path, t->num_funcs, t->num_rows);
+}
+
+
+void
+uw_recipe_table_unmap
+(
+  load_module_t *lm
+)
+{
+  if (table_dir == NULL) return;
+
+  spinlock_lock(&tables_lock);
+  uw_recipe_table_t **prev = &tables;
+  uw_recipe_table_t *t = tables;
+  while (t != NULL && t->lm != lm) {
+    prev = &t->next;
+    t = t->next;
+  }
+  if (t != NULL) {
+    *prev = t->next;
+  }
+  spinlock_unlock(&tables_lock);
+
+  if (t == NULL) return;
+
+  // spans found before the unlink keep the rows mapped until released
+  table_unref(t);
+}
+
+
+bool
+uw_recipe_table_find
+(
+  void *start,
+  void *end,
+  uw_recipe_span_t *span
+)
+{
+  if (table_dir == NULL) return false;
+
+  uw_recipe_table_t *table = NULL;
+
+  // take a reference under the lock, so a concurrent unmap leaves the
+  // table mapped while we (and the caller) read it
+  spinlock_lock(&tables_lock);
+  for (uw_recipe_table_t *t = tables; t != NULL; t = t->next) {
+    if (t->start <= (uintptr_t)start && (uintptr_t)start < t->end) {
+      atomic_fetch_add_explicit(&t->refs, 1, memory_order_relaxed);
+      table = t;
+      break;
+    }
+  }
+  spinlock_unlock(&tables_lock);
+
+  if (table == NULL) return false;
+
+  // binary search for the last function that starts at or before start
+  uint64_t lstart = (uintptr_t)start - table->start_to_ref_dist;
+  uint64_t lend = (uintptr_t)end - table->start_to_ref_dist;
+  uint64_t lo = 0, hi = table->num_funcs;
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (table->funcs[mid].start <= lstart) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0 || lend > table->funcs[lo - 1].end) {
+    table_unref(table);
+    return false;
+  }
+
+  const struct uw_recipe_table_func *f = &table->funcs[lo - 1];
+  span->start = f->start + table->start_to_ref_dist;
+  span->end = f->end + table->start_to_ref_dist;
+  span->rows = table->rows + f->first_row;
+  span->num_rows = f->num_rows;
+  span->table = table;
+  return true;
+}
+
+
+void
+uw_recipe_table_release
+(
+  uw_recipe_span_t *span
+)
+{
+  if (span->table == NULL) return;
+  table_unref(span->table);
+  span->table = NULL;
+}
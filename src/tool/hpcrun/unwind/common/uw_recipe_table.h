@@ -0,0 +1,137 @@
+// -*-Mode: C++;-*- // technically C99
+
+#ifndef _hpctoolkit_uw_recipe_table_h_
+#define _hpctoolkit_uw_recipe_table_h_
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL: $
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2024, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+
+//*****************************************************************************
+// Unwind recipe tables written ahead of time by hpcfnbounds -u from the
+// call frame information (.eh_frame) of a load module.
+//
+// When HPCRUN_UNWIND_RECIPES names a directory, the table for each load
+// module is mapped as the module is mapped.  The architecture-specific
+// build_intervals then builds the intervals of a function from its rows,
+// and only analyzes the instructions of functions that the table does
+// not cover.
+//*****************************************************************************
+
+//*****************************************************************************
+// system includes
+//*****************************************************************************
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+
+//*****************************************************************************
+// local includes
+//*****************************************************************************
+
+#include "../../loadmap.h"
+#include "../../../hpcfnbounds/uw-recipe-table.h"
+
+
+
+//*****************************************************************************
+// type declarations
+//*****************************************************************************
+
+// the rows covering one function, relocated to run-time addresses
+typedef struct uw_recipe_span_s {
+  uintptr_t start;
+  uintptr_t end;
+  const struct uw_recipe_table_row *rows;
+  uint32_t num_rows;
+  struct uw_recipe_table_s *table;  // holds the rows mapped
+} uw_recipe_span_t;
+
+
+
+//*****************************************************************************
+// interface operations
+//*****************************************************************************
+
+// returns true if recipe tables are enabled
+bool
+uw_recipe_table_init
+(
+  void
+);
+
+void
+uw_recipe_table_map
+(
+  load_module_t *lm
+);
+
+void
+uw_recipe_table_unmap
+(
+  load_module_t *lm
+);
+
+// find the rows covering all of [start, end), if any.  the rows stay
+// mapped until the span is released, even if the load module is
+// unmapped in the meantime.
+bool
+uw_recipe_table_find
+(
+  void *start,
+  void *end,
+  uw_recipe_span_t *span
+);
+
+// release a span filled in by a successful uw_recipe_table_find
+void
+uw_recipe_table_release
+(
+  uw_recipe_span_t *span
+);
+
+#endif // _hpctoolkit_uw_recipe_table_h_
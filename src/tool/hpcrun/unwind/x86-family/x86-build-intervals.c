@@ -81,6 +81,9 @@ btuwi_status_t x86_build_intervals(void *ins, unsigned int len, int noisy);
 
 static int x86_coalesce_unwind_intervals(unwind_interval *ui);
 
+static bool x86_recipe_from_row(const struct uw_recipe_table_row *row,
+                                ra_loc *ra_status, x86registers_t *reg);
+
 /******************************************************************************
  * interface operations
  *****************************************************************************/
@@ -189,10 +192,121 @@ x86_build_intervals(void *ins, unsigned int len, int noisy)
 }
 
 
+bool
+x86_build_intervals_from_table(void *ins, unsigned int len,
+                               const uw_recipe_span_t *span,
+                               btuwi_status_t *status)
+{
+  uintptr_t beg = (uintptr_t)ins;
+  uintptr_t end = beg + len;
+  ra_loc ra_status;
+  x86registers_t reg;
+  uint32_t first = span->num_rows;
+  uint32_t last = 0;
+  uint32_t i;
+
+  // find the rows overlapping [beg, end), and make sure that all of
+  // them can be expressed before allocating any intervals
+  for (i = 0; i < span->num_rows; i++) {
+    uintptr_t row_start = span->start + span->rows[i].offset;
+    uintptr_t row_end = (i + 1 < span->num_rows) ?
+      span->start + span->rows[i + 1].offset : span->end;
+    if (row_end <= beg) continue;
+    if (row_start >= end) break;
+    if (!x86_recipe_from_row(&span->rows[i], &ra_status, &reg)) return false;
+    if (first == span->num_rows) first = i;
+    last = i;
+  }
+  if (first == span->num_rows) return false;
+
+  unwind_interval *current = NULL;
+  status->first = NULL;
+  for (i = first; i <= last; i++) {
+    uintptr_t row_start = span->start + span->rows[i].offset;
+    x86_recipe_from_row(&span->rows[i], &ra_status, &reg);
+    unwind_interval *next =
+      new_ui((char *)(row_start < beg ? beg : row_start), ra_status, &reg);
+    if (current) {
+      link_ui(current, next);
+    } else {
+      status->first = next;
+    }
+    current = next;
+  }
+  UWI_END_ADDR(current) = end;
+
+  status->first_undecoded_ins = (char *)end;
+  status->count = last - first + 1;
+  status->error = 0;
+
+  TMSG(UW_RECIPE_MAP, "intervals for %p to %p from recipe table: %d",
+       ins, (void *)end, status->count);
+
+  return true;
+}
+
+
+bool
+x86_intervals_agree(unwind_interval *a, unwind_interval *b)
+{
+  while (a && b) {
+    // compare the recipes wherever the two intervals overlap
+    if (UWI_START_ADDR(a) < UWI_END_ADDR(b) && UWI_START_ADDR(b) < UWI_END_ADDR(a)) {
+      x86recipe_t *ra = UWI_RECIPE(a);
+      x86recipe_t *rb = UWI_RECIPE(b);
+      bool a_sp = (ra->ra_status == RA_SP_RELATIVE);
+      bool b_sp = (rb->ra_status == RA_SP_RELATIVE);
+      if (a_sp != b_sp) return false;
+      if (a_sp ? ra->reg.sp_ra_pos != rb->reg.sp_ra_pos
+               : ra->reg.bp_ra_pos != rb->reg.bp_ra_pos) {
+        return false;
+      }
+    }
+    if (UWI_END_ADDR(a) <= UWI_END_ADDR(b)) a = UWI_NEXT(a);
+    else b = UWI_NEXT(b);
+  }
+  return true;
+}
+
+
 /******************************************************************************
  * private operations
  *****************************************************************************/
 
+// translate a row of call frame information into an x86 recipe.
+// CFA is the value of SP before the call, so offsets from the CFA turn
+// into offsets from SP or BP by adding the CFA offset.
+static bool
+x86_recipe_from_row(const struct uw_recipe_table_row *row,
+                    ra_loc *ra_status, x86registers_t *reg)
+{
+  int ra_pos = row->cfa_offset + row->ra_offset;
+  int bp_pos = row->cfa_offset + row->fp_offset;
+
+  *reg = (x86registers_t) {0, 0, BP_UNCHANGED, 0, 0};
+
+  if (row->cfa_reg == UW_RECIPE_CFA_SP) {
+    *ra_status = RA_SP_RELATIVE;
+    reg->sp_ra_pos = ra_pos;
+    if (row->fp_rule == UW_RECIPE_FP_SAVED) {
+      reg->bp_status = BP_SAVED;
+      reg->sp_bp_pos = bp_pos;
+    }
+    return true;
+  }
+
+  // a frame based on BP must have saved the caller's BP
+  if (row->cfa_reg == UW_RECIPE_CFA_FP && row->fp_rule == UW_RECIPE_FP_SAVED) {
+    *ra_status = RA_BP_FRAME;
+    reg->bp_status = BP_SAVED;
+    reg->bp_ra_pos = ra_pos;
+    reg->bp_bp_pos = bp_pos;
+    return true;
+  }
+
+  return false;
+}
+
 static bool
 x86_ui_same_data(x86recipe_t *proto, x86recipe_t *cand)
 {
@@ -47,9 +47,26 @@
 #ifndef x86_build_intervals_h
 #define x86_build_intervals_h
 
+#include <stdbool.h>
+
 #include "x86-unwind-interval.h"
+#include "../common/uw_recipe_table.h"
 
 btuwi_status_t
 x86_build_intervals(void *ins, unsigned int len, int noisy);
 
+// build the intervals for [ins, ins + len) from the rows of an unwind
+// recipe table instead of decoding instructions.  returns false if a
+// row has no x86 recipe, in which case nothing is allocated.
+bool
+x86_build_intervals_from_table(void *ins, unsigned int len,
+                               const uw_recipe_span_t *span,
+                               btuwi_status_t *status);
+
+// returns true if two lists of intervals for the same range find the
+// return address in the same place (relative to SP or to BP) at every
+// address they both cover
+bool
+x86_intervals_agree(unwind_interval *a, unwind_interval *b);
+
 #endif
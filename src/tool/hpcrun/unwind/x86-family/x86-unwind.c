@@ -79,7 +79,10 @@
 #include "../../../../include/gcc-attr.h"
 #include "x86-decoder.h"
 
+#include "../../control-knob.h"
+#include "../../env.h"
 #include "../../epoch.h"
+#include "../../hpcrun_stats.h"
 #include "../../main.h"
 #include "../common/stack_troll.h"
 #include "../../thread_use.h"
@@ -129,6 +132,28 @@ static int DEBUG_WAIT_BEFORE_TROLLING = 1;
 
 static int DEBUG_NO_LONGJMP = 0;
 
+// walk saved frame pointers for frames above the interrupted one,
+// checking each step with the recipe unwinder if asked to
+static bool unw_fp_enabled = false;
+static bool unw_fp_verify = false;
+
+// check the intervals built from unwind recipe tables against those
+// built by decoding the instructions, if asked to
+static bool unw_recipes_verify = false;
+
+
+
+//****************************************************************************
+// type declarations
+//****************************************************************************
+
+// cursor->flags
+typedef enum {
+  UnwFlg_NULL = 0,
+  UnwFlg_StackTop,       // the interrupted frame
+  UnwFlg_FramePointer,   // found by the frame pointer fast path
+} unw_flag_t;
+
 
 
 //****************************************************************************
@@ -150,6 +175,9 @@ unw_step_bp(hpcrun_unw_cursor_t* cursor);
 static step_state
 unw_step_std(hpcrun_unw_cursor_t* cursor);
 
+static step_state
+unw_step_fp(hpcrun_unw_cursor_t* cursor);
+
 static step_state
 t1_dbg_unw_step(hpcrun_unw_cursor_t* cursor);
 
@@ -196,6 +224,18 @@ hpcrun_unw_init(void)
   libunwind_bind();
   x86_family_decoder_init();
   uw_recipe_map_init();
+
+  unw_fp_enabled = hpcrun_get_env_bool(HPCRUN_UNWIND_FP);
+  if (unw_fp_enabled) {
+    int verify = 0;
+    control_knob_value_get_int("UNWIND_FP_VERIFY", &verify);
+    unw_fp_verify = (verify != 0);
+    TMSG(UNW, "frame pointer unwinding enabled (verify = %d)", verify);
+  }
+
+  int recipes_verify = 0;
+  control_knob_value_get_int("UNWIND_RECIPES_VERIFY", &recipes_verify);
+  unw_recipes_verify = (recipes_verify != 0);
 }
 
 typedef unw_frame_regnum_t unw_reg_code_t;
@@ -258,6 +298,7 @@ hpcrun_unw_init_cursor(hpcrun_unw_cursor_t* cursor, void* context)
   libunwind_get_reg(&cursor->uc, UNW_REG_SP, (unw_word_t *)&sp);
   libunwind_get_reg(&cursor->uc, UNW_TDEP_BP, (unw_word_t *)&bp);
   save_registers(cursor, pc, bp, sp, NULL);
+  cursor->flags = UnwFlg_StackTop;
 
   if (cursor->libunw_status == LIBUNW_READY)
     return;
@@ -294,8 +335,30 @@ hpcrun_unw_get_ra_loc(hpcrun_unw_cursor_t* cursor)
 btuwi_status_t
 build_intervals(char *ins, unsigned int len, unwinder_t uw)
 {
-  if (uw == NATIVE_UNWINDER)
+  if (uw == NATIVE_UNWINDER) {
+    // prefer the ahead-of-time recipes from .eh_frame, if mapped
+    uw_recipe_span_t span;
+    btuwi_status_t btuwi_stat;
+    if (uw_recipe_table_find(ins, ins + len, &span)) {
+      bool built = x86_build_intervals_from_table(ins, len, &span, &btuwi_stat);
+      uw_recipe_table_release(&span);
+      if (built) {
+        if (unw_recipes_verify) {
+          btuwi_status_t decoded = x86_build_intervals(ins, len, 0);
+          hpcrun_stats_recipe_table_checked_inc(1);
+          if (!x86_intervals_agree(btuwi_stat.first, decoded.first)) {
+            hpcrun_stats_recipe_table_mismatch_inc(1);
+            EMSG("unwind recipe table disagrees with the instructions of %p-%p",
+                 ins, ins + len);
+          }
+          bitree_uwi_free(NATIVE_UNWINDER, decoded.first);
+        }
+        return btuwi_stat;
+      }
+    }
+
     return x86_build_intervals(ins, len, 0);
+  }
 
   btuwi_status_t btuwi_stat = libunw_build_intervals(ins, len);
 
@@ -452,6 +515,43 @@ hpcrun_retry_libunw_find_step(hpcrun_unw_cursor_t *cursor,
   return libunw_finalize_cursor(cursor, 1);
 }
 
+// A frame found by the frame pointer fast path has its function bounds
+// but no unwind recipe.  Look the recipe up before handing the frame to
+// the recipe unwinder.
+static void
+unw_fp_prepare_fallback(hpcrun_unw_cursor_t *cursor)
+{
+  if (cursor->flags != UnwFlg_FramePointer) return;
+
+  if (!uw_recipe_map_lookup(((char *)cursor->pc_unnorm) - 1, NATIVE_UNWINDER,
+                            &cursor->unwr_info)) {
+    cursor->unwr_info.btuwi = NULL;
+  }
+}
+
+
+// Step a copy of the cursor with the recipe unwinder and count the
+// frames where it does not agree with the frame pointer fast path.
+static void
+unw_step_fp_verify(hpcrun_unw_cursor_t *before, hpcrun_unw_cursor_t *after)
+{
+  hpcrun_unw_cursor_t check = *before;
+  unw_fp_prepare_fallback(&check);
+  check.flags = UnwFlg_NULL;
+
+  step_state res = (check.libunw_status == LIBUNW_READY)
+    ? libunw_unw_step(&check) : hpcrun_unw_step_real(&check);
+
+  if (res != STEP_OK || check.pc_unnorm != after->pc_unnorm
+      || check.sp != after->sp) {
+    hpcrun_stats_frames_fp_mismatch_inc(1);
+    TMSG(UNW, "fp step from pc=%p: fp pc=%p sp=%p, recipe pc=%p sp=%p (%d)",
+         before->pc_unnorm, after->pc_unnorm, after->sp,
+         check.pc_unnorm, check.sp, res);
+  }
+}
+
+
 step_state
 hpcrun_unw_step(hpcrun_unw_cursor_t *cursor)
 {
@@ -463,6 +563,24 @@ hpcrun_unw_step(hpcrun_unw_cursor_t *cursor)
     msg_sent = true;
   }
 
+  if (unw_fp_enabled) {
+    if (cursor->flags != UnwFlg_StackTop) {
+      hpcrun_unw_cursor_t saved = *cursor;
+
+      unw_res = unw_step_fp(cursor);
+      if (unw_res != STEP_ERROR) {
+        hpcrun_stats_frames_fp_inc(1);
+        if (unw_fp_verify && unw_res == STEP_OK) {
+          unw_step_fp_verify(&saved, cursor);
+        }
+        return unw_res;
+      }
+      hpcrun_stats_frames_fp_fallback_inc(1);
+      unw_fp_prepare_fallback(cursor);
+    }
+    cursor->flags = UnwFlg_NULL;
+  }
+
   if (cursor->libunw_status == LIBUNW_READY) {
     void** prev_sp = cursor->sp;
 
@@ -701,6 +819,79 @@ unw_step_std(hpcrun_unw_cursor_t* cursor)
 
 
 
+// true if the instruction before 'ra' may be a call: a direct call
+// (e8 rel32) or an indirect call through a register or memory (ff /2)
+static bool
+unw_fp_ra_follows_call(void *ra)
+{
+  unsigned char *p = (unsigned char *) ra;
+  if (p[-5] == 0xe8) return true;
+  for (int len = 2; len <= 7; len++) {
+    if (p[-len] == 0xff && ((p[-len + 1] >> 3) & 7) == 2) return true;
+  }
+  return false;
+}
+
+
+// Fast path for frames above the interrupted one: the frame record at
+// bp holds the caller's bp and the return address.  The step is taken
+// only if bp lies between sp and the stack bottom, the caller's bp is
+// above it (or the caller is the outermost frame), and the return
+// address is in a known function and follows a call.  Otherwise
+// STEP_ERROR leaves the frame to the recipe unwinder.
+static step_state
+unw_step_fp(hpcrun_unw_cursor_t* cursor)
+{
+  void *pc = cursor->pc_unnorm;
+  if (monitor_unwind_process_bottom_frame(pc) ||
+      monitor_unwind_thread_bottom_frame(pc)) {
+    return STEP_ERROR;  // let the recipe unwinder record the fence
+  }
+
+  void **bp = cursor->bp;
+  void *sp = cursor->sp;
+  void *stack_bottom = monitor_stack_bottom();
+
+  if ((void *) bp < sp || (void *) (bp + 2) > stack_bottom
+      || ((uintptr_t) bp & (sizeof(void *) - 1)) != 0) {
+    return STEP_ERROR;
+  }
+
+  void **next_bp = (void **) bp[0];
+  void *next_pc = bp[1];
+  void **next_sp = bp + 2;
+
+  if (next_bp != NULL && (next_bp <= bp || (void *) next_bp >= stack_bottom)) {
+    return STEP_ERROR;
+  }
+
+  if (hpcrun_trampoline_at_entry(next_pc)) {
+    return STEP_ERROR;
+  }
+
+  void *start, *end;
+  load_module_t *lm;
+  if (!fnbounds_enclosing_addr(((char *) next_pc) - 1, &start, &end, &lm)
+      || lm == NULL || !unw_fp_ra_follows_call(next_pc)) {
+    return STEP_ERROR;
+  }
+
+  TMSG(UNW, "step_fp: STEP_OK, bp=%p, sp=%p, pc=%p", next_bp, next_sp, next_pc);
+
+  cursor->unwr_info.interval.start = (uintptr_t) start;
+  cursor->unwr_info.interval.end = (uintptr_t) end;
+  cursor->unwr_info.lm = lm;
+  cursor->unwr_info.btuwi = NULL;
+  cursor->libunw_status = LIBUNW_UNAVAIL;
+  cursor->flags = UnwFlg_FramePointer;
+  save_registers(cursor, next_pc, next_bp, next_sp, bp + 1);
+  compute_normalized_ips(cursor);
+
+  return STEP_OK;
+}
+
+
+
 // special steppers to artificially introduce error conditions
 static step_state
 t1_dbg_unw_step(hpcrun_unw_cursor_t* cursor)
@@ -60,6 +60,7 @@
 //*****************************************************************************
 
 #include "fname_max.h"
+#include "container.h"
 #include "unwind/common/backtrace.h"
 #include "files.h"
 #include "epoch.h"
@@ -70,6 +71,7 @@
 #include "write_data.h"
 #include "loadmap.h"
 #include "sample_prob.h"
+#include "snapshot.h"
 #include "cct/cct_bundle.h"
 
 #include "messages/messages.h"
@@ -155,8 +157,15 @@ lazy_open_data_file(core_profile_trace_data_t *cptd)
     rank = 0;
   }
 
-  int fd = hpcrun_open_profile_file(rank, cptd->id);
-  fs = fdopen(fd, "w");
+  if (hpcrun_container_enabled()) {
+    // Stage the profile in memory so its offsets are relative to the
+    // start of its region; the whole image is appended to the
+    // container when the profile is complete.
+    fs = open_memstream(&cptd->container_buf, &cptd->container_size);
+  } else {
+    int fd = hpcrun_open_profile_file(rank, cptd->id);
+    fs = fdopen(fd, "w");
+  }
   if (fs == NULL)
   {
     EEMSG("HPCToolkit: %s: unable to open profile file", __func__);
@@ -425,11 +434,15 @@ void hpcrun_flush_epochs(core_profile_trace_data_t *cptd)
     return;
 
   write_epochs(fs, cptd, cptd->epoch, NULL);
+  hpcrun_snapshot_thread_reset(cptd);
   hpcrun_epoch_reset();
 }
 
 int hpcrun_write_profile_data(core_profile_trace_data_t *cptd)
 {
+  // the thread's profile supersedes its snapshots
+  hpcrun_snapshot_thread_done(cptd);
+
 #ifdef ENABLE_GTPIN
   if (level0_gtpin_enabled()) {
     for (epoch_t *epoch = cptd->epoch; epoch; epoch = epoch->next) {
@@ -461,6 +474,18 @@ int hpcrun_write_profile_data(core_profile_trace_data_t *cptd)
 
   TMSG(DATA_WRITE, "closing file");
   hpcio_fclose(fs);
+
+  if (cptd->container_buf) {
+    int ret = hpcrun_container_append_profile(cptd, cptd->container_buf,
+                                              cptd->container_size);
+    free(cptd->container_buf);
+    cptd->container_buf = NULL;
+    cptd->container_size = 0;
+    if (ret != HPCFMT_OK) {
+      EMSG("could not append profile data to the container");
+      return HPCRUN_ERR;
+    }
+  }
   TMSG(DATA_WRITE, "Done!");
 
   return HPCRUN_OK;
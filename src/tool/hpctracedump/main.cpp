@@ -103,21 +103,43 @@ main(int argc, char **argv)
     exit(-1);
   }
 
-  // read and dump trace records until EOF
-  while ( !feof(infs) ) {
-    hpctrace_fmt_datum_t datum;
-
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
-
-    if (ret == HPCFMT_EOF) {
-      break;
+  if (HPCTRACE_HDR_FLAGS_GET_BIT(hdr.flags, HPCTRACE_HDR_FLAGS_BLOCKED_BIT_POS)) {
+    uint64_t end = hpctrace_fmt_blocks_end(infs, NULL, NULL);
+    uint64_t off = ftello(infs);
+    while (off + HPCTRACE_FMT_BlockHdrLen <= end) {
+      hpctrace_fmt_block_hdr_t bhdr;
+      if (hpctrace_fmt_block_hdr_fread(&bhdr, infs) != HPCFMT_OK) {
+        fprintf(stderr, "%s: error reading trace file %s\n", argv[0], fileName);
+        exit(-1);
+      }
+      for (uint32_t i = 0; i < bhdr.count; ++i) {
+        hpctrace_fmt_datum_t datum;
+        if (hpctrace_fmt_datum_fread(&datum, hdr.flags, infs) != HPCFMT_OK) {
+          fprintf(stderr, "%s: error reading trace file %s\n", argv[0], fileName);
+          exit(-1);
+        }
+        printf("%d\n", datum.cpId);
+      }
+      off = ftello(infs);
     }
-    else if (ret == HPCFMT_ERR) {
-      fprintf(stderr, "%s: error reading trace file %s\n", argv[0], fileName);
-      exit(-1);
+  }
+  else {
+    // read and dump trace records until EOF
+    while ( !feof(infs) ) {
+      hpctrace_fmt_datum_t datum;
+
+      ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+
+      if (ret == HPCFMT_EOF) {
+        break;
+      }
+      else if (ret == HPCFMT_ERR) {
+        fprintf(stderr, "%s: error reading trace file %s\n", argv[0], fileName);
+        exit(-1);
+      }
+
+      printf("%d\n", datum.cpId);
     }
-
-    printf("%d\n", datum.cpId);
   }
 
   hpcio_fclose(infs);
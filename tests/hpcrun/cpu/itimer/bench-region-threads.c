@@ -0,0 +1,79 @@
+// Benchmark for unwinding at high thread counts: all threads start each
+// parallel "region" together and call many distinct functions, so that
+// they all look up unwind recipes for code no thread has sampled yet.
+
+#include <error.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+enum {
+  REGIONS = 8,
+  SPIN = 1UL<<14,
+};
+
+static pthread_barrier_t barrier;
+
+#define SPINNER(n) \
+  static __attribute__((noinline)) double spin##n(double x) { \
+    for (unsigned long i = 0; i < SPIN; i++) \
+      x = x * 1.0000001 + n; \
+    return x; \
+  }
+#define SPINNER8(n) \
+  SPINNER(n##0) SPINNER(n##1) SPINNER(n##2) SPINNER(n##3) \
+  SPINNER(n##4) SPINNER(n##5) SPINNER(n##6) SPINNER(n##7)
+
+SPINNER8(1) SPINNER8(2) SPINNER8(3) SPINNER8(4)
+SPINNER8(5) SPINNER8(6) SPINNER8(7) SPINNER8(8)
+
+#define CALL8(n) \
+  spin##n##0, spin##n##1, spin##n##2, spin##n##3, \
+  spin##n##4, spin##n##5, spin##n##6, spin##n##7
+
+static double (*const spinners[])(double) = {
+  CALL8(1), CALL8(2), CALL8(3), CALL8(4),
+  CALL8(5), CALL8(6), CALL8(7), CALL8(8),
+};
+
+enum { NSPINNERS = sizeof spinners / sizeof spinners[0] };
+
+static void* work(void* arg) {
+  double x = (double)(unsigned long)arg;
+  for (int r = 0; r < REGIONS; r++) {
+    pthread_barrier_wait(&barrier);
+    for (unsigned long f = 0; f < NSPINNERS; f++)
+      x = spinners[(f + r * 7) % NSPINNERS](x);
+  }
+  return x == 0.0 ? arg : NULL;
+}
+
+int main(int argc, char* argv[]) {
+  long nthreads = argc > 1 ? strtol(argv[1], NULL, 10) : 1;
+  if (nthreads < 1)
+    error(1, 0, "invalid thread count: %s", argv[1]);
+
+  if (pthread_barrier_init(&barrier, NULL, nthreads) != 0)
+    error(1, 0, "error creating barrier");
+
+  pthread_t* threads = malloc(nthreads * sizeof threads[0]);
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (long i = 0; i < nthreads; i++) {
+    if (pthread_create(&threads[i], NULL, work, (void*)(i + 1)) != 0)
+      error(1, 0, "error creating worker thread");
+  }
+  for (long i = 0; i < nthreads; i++) {
+    if (pthread_join(threads[i], NULL) != 0)
+      error(1, 0, "error joining worker thread");
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  free(threads);
+  pthread_barrier_destroy(&barrier);
+
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  printf("%ld threads: %.3f s for %d regions\n", nthreads, secs, REGIONS);
+  return 0;
+}
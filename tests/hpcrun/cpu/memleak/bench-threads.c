@@ -0,0 +1,50 @@
+#include <error.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Allocation throughput under MEMLEAK: each thread repeatedly fills a
+// window of live blocks and frees them in a scrambled order.
+
+enum {
+  ITERS = 1UL<<20,
+  WINDOW = 1024,
+};
+
+static void* work(void* arg) {
+  void* live[WINDOW] = {0};
+  unsigned int seed = (unsigned int)(unsigned long)arg;
+  for (unsigned long i = 0; i < ITERS; i++) {
+    unsigned long slot = rand_r(&seed) % WINDOW;
+    free(live[slot]);
+    live[slot] = malloc(16 + rand_r(&seed) % 512);
+  }
+  for (unsigned long i = 0; i < WINDOW; i++)
+    free(live[i]);
+  return NULL;
+}
+
+int main(int argc, char* argv[]) {
+  long nthreads = argc > 1 ? strtol(argv[1], NULL, 10) : 1;
+  if (nthreads < 1)
+    error(1, 0, "invalid thread count: %s", argv[1]);
+
+  pthread_t* threads = malloc(nthreads * sizeof threads[0]);
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (long i = 0; i < nthreads; i++) {
+    if (pthread_create(&threads[i], NULL, work, (void*)(i + 1)) != 0)
+      error(1, 0, "error creating worker thread");
+  }
+  for (long i = 0; i < nthreads; i++) {
+    if (pthread_join(threads[i], NULL) != 0)
+      error(1, 0, "error joining worker thread");
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  free(threads);
+
+  double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  printf("%ld threads: %.3f Mallocs/s\n", nthreads, nthreads * (double)ITERS / secs * 1e-6);
+  return 0;
+}
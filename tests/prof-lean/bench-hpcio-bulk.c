@@ -0,0 +1,155 @@
+// Throughput of one big-endian bulk conversion kernel (hpcio-bulk.h),
+// for contiguous arrays and for a column of 12-byte records.  Results
+// are checked against a byte-by-byte conversion first.
+//
+// Usage: bench-hpcio-bulk [-c] <kernel> [values]
+//   -c  only check the results, do not measure the throughput
+// Exits with 77 (skipped) if the CPU does not support the kernel.
+
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/lib/prof-lean/hpcio-bulk.h"
+
+#define RECORD_STRIDE  12
+#define MIN_SECONDS    0.2
+
+static double
+now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t
+be_bytes(const char* p, int size)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < size; i++) {
+    v = (v << 8) | (uint8_t) p[i];
+  }
+  return v;
+}
+
+static int
+check(size_t n, size_t stride, const uint32_t* v4, const uint64_t* v8, char* buf,
+      uint32_t* out4, uint64_t* out8)
+{
+  // odd lengths exercise the scalar tails of the vector kernels
+  for (size_t len = n - 7; len <= n; len++) {
+    memset(buf, 0, n * stride);
+    if (hpcio_be4_encode_n(buf, stride, v4, len) != buf + len * stride) return 1;
+    for (size_t i = 0; i < len; i++) {
+      if (be_bytes(buf + i * stride, 4) != v4[i]) return 1;
+    }
+    if (hpcio_be4_decode_n(out4, buf, stride, len) != buf + len * stride) return 1;
+    if (memcmp(out4, v4, len * sizeof(uint32_t)) != 0) return 1;
+
+    if (stride < 8) continue;
+    memset(buf, 0, n * stride);
+    hpcio_be8_encode_n(buf, stride, v8, len);
+    for (size_t i = 0; i < len; i++) {
+      if (be_bytes(buf + i * stride, 8) != v8[i]) return 1;
+    }
+    hpcio_be8_decode_n(out8, buf, stride, len);
+    if (memcmp(out8, v8, len * sizeof(uint64_t)) != 0) return 1;
+  }
+  return 0;
+}
+
+typedef enum { ENC4, DEC4, ENC8, DEC8 } op_t;
+static const char* op_names[] = { "encode u32", "decode u32", "encode u64", "decode u64" };
+
+static void
+run(op_t op, size_t n, size_t stride, const uint32_t* v4, const uint64_t* v8,
+    char* buf, uint32_t* out4, uint64_t* out8)
+{
+  size_t reps = 0;
+  double start = now(), elapsed;
+  do {
+    for (int k = 0; k < 8; k++, reps++) {
+      switch (op) {
+      case ENC4: hpcio_be4_encode_n(buf, stride, v4, n); break;
+      case DEC4: hpcio_be4_decode_n(out4, buf, stride, n); break;
+      case ENC8: hpcio_be8_encode_n(buf, stride, v8, n); break;
+      case DEC8: hpcio_be8_decode_n(out8, buf, stride, n); break;
+      }
+    }
+    elapsed = now() - start;
+  } while (elapsed < MIN_SECONDS);
+
+  double values = (double) reps * n;
+  printf("%-7s %s, stride %2zu: %8.1f Mvalues/s\n", hpcio_bulk_kernel(),
+         op_names[op], stride, values / elapsed * 1e-6);
+}
+
+int
+main(int argc, char** argv)
+{
+  const char* prog = argv[0];
+  int check_only = 0;
+  if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+    check_only = 1;
+    argc--;
+    argv++;
+  }
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s [-c] <kernel> [values]\n", prog);
+    return 2;
+  }
+  if (!hpcio_bulk_select(argv[1])) {
+    printf("kernel %s is not available on this CPU\n", argv[1]);
+    return 77;
+  }
+  size_t n = (argc > 2) ? strtoul(argv[2], NULL, 10) : (1 << 16);
+  if (n < 8) n = 8;
+
+  uint32_t* v4 = malloc(n * sizeof(uint32_t));
+  uint64_t* v8 = malloc(n * sizeof(uint64_t));
+  uint32_t* out4 = malloc(n * sizeof(uint32_t));
+  uint64_t* out8 = malloc(n * sizeof(uint64_t));
+  char* buf = malloc(n * RECORD_STRIDE);
+  if (!v4 || !v8 || !out4 || !out8 || !buf) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  uint64_t x = 0x9e3779b97f4a7c15;
+  for (size_t i = 0; i < n; i++) {
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    v4[i] = (uint32_t) x;
+    v8[i] = x;
+  }
+
+  const size_t strides[] = { 4, 8, RECORD_STRIDE };
+  for (size_t s = 0; s < sizeof(strides) / sizeof(strides[0]); s++) {
+    if (check(n, strides[s], v4, v8, buf, out4, out8) != 0) {
+      fprintf(stderr, "%s: wrong result with stride %zu\n", argv[1], strides[s]);
+      return 1;
+    }
+  }
+
+  if (check_only) {
+    printf("%s: %zu values correct\n", argv[1], n);
+    free(v4); free(v8); free(out4); free(out8); free(buf);
+    return 0;
+  }
+
+  run(ENC4, n, 4, v4, v8, buf, out4, out8);
+  run(DEC4, n, 4, v4, v8, buf, out4, out8);
+  run(ENC8, n, 8, v4, v8, buf, out4, out8);
+  run(DEC8, n, 8, v4, v8, buf, out4, out8);
+  run(ENC4, n, RECORD_STRIDE, v4, v8, buf, out4, out8);
+  run(DEC4, n, RECORD_STRIDE, v4, v8, buf, out4, out8);
+  run(ENC8, n, RECORD_STRIDE, v4, v8, buf, out4, out8);
+  run(DEC8, n, RECORD_STRIDE, v4, v8, buf, out4, out8);
+
+  free(v4); free(v8); free(out4); free(out8); free(buf);
+  return 0;
+}